@@ -0,0 +1,34 @@
+#!/bin/bash
+
+# Author: zhangbinbin
+# Created on 2016-08-28
+
+if [ $# != 1 ]; then 
+    echo "Analyse the synchronization timelines of the mpi workers and servers,"
+    echo "written by the --sync-profile option, one line every rank"
+    echo "Usage: $0 sync_profile"
+    echo "eg: $0 exp/dnn_fbank_bsp/log/sync.iter1"
+    exit 1;
+fi
+
+prefix=$1
+
+printf "%-6s %8s %10s %10s %10s %10s %10s %10s %10s %8s\n" \
+    rank syncs span copy comm wait update sent_mb recv_mb wait%
+# Only the files ending with a rank, in the order of the rank
+for x in $(ls $prefix.* | awk -F. '$NF ~ /^[0-9]+$/ {print $NF" "$0}' | sort -n | cut -d' ' -f2-); do
+    rank=${x##*.}
+    grep -v "^#" $x | awk -v rank=$rank '
+    { 
+        if (NR == 1) begin = $2;
+        end = $2 + $3 + $4 + $5 + $6;
+        copy += $3; comm += $4; wait += $5; update += $6;
+        sent += $7; recv += $8;
+    }
+    END {
+        span = end - begin;
+        printf "%-6s %8d %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f %8.1f\n",
+            rank, NR, span, copy, comm, wait, update,
+            sent / 1048576, recv / 1048576, (span > 0 ? 100 * wait / span : 0);
+    }'
+done
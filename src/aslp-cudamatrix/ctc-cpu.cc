@@ -0,0 +1,132 @@
+// aslp-cudamatrix/ctc-cpu.cc
+
+// Copyright 2016  ASLP (Author: zhangbinbin liwenpeng duwei)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "aslp-cudamatrix/ctc-cpu.h"
+#include "aslp-cudamatrix/ctc-utils.h"
+
+namespace kaldi {
+
+// LogAPlusB without the log and exp when an operand is log_zero_ (it gives
+// the larger one then), most of the cells are log_zero_ far from the diagonal
+// of the lattice
+template<typename Real>
+static inline Real CtcLogAdd(Real a, Real b) {
+  if (a == NumericLimits<Real>::log_zero_ || b == NumericLimits<Real>::log_zero_)
+    return std::max(a, b);
+  return LogAPlusB(a, b);
+}
+
+template<typename Real>
+void CtcAlphaRow(const Real *log_prob, const Real *prev_alpha,
+                 const int32 *labels, int32 num_labels, Real *alpha) {
+  if (prev_alpha == NULL) {
+    for (int32 s = 0; s < num_labels; s++) {
+      alpha[s] = (s < 2) ? log_prob[labels[s]] : NumericLimits<Real>::log_zero_;
+    }
+    return;
+  }
+  alpha[0] = AddAB(log_prob[labels[0]], prev_alpha[0]);
+  if (num_labels > 1) {
+    alpha[1] = AddAB(log_prob[labels[1]],
+                     CtcLogAdd(prev_alpha[0], prev_alpha[1]));
+  }
+  for (int32 s = 2; s < num_labels; s++) {
+    Real sum = CtcLogAdd(prev_alpha[s-1], prev_alpha[s]);
+    // skip the blank between two different labels
+    if (s % 2 == 1 && labels[s-2] != labels[s]) {
+      sum = CtcLogAdd(prev_alpha[s-2], sum);
+    }
+    alpha[s] = AddAB(log_prob[labels[s]], sum);
+  }
+}
+
+template<typename Real>
+void CtcBetaRow(const Real *log_prob, const Real *next_beta,
+                const int32 *labels, int32 num_labels, Real *beta) {
+  if (next_beta == NULL) {
+    for (int32 s = 0; s < num_labels; s++) {
+      beta[s] = (s > num_labels - 3) ? log_prob[labels[s]] :
+                                       NumericLimits<Real>::log_zero_;
+    }
+    return;
+  }
+  for (int32 s = 0; s < num_labels - 2; s++) {
+    Real sum = CtcLogAdd(next_beta[s+1], next_beta[s]);
+    if (s % 2 == 1 && labels[s+2] != labels[s]) {
+      sum = CtcLogAdd(next_beta[s+2], sum);
+    }
+    beta[s] = AddAB(log_prob[labels[s]], sum);
+  }
+  if (num_labels > 1) {
+    int32 s = num_labels - 2;
+    beta[s] = AddAB(log_prob[labels[s]], CtcLogAdd(next_beta[s+1], next_beta[s]));
+  }
+  int32 s = num_labels - 1;
+  beta[s] = AddAB(log_prob[labels[s]], next_beta[s]);
+}
+
+template<typename Real>
+void CtcErrorRow(const Real *alpha, const Real *beta, const Real *prob,
+                 const int32 *labels, int32 num_labels, int32 num_classes,
+                 Real pzx, Real *error) {
+  // accumulate alpha * beta of every class in place first
+  for (int32 c = 0; c < num_classes; c++) {
+    error[c] = NumericLimits<Real>::log_zero_;
+  }
+  for (int32 s = 0; s < num_labels; s++) {
+    error[labels[s]] = CtcLogAdd(error[labels[s]], AddAB(alpha[s], beta[s]));
+  }
+  for (int32 c = 0; c < num_classes; c++) {
+    // no label of the class, -exp(log_zero_)
+    if (error[c] == NumericLimits<Real>::log_zero_) {
+      error[c] = -0.0;
+      continue;
+    }
+    Real log_prob2 = (prob[c] == 0) ? NumericLimits<Real>::log_zero_ :
+                                      2 * log(prob[c]);
+    error[c] = -1.0 * ExpA(SubAB(error[c], AddAB(pzx, log_prob2)));
+  }
+}
+
+template
+void CtcAlphaRow<float>(const float *log_prob, const float *prev_alpha,
+                        const int32 *labels, int32 num_labels, float *alpha);
+template
+void CtcAlphaRow<double>(const double *log_prob, const double *prev_alpha,
+                         const int32 *labels, int32 num_labels, double *alpha);
+template
+void CtcBetaRow<float>(const float *log_prob, const float *next_beta,
+                       const int32 *labels, int32 num_labels, float *beta);
+template
+void CtcBetaRow<double>(const double *log_prob, const double *next_beta,
+                        const int32 *labels, int32 num_labels, double *beta);
+template
+void CtcErrorRow<float>(const float *alpha, const float *beta,
+                        const float *prob, const int32 *labels,
+                        int32 num_labels, int32 num_classes, float pzx,
+                        float *error);
+template
+void CtcErrorRow<double>(const double *alpha, const double *beta,
+                         const double *prob, const int32 *labels,
+                         int32 num_labels, int32 num_classes, double pzx,
+                         double *error);
+
+}  // namespace kaldi
@@ -0,0 +1,56 @@
+// aslp-cudamatrix/ctc-cpu.h
+
+// Copyright 2016  ASLP (Author: zhangbinbin liwenpeng duwei)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CUDAMATRIX_CTC_CPU_H_
+#define CUDAMATRIX_CTC_CPU_H_
+
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/*
+ * CPU version of the CTC kernels in cu-kernels.cu, one frame of one sequence
+ * per call. The values are in the log scale (NumericLimits<Real>::log_zero_
+ * for zero) except the prob of CtcErrorRow, and labels are the expanded
+ * label sequence (blank between and around the labels) of num_labels.
+ * Within a frame there is no dependency along the label axis.
+ */
+
+/// alpha(t, .) from log_prob(t, .) and alpha(t-1, .), prev_alpha is NULL
+/// for the first frame
+template<typename Real>
+void CtcAlphaRow(const Real *log_prob, const Real *prev_alpha,
+                 const int32 *labels, int32 num_labels, Real *alpha);
+
+/// beta(t, .) from log_prob(t, .) and beta(t+1, .), next_beta is NULL for
+/// the last frame
+template<typename Real>
+void CtcBetaRow(const Real *log_prob, const Real *next_beta,
+                const int32 *labels, int32 num_labels, Real *beta);
+
+/// Error of the num_classes softmax outputs of a frame,
+/// -sum_{labels[s] == c} alpha(s) beta(s) / (p(z|x) prob(c)^2)
+template<typename Real>
+void CtcErrorRow(const Real *alpha, const Real *beta, const Real *prob,
+                 const int32 *labels, int32 num_labels, int32 num_classes,
+                 Real pzx, Real *error);
+
+}  // namespace kaldi
+
+#endif
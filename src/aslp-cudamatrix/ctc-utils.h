@@ -19,6 +19,8 @@
 #ifndef CUDAMATRIX_CTC_UTILS_H_
 #define CUDAMATRIX_CTC_UTILS_H_
 
+#include <cmath>
+
 //#if HAVE_CUDA == 1
 #pragma GCC diagnostic warning "-fpermissive"
 
@@ -47,11 +49,16 @@ struct NumericLimits<double>
   static const double max_ = 1.7976931348623157e+308;
 };
 
+// The operations are used by the CUDA kernels and by the CPU code (ctc-cpu.h)
 #if HAVE_CUDA == 1
+#define CTC_HOST_DEVICE __host__ __device__
+#else
+#define CTC_HOST_DEVICE
+#endif
 
 // a + b, where a and b are assumed to be in the log scale 
 template <typename T>
-static inline __host__ __device__ T AddAB(T a, T b)
+static inline CTC_HOST_DEVICE T AddAB(T a, T b)
 {
   if (a == NumericLimits<T>::log_zero_ || b == NumericLimits<T>::log_zero_)
     return NumericLimits<T>::log_zero_;
@@ -61,7 +68,7 @@ static inline __host__ __device__ T AddAB(T a, T b)
 
 // a - b, where a and b are assumed to be in the log scale
 template <typename T>
-static inline __host__ __device__ T SubAB(T a, T b)
+static inline CTC_HOST_DEVICE T SubAB(T a, T b)
 {
   if (a == NumericLimits<T>::log_zero_)
     return NumericLimits<T>::log_zero_;
@@ -73,7 +80,7 @@ static inline __host__ __device__ T SubAB(T a, T b)
 
 // exp(a)
 template <typename T>
-static inline __host__ __device__ T ExpA(T a)
+static inline CTC_HOST_DEVICE T ExpA(T a)
 {
   if (a <= NumericLimits<T>::log_zero_)
     return 0;
@@ -86,23 +93,13 @@ static inline __host__ __device__ T ExpA(T a)
 // Approximation of  log(a + b) = log(a) + log(1 + b/a), if b < a
 //                              = log(b) + log(1 + a/b), if a < b
 template <typename T>
-static inline __host__ __device__ T LogAPlusB(T a, T b) // x and y are in log scale and so is the result
+static inline CTC_HOST_DEVICE T LogAPlusB(T a, T b) // x and y are in log scale and so is the result
   {
     if (b < a)
-      return AddAB(a, log(1 + ExpA(SubAB(b, a))));
+      return AddAB<T>(a, log(1 + ExpA(SubAB(b, a))));
     else
-      return AddAB(b, log(1 + ExpA(SubAB(a, b))));
+      return AddAB<T>(b, log(1 + ExpA(SubAB(a, b))));
   }
 
-#else
-
-// exp(a)
-template <typename T>
-static inline T ExpA(T a)
-{
-  return exp(a);
-}
-
-#endif // HAVE_CUDA
 
 #endif
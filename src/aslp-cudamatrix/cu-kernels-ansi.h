@@ -98,6 +98,8 @@ void cudaF_add_mat_diag_vec(dim3 Gr, dim3 Bl, float alpha, float *mat, MatrixDim
 void cudaF_add_mat_mat_elements(dim3 Gr, dim3 Bl, float *data, const float *srcA_data, const float *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, float alpha, float beta);
 void cudaF_add_row_sum_mat(dim3 Gr, dim3 Bl, float *data, const float *src_data, MatrixDim dim, int src_stride, int patch_nrows, float alpha, float beta);
 void cudaF_add_conv_mat_mat_elements(dim3 Gr, dim3 Bl, float *data, const float *srcA_data, const float *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, float alpha, float beta);
+void cudaF_add_depthwise_conv(dim3 Gr, dim3 Bl, float *data, const float *srcA_data, const float *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, int srcB_rows, float alpha, float beta);
+void cudaF_add_depthwise_conv_grad(dim3 Gr, dim3 Bl, float *data, const float *srcA_data, const float *diff_data, MatrixDim dim, int srcA_stride, int diff_stride, int diff_rows, float alpha, float beta);
 
 /*
  * CuVector
@@ -242,6 +244,8 @@ void cudaD_add_mat_diag_vec(dim3 Gr, dim3 Bl, double alpha, double *mat, MatrixD
 void cudaD_add_mat_mat_elements(dim3 Gr, dim3 Bl, double *data, const double *srcA_data, const double *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, double alpha, double beta);
 void cudaD_add_row_sum_mat(dim3 Gr, dim3 Bl, double *data, const double *src_data, MatrixDim dim, int src_stride, int patch_nrows, double alpha, double beta);
 void cudaD_add_conv_mat_mat_elements(dim3 Gr, dim3 Bl, double *data, const double *srcA_data, const double *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, double alpha, double beta);
+void cudaD_add_depthwise_conv(dim3 Gr, dim3 Bl, double *data, const double *srcA_data, const double *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, int srcB_rows, double alpha, double beta);
+void cudaD_add_depthwise_conv_grad(dim3 Gr, dim3 Bl, double *data, const double *srcA_data, const double *diff_data, MatrixDim dim, int srcA_stride, int diff_stride, int diff_rows, double alpha, double beta);
 /*
  * CuVector
  */
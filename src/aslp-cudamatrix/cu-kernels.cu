@@ -781,6 +781,46 @@ static void _add_conv_mat_mat_elements(Real *data, const Real *srcA_data, const
     }
 }
 
+// row j of data from the rows [j, j + srcB_rows) of srcA
+template<typename Real>
+__global__
+static void _add_depthwise_conv(Real *data, const Real *srcA_data, const Real *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, int srcB_rows, Real alpha, Real beta) {
+    int32_cuda i = blockIdx.x * blockDim.x + threadIdx.x;
+    int32_cuda j = blockIdx.y * blockDim.y + threadIdx.y;
+    int32_cuda tgt_index = i + j*dim.stride;
+
+    if (i < dim.cols && j < dim.rows) {
+        int32_cuda srcA_index = i + j*srcA_stride, srcB_index = i;
+        Real sum = 0.0;
+        for (int32_cuda k = 0; k < srcB_rows; k++) {
+            sum += srcA_data[srcA_index] * srcB_data[srcB_index];
+            srcA_index += srcA_stride;
+            srcB_index += srcB_stride;
+        }
+        data[tgt_index] = alpha * sum + beta * data[tgt_index];
+    }
+}
+
+// row j of data from the rows [j, j + diff_rows) of srcA
+template<typename Real>
+__global__
+static void _add_depthwise_conv_grad(Real *data, const Real *srcA_data, const Real *diff_data, MatrixDim dim, int srcA_stride, int diff_stride, int diff_rows, Real alpha, Real beta) {
+    int32_cuda i = blockIdx.x * blockDim.x + threadIdx.x;
+    int32_cuda j = blockIdx.y * blockDim.y + threadIdx.y;
+    int32_cuda tgt_index = i + j*dim.stride;
+
+    if (i < dim.cols && j < dim.rows) {
+        int32_cuda srcA_index = i + j*srcA_stride, diff_index = i;
+        Real sum = 0.0;
+        for (int32_cuda t = 0; t < diff_rows; t++) {
+            sum += srcA_data[srcA_index] * diff_data[diff_index];
+            srcA_index += srcA_stride;
+            diff_index += diff_stride;
+        }
+        data[tgt_index] = alpha * sum + beta * data[tgt_index];
+    }
+}
+
 
 
 /*
@@ -2421,6 +2461,14 @@ void cudaF_add_conv_mat_mat_elements(dim3 Gr, dim3 Bl, float *data, const float
     _add_conv_mat_mat_elements<<<Gr, Bl>>>(data, srcA_data, srcB_data, dim, srcA_stride, srcB_stride, alpha, beta);
 }
 
+void cudaF_add_depthwise_conv(dim3 Gr, dim3 Bl, float *data, const float *srcA_data, const float *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, int srcB_rows, float alpha, float beta) {
+    _add_depthwise_conv<<<Gr, Bl>>>(data, srcA_data, srcB_data, dim, srcA_stride, srcB_stride, srcB_rows, alpha, beta);
+}
+
+void cudaF_add_depthwise_conv_grad(dim3 Gr, dim3 Bl, float *data, const float *srcA_data, const float *diff_data, MatrixDim dim, int srcA_stride, int diff_stride, int diff_rows, float alpha, float beta) {
+    _add_depthwise_conv_grad<<<Gr, Bl>>>(data, srcA_data, diff_data, dim, srcA_stride, diff_stride, diff_rows, alpha, beta);
+}
+
 // CURRENTLY UNUSED...
 void cudaF_apply_mask(dim3 Gr, dim3 Bl, float* mat, const char* mask, MatrixDim dmat, MatrixDim dmask) {
   _apply_mask<<<Gr,Bl>>>(mat,mask,dmat,dmask);
@@ -2898,6 +2946,14 @@ void cudaD_add_conv_mat_mat_elements(dim3 Gr, dim3 Bl, double *data, const doubl
     _add_conv_mat_mat_elements<<<Gr, Bl>>>(data, srcA_data, srcB_data, dim, srcA_stride, srcB_stride, alpha, beta);
 }
 
+void cudaD_add_depthwise_conv(dim3 Gr, dim3 Bl, double *data, const double *srcA_data, const double *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, int srcB_rows, double alpha, double beta) {
+    _add_depthwise_conv<<<Gr, Bl>>>(data, srcA_data, srcB_data, dim, srcA_stride, srcB_stride, srcB_rows, alpha, beta);
+}
+
+void cudaD_add_depthwise_conv_grad(dim3 Gr, dim3 Bl, double *data, const double *srcA_data, const double *diff_data, MatrixDim dim, int srcA_stride, int diff_stride, int diff_rows, double alpha, double beta) {
+    _add_depthwise_conv_grad<<<Gr, Bl>>>(data, srcA_data, diff_data, dim, srcA_stride, diff_stride, diff_rows, alpha, beta);
+}
+
 // CURRENTLY UNUSED...
 void cudaD_apply_mask(dim3 Gr, dim3 Bl, double* mat, const char* mask, MatrixDim dmat, MatrixDim dmask) {
   _apply_mask<<<Gr,Bl>>>(mat,mask,dmat,dmask);
@@ -193,6 +193,8 @@ inline void cuda_add_mat_diag_vec(dim3 Gr, dim3 Bl, float alpha, float *mat, Mat
 inline void cuda_add_mat_mat_elements(dim3 Gr, dim3 Bl, float *data, const float *srcA_data, const float *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, float alpha, float beta) { cudaF_add_mat_mat_elements(Gr, Bl, data, srcA_data, srcB_data, dim, srcA_stride, srcB_stride, alpha, beta); } 
 inline void cuda_add_row_sum_mat(dim3 Gr, dim3 Bl, float *data, const float *src_data, MatrixDim dim, int src_stride, int patch_nrows, float alpha, float beta) { cudaF_add_row_sum_mat(Gr, Bl, data, src_data, dim, src_stride, patch_nrows, alpha, beta); }
 inline void cuda_add_conv_mat_mat_elements(dim3 Gr, dim3 Bl, float *data, const float *srcA_data, const float *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, float alpha, float beta) { cudaF_add_conv_mat_mat_elements(Gr, Bl, data, srcA_data, srcB_data, dim, srcA_stride, srcB_stride, alpha, beta); } 
+inline void cuda_add_depthwise_conv(dim3 Gr, dim3 Bl, float *data, const float *srcA_data, const float *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, int srcB_rows, float alpha, float beta) { cudaF_add_depthwise_conv(Gr, Bl, data, srcA_data, srcB_data, dim, srcA_stride, srcB_stride, srcB_rows, alpha, beta); }
+inline void cuda_add_depthwise_conv_grad(dim3 Gr, dim3 Bl, float *data, const float *srcA_data, const float *diff_data, MatrixDim dim, int srcA_stride, int diff_stride, int diff_rows, float alpha, float beta) { cudaF_add_depthwise_conv_grad(Gr, Bl, data, srcA_data, diff_data, dim, srcA_stride, diff_stride, diff_rows, alpha, beta); }
  
 /*
  * CuVector
@@ -381,6 +383,8 @@ inline void cuda_add_mat_diag_vec(dim3 Gr, dim3 Bl, double alpha, double *mat, M
 inline void cuda_add_mat_mat_elements(dim3 Gr, dim3 Bl, double *data, const double *srcA_data, const double *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, double alpha, double beta) { cudaD_add_mat_mat_elements(Gr, Bl, data, srcA_data, srcB_data, dim, srcA_stride, srcB_stride, alpha, beta); }
 inline void cuda_add_row_sum_mat(dim3 Gr, dim3 Bl, double *data, const double *src_data, MatrixDim dim, int src_stride, int patch_nrows, double alpha, double beta) { cudaD_add_row_sum_mat(Gr, Bl, data, src_data, dim, src_stride, patch_nrows, alpha, beta); }
 inline void cuda_add_conv_mat_mat_elements(dim3 Gr, dim3 Bl, double *data, const double *srcA_data, const double *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, double alpha, double beta) { cudaD_add_conv_mat_mat_elements(Gr, Bl, data, srcA_data, srcB_data, dim, srcA_stride, srcB_stride, alpha, beta); }
+inline void cuda_add_depthwise_conv(dim3 Gr, dim3 Bl, double *data, const double *srcA_data, const double *srcB_data, MatrixDim dim, int srcA_stride, int srcB_stride, int srcB_rows, double alpha, double beta) { cudaD_add_depthwise_conv(Gr, Bl, data, srcA_data, srcB_data, dim, srcA_stride, srcB_stride, srcB_rows, alpha, beta); }
+inline void cuda_add_depthwise_conv_grad(dim3 Gr, dim3 Bl, double *data, const double *srcA_data, const double *diff_data, MatrixDim dim, int srcA_stride, int diff_stride, int diff_rows, double alpha, double beta) { cudaD_add_depthwise_conv_grad(Gr, Bl, data, srcA_data, diff_data, dim, srcA_stride, diff_stride, diff_rows, alpha, beta); }
 
 /*
  * CuVector
@@ -139,6 +139,99 @@ static void UnitTestCuMathSplice() {
   }
 }
 
+// The element-wise ops the LSTM components did before cu::LstmCellForward
+template<typename Real>
+static void LstmCellForwardOps(const CuMatrixBase<Real> &prev_c,
+                               const CuVectorBase<Real> &peephole_i_c,
+                               const CuVectorBase<Real> &peephole_f_c,
+                               const CuVectorBase<Real> &peephole_o_c,
+                               Real cell_clip, CuMatrixBase<Real> *y) {
+  int32 n = prev_c.NumCols();
+  CuSubMatrix<Real> y_g(y->ColRange(0 * n, n)), y_i(y->ColRange(1 * n, n)),
+      y_f(y->ColRange(2 * n, n)), y_o(y->ColRange(3 * n, n)),
+      y_c(y->ColRange(4 * n, n)), y_h(y->ColRange(5 * n, n)),
+      y_m(y->ColRange(6 * n, n));
+  y_i.AddMatDiagVec(1.0, prev_c, kNoTrans, peephole_i_c, 1.0);
+  y_f.AddMatDiagVec(1.0, prev_c, kNoTrans, peephole_f_c, 1.0);
+  y_i.Sigmoid(y_i);
+  y_f.Sigmoid(y_f);
+  y_g.Tanh(y_g);
+  y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
+  y_c.AddMatMatElements(1.0, prev_c, y_f, 1.0);
+  y_c.ApplyFloor(-cell_clip);
+  y_c.ApplyCeiling(cell_clip);
+  y_h.Tanh(y_c);
+  y_o.AddMatDiagVec(1.0, y_c, kNoTrans, peephole_o_c, 1.0);
+  y_o.Sigmoid(y_o);
+  y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+}
+
+template<typename Real>
+static void UnitTestCuMathLstmCellForward() {
+  int32 S = 1 + Rand() % 20, n = 10 + Rand() % 100;
+  CuMatrix<Real> prev_c(S, n), y(S, 7 * n + 5);
+  CuVector<Real> pi(n), pf(n), po(n);
+  prev_c.SetRandn();
+  prev_c.Scale(4.0);
+  // the cell is clipped at 1.0, so some of the cells hit the clipping
+  y.SetRandn();
+  y.Scale(4.0);
+  pi.SetRandn();
+  pf.SetRandn();
+  po.SetRandn();
+  CuMatrix<Real> y_ref(y);
+  cu::LstmCellForward(prev_c, pi, pf, po, Real(1.0), &y);
+  LstmCellForwardOps(prev_c, pi, pf, po, Real(1.0), &y_ref);
+  AssertEqual(y, y_ref);
+}
+
+template<typename Real>
+static void UnitTestCuMathCifgLstmCellForward() {
+  int32 S = 1 + Rand() % 20, n = 10 + Rand() % 100;
+  CuMatrix<Real> prev_c(S, n), y(S, 6 * n);
+  CuVector<Real> pf(n), po(n), pi(n);
+  prev_c.SetRandn();
+  y.SetRandn();
+  pf.SetRandn();
+  po.SetRandn();
+  // the same as LstmCellForward with i = 1 - f, i.e. the input gate
+  // pre-activation -f with no peephole
+  CuMatrix<Real> y_ref(S, 7 * n);
+  y_ref.ColRange(0, n).CopyFromMat(y.ColRange(0, n));
+  y_ref.ColRange(1 * n, n).CopyFromMat(y.ColRange(n, n));
+  y_ref.ColRange(1 * n, n).AddMatDiagVec(1.0, prev_c, kNoTrans, pf, 1.0);
+  y_ref.ColRange(1 * n, n).Scale(-1.0);
+  y_ref.ColRange(2 * n, 2 * n).CopyFromMat(y.ColRange(n, 2 * n));
+  cu::CifgLstmCellForward(prev_c, pf, po, Real(50.0), &y);
+  LstmCellForwardOps(prev_c, pi, pf, po, Real(50.0), &y_ref);
+  AssertEqual(y.ColRange(0, n), y_ref.ColRange(0, n));
+  AssertEqual(y.ColRange(n, 5 * n), y_ref.ColRange(2 * n, 5 * n));
+}
+
+template<typename Real>
+static void UnitTestCuMathGruForward() {
+  int32 S = 1 + Rand() % 20, n = 10 + Rand() % 100;
+  CuMatrix<Real> prev_h(S, n), y(S, 5 * n);
+  prev_h.SetRandn();
+  y.SetRandn();
+  Matrix<Real> y_in(y), h(prev_h);
+  cu::GruGateForward(prev_h, &y);
+  cu::GruOutputForward(prev_h, &y);
+  Matrix<Real> y_out(y);
+  for (int32 s = 0; s < S; s++) {
+    for (int32 j = 0; j < n; j++) {
+      Real z = 1.0 / (1.0 + Exp(-y_in(s, j))),
+          r = 1.0 / (1.0 + Exp(-y_in(s, n + j))),
+          m = std::tanh(y_in(s, 2 * n + j));
+      AssertEqual(z, y_out(s, j));
+      AssertEqual(r, y_out(s, n + j));
+      AssertEqual(m, y_out(s, 2 * n + j));
+      AssertEqual(r * h(s, j), y_out(s, 3 * n + j));
+      AssertEqual((1 - z) * h(s, j) + z * m, y_out(s, 4 * n + j));
+    }
+  }
+}
+
 template<typename Real> void CudaMathUnitTest() {
   #if HAVE_CUDA == 1  
     if (CuDevice::Instantiate().DoublePrecisionSupported())
@@ -146,6 +239,9 @@ template<typename Real> void CudaMathUnitTest() {
   UnitTestCuMathRandomize<Real>();
   UnitTestCuMathSplice<Real>();
   UnitTestCuMathCopy<Real>();
+  UnitTestCuMathLstmCellForward<Real>();
+  UnitTestCuMathCifgLstmCellForward<Real>();
+  UnitTestCuMathGruForward<Real>();
 }
 
 
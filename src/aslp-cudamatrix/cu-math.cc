@@ -18,9 +18,14 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "base/timer.h"
 #include "aslp-cudamatrix/cu-common.h"
 #include "aslp-cudamatrix/cu-matrix.h"
+#include "aslp-cudamatrix/cu-vector.h"
 #include "aslp-cudamatrix/cu-device.h"
 #include "aslp-cudamatrix/cu-kernels.h"
 
@@ -205,6 +210,356 @@ void Copy(const CuMatrixBase<Real> &src, const CuArray<int32> &copy_from_indices
   }
 }
 
+// The same formulas as VectorBase::Sigmoid() and VectorBase::Tanh()
+template<typename Real>
+static inline Real CellSigmoid(Real x) {
+  if (x > 0.0) return 1.0 / (1.0 + Exp(-x));
+  Real ex = Exp(x);
+  return ex / (ex + 1.0);
+}
+
+template<typename Real>
+static inline Real CellTanh(Real x) {
+  if (x > 0.0) {
+    Real inv_expx = Exp(-x);
+    return -1.0 + 2.0 / (1.0 + inv_expx * inv_expx);
+  }
+  Real inv_expx = Exp(x);
+  return 1.0 - 2.0 / (1.0 + inv_expx * inv_expx);
+}
+
+// The row kernels of the time steps on the host, the cells [begin, n) of
+// one stream, y points to the first column of the row of the stream
+template<typename Real>
+static void LstmCellRow(const Real *cp, const Real *pi, const Real *pf,
+                        const Real *po, Real clip, int32 begin, int32 n,
+                        Real *y) {
+  Real *g = y, *i = g + n, *f = i + n, *o = f + n, *c = o + n, *h = c + n,
+      *m = h + n;
+  for (int32 j = begin; j < n; j++) {
+    Real i_j = CellSigmoid<Real>(i[j] + cp[j] * pi[j]),
+        f_j = CellSigmoid<Real>(f[j] + cp[j] * pf[j]),
+        g_j = CellTanh<Real>(g[j]),
+        c_j = g_j * i_j + cp[j] * f_j;
+    if (c_j < -clip) c_j = -clip;
+    if (c_j > clip) c_j = clip;
+    Real h_j = CellTanh<Real>(c_j), o_j = CellSigmoid<Real>(o[j] + c_j * po[j]);
+    g[j] = g_j; i[j] = i_j; f[j] = f_j; o[j] = o_j;
+    c[j] = c_j; h[j] = h_j; m[j] = h_j * o_j;
+  }
+}
+
+template<typename Real>
+static void CifgLstmCellRow(const Real *cp, const Real *pf, const Real *po,
+                            Real clip, int32 begin, int32 n, Real *y) {
+  Real *g = y, *f = g + n, *o = f + n, *c = o + n, *h = c + n, *m = h + n;
+  for (int32 j = begin; j < n; j++) {
+    Real f_j = CellSigmoid<Real>(f[j] + cp[j] * pf[j]),
+        g_j = CellTanh<Real>(g[j]),
+        c_j = g_j * (1.0 - f_j) + cp[j] * f_j;
+    if (c_j < -clip) c_j = -clip;
+    if (c_j > clip) c_j = clip;
+    Real h_j = CellTanh<Real>(c_j), o_j = CellSigmoid<Real>(o[j] + c_j * po[j]);
+    g[j] = g_j; f[j] = f_j; o[j] = o_j;
+    c[j] = c_j; h[j] = h_j; m[j] = h_j * o_j;
+  }
+}
+
+template<typename Real>
+static void GruGateRow(const Real *hp, int32 begin, int32 n, Real *y) {
+  Real *z = y, *r = z + n, *g = r + 2 * n;
+  for (int32 j = begin; j < n; j++) {
+    z[j] = CellSigmoid<Real>(z[j]);
+    r[j] = CellSigmoid<Real>(r[j]);
+    g[j] = r[j] * hp[j];
+  }
+}
+
+template<typename Real>
+static void GruOutputRow(const Real *hp, int32 begin, int32 n, Real *y) {
+  Real *z = y, *m = z + 2 * n, *h = z + 4 * n;
+  for (int32 j = begin; j < n; j++) {
+    m[j] = CellTanh<Real>(m[j]);
+    h[j] = hp[j] - hp[j] * z[j] + z[j] * m[j];
+  }
+}
+
+// The kernels of a whole row, which are vectorized for float below
+template<typename Real>
+static inline void LstmCellRow(const Real *cp, const Real *pi, const Real *pf,
+                               const Real *po, Real clip, int32 n, Real *y) {
+  LstmCellRow(cp, pi, pf, po, clip, 0, n, y);
+}
+
+template<typename Real>
+static inline void CifgLstmCellRow(const Real *cp, const Real *pf,
+                                   const Real *po, Real clip, int32 n,
+                                   Real *y) {
+  CifgLstmCellRow(cp, pf, po, clip, 0, n, y);
+}
+
+template<typename Real>
+static inline void GruGateRow(const Real *hp, int32 n, Real *y) {
+  GruGateRow(hp, 0, n, y);
+}
+
+template<typename Real>
+static inline void GruOutputRow(const Real *hp, int32 n, Real *y) {
+  GruOutputRow(hp, 0, n, y);
+}
+
+#if defined(__SSE2__)
+// exp() of 4 floats by the polynomial of the Cephes library, the relative
+// error is about 2e-7 on [-87, 88], the input is clamped to [-88.37, 88.37]
+static inline __m128 Exp4(__m128 x) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  x = _mm_min_ps(x, _mm_set1_ps(88.3762626647949f));
+  x = _mm_max_ps(x, _mm_set1_ps(-88.3762626647949f));
+  // x = n * log(2) + r, |r| <= log(2) / 2
+  __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)),
+                         _mm_set1_ps(0.5f));
+  __m128 tmp = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+  fx = _mm_sub_ps(tmp, _mm_and_ps(_mm_cmpgt_ps(tmp, fx), one));
+  x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(0.693359375f)));
+  x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(-2.12194440e-4f)));
+  __m128 z = _mm_mul_ps(x, x);
+  __m128 y = _mm_set1_ps(1.9875691500e-4f);
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507e-3f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073e-3f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894e-2f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459e-1f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201e-1f));
+  y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, z), x), one);
+  // 2^n from the exponent bits
+  __m128i n = _mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(0x7f));
+  return _mm_mul_ps(y, _mm_castsi128_ps(_mm_slli_epi32(n, 23)));
+}
+
+static inline __m128 Sigmoid4(__m128 x) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  return _mm_div_ps(one, _mm_add_ps(one, Exp4(_mm_sub_ps(_mm_setzero_ps(), x))));
+}
+
+// tanh(|x|) = (1 - e) / (1 + e) with e = exp(-2|x|), and the sign of x
+static inline __m128 Tanh4(__m128 x) {
+  const __m128 one = _mm_set1_ps(1.0f), sign = _mm_set1_ps(-0.0f);
+  __m128 abs_x = _mm_andnot_ps(sign, x);
+  __m128 e = Exp4(_mm_mul_ps(abs_x, _mm_set1_ps(-2.0f)));
+  __m128 t = _mm_div_ps(_mm_sub_ps(one, e), _mm_add_ps(one, e));
+  return _mm_or_ps(t, _mm_and_ps(sign, x));
+}
+
+static inline void LstmCellRow(const float *cp, const float *pi,
+                               const float *pf, const float *po, float clip,
+                               int32 n, float *y) {
+  float *g = y, *i = g + n, *f = i + n, *o = f + n, *c = o + n, *h = c + n,
+      *m = h + n;
+  const __m128 max_c = _mm_set1_ps(clip), min_c = _mm_set1_ps(-clip);
+  int32 j = 0;
+  for (; j + 4 <= n; j += 4) {
+    __m128 cp_j = _mm_loadu_ps(cp + j);
+    __m128 i_j = Sigmoid4(_mm_add_ps(_mm_loadu_ps(i + j),
+                                     _mm_mul_ps(cp_j, _mm_loadu_ps(pi + j))));
+    __m128 f_j = Sigmoid4(_mm_add_ps(_mm_loadu_ps(f + j),
+                                     _mm_mul_ps(cp_j, _mm_loadu_ps(pf + j))));
+    __m128 g_j = Tanh4(_mm_loadu_ps(g + j));
+    __m128 c_j = _mm_add_ps(_mm_mul_ps(g_j, i_j), _mm_mul_ps(cp_j, f_j));
+    c_j = _mm_min_ps(_mm_max_ps(c_j, min_c), max_c);
+    __m128 h_j = Tanh4(c_j);
+    __m128 o_j = Sigmoid4(_mm_add_ps(_mm_loadu_ps(o + j),
+                                     _mm_mul_ps(c_j, _mm_loadu_ps(po + j))));
+    _mm_storeu_ps(g + j, g_j);
+    _mm_storeu_ps(i + j, i_j);
+    _mm_storeu_ps(f + j, f_j);
+    _mm_storeu_ps(o + j, o_j);
+    _mm_storeu_ps(c + j, c_j);
+    _mm_storeu_ps(h + j, h_j);
+    _mm_storeu_ps(m + j, _mm_mul_ps(h_j, o_j));
+  }
+  LstmCellRow<float>(cp, pi, pf, po, clip, j, n, y);
+}
+
+static inline void CifgLstmCellRow(const float *cp, const float *pf,
+                                   const float *po, float clip, int32 n,
+                                   float *y) {
+  float *g = y, *f = g + n, *o = f + n, *c = o + n, *h = c + n, *m = h + n;
+  const __m128 one = _mm_set1_ps(1.0f), max_c = _mm_set1_ps(clip),
+      min_c = _mm_set1_ps(-clip);
+  int32 j = 0;
+  for (; j + 4 <= n; j += 4) {
+    __m128 cp_j = _mm_loadu_ps(cp + j);
+    __m128 f_j = Sigmoid4(_mm_add_ps(_mm_loadu_ps(f + j),
+                                     _mm_mul_ps(cp_j, _mm_loadu_ps(pf + j))));
+    __m128 g_j = Tanh4(_mm_loadu_ps(g + j));
+    __m128 c_j = _mm_add_ps(_mm_mul_ps(g_j, _mm_sub_ps(one, f_j)),
+                            _mm_mul_ps(cp_j, f_j));
+    c_j = _mm_min_ps(_mm_max_ps(c_j, min_c), max_c);
+    __m128 h_j = Tanh4(c_j);
+    __m128 o_j = Sigmoid4(_mm_add_ps(_mm_loadu_ps(o + j),
+                                     _mm_mul_ps(c_j, _mm_loadu_ps(po + j))));
+    _mm_storeu_ps(g + j, g_j);
+    _mm_storeu_ps(f + j, f_j);
+    _mm_storeu_ps(o + j, o_j);
+    _mm_storeu_ps(c + j, c_j);
+    _mm_storeu_ps(h + j, h_j);
+    _mm_storeu_ps(m + j, _mm_mul_ps(h_j, o_j));
+  }
+  CifgLstmCellRow<float>(cp, pf, po, clip, j, n, y);
+}
+
+static inline void GruGateRow(const float *hp, int32 n, float *y) {
+  float *z = y, *r = z + n, *g = r + 2 * n;
+  int32 j = 0;
+  for (; j + 4 <= n; j += 4) {
+    __m128 r_j = Sigmoid4(_mm_loadu_ps(r + j));
+    _mm_storeu_ps(z + j, Sigmoid4(_mm_loadu_ps(z + j)));
+    _mm_storeu_ps(r + j, r_j);
+    _mm_storeu_ps(g + j, _mm_mul_ps(r_j, _mm_loadu_ps(hp + j)));
+  }
+  GruGateRow<float>(hp, j, n, y);
+}
+
+static inline void GruOutputRow(const float *hp, int32 n, float *y) {
+  float *z = y, *m = z + 2 * n, *h = z + 4 * n;
+  int32 j = 0;
+  for (; j + 4 <= n; j += 4) {
+    __m128 hp_j = _mm_loadu_ps(hp + j), z_j = _mm_loadu_ps(z + j),
+        m_j = Tanh4(_mm_loadu_ps(m + j));
+    _mm_storeu_ps(m + j, m_j);
+    _mm_storeu_ps(h + j, _mm_add_ps(_mm_sub_ps(hp_j, _mm_mul_ps(hp_j, z_j)),
+                                    _mm_mul_ps(z_j, m_j)));
+  }
+  GruOutputRow<float>(hp, j, n, y);
+}
+#endif
+
+template<typename Real>
+void LstmCellForward(const CuMatrixBase<Real> &prev_c,
+                     const CuVectorBase<Real> &peephole_i_c,
+                     const CuVectorBase<Real> &peephole_f_c,
+                     const CuVectorBase<Real> &peephole_o_c,
+                     Real cell_clip, CuMatrixBase<Real> *y) {
+  int32 ncell = prev_c.NumCols(), nstream = prev_c.NumRows();
+  KALDI_ASSERT(y->NumRows() == nstream && y->NumCols() >= 7 * ncell);
+  KALDI_ASSERT(peephole_i_c.Dim() == ncell && peephole_f_c.Dim() == ncell &&
+               peephole_o_c.Dim() == ncell);
+
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    // no fused kernel, the same ops as the components had
+    CuSubMatrix<Real> y_g(y->ColRange(0 * ncell, ncell)),
+        y_i(y->ColRange(1 * ncell, ncell)), y_f(y->ColRange(2 * ncell, ncell)),
+        y_o(y->ColRange(3 * ncell, ncell)), y_c(y->ColRange(4 * ncell, ncell)),
+        y_h(y->ColRange(5 * ncell, ncell)), y_m(y->ColRange(6 * ncell, ncell));
+    y_i.AddMatDiagVec(1.0, prev_c, kNoTrans, peephole_i_c, 1.0);
+    y_f.AddMatDiagVec(1.0, prev_c, kNoTrans, peephole_f_c, 1.0);
+    y_i.Sigmoid(y_i);
+    y_f.Sigmoid(y_f);
+    y_g.Tanh(y_g);
+    y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
+    y_c.AddMatMatElements(1.0, prev_c, y_f, 1.0);
+    y_c.ApplyFloor(-cell_clip);
+    y_c.ApplyCeiling(cell_clip);
+    y_h.Tanh(y_c);
+    y_o.AddMatDiagVec(1.0, y_c, kNoTrans, peephole_o_c, 1.0);
+    y_o.Sigmoid(y_o);
+    y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+  } else
+#endif
+  {
+    const MatrixBase<Real> &prev_c_mat = prev_c.Mat();
+    MatrixBase<Real> &y_mat = y->Mat();
+    for (int32 s = 0; s < nstream; s++) {
+      LstmCellRow(prev_c_mat.RowData(s), peephole_i_c.Data(),
+                  peephole_f_c.Data(), peephole_o_c.Data(), cell_clip, ncell,
+                  y_mat.RowData(s));
+    }
+  }
+}
+
+template<typename Real>
+void CifgLstmCellForward(const CuMatrixBase<Real> &prev_c,
+                         const CuVectorBase<Real> &peephole_f_c,
+                         const CuVectorBase<Real> &peephole_o_c,
+                         Real cell_clip, CuMatrixBase<Real> *y) {
+  int32 ncell = prev_c.NumCols(), nstream = prev_c.NumRows();
+  KALDI_ASSERT(y->NumRows() == nstream && y->NumCols() >= 6 * ncell);
+  KALDI_ASSERT(peephole_f_c.Dim() == ncell && peephole_o_c.Dim() == ncell);
+
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    CuSubMatrix<Real> y_g(y->ColRange(0 * ncell, ncell)),
+        y_f(y->ColRange(1 * ncell, ncell)), y_o(y->ColRange(2 * ncell, ncell)),
+        y_c(y->ColRange(3 * ncell, ncell)), y_h(y->ColRange(4 * ncell, ncell)),
+        y_m(y->ColRange(5 * ncell, ncell));
+    y_f.AddMatDiagVec(1.0, prev_c, kNoTrans, peephole_f_c, 1.0);
+    y_f.Sigmoid(y_f);
+    y_g.Tanh(y_g);
+    y_c.AddMatMatElements(-1.0, y_g, y_f, 0.0);
+    y_c.AddMat(1.0, y_g);
+    y_c.AddMatMatElements(1.0, prev_c, y_f, 1.0);
+    y_c.ApplyFloor(-cell_clip);
+    y_c.ApplyCeiling(cell_clip);
+    y_h.Tanh(y_c);
+    y_o.AddMatDiagVec(1.0, y_c, kNoTrans, peephole_o_c, 1.0);
+    y_o.Sigmoid(y_o);
+    y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+  } else
+#endif
+  {
+    const MatrixBase<Real> &prev_c_mat = prev_c.Mat();
+    MatrixBase<Real> &y_mat = y->Mat();
+    for (int32 s = 0; s < nstream; s++) {
+      CifgLstmCellRow(prev_c_mat.RowData(s), peephole_f_c.Data(),
+                      peephole_o_c.Data(), cell_clip, ncell, y_mat.RowData(s));
+    }
+  }
+}
+
+template<typename Real>
+void GruGateForward(const CuMatrixBase<Real> &prev_h, CuMatrixBase<Real> *y) {
+  int32 dim = prev_h.NumCols(), nstream = prev_h.NumRows();
+  KALDI_ASSERT(y->NumRows() == nstream && y->NumCols() >= 5 * dim);
+
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    CuSubMatrix<Real> y_zr(y->ColRange(0, 2 * dim)),
+        y_r(y->ColRange(1 * dim, dim)), y_g(y->ColRange(3 * dim, dim));
+    y_zr.Sigmoid(y_zr);
+    y_g.AddMatMatElements(1.0, y_r, prev_h, 0.0);
+  } else
+#endif
+  {
+    const MatrixBase<Real> &prev_h_mat = prev_h.Mat();
+    MatrixBase<Real> &y_mat = y->Mat();
+    for (int32 s = 0; s < nstream; s++)
+      GruGateRow(prev_h_mat.RowData(s), dim, y_mat.RowData(s));
+  }
+}
+
+template<typename Real>
+void GruOutputForward(const CuMatrixBase<Real> &prev_h, CuMatrixBase<Real> *y) {
+  int32 dim = prev_h.NumCols(), nstream = prev_h.NumRows();
+  KALDI_ASSERT(y->NumRows() == nstream && y->NumCols() >= 5 * dim);
+
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    CuSubMatrix<Real> y_z(y->ColRange(0 * dim, dim)),
+        y_m(y->ColRange(2 * dim, dim)), y_h(y->ColRange(4 * dim, dim));
+    y_m.Tanh(y_m);
+    y_h.CopyFromMat(prev_h);
+    y_h.AddMatMatElements(-1.0, prev_h, y_z, 1.0);
+    y_h.AddMatMatElements(1.0, y_z, y_m, 1.0);
+  } else
+#endif
+  {
+    const MatrixBase<Real> &prev_h_mat = prev_h.Mat();
+    MatrixBase<Real> &y_mat = y->Mat();
+    for (int32 s = 0; s < nstream; s++)
+      GruOutputRow(prev_h_mat.RowData(s), dim, y_mat.RowData(s));
+  }
+}
+
 // instantiate the templates.
 template
 void RegularizeL1(CuMatrixBase<float> *weight, CuMatrixBase<float> *grad, float l1, float lr);
@@ -233,6 +588,37 @@ void Randomize(const CuMatrixBase<double> &src,
                const CuArray<int32> &copy_from_idx,
                CuMatrixBase<double> *tgt);
 
+template
+void LstmCellForward(const CuMatrixBase<float> &prev_c,
+                     const CuVectorBase<float> &peephole_i_c,
+                     const CuVectorBase<float> &peephole_f_c,
+                     const CuVectorBase<float> &peephole_o_c,
+                     float cell_clip, CuMatrixBase<float> *y);
+template
+void LstmCellForward(const CuMatrixBase<double> &prev_c,
+                     const CuVectorBase<double> &peephole_i_c,
+                     const CuVectorBase<double> &peephole_f_c,
+                     const CuVectorBase<double> &peephole_o_c,
+                     double cell_clip, CuMatrixBase<double> *y);
+template
+void CifgLstmCellForward(const CuMatrixBase<float> &prev_c,
+                         const CuVectorBase<float> &peephole_f_c,
+                         const CuVectorBase<float> &peephole_o_c,
+                         float cell_clip, CuMatrixBase<float> *y);
+template
+void CifgLstmCellForward(const CuMatrixBase<double> &prev_c,
+                         const CuVectorBase<double> &peephole_f_c,
+                         const CuVectorBase<double> &peephole_o_c,
+                         double cell_clip, CuMatrixBase<double> *y);
+template
+void GruGateForward(const CuMatrixBase<float> &prev_h, CuMatrixBase<float> *y);
+template
+void GruGateForward(const CuMatrixBase<double> &prev_h, CuMatrixBase<double> *y);
+template
+void GruOutputForward(const CuMatrixBase<float> &prev_h, CuMatrixBase<float> *y);
+template
+void GruOutputForward(const CuMatrixBase<double> &prev_h, CuMatrixBase<double> *y);
+
 
 
 } //namespace cu
@@ -73,6 +73,39 @@ void Copy(const CuMatrixBase<Real> &src,
           const CuArray<int32> &copy_from_indices,
           CuMatrixBase<Real> *tgt);
 
+/// One time step of the peephole LSTM cell of the aslp-nnet LSTM components,
+/// fused into a single pass over the streams. y holds the rows
+/// [g, i, f, o, c, h, m] of the propagation buffer (ncell columns each, the
+/// columns after m are not touched), g, i, f, o are the pre-activations on
+/// input. prev_c is the cell of the previous time step, the new cell is
+/// clipped to [-cell_clip, cell_clip].
+template<typename Real>
+void LstmCellForward(const CuMatrixBase<Real> &prev_c,
+                     const CuVectorBase<Real> &peephole_i_c,
+                     const CuVectorBase<Real> &peephole_f_c,
+                     const CuVectorBase<Real> &peephole_o_c,
+                     Real cell_clip, CuMatrixBase<Real> *y);
+
+/// LstmCellForward with the input and forget gates coupled (i = 1 - f),
+/// y holds the rows [g, f, o, c, h, m].
+template<typename Real>
+void CifgLstmCellForward(const CuMatrixBase<Real> &prev_c,
+                         const CuVectorBase<Real> &peephole_f_c,
+                         const CuVectorBase<Real> &peephole_o_c,
+                         Real cell_clip, CuMatrixBase<Real> *y);
+
+/// The element-wise parts of one GRU time step, before and after the
+/// g -> m matrix product. y holds the rows [z, r, m, g, h] of the
+/// propagation buffer, prev_h is h of the previous time step.
+/// GruGateForward squashes the pre-activations of z and r and sets
+/// g = r * prev_h, GruOutputForward squashes the pre-activation of m and
+/// sets h = (1 - z) * prev_h + z * m.
+template<typename Real>
+void GruGateForward(const CuMatrixBase<Real> &prev_h, CuMatrixBase<Real> *y);
+
+template<typename Real>
+void GruOutputForward(const CuMatrixBase<Real> &prev_h, CuMatrixBase<Real> *y);
+
 
 } // namespace cu
 } // namespace kaldi
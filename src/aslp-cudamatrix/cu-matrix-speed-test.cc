@@ -776,6 +776,54 @@ template<typename Real> void TestCuMatrixAddRowRanges(int32 dim) {
             << dim << ", speed was " << gflops << " gigaflops.";
 }
 
+// One LSTM time step of 16 streams of dim cells, by cu::LstmCellForward
+// and by the separate element-wise ops it replaced
+template<typename Real> void TestCuMathLstmCellForward(int32 dim) {
+  BaseFloat time_in_secs = 0.025;
+  int32 S = 16;
+  CuMatrix<Real> prev_c(S, dim), y_in(S, 7 * dim), y(S, 7 * dim);
+  CuVector<Real> pi(dim), pf(dim), po(dim);
+  prev_c.SetRandn();
+  y_in.SetRandn();
+  pi.SetRandn();
+  pf.SetRandn();
+  po.SetRandn();
+  CuSubMatrix<Real> y_g(y.ColRange(0 * dim, dim)), y_i(y.ColRange(1 * dim, dim)),
+      y_f(y.ColRange(2 * dim, dim)), y_o(y.ColRange(3 * dim, dim)),
+      y_c(y.ColRange(4 * dim, dim)), y_h(y.ColRange(5 * dim, dim)),
+      y_m(y.ColRange(6 * dim, dim));
+  Timer tim;
+  int32 iter = 0;
+  for (;tim.Elapsed() < time_in_secs; iter++) {
+    y.CopyFromMat(y_in);
+    y_i.AddMatDiagVec(1.0, prev_c, kNoTrans, pi, 1.0);
+    y_f.AddMatDiagVec(1.0, prev_c, kNoTrans, pf, 1.0);
+    y_i.Sigmoid(y_i);
+    y_f.Sigmoid(y_f);
+    y_g.Tanh(y_g);
+    y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
+    y_c.AddMatMatElements(1.0, prev_c, y_f, 1.0);
+    y_c.ApplyFloor(-50);
+    y_c.ApplyCeiling(50);
+    y_h.Tanh(y_c);
+    y_o.AddMatDiagVec(1.0, y_c, kNoTrans, po, 1.0);
+    y_o.Sigmoid(y_o);
+    y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+  }
+  BaseFloat ops_fps = S * iter / tim.Elapsed();
+
+  Timer tim2;
+  iter = 0;
+  for (;tim2.Elapsed() < time_in_secs; iter++) {
+    y.CopyFromMat(y_in);
+    cu::LstmCellForward(prev_c, pi, pf, po, Real(50), &y);
+  }
+  BaseFloat fused_fps = S * iter / tim2.Elapsed();
+  KALDI_LOG << "For cu::LstmCellForward" << NameOf<Real>() << ", for dim = "
+            << dim << ", speed was " << fused_fps << " frames/s, against "
+            << ops_fps << " frames/s of the separate ops.";
+}
+
 template<typename Real> void CudaMatrixSpeedTest() {
   std::vector<int32> sizes;
   sizes.push_back(16);
@@ -806,6 +854,8 @@ template<typename Real> void CudaMatrixSpeedTest() {
     TestCuMatrixCholesky<Real>(sizes[s]);
   for (int32 s = 0; s < ns; s++)
     TestCuMatrixSigmoid<Real>(sizes[s]);
+  for (int32 s = 0; s < ns; s++)
+    TestCuMathLstmCellForward<Real>(sizes[s]);
   for (int32 s = 0; s < ns; s++)
     TestCuFindRowMaxId<Real>(sizes[s]);
   for (int32 s = 0; s < ns; s++)
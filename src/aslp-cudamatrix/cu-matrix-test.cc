@@ -1123,6 +1123,35 @@ template<typename Real> static void UnitTestCuMatrixAddConvMatMatElements() {
   AssertEqual(M, Mcheck);
 }
 
+template<typename Real> static void UnitTestCuMatrixAddDepthwiseConv() {
+  MatrixIndexT cols = 5 + Rand() % 30, rowsB = 1 + Rand() % 20;
+  MatrixIndexT rowsM = 10 + Rand() % 200, rowsA = rowsM + rowsB - 1;
+  Real alpha = 0.43243, beta = 1.423;
+
+  CuMatrix<Real> M(rowsM, cols), A(rowsA, cols), B(rowsB, cols);
+  M.SetRandn();
+  A.SetRandn();
+  B.SetRandn();
+
+  // the same as the sum of the products of AddConvMatMatElements()
+  CuMatrix<Real> conv((rowsA - rowsB + 1) * rowsB, cols), Mcheck(M);
+  conv.AddConvMatMatElements(1.0, A, B, 0.0);
+  Mcheck.AddRowSumMat(alpha, conv, beta);
+  M.AddDepthwiseConv(alpha, A, B, beta);
+  AssertEqual(M, Mcheck);
+
+  // the gradient of B, with M as the output gradient
+  CuMatrix<Real> G(rowsB, cols), Gcheck(rowsB, cols), prod(rowsM, cols);
+  G.SetRandn();
+  Gcheck.CopyFromMat(G);
+  for (int32 c = 0; c < rowsB; c++) {
+    prod.AddMatMatElements(1.0, A.RowRange(c, rowsM), M, 0.0);
+    Gcheck.Row(c).AddRowSumMat(alpha, prod, beta);
+  }
+  G.AddDepthwiseConvGrad(alpha, A, M, beta);
+  AssertEqual(G, Gcheck);
+}
+
 template<typename Real>
 static void UnitTestCuMatrixDivRowsVec() {
   Matrix<Real> Hm(100,99);
@@ -2591,6 +2620,7 @@ template<typename Real> void CudaMatrixUnitTest() {
   UnitTestCuMatrixAddMatMatElements<Real>();
   UnitTestCuMatrixAddRowSumMat<Real>();
   UnitTestCuMatrixAddConvMatMatElements<Real>();
+  UnitTestCuMatrixAddDepthwiseConv<Real>();
   UnitTestCuTanh<Real>();
   UnitTestCuCholesky<Real>();
   UnitTestCuDiffTanh<Real>();
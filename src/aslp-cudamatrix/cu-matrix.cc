@@ -28,6 +28,10 @@
 #include <cublas_v2.h>
 #endif
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "base/timer.h"
 #include "aslp-cudamatrix/cu-common.h"
 #include "aslp-cudamatrix/cu-vector.h"
@@ -41,6 +45,8 @@
 #include "aslp-cudamatrix/cu-block-matrix.h"
 #include "aslp-cudamatrix/cu-sparse-matrix.h"
 #include "aslp-cudamatrix/cublas-wrappers.h"
+#include "aslp-cudamatrix/ctc-cpu.h"
+#include "aslp-cudamatrix/ctc-utils.h"
 
 namespace kaldi {
 
@@ -1152,7 +1158,7 @@ template<typename Real>
 void CuMatrixBase<Real>::AddMatDiagVec(
     const Real alpha,
     const CuMatrixBase<Real> &M, MatrixTransposeType transM,
-    CuVectorBase<Real> &v,
+    const CuVectorBase<Real> &v,
     Real beta) {
 #if HAVE_CUDA == 1
   if (CuDevice::Instantiate().Enabled()) {
@@ -2803,6 +2809,14 @@ void CuMatrixBase<Real>::EqualElementMask(const CuMatrixBase<Real> &mat, CuMatri
   }
 }
 
+// Length of the expanded labels of a sequence in the multiple sequence CTC,
+// which are padded with -1 to the stride
+static inline int32 CtcNumLabels(const MatrixIndexT *labels, int32 stride) {
+  int32 n = 0;
+  while (n < stride && labels[n] != -1) n++;
+  return n;
+}
+
 template<typename Real>
 void CuMatrixBase<Real>::ComputeCtcAlpha(const CuMatrixBase<Real> &prob,
                                          int32 row_idx,
@@ -2833,7 +2847,14 @@ void CuMatrixBase<Real>::ComputeCtcAlpha(const CuMatrixBase<Real> &prob,
   } else
 #endif
  {
-    // not implemented for CPU yet
+    KALDI_ASSERT(prob.NumRows() == NumRows());
+    KALDI_ASSERT(static_cast<MatrixIndexT>(labels.size()) == NumCols());
+    if (rescale) {
+      KALDI_ERR << "Rescaled CTC is not implemented for CPU";
+    }
+    CtcAlphaRow(prob.Mat().RowData(row_idx),
+                row_idx > 0 ? Mat().RowData(row_idx - 1) : NULL,
+                &labels[0], NumCols(), Mat().RowData(row_idx));
  }
 }
 
@@ -2866,7 +2887,22 @@ void CuMatrixBase<Real>::ComputeCtcAlphaMSeq(const CuMatrixBase<Real> &prob,
   } else
 #endif
  {
-    // not implemented for CPU yet
+    KALDI_ASSERT(prob.NumRows() == NumRows());
+    KALDI_ASSERT(static_cast<MatrixIndexT>(labels.size()) % NumCols() == 0);
+    int32 seq_num = frame_num_utt.size();
+    for (int32 i = 0; i < seq_num; i++) {
+      const MatrixIndexT *seq_labels = &labels[i * NumCols()];
+      int32 num_labels = CtcNumLabels(seq_labels, NumCols());
+      int32 row = row_idx * seq_num + i;
+      Real *alpha = Mat().RowData(row);
+      if (row_idx >= frame_num_utt[i]) num_labels = 0;
+      else CtcAlphaRow(prob.Mat().RowData(row),
+                       row_idx > 0 ? Mat().RowData(row - seq_num) : NULL,
+                       seq_labels, num_labels, alpha);
+      // the padding
+      for (int32 j = num_labels; j < NumCols(); j++)
+        alpha[j] = NumericLimits<Real>::log_zero_;
+    }
  }
 }
 
@@ -2899,7 +2935,14 @@ void CuMatrixBase<Real>::ComputeCtcBeta(const CuMatrixBase<Real> &prob,
   } else
 #endif
  {
-    // not implemented for CPU yet
+    KALDI_ASSERT(prob.NumRows() == NumRows());
+    KALDI_ASSERT(static_cast<MatrixIndexT>(labels.size()) == NumCols());
+    if (rescale) {
+      KALDI_ERR << "Rescaled CTC is not implemented for CPU";
+    }
+    CtcBetaRow(prob.Mat().RowData(row_idx),
+               row_idx < NumRows() - 1 ? Mat().RowData(row_idx + 1) : NULL,
+               &labels[0], NumCols(), Mat().RowData(row_idx));
  }
 }
 
@@ -2933,7 +2976,22 @@ void CuMatrixBase<Real>::ComputeCtcBetaMSeq(const CuMatrixBase<Real> &prob,
   } else
 #endif
  {
-    // not implemented for CPU yet
+    KALDI_ASSERT(prob.NumRows() == NumRows());
+    KALDI_ASSERT(static_cast<MatrixIndexT>(labels.size()) % NumCols() == 0);
+    int32 seq_num = frame_num_utt.size();
+    for (int32 i = 0; i < seq_num; i++) {
+      const MatrixIndexT *seq_labels = &labels[i * NumCols()];
+      int32 num_labels = CtcNumLabels(seq_labels, NumCols());
+      KALDI_ASSERT(label_lengths_utt[i] == num_labels);
+      int32 row = row_idx * seq_num + i;
+      Real *beta = Mat().RowData(row);
+      if (row_idx >= frame_num_utt[i]) num_labels = 0;
+      else CtcBetaRow(prob.Mat().RowData(row),
+                      row_idx < frame_num_utt[i] - 1 ? Mat().RowData(row + seq_num) : NULL,
+                      seq_labels, num_labels, beta);
+      for (int32 j = num_labels; j < NumCols(); j++)
+        beta[j] = NumericLimits<Real>::log_zero_;
+    }
  }
 }
 
@@ -2966,7 +3024,15 @@ void CuMatrixBase<Real>::ComputeCtcError(const CuMatrixBase<Real> &alpha,
   } else
 #endif
  {
-    // not implemented for CPU yet
+    KALDI_ASSERT(alpha.NumRows() == NumRows() && beta.NumRows() == NumRows() && prob.NumRows() == NumRows());
+    KALDI_ASSERT(alpha.NumCols() == beta.NumCols());
+    KALDI_ASSERT(prob.NumCols() == NumCols());
+    KALDI_ASSERT(static_cast<MatrixIndexT>(labels.size()) == alpha.NumCols());
+    for (MatrixIndexT r = 0; r < NumRows(); r++) {
+      CtcErrorRow(alpha.Mat().RowData(r), beta.Mat().RowData(r),
+                  prob.Mat().RowData(r), &labels[0], alpha.NumCols(),
+                  NumCols(), pzx, Mat().RowData(r));
+    }
  }
 }
 
@@ -3002,7 +3068,21 @@ void CuMatrixBase<Real>::ComputeCtcErrorMSeq(const CuMatrixBase<Real> &alpha,
   } else
 #endif
  {
-    // not implemented for CPU yet
+    KALDI_ASSERT(alpha.NumRows() == NumRows() && beta.NumRows() == NumRows() && prob.NumRows() == NumRows());
+    KALDI_ASSERT(alpha.NumCols() == beta.NumCols());
+    KALDI_ASSERT(prob.NumCols() == NumCols());
+    KALDI_ASSERT(static_cast<MatrixIndexT>(labels.size()) % alpha.NumCols() == 0);
+    int32 seq_num = frame_num_utt.size();
+    for (MatrixIndexT r = 0; r < NumRows(); r++) {
+      int32 i = r % seq_num;
+      // the padded frames are left as they are
+      if (r / seq_num >= frame_num_utt[i]) continue;
+      const MatrixIndexT *seq_labels = &labels[i * alpha.NumCols()];
+      CtcErrorRow(alpha.Mat().RowData(r), beta.Mat().RowData(r),
+                  prob.Mat().RowData(r), seq_labels,
+                  CtcNumLabels(seq_labels, alpha.NumCols()),
+                  NumCols(), pzx.Vec()(i), Mat().RowData(r));
+    }
  }
 }
 
@@ -3072,6 +3152,95 @@ void CuMatrixBase<Real>::AddConvMatMatElements(Real alpha,
   }
 }
 
+// out[d] += alpha * a[d] * b[d] for d in [0, n), the row kernel of the
+// depthwise convolution on the host
+template<typename Real>
+static inline void AddRowMulElements(Real alpha, const Real *a, const Real *b,
+                                     int32 n, Real *out) {
+  for (int32 d = 0; d < n; d++)
+    out[d] += alpha * a[d] * b[d];
+}
+
+#if defined(__SSE2__)
+static inline void AddRowMulElements(float alpha, const float *a,
+                                     const float *b, int32 n, float *out) {
+  __m128 va = _mm_set1_ps(alpha);
+  int32 d = 0;
+  for (; d + 4 <= n; d += 4) {
+    __m128 p = _mm_mul_ps(_mm_loadu_ps(a + d), _mm_loadu_ps(b + d));
+    _mm_storeu_ps(out + d, _mm_add_ps(_mm_loadu_ps(out + d), _mm_mul_ps(va, p)));
+  }
+  for (; d < n; d++)
+    out[d] += alpha * a[d] * b[d];
+}
+#endif
+
+template<typename Real>
+void CuMatrixBase<Real>::AddDepthwiseConv(Real alpha,
+                                          const CuMatrixBase<Real> &A,
+                                          const CuMatrixBase<Real> &B,
+                                          Real beta) {
+  KALDI_ASSERT(A.NumRows() == NumRows() + B.NumRows() - 1);
+  KALDI_ASSERT(NumCols() == A.NumCols() && A.NumCols() == B.NumCols());
+  if (NumRows() == 0) return;
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    Timer tim;
+    dim3 dimBlock(CU2DBLOCK, CU2DBLOCK);
+    dim3 dimGrid(n_blocks(NumCols(), CU2DBLOCK), n_blocks(NumRows(), CU2DBLOCK));
+    cuda_add_depthwise_conv(dimGrid, dimBlock, this->data_, A.Data(), B.Data(), Dim(),
+                            A.Stride(), B.Stride(), B.NumRows(), alpha, beta);
+    CU_SAFE_CALL(cudaGetLastError());
+    CuDevice::Instantiate().AccuProfile(__func__, tim.Elapsed());
+  } else
+#endif
+  {
+    if (beta == 0.0) Mat().SetZero();
+    else if (beta != 1.0) Mat().Scale(beta);
+    int32 C = B.NumRows(), D = NumCols();
+    const MatrixBase<Real> &a = A.Mat(), &b = B.Mat();
+    // the rows [t, t + C) of A stay in the cache for the row t
+    for (int32 t = 0; t < NumRows(); t++) {
+      Real *out = Mat().RowData(t);
+      for (int32 c = 0; c < C; c++)
+        AddRowMulElements(alpha, a.RowData(t + c), b.RowData(c), D, out);
+    }
+  }
+}
+
+template<typename Real>
+void CuMatrixBase<Real>::AddDepthwiseConvGrad(Real alpha,
+                                              const CuMatrixBase<Real> &A,
+                                              const CuMatrixBase<Real> &D,
+                                              Real beta) {
+  KALDI_ASSERT(A.NumRows() == D.NumRows() + NumRows() - 1);
+  KALDI_ASSERT(NumCols() == A.NumCols() && A.NumCols() == D.NumCols());
+  if (NumRows() == 0) return;
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    Timer tim;
+    dim3 dimBlock(CU2DBLOCK, CU2DBLOCK);
+    dim3 dimGrid(n_blocks(NumCols(), CU2DBLOCK), n_blocks(NumRows(), CU2DBLOCK));
+    cuda_add_depthwise_conv_grad(dimGrid, dimBlock, this->data_, A.Data(), D.Data(), Dim(),
+                                 A.Stride(), D.Stride(), D.NumRows(), alpha, beta);
+    CU_SAFE_CALL(cudaGetLastError());
+    CuDevice::Instantiate().AccuProfile(__func__, tim.Elapsed());
+  } else
+#endif
+  {
+    if (beta == 0.0) Mat().SetZero();
+    else if (beta != 1.0) Mat().Scale(beta);
+    int32 C = NumRows(), dim = NumCols();
+    const MatrixBase<Real> &a = A.Mat(), &d = D.Mat();
+    // frame by frame, the C x dim gradient stays in the cache
+    for (int32 t = 0; t < D.NumRows(); t++) {
+      const Real *diff = d.RowData(t);
+      for (int32 c = 0; c < C; c++)
+        AddRowMulElements(alpha, a.RowData(t + c), diff, dim, Mat().RowData(c));
+    }
+  }
+}
+
 /**
  * Print the matrix to stream
  */
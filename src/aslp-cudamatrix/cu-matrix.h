@@ -445,6 +445,17 @@ class CuMatrixBase {
   
   void AddConvMatMatElements(Real alpha, const CuMatrixBase<Real> &A, const CuMatrixBase<Real> &B, Real beta);
 
+  /// Depthwise convolution of the columns along the rows (the memory block of
+  /// FSMN), (*this)(t, d) = beta * (*this)(t, d) + alpha * sum_c A(t + c, d) * B(c, d),
+  /// A has NumRows() + B.NumRows() - 1 rows. It is AddRowSumMat() of the result
+  /// of AddConvMatMatElements() without the NumRows() * B.NumRows() rows of it.
+  void AddDepthwiseConv(Real alpha, const CuMatrixBase<Real> &A, const CuMatrixBase<Real> &B, Real beta);
+
+  /// The gradient of B of AddDepthwiseConv() for the output gradient D,
+  /// (*this)(c, d) = beta * (*this)(c, d) + alpha * sum_t A(t + c, d) * D(t, d),
+  /// A has D.NumRows() + NumRows() - 1 rows.
+  void AddDepthwiseConvGrad(Real alpha, const CuMatrixBase<Real> &A, const CuMatrixBase<Real> &D, Real beta);
+
   /// (for each column c of *this), c = alpha * col + beta * c
   void AddVecToCols(Real alpha, const CuVectorBase<Real> &col, Real beta = 1.0);
   /// (for each row r of *this), r = alpha * row + beta * r
@@ -479,7 +490,7 @@ class CuMatrixBase {
   // The same as adding M but scaling each column M_j by v(j).
   void AddMatDiagVec(const Real alpha,
                      const CuMatrixBase<Real> &M, MatrixTransposeType transM,
-                     CuVectorBase<Real> &v,
+                     const CuVectorBase<Real> &v,
                      Real beta = 1.0);
 
   /// *this = beta * *this + alpha * A .* B (.* element by element multiplication)
@@ -42,11 +42,42 @@ void Arc::Write(FILE *fout) const {
     WriteBasic(fout, next_state);
 }
 
+Fst::~Fst() {
+    delete mapped_;
+}
+
 void Fst::Reset() {
     start_ = 0;
-    arcs_.clear();
-    arc_offset_.clear();
-    finals_.clear();
+    arc_offset_buf_.assign(1, 0);
+    arcs_buf_.clear();
+    final_bitmap_buf_.clear();
+    finals_buf_.clear();
+    delete mapped_;
+    mapped_ = NULL;
+    SetBuffers(std::map<int32_t, float>());
+}
+
+void Fst::SetBuffers(const std::map<int32_t, float> &finals) {
+    num_states_ = arc_offset_buf_.size() - 1;
+    num_arcs_ = arcs_buf_.size();
+    CHECK(arc_offset_buf_[num_states_] == num_arcs_);
+    final_bitmap_buf_.assign((num_states_ + 63) / 64 + 1, 0);
+    finals_buf_.clear();
+    std::map<int32_t, float>::const_iterator it = finals.begin();
+    for (; it != finals.end(); it++) {
+        FinalWeight final_weight;
+        final_weight.state = it->first;
+        final_weight.weight = it->second;
+        finals_buf_.push_back(final_weight);
+        if (it->first >= 0 && it->first < num_states_) {
+            final_bitmap_buf_[it->first >> 6] |= (uint64_t)1 << (it->first & 63);
+        }
+    }
+    num_finals_ = finals_buf_.size();
+    arc_offset_ = arc_offset_buf_.data();
+    arcs_ = arcs_buf_.data();
+    final_bitmap_ = final_bitmap_buf_.data();
+    finals_ = finals_buf_.data();
 }
 
 void Fst::ReadTopo(const SymbolTable &isymbol_table, 
@@ -65,6 +96,7 @@ void Fst::ReadTopo(const SymbolTable &isymbol_table,
     float weight = 0.0f;
     
     std::vector<std::vector<Arc> > all_arcs;
+    std::map<int32_t, float> finals;
     while(fgets(buffer, 1024, fp)) {
         int32_t num = sscanf(buffer, "%d %d %s %s %f", &src, &dest, ilabel, olabel, &weight);
         if (num >= 4) {
@@ -80,7 +112,7 @@ void Fst::ReadTopo(const SymbolTable &isymbol_table,
             all_arcs[src].push_back(arc);
         } 
         else if (sscanf(buffer, "%d %f", &src, &weight) == 2) {
-            finals_[src] = weight; 
+            finals[src] = weight; 
         }
         else {
             ERROR("wrong line, expected (src, dest, ilabel, olabel, weight) " 
@@ -90,13 +122,15 @@ void Fst::ReadTopo(const SymbolTable &isymbol_table,
     }
     fclose(fp);
 
-    arc_offset_.resize(all_arcs.size());
+    arc_offset_buf_.resize(all_arcs.size() + 1);
     int32_t offset = 0;
     for (int i = 0; i < all_arcs.size(); i++) {
-        arc_offset_[i] = offset;
-        arcs_.insert(arcs_.end(), all_arcs[i].begin(), all_arcs[i].end()); 
+        arc_offset_buf_[i] = offset;
+        arcs_buf_.insert(arcs_buf_.end(), all_arcs[i].begin(), all_arcs[i].end()); 
         offset += all_arcs[i].size();
     }
+    arc_offset_buf_[all_arcs.size()] = offset;
+    SetBuffers(finals);
 }
 
 // Show the text format fsm info
@@ -107,10 +141,10 @@ void Fst::Info() const {
     fprintf(stderr, "num_states:\t%d\n", NumStates());
     fprintf(stderr, "num_arcs:\t%d\n", NumArcs());
     // final set info
+    fprintf(stderr, "mapped:\t%d\n", IsMapped());
     fprintf(stderr, "final states:\t%d { ", NumFinals());
-    unordered_map<int32_t, float>::const_iterator it = finals_.begin();
-    for (; it != finals_.end(); it++) {
-        fprintf(stderr, "(%d, %f) ", it->first, it->second);
+    for (int32_t i = 0; i < NumFinals(); i++) {
+        fprintf(stderr, "(%d, %f) ", finals_[i].state, finals_[i].weight);
     }
     fprintf(stderr, "}\n");
 
@@ -128,6 +162,10 @@ void Fst::Info() const {
 }
 
 void Fst::Read(const std::string &file) {
+    if (MappedFile::HasMagic(file, kMappedFstMagic, sizeof(kMappedFstMagic))) {
+        ReadMapped(file);
+        return;
+    }
     Reset();
 
     FILE *fin = fopen(file.c_str(), "rb");
@@ -140,26 +178,86 @@ void Fst::Read(const std::string &file) {
     ReadBasic(fin, &num_states);
     ReadBasic(fin, &num_finals);
     ReadBasic(fin, &num_arcs);
+    CHECK(num_states >= 0 && num_finals >= 0 && num_arcs >= 0);
 
-    arc_offset_.resize(num_states);
-    for (int i = 0; i < num_states; i++) {
-        ReadBasic(fin, &arc_offset_[i]);   
+    arc_offset_buf_.resize(num_states + 1);
+    if (num_states > 0 &&
+        fread(arc_offset_buf_.data(), sizeof(int32_t), num_states, fin) !=
+            num_states) {
+        ERROR("Read failure of the arc offsets of %s", file.c_str());
     }
+    arc_offset_buf_[num_states] = num_arcs;
 
+    std::map<int32_t, float> finals;
     for (int i = 0; i < num_finals; i++) {
         int32_t state;
         float weight;
         ReadBasic(fin, &state);
         ReadBasic(fin, &weight);
-        finals_[state] = weight;
+        finals[state] = weight;
     }
 
-    arcs_.resize(num_arcs);
+    // the arcs are (ilabel, weight, olabel, next_state) in the file, read
+    // them at once
+    std::vector<int32_t> buffer(num_arcs * 4);
+    if (num_arcs > 0 &&
+        fread(buffer.data(), sizeof(int32_t), buffer.size(), fin) !=
+            buffer.size()) {
+        ERROR("Read failure of the arcs of %s", file.c_str());
+    }
+    arcs_buf_.resize(num_arcs);
     for (int i = 0; i < num_arcs; i++) {
-        arcs_[i].Read(fin);
+        const int32_t *field = &buffer[i * 4];
+        arcs_buf_[i].ilabel = field[0];
+        memcpy(&arcs_buf_[i].weight, &field[1], sizeof(float));
+        arcs_buf_[i].olabel = field[2];
+        arcs_buf_[i].next_state = field[3];
     }
 
     fclose(fin);
+    SetBuffers(finals);
+}
+
+void Fst::ReadMapped(const std::string &file) {
+    Reset();
+    MappedFile *mapped = new MappedFile(file);
+    const char *data = mapped->Data();
+    size_t size = mapped->Size();
+    if (size < sizeof(MappedFstHeader)) {
+        ERROR("%s is too short for a mapped fst", file.c_str());
+    }
+    const MappedFstHeader *header =
+        reinterpret_cast<const MappedFstHeader *>(data);
+    if (header->byte_order != kMappedByteOrder) {
+        ERROR("%s is written in another byte order", file.c_str());
+    }
+    if (header->version != kMappedFstVersion) {
+        ERROR("%s is mapped fst version %d, expected %d", file.c_str(),
+              header->version, kMappedFstVersion);
+    }
+    int64_t num_states = header->num_states, num_arcs = header->num_arcs,
+            num_finals = header->num_finals;
+    if (num_states < 0 || num_arcs < 0 || num_finals < 0 ||
+        header->file_size != size ||
+        header->arc_offset_pos + (num_states + 1) * sizeof(int32_t) > size ||
+        header->arcs_pos + num_arcs * sizeof(Arc) > size ||
+        header->final_bitmap_pos + ((num_states + 63) / 64 + 1) *
+            sizeof(uint64_t) > size ||
+        header->finals_pos + num_finals * sizeof(FinalWeight) > size) {
+        ERROR("%s is a corrupted mapped fst", file.c_str());
+    }
+    mapped_ = mapped;
+    start_ = header->start;
+    num_states_ = num_states;
+    num_arcs_ = num_arcs;
+    num_finals_ = num_finals;
+    arc_offset_ = reinterpret_cast<const int32_t *>(data + header->arc_offset_pos);
+    arcs_ = reinterpret_cast<const Arc *>(data + header->arcs_pos);
+    final_bitmap_ = reinterpret_cast<const uint64_t *>(data + header->final_bitmap_pos);
+    finals_ = reinterpret_cast<const FinalWeight *>(data + header->finals_pos);
+    if (arc_offset_[num_states_] != num_arcs_) {
+        ERROR("%s is a corrupted mapped fst", file.c_str());
+    }
 }
 
 void Fst::Write(const std::string &file) const {
@@ -180,10 +278,9 @@ void Fst::Write(const std::string &file) const {
         WriteBasic(fout, arc_offset_[i]);   
     }
     
-    unordered_map<int, float>::const_iterator it = finals_.begin();
-    for (; it != finals_.end(); it++) {
-        WriteBasic(fout, it->first);
-        WriteBasic(fout, it->second);
+    for (int i = 0; i < num_finals; i++) {
+        WriteBasic(fout, finals_[i].state);
+        WriteBasic(fout, finals_[i].weight);
     }
 
     for (int i = 0; i < num_arcs; i++) {
@@ -193,6 +290,41 @@ void Fst::Write(const std::string &file) const {
     fclose(fout);
 }
 
+void Fst::WriteMapped(const std::string &file) const {
+    FILE *fout = fopen(file.c_str(), "wb");
+    if (!fout) {
+        ERROR("can not oopen file %s write", file.c_str());
+    }
+
+    MappedFstHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMappedFstMagic, sizeof(kMappedFstMagic));
+    header.version = kMappedFstVersion;
+    header.byte_order = kMappedByteOrder;
+    header.start = start_;
+    header.num_states = num_states_;
+    header.num_arcs = num_arcs_;
+    header.num_finals = num_finals_;
+    size_t arc_offset_size = (num_states_ + 1) * sizeof(int32_t),
+           arcs_size = num_arcs_ * sizeof(Arc),
+           final_bitmap_size = ((num_states_ + 63) / 64 + 1) * sizeof(uint64_t),
+           finals_size = num_finals_ * sizeof(FinalWeight);
+    header.arc_offset_pos = MappedAlign(sizeof(header));
+    header.arcs_pos = MappedAlign(header.arc_offset_pos + arc_offset_size);
+    header.final_bitmap_pos = MappedAlign(header.arcs_pos + arcs_size);
+    header.finals_pos = MappedAlign(header.final_bitmap_pos + final_bitmap_size);
+    header.file_size = header.finals_pos + finals_size;
+
+    WriteMappedSection(fout, 0, &header, sizeof(header));
+    WriteMappedSection(fout, header.arc_offset_pos, arc_offset_, arc_offset_size);
+    WriteMappedSection(fout, header.arcs_pos, arcs_, arcs_size);
+    WriteMappedSection(fout, header.final_bitmap_pos, final_bitmap_,
+                       final_bitmap_size);
+    WriteMappedSection(fout, header.finals_pos, finals_, finals_size);
+
+    fclose(fout);
+}
+
 void Fst::Dot(const SymbolTable &isymbol_table, 
               const SymbolTable &osymbol_table) const {
     printf("digraph FSM {\n");
@@ -10,9 +10,10 @@
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <map>
 
-#include "util/stl-utils.h"
 #include "utils.h"
+#include "mapped-file.h"
 #include "symbol-table.h"
 
 namespace kaldi {
@@ -39,13 +40,41 @@ struct Arc {
     int32_t next_state;
 };
 
+struct FinalWeight {
+    int32_t state;
+    float weight;
+};
+
+/* Mapped fst format (Fst::WriteMapped), which Fst::Read maps read-only and
+   uses in place, so the processes using one fst share the pages. All the
+   sections start at a kMappedAlign aligned position, in native byte order:
+     MappedFstHeader
+     int32_t arc_offset[num_states + 1], arcs of state s are
+         [arc_offset[s], arc_offset[s + 1])
+     Arc arcs[num_arcs]
+     uint64_t final_bitmap[(num_states + 63) / 64 + 1], bit s for state s
+     FinalWeight finals[num_finals], in state order */
+const char kMappedFstMagic[8] = { 'K', 'W', 'S', 'F', 'S', 'T', 'M', 'P' };
+const int32_t kMappedFstVersion = 1;
+
+struct MappedFstHeader {
+    char magic[8];
+    int32_t version;
+    uint32_t byte_order;
+    int32_t start, num_states, num_arcs, num_finals;
+    int64_t arc_offset_pos, arcs_pos, final_bitmap_pos, finals_pos;
+    int64_t file_size;
+};
+
 class Fst {
 public:
-    Fst(): start_(0) {}
-    Fst(const std::string &file) {
+    Fst(): mapped_(NULL) {
+        Reset();
+    }
+    Fst(const std::string &file): mapped_(NULL) {
         Read(file);
     }
-    //~Fst();
+    ~Fst();
     void Reset();
     void Info() const;
     
@@ -58,56 +87,69 @@ public:
     }
     
     int32_t NumFinals() const {
-        return finals_.size();
+        return num_finals_;
     }
 
     int32_t NumArcs() const {
-        return arcs_.size();
+        return num_arcs_;
     }
 
     int32_t NumStates() const {
-        return arc_offset_.size();
+        return num_states_;
     }
     
     bool IsFinal(int32_t id) const {
-        return (finals_.find(id) != finals_.end());
+        return id >= 0 && id < num_states_ &&
+               ((final_bitmap_[id >> 6] >> (id & 63)) & 1);
     }
 
     int32_t NumArcs(int32_t id) const {
-        if (id < NumStates() - 1) {
-            return arc_offset_[id + 1] - arc_offset_[id];
-        } else {
-            return arcs_.size() - arc_offset_[id];
-        }
+        CHECK(id < NumStates());
+        return arc_offset_[id + 1] - arc_offset_[id];
     }
 
     const Arc *ArcStart(int32_t id) const {
         CHECK(id < NumStates());
-        return arcs_.data() + arc_offset_[id];
+        return arcs_ + arc_offset_[id];
     }
 
     const Arc *ArcEnd(int32_t id) const {
         CHECK(id < NumStates());
-        if (id < NumStates() - 1) {
-            return arcs_.data() + arc_offset_[id + 1];
-        } else {
-            return arcs_.data() + arcs_.size();
-        }
+        return arcs_ + arc_offset_[id + 1];
+    }
+
+    // Whether the fst is mapped from a file of the mapped format
+    bool IsMapped() const {
+        return mapped_ != NULL;
     }
 
     void ReadTopo(const SymbolTable &isymbol_table, 
                   const SymbolTable &osymbol_table, 
                   const std::string &topo_file);
     
+    // Read the fst of the original format or map the mapped format
     void Read(const std::string &file);
     void Write(const std::string &file) const;
+    void WriteMapped(const std::string &file) const;
     void Dot(const SymbolTable &isymbol_table, 
              const SymbolTable &osymbol_table) const; 
 private:
-    int32_t start_;
-    std::vector<int32_t> arc_offset_; // arc offset of state
-    unordered_map<int32_t, float> finals_;
-    std::vector<Arc> arcs_;
+    void ReadMapped(const std::string &file);
+    // Point the arrays to the buffers, after they are filled
+    void SetBuffers(const std::map<int32_t, float> &finals);
+
+    int32_t start_, num_states_, num_arcs_, num_finals_;
+    // in the buffers below or the mapped file
+    const int32_t *arc_offset_; // arc offset of state, num_states_ + 1
+    const Arc *arcs_;
+    const uint64_t *final_bitmap_;
+    const FinalWeight *finals_;
+
+    std::vector<int32_t> arc_offset_buf_;
+    std::vector<Arc> arcs_buf_;
+    std::vector<uint64_t> final_bitmap_buf_;
+    std::vector<FinalWeight> finals_buf_;
+    MappedFile *mapped_;
     DISALLOW_COPY_AND_ASSIGN(Fst);
 };
 
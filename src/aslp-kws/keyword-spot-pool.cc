@@ -0,0 +1,336 @@
+// aslp-kws/keyword-spot-pool.cc
+
+#include "aslp-kws/keyword-spot-pool.h"
+#include "thread/kaldi-thread.h"
+
+namespace kaldi {
+namespace kws {
+
+KeywordSpotPool::Stream::Stream(const KeywordSpotPool &pool):
+        spotter(pool.graph_), transform_state(NULL) {
+    spotter.SetSpotThreshold(pool.opts_.spot_threshold);
+    spotter.SetMinKeywordFrames(pool.opts_.min_keyword_frames);
+    if (pool.feature_transform_ != NULL) {
+        transform_state = new aslp_nnet::NnetStreamState(*pool.feature_transform_);
+    }
+    Reset(pool);
+}
+
+KeywordSpotPool::Stream::~Stream() {
+    delete transform_state;
+}
+
+void KeywordSpotPool::Stream::Reset(const KeywordSpotPool &pool) {
+    spotter.Reset();
+    am_state = pool.zero_state_;
+    feats.Resize(0, 0);
+    finished = false;
+    num_frames = 0;
+}
+
+// Token passing of the streams of a batch, stream i is done by thread
+// i % num_threads_
+class KeywordSpotPool::SpotTask : public MultiThreadable {
+public:
+    SpotTask(const std::vector<int32> *ids,
+             const std::vector<Stream *> *streams):
+        ids_(ids), streams_(streams) {}
+
+    void operator() () {
+        for (size_t i = thread_id_; i < streams_->size(); i += num_threads_) {
+            KeywordSpotPool::SpotStream((*ids_)[i], (*streams_)[i]);
+        }
+    }
+
+private:
+    const std::vector<int32> *ids_;
+    const std::vector<Stream *> *streams_;
+};
+
+// Components looking at the neighbour rows, the rows of different streams
+// can not be put together for them
+static bool HasFrameContext(const aslp_nnet::Nnet &nnet) {
+    for (int32 c = 0; c < nnet.NumComponents(); c++) {
+        switch (nnet.GetComponent(c).GetType()) {
+            case aslp_nnet::Component::kSplice:
+            case aslp_nnet::Component::kRowConvolution:
+            case aslp_nnet::Component::kCompactFsmn:
+            case aslp_nnet::Component::kBLstmProjectedStreams:
+            case aslp_nnet::Component::kBLstm:
+            case aslp_nnet::Component::kBLstmProjectedStreamsLC:
+            case aslp_nnet::Component::kSentenceAveragingComponent:
+            case aslp_nnet::Component::kSimpleSentenceAveragingComponent:
+                return true;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+KeywordSpotPool::KeywordSpotPool(const KeywordSpotPoolOptions &opts,
+                                 aslp_nnet::Nnet *feature_transform,
+                                 aslp_nnet::Nnet *nnet,
+                                 const Fst &fst,
+                                 const SymbolTable &filler_table):
+        opts_(opts), feature_transform_(feature_transform), nnet_(nnet),
+        graph_(fst, filler_table), num_streams_(0) {
+    KALDI_ASSERT(nnet_ != NULL);
+    KALDI_ASSERT(opts_.num_threads > 0);
+    if (nnet_->NumInput() != 1 || nnet_->NumOutput() != 1) {
+        KALDI_ERR << "Num input and num output must equal 1";
+    }
+    if (HasFrameContext(*nnet_)) {
+        KALDI_ERR << "Batched spotting only supports frame by frame and "
+                  << "unidirectional multi-stream recurrent components in "
+                  << "the am, put the context in the feature transform";
+    }
+    if (graph_.MaxIlabel() > nnet_->OutputDim()) {
+        KALDI_ERR << "The fst has ilabel " << graph_.MaxIlabel()
+                  << " but the nnet output dim is " << nnet_->OutputDim();
+    }
+    if (feature_transform_ != NULL &&
+        feature_transform_->OutputDim() != nnet_->InputDim()) {
+        KALDI_ERR << "Feature transform output dim "
+                  << feature_transform_->OutputDim()
+                  << " mismatches the nnet input dim " << nnet_->InputDim();
+    }
+    // Allocate one stream state to know the state layout
+    std::vector<int32> flags(1, 1);
+    nnet_->ResetLstmStreams(flags);
+    nnet_->GetLstmStreamState(&zero_state_);
+    for (int i = 0; i < zero_state_.size(); i++) {
+        KALDI_ASSERT(zero_state_[i].NumRows() == 1);
+        zero_state_[i].SetZero();
+    }
+    recurrent_ = (zero_state_.size() > 0);
+}
+
+KeywordSpotPool::~KeywordSpotPool() {
+    for (int i = 0; i < streams_.size(); i++) {
+        delete streams_[i];
+    }
+    delete feature_transform_;
+    delete nnet_;
+}
+
+int32 KeywordSpotPool::NewStream() {
+    int32 id;
+    if (!free_ids_.empty()) {
+        id = free_ids_.back();
+        free_ids_.pop_back();
+    } else {
+        id = streams_.size();
+        streams_.push_back(NULL);
+    }
+    streams_[id] = new Stream(*this);
+    num_streams_++;
+    return id;
+}
+
+void KeywordSpotPool::DeleteStream(int32 stream) {
+    delete GetStream(stream);
+    streams_[stream] = NULL;
+    free_ids_.push_back(stream);
+    num_streams_--;
+}
+
+KeywordSpotPool::Stream *KeywordSpotPool::GetStream(int32 stream) const {
+    if (stream < 0 || stream >= streams_.size() || streams_[stream] == NULL) {
+        KALDI_ERR << "No stream " << stream << " in the pool";
+    }
+    return streams_[stream];
+}
+
+void KeywordSpotPool::AcceptFeatures(int32 stream,
+                                     const MatrixBase<BaseFloat> &feats) {
+    Stream *s = GetStream(stream);
+    if (s->finished) {
+        KALDI_ERR << "Stream " << stream << " got features after "
+                  << "InputFinished, call Compute first";
+    }
+    if (feats.NumRows() == 0) return;
+    int32 num_rows = s->feats.NumRows();
+    if (num_rows == 0) {
+        s->feats = feats;
+    } else {
+        KALDI_ASSERT(feats.NumCols() == s->feats.NumCols());
+        s->feats.Resize(num_rows + feats.NumRows(), feats.NumCols(),
+                        kCopyData);
+        s->feats.RowRange(num_rows, feats.NumRows()).CopyFromMat(feats);
+    }
+}
+
+void KeywordSpotPool::InputFinished(int32 stream) {
+    GetStream(stream)->finished = true;
+}
+
+void KeywordSpotPool::TransformFeatures(Stream *stream) {
+    if (feature_transform_ != NULL) {
+        CuMatrix<BaseFloat> feats;
+        if (stream->feats.NumRows() > 0) feats = stream->feats;
+        else feats.Resize(0, feature_transform_->InputDim());
+        feature_transform_->FeedforwardChunk(feats, stream->finished,
+                                             &stream->am_in,
+                                             stream->transform_state);
+    } else {
+        stream->am_in = stream->feats;
+    }
+    stream->feats.Resize(0, 0);
+    if (stream->am_in.NumRows() > 0 &&
+        stream->am_in.NumCols() != nnet_->InputDim()) {
+        KALDI_ERR << "Input dim " << stream->am_in.NumCols()
+                  << " mismatches the nnet input dim " << nnet_->InputDim();
+    }
+}
+
+void KeywordSpotPool::Compute(std::vector<KeywordDetection> *detections) {
+    KALDI_ASSERT(detections != NULL);
+    std::vector<int32> ids;
+    std::vector<Stream *> batch;
+    for (int32 id = 0; id < streams_.size(); id++) {
+        Stream *stream = streams_[id];
+        if (stream == NULL) continue;
+        if (stream->feats.NumRows() == 0 && !stream->finished) continue;
+        TransformFeatures(stream);
+        if (stream->am_in.NumRows() > 0) {
+            ids.push_back(id);
+            batch.push_back(stream);
+        }
+    }
+
+    if (!batch.empty()) {
+        if (recurrent_) ComputeStreamBatch(batch);
+        else ComputeBatch(batch);
+        SpotTask task(&ids, &batch);
+        // 0 runs the task in this thread
+        MultiThreader<SpotTask> threader(
+            opts_.num_threads > 1 ? opts_.num_threads : 0, task);
+    }
+
+    for (int32 id = 0; id < streams_.size(); id++) {
+        Stream *stream = streams_[id];
+        if (stream == NULL) continue;
+        detections->insert(detections->end(), stream->detections.begin(),
+                           stream->detections.end());
+        stream->detections.clear();
+        if (stream->finished) stream->Reset(*this);
+    }
+}
+
+void KeywordSpotPool::SpotStream(int32 id, Stream *stream) {
+    const Matrix<BaseFloat> &out = stream->am_out;
+    for (int32 t = 0; t < out.NumRows(); t++) {
+        float confidence = 0.0;
+        int32_t keyword = 0;
+        if (stream->spotter.Spot(out.RowData(t), out.NumCols(),
+                                 &confidence, &keyword)) {
+            KeywordDetection detection;
+            detection.stream = id;
+            detection.keyword = keyword;
+            detection.frame = stream->num_frames + t;
+            detection.confidence = confidence;
+            stream->detections.push_back(detection);
+            stream->spotter.Reset();
+        }
+    }
+    stream->num_frames += out.NumRows();
+}
+
+// Frame by frame model, just stack the streams
+void KeywordSpotPool::ComputeBatch(const std::vector<Stream *> &streams) {
+    int32 num_rows = 0;
+    for (int i = 0; i < streams.size(); i++) {
+        num_rows += streams[i]->am_in.NumRows();
+    }
+    CuMatrix<BaseFloat> feats(num_rows, nnet_->InputDim(), kUndefined), out;
+    int32 offset = 0;
+    for (int i = 0; i < streams.size(); i++) {
+        int32 rows = streams[i]->am_in.NumRows();
+        feats.RowRange(offset, rows).CopyFromMat(streams[i]->am_in);
+        offset += rows;
+    }
+    nnet_->Feedforward(feats, &out);
+    Matrix<BaseFloat> out_host(out);
+    offset = 0;
+    for (int i = 0; i < streams.size(); i++) {
+        int32 rows = streams[i]->am_in.NumRows();
+        streams[i]->am_out = out_host.RowRange(offset, rows);
+        offset += rows;
+    }
+}
+
+/* Recurrent model, the streams of one forward must have the same number of
+ * frames, so they are forwarded in rounds: every round forwards the first T
+ * left frames of the S streams still having frames, T being the least number
+ * of left frames among them.
+ */
+void KeywordSpotPool::ComputeStreamBatch(const std::vector<Stream *> &streams) {
+    std::vector<int32> offset(streams.size(), 0);
+    std::vector<CuMatrix<BaseFloat> > am_out(streams.size());
+    for (int i = 0; i < streams.size(); i++) {
+        am_out[i].Resize(streams[i]->am_in.NumRows(), nnet_->OutputDim(),
+                         kUndefined);
+    }
+    std::vector<CuMatrix<BaseFloat> > state(zero_state_.size());
+    CuMatrix<BaseFloat> feats, out;
+    while (true) {
+        std::vector<int32> active;
+        int32 T = 0;
+        for (int i = 0; i < streams.size(); i++) {
+            int32 left = streams[i]->am_in.NumRows() - offset[i];
+            if (left == 0) continue;
+            if (active.empty() || left < T) T = left;
+            active.push_back(i);
+        }
+        if (active.empty()) break;
+        int32 S = active.size();
+
+        // Gather input in multi-stream order and the stream states
+        std::vector<const BaseFloat *> in_rows(T * S);
+        std::vector<BaseFloat *> out_rows(T * S);
+        for (int32 t = 0; t < T; t++) {
+            for (int32 s = 0; s < S; s++) {
+                int32 i = active[s];
+                in_rows[t * S + s] = streams[i]->am_in.RowData(offset[i] + t);
+                out_rows[t * S + s] = am_out[i].RowData(offset[i] + t);
+            }
+        }
+        feats.Resize(T * S, nnet_->InputDim(), kUndefined);
+        feats.CopyRows(CuArray<const BaseFloat *>(in_rows));
+        for (int c = 0; c < state.size(); c++) {
+            std::vector<const BaseFloat *> state_rows(S);
+            for (int32 s = 0; s < S; s++) {
+                state_rows[s] = streams[active[s]]->am_state[c].RowData(0);
+            }
+            state[c].Resize(S, zero_state_[c].NumCols(), kUndefined);
+            state[c].CopyRows(CuArray<const BaseFloat *>(state_rows));
+        }
+        nnet_->SetLstmStreamState(state);
+
+        nnet_->Feedforward(feats, &out);
+
+        // Scatter output and the new stream states
+        out.CopyToRows(CuArray<BaseFloat *>(out_rows));
+        nnet_->GetLstmStreamState(&state);
+        for (int c = 0; c < state.size(); c++) {
+            std::vector<BaseFloat *> state_rows(S);
+            for (int32 s = 0; s < S; s++) {
+                state_rows[s] = streams[active[s]]->am_state[c].RowData(0);
+            }
+            state[c].CopyToRows(CuArray<BaseFloat *>(state_rows));
+        }
+
+        for (int32 s = 0; s < S; s++) {
+            offset[active[s]] += T;
+        }
+    }
+    for (int i = 0; i < streams.size(); i++) {
+        streams[i]->am_out.Resize(am_out[i].NumRows(), am_out[i].NumCols(),
+                                  kUndefined);
+        am_out[i].CopyToMat(&streams[i]->am_out);
+    }
+}
+
+} // namespace kws
+} // namespace kaldi
@@ -0,0 +1,133 @@
+// aslp-kws/keyword-spot-pool.h
+
+/* Keyword spotting on many audio streams in one process.
+ *
+ * All the streams share one nnet and one SpotGraph, a stream only keeps its
+ * own forward state and tokens. The caller queues the features of the
+ * streams by AcceptFeatures(), then every Compute() forwards the queued
+ * frames of all the streams as one batch and runs the token passing of the
+ * streams on several threads.
+ *
+ * The feature transform (usually splicing) is run per stream with
+ * Nnet::FeedforwardChunk, so it may look at the neighbour frames. The am
+ * forward puts the rows of different streams together, it supports frame by
+ * frame and unidirectional multi-stream recurrent components, the recurrent
+ * state of every stream is saved and restored around each batch.
+ */
+
+#ifndef ASLP_KWS_KEYWORD_SPOT_POOL_H_
+#define ASLP_KWS_KEYWORD_SPOT_POOL_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+
+#include "aslp-nnet/nnet-nnet.h"
+#include "aslp-kws/keyword-spot.h"
+
+namespace kaldi {
+namespace kws {
+
+struct KeywordSpotPoolOptions {
+    BaseFloat spot_threshold;
+    int32 min_keyword_frames;
+    int32 num_threads;
+
+    KeywordSpotPoolOptions(): spot_threshold(0.5), min_keyword_frames(0),
+                              num_threads(1) {}
+
+    void Register(OptionsItf *opts) {
+        opts->Register("spot-threshold", &spot_threshold,
+                "Confidence threshold of a keyword detection");
+        opts->Register("min-keyword-frames", &min_keyword_frames,
+                "Min number of keyword frames of a detection");
+        opts->Register("num-threads", &num_threads,
+                "Number of threads for the token passing of the streams");
+    }
+};
+
+struct KeywordDetection {
+    int32 stream;
+    int32 keyword;
+    // index of the am output frame of the stream where it's spotted
+    int32 frame;
+    BaseFloat confidence;
+};
+
+class KeywordSpotPool {
+public:
+    // The pool takes the ownership of @feature_transform (may be NULL) and
+    // @nnet, @fst and @filler_table must outlive the pool
+    KeywordSpotPool(const KeywordSpotPoolOptions &opts,
+                    aslp_nnet::Nnet *feature_transform, aslp_nnet::Nnet *nnet,
+                    const Fst &fst, const SymbolTable &filler_table);
+    ~KeywordSpotPool();
+
+    // A new stream, returns its id
+    int32 NewStream();
+    void DeleteStream(int32 stream);
+    int32 NumStreams() const { return num_streams_; }
+
+    // Queue the features of a stream for the next Compute()
+    void AcceptFeatures(int32 stream, const MatrixBase<BaseFloat> &feats);
+    // No more features of the current utterance of the stream, the next
+    // Compute() flushes it and the stream starts a new utterance after it
+    void InputFinished(int32 stream);
+
+    // Forward and spot the queued frames of all the streams, the detections
+    // are appended to @detections in stream order. After a detection the
+    // spotter of the stream is reset, so a keyword is reported once
+    void Compute(std::vector<KeywordDetection> *detections);
+
+private:
+    struct Stream {
+        explicit Stream(const KeywordSpotPool &pool);
+        ~Stream();
+        void Reset(const KeywordSpotPool &pool);
+
+        KeywordSpot spotter;
+        // Streaming state of the feature transform
+        aslp_nnet::NnetStreamState *transform_state;
+        // Recurrent state of the am, one single row matrix per recurrent
+        // component
+        std::vector<CuMatrix<BaseFloat> > am_state;
+        // Queued features, and the am input of the current batch
+        Matrix<BaseFloat> feats;
+        CuMatrix<BaseFloat> am_in;
+        Matrix<BaseFloat> am_out;
+        bool finished;
+        // Number of frames spotted of the utterance
+        int32 num_frames;
+        // Detections of the current batch
+        std::vector<KeywordDetection> detections;
+    };
+
+    class SpotTask;
+
+    void TransformFeatures(Stream *stream);
+    // Forward the am_in of @streams to their am_out
+    void ComputeBatch(const std::vector<Stream *> &streams);
+    void ComputeStreamBatch(const std::vector<Stream *> &streams);
+    static void SpotStream(int32 id, Stream *stream);
+
+    Stream *GetStream(int32 stream) const;
+
+    KeywordSpotPoolOptions opts_;
+    aslp_nnet::Nnet *feature_transform_;
+    aslp_nnet::Nnet *nnet_;
+    SpotGraph graph_;
+    bool recurrent_;
+    // Recurrent state of a new stream
+    std::vector<CuMatrix<BaseFloat> > zero_state_;
+    // Indexed by the stream id, NULL for the deleted ones
+    std::vector<Stream *> streams_;
+    std::vector<int32> free_ids_;
+    int32 num_streams_;
+    KALDI_DISALLOW_COPY_AND_ASSIGN(KeywordSpotPool);
+};
+
+} // namespace kws
+} // namespace kaldi
+
+#endif
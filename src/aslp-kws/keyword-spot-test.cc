@@ -0,0 +1,266 @@
+/*
+ * Created on 2018-05-02
+ * Author: Zhang Binbin
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <math.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "keyword-spot.h"
+
+namespace kaldi {
+namespace kws {
+
+// The spotter before the active state list and the SoA tokens, every state
+// is scanned and all the tokens are reset every frame, as the reference
+class ReferenceKeywordSpot {
+public:
+    ReferenceKeywordSpot(const Fst &fst, const SymbolTable &filler_table):
+            fst_(fst), filler_table_(filler_table), spot_threshold_(0.5),
+            min_keyword_frames_(0), min_frames_for_last_state_(5) {
+        prev_tokens_.resize(fst_.NumStates(), Token());
+        cur_tokens_.resize(fst_.NumStates(), Token());
+        Reset();
+    }
+
+    void Reset() {
+        for (int i = 0; i < prev_tokens_.size(); i++) prev_tokens_[i].Reset();
+        for (int i = 0; i < cur_tokens_.size(); i++) cur_tokens_[i].Reset();
+        prev_tokens_[0].active = true;
+    }
+
+    bool Spot(const float *am_score, float *confidence, int32_t *keyword_id) {
+        bool spot = false;
+        *confidence = 0.0;
+        *keyword_id = 0;
+        for (int i = 0; i < prev_tokens_.size(); i++) {
+            if (!prev_tokens_[i].active) continue;
+            for (const Arc *arc = fst_.ArcStart(i); arc != fst_.ArcEnd(i); arc++) {
+                float score = logf(am_score[arc->ilabel - 1]);
+                cur_tokens_[arc->next_state].Update(prev_tokens_[i],
+                    arc->olabel, i == arc->next_state,
+                    filler_table_.HaveId(arc->ilabel), score);
+            }
+        }
+        int best_final_state = 0;
+        float best_final_score = 0.0f;
+        bool reach_final = false;
+        for (int i = 1; i < cur_tokens_.size(); i++) {
+            if (cur_tokens_[i].active && fst_.IsFinal(i)) {
+                if (!reach_final || best_final_score < cur_tokens_[i].score) {
+                    best_final_state = i;
+                    best_final_score = cur_tokens_[i].score;
+                    reach_final = true;
+                }
+            }
+        }
+        if (reach_final) {
+            const Token &token = cur_tokens_[best_final_state];
+            *confidence = expf(token.average_max_keyword_score);
+            *keyword_id = token.keyword;
+            if (token.num_keyword_frames >= min_keyword_frames_ &&
+                token.num_frames_of_current_state >= min_frames_for_last_state_ &&
+                *confidence > spot_threshold_) {
+                spot = true;
+            }
+        }
+        prev_tokens_.swap(cur_tokens_);
+        for (int i = 0; i < cur_tokens_.size(); i++) cur_tokens_[i].Reset();
+        return spot;
+    }
+
+private:
+    struct Token {
+        Token() { Reset(); }
+        void Reset() {
+            active = false;
+            is_filler = true;
+            score = 0;
+            num_keyword_frames = 0;
+            keyword = 0;
+            num_frames_of_current_state = 0;
+            num_keyword_states = 0;
+            max_score_of_current_state = 0.0;
+            average_max_keyword_score = 0.0;
+            average_max_keyword_score_before = 0.0;
+        }
+
+        void Update(const Token &prev, int32_t olabel, bool is_self_arc,
+                    bool is_filler, float am_score) {
+            if (!active || score < prev.score + am_score) {
+                score = prev.score + am_score;
+                if (!is_filler) {
+                    num_keyword_frames = prev.num_keyword_frames + 1;
+                    if (is_self_arc) {
+                        num_frames_of_current_state = prev.num_frames_of_current_state + 1;
+                        num_keyword_states = prev.num_keyword_states;
+                        max_score_of_current_state = std::max(prev.max_score_of_current_state, am_score);
+                        average_max_keyword_score_before = prev.average_max_keyword_score_before;
+                    } else {
+                        num_frames_of_current_state = 1;
+                        num_keyword_states = prev.num_keyword_states + 1;
+                        max_score_of_current_state = am_score;
+                        average_max_keyword_score_before = prev.average_max_keyword_score;
+                    }
+                    average_max_keyword_score = (max_score_of_current_state +
+                        average_max_keyword_score_before * (num_keyword_states - 1)) /
+                        num_keyword_states;
+                    if (olabel != 0) keyword = olabel;
+                }
+            }
+            active = true;
+            this->is_filler = is_filler;
+        }
+
+        bool active;
+        bool is_filler;
+        float score;
+        int num_keyword_frames;
+        int32_t keyword;
+        int num_frames_of_current_state;
+        int num_keyword_states;
+        float max_score_of_current_state;
+        float average_max_keyword_score;
+        float average_max_keyword_score_before;
+    };
+
+    const Fst &fst_;
+    const SymbolTable &filler_table_;
+    std::vector<Token> prev_tokens_;
+    std::vector<Token> cur_tokens_;
+    float spot_threshold_;
+    int min_keyword_frames_;
+    int min_frames_for_last_state_;
+};
+
+static void WriteFile(const std::string &file, const std::string &text) {
+    FILE *fp = fopen(file.c_str(), "w");
+    CHECK(fp != NULL);
+    fputs(text.c_str(), fp);
+    fclose(fp);
+}
+
+// Posteriors of num_frames frames, segments of a few frames each peaked on
+// a random phone, the keyword phones in order now and then, so the
+// keywords are spotted and the tokens compete
+static void RandPosteriors(int num_frames, int num_pdfs,
+                           std::vector<float> *posteriors) {
+    // phone ids of the keywords "a b c" and "d b"
+    const int keyword[2][3] = { { 3, 4, 5 }, { 6, 4, 0 } };
+    posteriors->resize(num_frames * num_pdfs);
+    int t = 0;
+    while (t < num_frames) {
+        std::vector<int> phones;
+        if (rand() % 3 == 0) {
+            int k = rand() % 2;
+            for (int i = 0; i < 3 && keyword[k][i] > 0; i++) {
+                phones.push_back(keyword[k][i]);
+            }
+        } else {
+            phones.push_back(1 + rand() % num_pdfs);
+        }
+        for (size_t p = 0; p < phones.size(); p++) {
+            int len = 1 + rand() % 10;
+            for (int i = 0; i < len && t < num_frames; i++, t++) {
+                float *row = &(*posteriors)[t * num_pdfs], sum = 0.0f;
+                for (int j = 0; j < num_pdfs; j++) {
+                    row[j] = 0.01f + static_cast<float>(rand()) / RAND_MAX;
+                }
+                row[phones[p] - 1] += 2.0f + 8.0f * rand() / RAND_MAX;
+                for (int j = 0; j < num_pdfs; j++) sum += row[j];
+                for (int j = 0; j < num_pdfs; j++) row[j] /= sum;
+            }
+        }
+    }
+}
+
+void UnitTestKeywordSpot() {
+    WriteFile("tmp.isym", "<eps> 0\nsil 1\ngbg 2\na 3\nb 4\nc 5\nd 6\n");
+    WriteFile("tmp.osym", "<eps> 0\nhello 1\nworld 2\n");
+    WriteFile("tmp.filler", "sil 1\ngbg 2\n");
+    // two keywords sharing phone b, fillers on the start state, the
+    // keyword end states go back to the fillers
+    WriteFile("tmp.topo",
+              "0 0 sil <eps>\n"
+              "0 0 gbg <eps>\n"
+              "0 1 a hello\n"
+              "1 1 a <eps>\n"
+              "1 2 b <eps>\n"
+              "2 2 b <eps>\n"
+              "2 3 c <eps>\n"
+              "3 3 c <eps>\n"
+              "3 0 sil <eps>\n"
+              "0 4 d world\n"
+              "4 4 d <eps>\n"
+              "4 5 b <eps>\n"
+              "5 5 b <eps>\n"
+              "5 0 gbg <eps>\n"
+              "3 0\n"
+              "5 0\n");
+    SymbolTable isymbol_table("tmp.isym"), osymbol_table("tmp.osym"),
+                filler_table("tmp.filler");
+    Fst fst;
+    fst.ReadTopo(isymbol_table, osymbol_table, "tmp.topo");
+    unlink("tmp.isym");
+    unlink("tmp.osym");
+    unlink("tmp.filler");
+    unlink("tmp.topo");
+
+    const int num_pdfs = 6, num_frames = 3000;
+    SpotGraph graph(fst, filler_table);
+    ReferenceKeywordSpot reference(fst, filler_table);
+    KeywordSpot spotter(fst, filler_table), batch_spotter(graph);
+    std::vector<float> posteriors, confidence(num_frames);
+    std::vector<int32_t> keyword(num_frames);
+    int num_spots = 0;
+    for (int n = 0; n < 3; n++) {
+        RandPosteriors(num_frames, num_pdfs, &posteriors);
+        // spot frame by frame and in batches, batches of 1 frame and
+        // batches not dividing the utterance
+        int batch_size = 1 + n * 6;
+        reference.Reset();
+        spotter.Reset();
+        batch_spotter.Reset();
+        for (int t = 0; t < num_frames; t += batch_size) {
+            int num = std::min(batch_size, num_frames - t);
+            int first = batch_spotter.SpotFrames(&posteriors[t * num_pdfs], num,
+                                                 num_pdfs, num_pdfs,
+                                                 &confidence[t], &keyword[t]);
+            int first_ref = -1;
+            for (int i = t; i < t + num; i++) {
+                float ref_confidence, frame_confidence;
+                int32_t ref_keyword, frame_keyword;
+                bool ref_spot = reference.Spot(&posteriors[i * num_pdfs],
+                                               &ref_confidence, &ref_keyword);
+                bool spot = spotter.Spot(&posteriors[i * num_pdfs], num_pdfs,
+                                         &frame_confidence, &frame_keyword);
+                CHECK(spot == ref_spot);
+                CHECK(frame_confidence == ref_confidence);
+                CHECK(frame_keyword == ref_keyword);
+                CHECK(confidence[i] == ref_confidence);
+                CHECK(keyword[i] == ref_keyword);
+                if (ref_spot && first_ref < 0) first_ref = i - t;
+                if (ref_spot) num_spots++;
+            }
+            CHECK(first == first_ref);
+        }
+    }
+    // the posteriors must spot the keywords, or nothing is checked
+    LOG("%d spotted frames", num_spots);
+    CHECK(num_spots > 0);
+}
+
+}
+}
+
+int main() {
+    using namespace kaldi::kws;
+    UnitTestKeywordSpot();
+    LOG("Tests succeeded.");
+    return 0;
+}
@@ -0,0 +1,260 @@
+/*
+ * Created on 2018-02-05
+ * Author: Zhang Binbin
+ */
+
+#include <algorithm>
+
+#include "keyword-spot.h"
+
+namespace kaldi {
+namespace kws {
+
+void KeywordSpot::Tokens::Resize(int num_states) {
+    active_states.reserve(num_states);
+    active.resize(num_states, 0);
+    is_filler.resize(num_states, 1);
+    score.resize(num_states, 0.0f);
+    num_keyword_frames.resize(num_states, 0);
+    keyword.resize(num_states, 0);
+    num_frames_of_current_state.resize(num_states, 0);
+    num_keyword_states.resize(num_states, 0);
+    max_score_of_current_state.resize(num_states, 0.0f);
+    average_max_keyword_score.resize(num_states, 0.0f);
+    average_max_keyword_score_before.resize(num_states, 0.0f);
+}
+
+void KeywordSpot::Tokens::Activate(int32_t s) {
+    active[s] = 1;
+    active_states.push_back(s);
+    is_filler[s] = 1;
+    score[s] = 0.0f;
+    num_keyword_frames[s] = 0;
+    keyword[s] = 0;
+    num_frames_of_current_state[s] = 0;
+    num_keyword_states[s] = 0;
+    max_score_of_current_state[s] = 0.0f;
+    average_max_keyword_score[s] = 0.0f;
+    average_max_keyword_score_before[s] = 0.0f;
+}
+
+void KeywordSpot::Tokens::Clear() {
+    for (size_t i = 0; i < active_states.size(); i++) {
+        active[active_states[i]] = 0;
+    }
+    active_states.clear();
+}
+
+SpotGraph::SpotGraph(const Fst &fst, const SymbolTable &filler_table):
+        filler_table_(filler_table), max_ilabel_(0) {
+    int num_states = fst.NumStates();
+    CHECK(num_states > 0);
+    arc_offset_.resize(num_states + 1);
+    is_final_.resize(num_states);
+    arcs_.reserve(fst.NumArcs());
+    for (int32_t s = 0; s < num_states; s++) {
+        arc_offset_[s] = arcs_.size();
+        is_final_[s] = fst.IsFinal(s);
+        for (const Arc *arc = fst.ArcStart(s); arc != fst.ArcEnd(s); arc++) {
+            CHECK(arc->next_state >= 0);
+            CHECK(arc->next_state < num_states);
+            CHECK(arc->ilabel > 0); // no <eps> arc
+            SpotArc spot_arc;
+            spot_arc.next_state = arc->next_state;
+            spot_arc.ilabel = arc->ilabel;
+            spot_arc.olabel = arc->olabel;
+            spot_arc.is_filler = filler_table_.HaveId(arc->ilabel);
+            spot_arc.is_self_arc = (s == arc->next_state);
+            arcs_.push_back(spot_arc);
+            ilabels_.push_back(arc->ilabel);
+            max_ilabel_ = std::max(max_ilabel_, arc->ilabel);
+        }
+    }
+    arc_offset_[num_states] = arcs_.size();
+    std::sort(ilabels_.begin(), ilabels_.end());
+    ilabels_.erase(std::unique(ilabels_.begin(), ilabels_.end()),
+                   ilabels_.end());
+}
+
+KeywordSpot::KeywordSpot(const Fst &fst, const SymbolTable &filler_table):
+        own_graph_(new SpotGraph(fst, filler_table)) {
+    graph_ = own_graph_;
+    Init();
+}
+
+KeywordSpot::KeywordSpot(const SpotGraph &graph):
+        graph_(&graph), own_graph_(NULL) {
+    Init();
+}
+
+KeywordSpot::~KeywordSpot() {
+    delete own_graph_;
+}
+
+void KeywordSpot::Init() {
+    num_frames_ = 0;
+    prev_tokens_ = &tokens_[0];
+    cur_tokens_ = &tokens_[1];
+    spot_threshold_ = 0.5;
+    min_keyword_frames_ = 0;
+    min_frames_for_last_state_ = 5;
+    log_score_.resize(graph_->MaxIlabel() + 1, 0.0f);
+    tokens_[0].Resize(graph_->NumStates());
+    tokens_[1].Resize(graph_->NumStates());
+    Reset();
+}
+
+void KeywordSpot::Reset() {
+    prev_tokens_->Clear();
+    cur_tokens_->Clear();
+    prev_tokens_->Activate(0);
+    num_frames_ = 0;
+}
+
+bool KeywordSpot::Spot(const float *am_score, int num, float *confidence,
+                       int32_t *keyword_id) {
+    CHECK(graph_->MaxIlabel() <= num);
+    return SpotFrame(am_score, confidence, keyword_id);
+}
+
+int KeywordSpot::SpotFrames(const float *am_score, int num_frames, int num,
+                            int stride, float *confidence,
+                            int32_t *keyword_id) {
+    CHECK(graph_->MaxIlabel() <= num);
+    CHECK(stride >= num);
+    int first_spot = -1;
+    for (int t = 0; t < num_frames; t++) {
+        if (SpotFrame(am_score + t * stride, confidence + t, keyword_id + t)
+                && first_spot < 0) {
+            first_spot = t;
+        }
+    }
+    return first_spot;
+}
+
+bool KeywordSpot::SpotFrame(const float *am_score, float *confidence,
+                            int32_t *keyword_id) {
+    bool spot = false;
+    *confidence = 0.0;
+    *keyword_id = 0;
+
+    const std::vector<int32_t> &ilabels = graph_->Ilabels();
+    for (size_t k = 0; k < ilabels.size(); k++) {
+        log_score_[ilabels[k]] = logf(am_score[ilabels[k] - 1]);
+    }
+
+    Tokens &prev = *prev_tokens_, &cur = *cur_tokens_;
+    // the active states are in ascending order, the same order as a full
+    // scan of the states, so the ties are resolved the same way
+    for (size_t n = 0; n < prev.active_states.size(); n++) {
+        int32_t i = prev.active_states[n];
+        float prev_score = prev.score[i];
+        const SpotGraph::SpotArc *end = graph_->ArcEnd(i);
+        for (const SpotGraph::SpotArc *arc = graph_->ArcStart(i);
+             arc != end; arc++) {
+            int32_t j = arc->next_state;
+            float am = log_score_[arc->ilabel];
+            float score = prev_score + am;
+            bool better = true;
+            // first time access by previous token
+            if (!cur.active[j]) {
+                cur.Activate(j);
+            } else {
+                better = (cur.score[j] < score);
+            }
+            if (better) {
+                cur.score[j] = score;
+                // it's a keyword state
+                if (!arc->is_filler) {
+                    cur.num_keyword_frames[j] = prev.num_keyword_frames[i] + 1;
+                    if (arc->is_self_arc) {
+                        cur.num_frames_of_current_state[j] =
+                            prev.num_frames_of_current_state[i] + 1;
+                        cur.num_keyword_states[j] = prev.num_keyword_states[i];
+                        cur.max_score_of_current_state[j] =
+                            std::max(prev.max_score_of_current_state[i], am);
+                        cur.average_max_keyword_score_before[j] =
+                            prev.average_max_keyword_score_before[i];
+                        CHECK(cur.num_keyword_states[j] > 0);
+                    } else {
+                        cur.num_frames_of_current_state[j] = 1;
+                        cur.num_keyword_states[j] =
+                            prev.num_keyword_states[i] + 1;
+                        cur.max_score_of_current_state[j] = am;
+                        cur.average_max_keyword_score_before[j] =
+                            prev.average_max_keyword_score[i];
+                    }
+                    int num_states = cur.num_keyword_states[j];
+                    cur.average_max_keyword_score[j] =
+                        (cur.max_score_of_current_state[j] +
+                         cur.average_max_keyword_score_before[j] *
+                         (num_states - 1)) / num_states;
+                    if (arc->olabel != 0) cur.keyword[j] = arc->olabel;
+                }
+            }
+            cur.is_filler[j] = arc->is_filler;
+        }
+    }
+    // keep the active states in ascending order, a scan of the flags is
+    // cheaper than sorting when a good part of the states are active
+    if (cur.active_states.size() * 16 > cur.active.size()) {
+        cur.active_states.clear();
+        for (size_t i = 0; i < cur.active.size(); i++) {
+            if (cur.active[i]) cur.active_states.push_back(i);
+        }
+    } else {
+        std::sort(cur.active_states.begin(), cur.active_states.end());
+    }
+
+    // find best final score, an inactive state has score 0
+    int best_state = 0, best_final_state = 0;
+    float best_score = cur.active[0] ? cur.score[0] : 0.0f,
+          best_final_score = 0.0f;
+    bool reach_final = false;
+    for (size_t n = 0; n < cur.active_states.size(); n++) {
+        int32_t i = cur.active_states[n];
+        if (i == 0) continue;
+        if (best_score < cur.score[i]) {
+            best_score = cur.score[i];
+            best_state = i;
+        }
+
+        if (graph_->IsFinal(i)) {
+            if (!reach_final) {
+                best_final_state = i;
+                best_final_score = cur.score[i];
+                reach_final = true;
+            } else if (best_final_score < cur.score[i]) {
+                best_final_state = i;
+                best_final_score = cur.score[i];
+            }
+        }
+    }
+
+    // if we reach final state, then get confidence
+    if (reach_final) {
+        int32_t s = best_final_state;
+        *confidence = expf(cur.average_max_keyword_score[s]);
+        *keyword_id = cur.keyword[s];
+        if (cur.num_keyword_frames[s] >= min_keyword_frames_ &&
+            cur.num_frames_of_current_state[s] >= min_frames_for_last_state_ &&
+            *confidence > spot_threshold_) {
+            spot = true;
+        }
+    }
+    bool best_is_filler = cur.active[best_state] ? cur.is_filler[best_state]
+                                                 : true;
+
+    std::swap(prev_tokens_, cur_tokens_);
+    cur_tokens_->Clear();
+
+    num_frames_++;
+    // Reset state to avoid number overflow, and it's not in a keyword state
+    if (num_frames_ > kMaxTokenPassingFrames && best_is_filler) {
+        Reset();
+    }
+    return spot;
+}
+
+}
+}
@@ -0,0 +1,169 @@
+/*
+ * Created on 2018-05-02
+ * Author: Zhang Binbin
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <string>
+#include <vector>
+
+#include "fst.h"
+#include "symbol-table.h"
+
+namespace kaldi {
+namespace kws {
+
+static void WriteFile(const std::string &file, const std::string &text) {
+    FILE *fp = fopen(file.c_str(), "wb");
+    CHECK(fp != NULL);
+    fwrite(text.data(), 1, text.size(), fp);
+    fclose(fp);
+}
+
+static std::string ReadFile(const std::string &file) {
+    FILE *fp = fopen(file.c_str(), "rb");
+    CHECK(fp != NULL);
+    std::string text;
+    char buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        text.append(buffer, size);
+    }
+    fclose(fp);
+    return text;
+}
+
+// Whether reading the file (ERROR exits) succeeds, in a child process
+static bool ReadSucceeds(const std::string &file, bool is_fst) {
+    pid_t pid = fork();
+    CHECK(pid >= 0);
+    if (pid == 0) {
+        if (is_fst) {
+            Fst fst(file);
+        } else {
+            SymbolTable symbol_table(file);
+        }
+        _exit(0);
+    }
+    int status;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static void CheckSameFst(const Fst &fst, const Fst &mapped) {
+    CHECK(mapped.Start() == fst.Start());
+    CHECK(mapped.NumStates() == fst.NumStates());
+    CHECK(mapped.NumArcs() == fst.NumArcs());
+    CHECK(mapped.NumFinals() == fst.NumFinals());
+    for (int32_t s = -1; s <= fst.NumStates(); s++) {
+        CHECK(mapped.IsFinal(s) == fst.IsFinal(s));
+    }
+    for (int32_t s = 0; s < fst.NumStates(); s++) {
+        CHECK(mapped.NumArcs(s) == fst.NumArcs(s));
+        const Arc *arc = fst.ArcStart(s), *mapped_arc = mapped.ArcStart(s);
+        for (; arc != fst.ArcEnd(s); arc++, mapped_arc++) {
+            CHECK(mapped_arc->ilabel == arc->ilabel);
+            CHECK(mapped_arc->olabel == arc->olabel);
+            CHECK(mapped_arc->weight == arc->weight);
+            CHECK(mapped_arc->next_state == arc->next_state);
+        }
+        CHECK(mapped_arc == mapped.ArcEnd(s));
+    }
+}
+
+static void CheckSameSymbolTable(const SymbolTable &symbol_table,
+                                 const SymbolTable &mapped,
+                                 const std::vector<std::string> &symbols) {
+    for (int32_t i = -1; i < (int32_t)symbols.size() + 2; i++) {
+        CHECK(mapped.HaveId(i) == symbol_table.HaveId(i));
+        if (symbol_table.HaveId(i)) {
+            CHECK(mapped.GetSymbol(i) == symbol_table.GetSymbol(i));
+        }
+    }
+    for (size_t i = 0; i < symbols.size(); i++) {
+        CHECK(mapped.GetId(symbols[i]) == symbol_table.GetId(symbols[i]));
+    }
+    CHECK(mapped.GetId("none") == -1);
+}
+
+void UnitTestMappedFst() {
+    // ids 4 and 5 have no symbol
+    WriteFile("tmp.isym", "<eps> 0\nsil 1\na 2\nb 3\nc 6\n");
+    WriteFile("tmp.osym", "<eps> 0\nhello 1\nworld 2\n");
+    WriteFile("tmp.topo",
+              "0 0 sil <eps> 0.5\n"
+              "0 1 a hello 1.25\n"
+              "1 1 a <eps>\n"
+              "1 2 b <eps>\n"
+              "2 2 b <eps>\n"
+              "0 3 c world -2.0\n"
+              "3 0 sil <eps>\n"
+              "2 0.5\n"
+              "3 0\n");
+    SymbolTable isymbol_table("tmp.isym"), osymbol_table("tmp.osym");
+    Fst fst;
+    fst.ReadTopo(isymbol_table, osymbol_table, "tmp.topo");
+    CHECK(!fst.IsMapped() && !isymbol_table.IsMapped());
+    CHECK(fst.NumStates() == 4 && fst.NumArcs() == 7 && fst.NumFinals() == 2);
+
+    // write the mapped format and map it back
+    fst.WriteMapped("tmp.fst.map");
+    isymbol_table.WriteMapped("tmp.isym.map");
+    {
+        Fst mapped("tmp.fst.map");
+        SymbolTable mapped_isymbol_table("tmp.isym.map");
+        CHECK(mapped.IsMapped() && mapped_isymbol_table.IsMapped());
+        CheckSameFst(fst, mapped);
+        std::vector<std::string> symbols;
+        symbols.push_back("<eps>");
+        symbols.push_back("sil");
+        symbols.push_back("a");
+        symbols.push_back("b");
+        symbols.push_back("c");
+        CheckSameSymbolTable(isymbol_table, mapped_isymbol_table, symbols);
+        // the mapped fst written in the original format reads the same
+        mapped.Write("tmp.fst");
+        Fst fst_read("tmp.fst");
+        CHECK(!fst_read.IsMapped());
+        CheckSameFst(fst, fst_read);
+    }
+
+    // a truncated file is refused, not read out of the mapping
+    std::string fst_data = ReadFile("tmp.fst.map"),
+                symbol_data = ReadFile("tmp.isym.map");
+    CHECK(ReadSucceeds("tmp.fst.map", true));
+    CHECK(ReadSucceeds("tmp.isym.map", false));
+    size_t fst_cut[] = { fst_data.size() - 1, fst_data.size() / 2,
+                         sizeof(MappedFstHeader), 16 };
+    for (int i = 0; i < 4; i++) {
+        WriteFile("tmp.fst.map", fst_data.substr(0, fst_cut[i]));
+        CHECK(!ReadSucceeds("tmp.fst.map", true));
+    }
+    size_t symbol_cut[] = { symbol_data.size() - 1, sizeof(MappedSymbolHeader),
+                            16 };
+    for (int i = 0; i < 3; i++) {
+        WriteFile("tmp.isym.map", symbol_data.substr(0, symbol_cut[i]));
+        CHECK(!ReadSucceeds("tmp.isym.map", false));
+    }
+
+    unlink("tmp.isym");
+    unlink("tmp.osym");
+    unlink("tmp.topo");
+    unlink("tmp.fst");
+    unlink("tmp.fst.map");
+    unlink("tmp.isym.map");
+}
+
+}
+}
+
+int main() {
+    using namespace kaldi::kws;
+    UnitTestMappedFst();
+    LOG("Tests succeeded.");
+    return 0;
+}
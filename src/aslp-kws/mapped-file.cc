@@ -0,0 +1,68 @@
+/*
+ * Created on 2018-04-22
+ * Author: Zhang Binbin
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mapped-file.h"
+
+namespace kaldi {
+namespace kws {
+
+MappedFile::MappedFile(const std::string &file): data_(NULL), size_(0) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        ERROR("file %s not exist", file.c_str());
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        ERROR("can not stat file %s or it's empty", file.c_str());
+    }
+    size_ = st.st_size;
+    void *data = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps the file
+    close(fd);
+    if (data == MAP_FAILED) {
+        ERROR("mmap file %s failed", file.c_str());
+    }
+    data_ = static_cast<char *>(data);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != NULL) munmap(data_, size_);
+}
+
+bool MappedFile::HasMagic(const std::string &file, const char *magic,
+                          size_t size) {
+    FILE *fin = fopen(file.c_str(), "rb");
+    if (!fin) return false;
+    char buffer[64];
+    CHECK(size <= sizeof(buffer));
+    bool match = (fread(buffer, 1, size, fin) == size &&
+                  memcmp(buffer, magic, size) == 0);
+    fclose(fin);
+    return match;
+}
+
+void WriteMappedSection(FILE *fout, int64_t pos, const void *data,
+                        size_t size) {
+    long cur = ftell(fout);
+    CHECK(cur <= pos);
+    for (; cur < pos; cur++) {
+        if (fputc(0, fout) == EOF) {
+            ERROR("Write failure in WriteMappedSection.");
+        }
+    }
+    if (size > 0 && fwrite(data, 1, size, fout) != size) {
+        ERROR("Write failure in WriteMappedSection.");
+    }
+}
+
+}
+}
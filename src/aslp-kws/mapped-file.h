@@ -0,0 +1,56 @@
+/*
+ * Created on 2018-04-22
+ * Author: Zhang Binbin
+ */
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+#include "utils.h"
+
+namespace kaldi {
+namespace kws {
+
+// Alignment of the sections of the mapped formats (see Fst and SymbolTable),
+// so the arrays can be used in place
+const int kMappedAlign = 64;
+// Written in the header, to refuse the files of other byte order
+const uint32_t kMappedByteOrder = 0x01020304;
+
+inline int64_t MappedAlign(int64_t pos) {
+    return (pos + kMappedAlign - 1) / kMappedAlign * kMappedAlign;
+}
+
+// Read-only mmap of a whole file, the pages are shared by all the processes
+// mapping the same file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &file);
+    ~MappedFile();
+
+    const char *Data() const { return data_; }
+    size_t Size() const { return size_; }
+
+    // Whether the file starts with the magic (of size bytes)
+    static bool HasMagic(const std::string &file, const char *magic,
+                         size_t size);
+
+private:
+    char *data_;
+    size_t size_;
+    DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+// Write size bytes of data at pos of fout, zeros are padded from the current
+// position, which must not be after pos
+void WriteMappedSection(FILE *fout, int64_t pos, const void *data,
+                        size_t size);
+
+}
+}
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * Created on 2016-11-11
+ * Author: Zhang Binbin
+ */
+
+#include <string.h>
+
+#include <map>
+
+#include "symbol-table.h"
+
+namespace kaldi {
+namespace kws {
+
+SymbolTable::SymbolTable(const std::string &symbol_file): mapped_(NULL) {
+    if (MappedFile::HasMagic(symbol_file, kMappedSymbolMagic,
+                             sizeof(kMappedSymbolMagic))) {
+        ReadMapped(symbol_file);
+    } else {
+        ReadSymbolFile(symbol_file);
+    }
+}
+
+SymbolTable::~SymbolTable() {
+    delete mapped_;
+}
+
+int32_t SymbolTable::GetId(const std::string &symbol) const {
+    for (int32_t i = 0; i < num_ids_; i++) {
+        if (HaveId(i) && symbol == pool_ + offset_[i]) return i;
+    }
+    // return -f if not find
+    return -1;
+}
+
+void SymbolTable::ReadSymbolFile(const std::string &symbol_file) {
+    FILE *fp = fopen(symbol_file.c_str(), "r");
+    if (!fp) {
+        ERROR("%s not exint, please check!!!", symbol_file.c_str());
+    }
+    char buffer[1024], str[1024];
+    int id;
+    std::map<int32_t, std::string> symbols;
+    while (fgets(buffer, 1024, fp)) {
+        int num = sscanf(buffer, "%s %d", str, &id);
+        if (num != 2) {
+            ERROR("each line shoud have 2 fields, symbol & id");
+        }
+        CHECK(id >= 0);
+        symbols[id] = str;
+    }
+    fclose(fp);
+
+    num_ids_ = symbols.empty() ? 0 : symbols.rbegin()->first + 1;
+    offset_buf_.assign(num_ids_ + 1, 0);
+    pool_buf_.clear();
+    std::map<int32_t, std::string>::const_iterator it = symbols.begin();
+    for (int32_t i = 0; i < num_ids_; i++) {
+        offset_buf_[i] = pool_buf_.size();
+        if (it != symbols.end() && it->first == i) {
+            pool_buf_.insert(pool_buf_.end(), it->second.begin(),
+                             it->second.end());
+            pool_buf_.push_back('\0');
+            it++;
+        }
+    }
+    offset_buf_[num_ids_] = pool_buf_.size();
+    // never empty, so pool_ is valid
+    pool_buf_.push_back('\0');
+    pool_size_ = pool_buf_.size();
+    offset_ = offset_buf_.data();
+    pool_ = pool_buf_.data();
+}
+
+void SymbolTable::ReadMapped(const std::string &symbol_file) {
+    mapped_ = new MappedFile(symbol_file);
+    const char *data = mapped_->Data();
+    size_t size = mapped_->Size();
+    if (size < sizeof(MappedSymbolHeader)) {
+        ERROR("%s is too short for a mapped symbol table",
+              symbol_file.c_str());
+    }
+    const MappedSymbolHeader *header =
+        reinterpret_cast<const MappedSymbolHeader *>(data);
+    if (header->byte_order != kMappedByteOrder) {
+        ERROR("%s is written in another byte order", symbol_file.c_str());
+    }
+    if (header->version != kMappedSymbolVersion) {
+        ERROR("%s is mapped symbol table version %d, expected %d",
+              symbol_file.c_str(), header->version, kMappedSymbolVersion);
+    }
+    int64_t num_ids = header->num_ids, pool_size = header->pool_size;
+    if (num_ids < 0 || pool_size <= 0 || header->file_size != size ||
+        header->offset_pos + (num_ids + 1) * sizeof(int32_t) > size ||
+        header->pool_pos + pool_size > size) {
+        ERROR("%s is a corrupted mapped symbol table", symbol_file.c_str());
+    }
+    num_ids_ = num_ids;
+    pool_size_ = pool_size;
+    offset_ = reinterpret_cast<const int32_t *>(data + header->offset_pos);
+    pool_ = data + header->pool_pos;
+    if (offset_[num_ids_] >= pool_size_ || pool_[pool_size_ - 1] != '\0') {
+        ERROR("%s is a corrupted mapped symbol table", symbol_file.c_str());
+    }
+}
+
+void SymbolTable::WriteMapped(const std::string &file) const {
+    FILE *fout = fopen(file.c_str(), "wb");
+    if (!fout) {
+        ERROR("can not oopen file %s write", file.c_str());
+    }
+
+    MappedSymbolHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMappedSymbolMagic, sizeof(kMappedSymbolMagic));
+    header.version = kMappedSymbolVersion;
+    header.byte_order = kMappedByteOrder;
+    header.num_ids = num_ids_;
+    header.pool_size = pool_size_;
+    size_t offset_size = (num_ids_ + 1) * sizeof(int32_t);
+    header.offset_pos = MappedAlign(sizeof(header));
+    header.pool_pos = MappedAlign(header.offset_pos + offset_size);
+    header.file_size = header.pool_pos + pool_size_;
+
+    WriteMappedSection(fout, 0, &header, sizeof(header));
+    WriteMappedSection(fout, header.offset_pos, offset_, offset_size);
+    WriteMappedSection(fout, header.pool_pos, pool_, pool_size_);
+
+    fclose(fout);
+}
+
+}
+}
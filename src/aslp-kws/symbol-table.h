@@ -8,66 +8,74 @@
 
 #include <stdio.h>
 #include <string>
-
-#include "util/stl-utils.h"
+#include <vector>
 
 #include "utils.h"
+#include "mapped-file.h"
 
 namespace kaldi {
 namespace kws {
 
 const int kEpsilon = 0;
 
+/* Mapped symbol table format (SymbolTable::WriteMapped), which SymbolTable
+   maps read-only and uses in place. All the sections start at a kMappedAlign
+   aligned position, in native byte order:
+     MappedSymbolHeader
+     int32_t offset[num_ids + 1], the symbol of id i is the nul terminated
+         string at pool + offset[i], no symbol if offset[i] == offset[i + 1]
+     char pool[pool_size] */
+const char kMappedSymbolMagic[8] = { 'K', 'W', 'S', 'S', 'Y', 'M', 'M', 'P' };
+const int32_t kMappedSymbolVersion = 1;
+
+struct MappedSymbolHeader {
+    char magic[8];
+    int32_t version;
+    uint32_t byte_order;
+    int32_t num_ids, pool_size;
+    int64_t offset_pos, pool_pos;
+    int64_t file_size;
+};
+
 class SymbolTable {
 public:
-    SymbolTable(const std::string &symbol_file) {
-        ReadSymbolFile(symbol_file);
-    }
+    // Read the text format ("symbol id" per line) or map the mapped format
+    SymbolTable(const std::string &symbol_file);
 
-    ~SymbolTable() {}
+    ~SymbolTable();
 
     std::string GetSymbol(int32_t id) const {
-        CHECK(symbol_tabel_.find(id) != symbol_tabel_.end());
-        return symbol_tabel_[id];
+        CHECK(HaveId(id));
+        return std::string(pool_ + offset_[id]);
     }
 
     // GetId is used in the construction fst period
     // so here just a lazy/inefficient implemenation
-    int32_t GetId(const std::string &symbol) const {
-        for (int32_t i = 0; i < symbol_tabel_.size(); i++) {
-            if (symbol == symbol_tabel_[i]) return i;
-        }
-        // return -f if not find
-        return -1;
-    }
+    int32_t GetId(const std::string &symbol) const;
 
     bool HaveId (int32_t id) const {
-        return (symbol_tabel_.find(id) != symbol_tabel_.end());
+        return id >= 0 && id < num_ids_ && offset_[id] != offset_[id + 1];
     }
 
-protected:
-    void ReadSymbolFile(const std::string &symbol_file) {
-        FILE *fp = fopen(symbol_file.c_str(), "r");
-        if (!fp) {
-            ERROR("%s not exint, please check!!!", symbol_file.c_str());
-        }
-        char buffer[1024], str[1024];
-        int id;
-        while (fgets(buffer, 1024, fp)) {
-            int num = sscanf(buffer, "%s %d", str, &id);
-            if (num != 2) {
-                ERROR("each line shoud have 2 fields, symbol & id");
-            }
-            CHECK(str != NULL);
-            CHECK(id >= 0);
-            
-            std::string symbol = str;
-            symbol_tabel_[id] = symbol;
-        }
-        fclose(fp);
+    bool IsMapped() const {
+        return mapped_ != NULL;
     }
-    
-    mutable unordered_map<int32_t, std::string> symbol_tabel_;
+
+    void WriteMapped(const std::string &file) const;
+
+protected:
+    void ReadSymbolFile(const std::string &symbol_file);
+    void ReadMapped(const std::string &symbol_file);
+
+    int32_t num_ids_;
+    // in the buffers below or the mapped file
+    const int32_t *offset_;
+    const char *pool_;
+    int32_t pool_size_;
+
+    std::vector<int32_t> offset_buf_;
+    std::vector<char> pool_buf_;
+    MappedFile *mapped_;
     DISALLOW_COPY_AND_ASSIGN(SymbolTable);
 };
 
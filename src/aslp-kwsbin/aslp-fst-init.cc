@@ -8,7 +8,9 @@
 int main(int argc, char *argv[]) {
     using namespace kaldi;
     using namespace kaldi::kws;
-    const char *usage = "Init fst from topo file, just like the way openfst compile"
+    const char *usage = "Init fst from topo file, just like the way openfst compile\n"
+                        "With --mapped it's written in the mapped format, which is mapped\n"
+                        "read-only by the readers and shared among the processes\n"
                         "Usage: aslp-fst-init topo_file out_file\n"
                         "eg: aslp-fst-init topo_file out.fst\n";
     
@@ -17,6 +19,8 @@ int main(int argc, char *argv[]) {
     po.Register("isymbols", &isymbols, "input symbol file"); 
     std::string osymbols = "";
     po.Register("osymbols", &osymbols, "output symbol file"); 
+    bool mapped = false;
+    po.Register("mapped", &mapped, "write the fst in the mapped format"); 
     
     po.Read(argc, argv);
 
@@ -33,7 +37,11 @@ int main(int argc, char *argv[]) {
     Fst fst;
 
     fst.ReadTopo(isymbol_table, osymbol_table, topo_file);
-    fst.Write(out_file);
+    if (mapped) {
+        fst.WriteMapped(out_file);
+    } else {
+        fst.Write(out_file);
+    }
     
     return 0;
 }
@@ -0,0 +1,151 @@
+// aslp-kwsbin/aslp-kws-bench.cc
+
+// Copyright 2016  ASLP (Author: zhangbinbin liwenpeng duwei)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "base/timer.h"
+
+#include "aslp-kws/keyword-spot.h"
+
+
+int main(int argc, char *argv[]) {
+  using namespace kaldi;
+  using namespace kaldi::kws;
+  typedef kaldi::int32 int32;
+  try {
+    const char *usage =
+        "Benchmark the keyword spotter on the posteriors of an archive, or on\n"
+        "random posteriors if no archive is given. The frames are spotted\n"
+        "frame by frame and in batches of --batch-size frames (see\n"
+        "aslp-kws/keyword-spot-test for the check of the results).\n"
+        "\n"
+        "Usage:  aslp-kws-bench [options] <fst-in> <filler-table-file> [<posterior-rspecifier>]\n"
+        "e.g.: \n"
+        " aslp-kws-bench --num-frames=360000 kws.fst filler.txt\n"
+        " aslp-kws-bench kws.fst filler.txt ark:nnet_out.ark\n";
+
+    ParseOptions po(usage);
+
+    int32 batch_size = 10, num_frames = 100 * 60 * 60, num_repeats = 1;
+    po.Register("batch-size", &batch_size, "Number of frames per spot call in batch mode");
+    po.Register("num-frames", &num_frames, "Number of random frames, if no archive is given");
+    po.Register("num-repeats", &num_repeats, "Times to spot the whole data, for stable timing");
+    BaseFloat frame_rate = 100;
+    po.Register("frame-rate", &frame_rate, "Frames per second, for the real time factor");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2 && po.NumArgs() != 3) {
+      po.PrintUsage();
+      exit(1);
+    }
+    KALDI_ASSERT(batch_size > 0 && num_repeats > 0);
+
+    std::string fst_filename = po.GetArg(1),
+        filler_table_file = po.GetArg(2),
+        posterior_rspecifier = po.GetOptArg(3);
+
+    SymbolTable filler_table(filler_table_file);
+    Fst fst;
+    fst.Read(fst_filename.c_str());
+
+    // the posteriors, one matrix per utterance
+    std::vector<Matrix<BaseFloat> > posteriors;
+    if (posterior_rspecifier != "") {
+      SequentialBaseFloatMatrixReader posterior_reader(posterior_rspecifier);
+      for (; !posterior_reader.Done(); posterior_reader.Next()) {
+        posteriors.push_back(posterior_reader.Value());
+      }
+    } else {
+      int32 num_pdfs = 0;
+      for (int32 s = 0; s < fst.NumStates(); s++) {
+        for (const Arc *arc = fst.ArcStart(s); arc != fst.ArcEnd(s); arc++) {
+          num_pdfs = std::max(num_pdfs, arc->ilabel);
+        }
+      }
+      // peaky random posteriors, like the softmax output of a nnet
+      Matrix<BaseFloat> mat(num_frames, num_pdfs);
+      mat.SetRandn();
+      mat.Scale(3.0);
+      for (int32 t = 0; t < num_frames; t++) {
+        SubVector<BaseFloat> row(mat, t);
+        row.ApplySoftMax();
+      }
+      posteriors.push_back(mat);
+    }
+
+    KeywordSpot frame_spotter(fst, filler_table),
+                batch_spotter(fst, filler_table);
+
+    Timer timer;
+    double frame_time = 0.0, batch_time = 0.0;
+    int64 tot_t = 0, num_frame_spots = 0, num_batch_spots = 0;
+    std::vector<float> frame_confidence, batch_confidence;
+    std::vector<int32_t> frame_keyword, batch_keyword;
+    for (int32 n = 0; n < num_repeats; n++) {
+      for (size_t u = 0; u < posteriors.size(); u++) {
+        const Matrix<BaseFloat> &mat = posteriors[u];
+        int32 num_rows = mat.NumRows();
+        if (num_rows == 0) continue;
+        frame_confidence.resize(num_rows);
+        frame_keyword.resize(num_rows);
+        batch_confidence.resize(num_rows);
+        batch_keyword.resize(num_rows);
+
+        timer.Reset();
+        frame_spotter.Reset();
+        for (int32 t = 0; t < num_rows; t++) {
+          if (frame_spotter.Spot(mat.RowData(t), mat.NumCols(),
+                                 &frame_confidence[t], &frame_keyword[t])) {
+            num_frame_spots++;
+          }
+        }
+        frame_time += timer.Elapsed();
+
+        timer.Reset();
+        batch_spotter.Reset();
+        for (int32 t = 0; t < num_rows; t += batch_size) {
+          int32 num = std::min(batch_size, num_rows - t);
+          int32 first = batch_spotter.SpotFrames(mat.RowData(t), num,
+                                                 mat.NumCols(), mat.Stride(),
+                                                 &batch_confidence[t],
+                                                 &batch_keyword[t]);
+          if (first >= 0) num_batch_spots++;
+        }
+        batch_time += timer.Elapsed();
+        tot_t += num_rows;
+      }
+    }
+
+    if (tot_t == 0) return -1;
+    double audio_time = tot_t / frame_rate;
+    KALDI_LOG << "Spotted " << tot_t << " frames, " << posteriors.size()
+              << " utterances, " << num_repeats << " times";
+    KALDI_LOG << "Frame by frame: fps " << tot_t / frame_time
+              << ", real time factor " << frame_time / audio_time
+              << ", spotted frames " << num_frame_spots;
+    KALDI_LOG << "Batch of " << batch_size << ": fps " << tot_t / batch_time
+              << ", real time factor " << batch_time / audio_time
+              << ", spotted batches " << num_batch_spots;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -0,0 +1,20 @@
+#include <stdio.h>
+
+#include "aslp-kws/symbol-table.h"
+
+int main(int argc, char *argv[]) {
+    using namespace kaldi::kws;
+    const char *usage = "Convert symbol table (or filler table) to the mapped format, which\n"
+                        "is mapped read-only by the readers and shared among the processes\n"
+                        "Usage: aslp-kws-map-symbols symbol_file out_file\n"
+                        "eg: aslp-kws-map-symbols phones.txt phones.map\n";
+
+    if (argc != 3) {
+        printf("%s", usage);
+        return -1;
+    }
+
+    SymbolTable symbol_table(argv[1]);
+    symbol_table.WriteMapped(argv[2]);
+    return 0;
+}
@@ -0,0 +1,158 @@
+// aslp-kwsbin/aslp-kws-pool-score.cc
+
+// Copyright 2016  ASLP (Author: zhangbinbin liwenpeng duwei)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "base/timer.h"
+
+#include "aslp-kws/keyword-spot-pool.h"
+
+
+int main(int argc, char *argv[]) {
+  using namespace kaldi;
+  using namespace kaldi::aslp_nnet;
+  using namespace kaldi::kws;
+  typedef kaldi::int32 int32;
+  try {
+    const char *usage =
+        "Keyword spotting of many streams at the same time with KeywordSpotPool,\n"
+        "every utterance is a stream, --num-streams of them are live at once and\n"
+        "each gets --chunk-size frames per batch. The detections are written as\n"
+        "lines of \"<utt> <keyword-id> <frame> <confidence>\".\n"
+        "\n"
+        "Usage:  aslp-kws-pool-score [options] <model-in> <fst-in> <filler-table-file> "
+        "<feature-rspecifier> <detection-wxfilename>\n"
+        "e.g.: \n"
+        " aslp-kws-pool-score --feature-transform=final.feature_transform --num-streams=200 \\\n"
+        "   final.nnet kws.fst filler.txt ark:feats.ark detections.txt\n";
+
+    ParseOptions po(usage);
+
+    KeywordSpotPoolOptions pool_opts;
+    pool_opts.Register(&po);
+    std::string feature_transform;
+    po.Register("feature-transform", &feature_transform, "Feature transform in front of main network (in nnet format)");
+    int32 num_streams = 100, chunk_size = 10;
+    po.Register("num-streams", &num_streams, "Number of streams spotted at the same time");
+    po.Register("chunk-size", &chunk_size, "Number of frames of a stream per batch");
+    std::string use_gpu="no";
+    po.Register("use-gpu", &use_gpu, "yes|no|optional, only has effect if compiled with CUDA");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 5) {
+      po.PrintUsage();
+      exit(1);
+    }
+    KALDI_ASSERT(num_streams > 0 && chunk_size > 0);
+
+    std::string model_filename = po.GetArg(1),
+        fst_filename = po.GetArg(2),
+        filler_table_file = po.GetArg(3),
+        feature_rspecifier = po.GetArg(4),
+        detection_wxfilename = po.GetArg(5);
+
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+#endif
+
+    Nnet *nnet_transf = NULL;
+    if (feature_transform != "") {
+      nnet_transf = new Nnet;
+      nnet_transf->Read(feature_transform);
+    }
+    Nnet *nnet = new Nnet;
+    nnet->Read(model_filename);
+    nnet->SetDropoutRetention(1.0);
+
+    SymbolTable filler_table(filler_table_file);
+    Fst fst;
+    fst.Read(fst_filename.c_str());
+
+    KeywordSpotPool pool(pool_opts, nnet_transf, nnet, fst, filler_table);
+
+    SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+    Output ko(detection_wxfilename, false);
+
+    // The utterance of every stream and its next frame to feed
+    std::vector<std::string> utt(num_streams);
+    std::vector<Matrix<BaseFloat> > feats(num_streams);
+    std::vector<int32> offset(num_streams, 0);
+    for (int32 s = 0; s < num_streams; s++) {
+      // the ids of a new pool are allocated in order
+      int32 id = pool.NewStream();
+      KALDI_ASSERT(id == s);
+    }
+
+    Timer timer;
+    int64 tot_t = 0, num_batches = 0, num_detections = 0;
+    int32 num_done = 0;
+    std::vector<KeywordDetection> detections;
+    while (true) {
+      int32 num_live = 0;
+      for (int32 s = 0; s < num_streams; s++) {
+        // Start the next utterance on the idle streams
+        if (offset[s] == feats[s].NumRows() && !feature_reader.Done()) {
+          utt[s] = feature_reader.Key();
+          feats[s] = feature_reader.Value();
+          offset[s] = 0;
+          feature_reader.Next();
+        }
+        int32 num = std::min(chunk_size, feats[s].NumRows() - offset[s]);
+        if (num == 0) continue;
+        pool.AcceptFeatures(s, feats[s].RowRange(offset[s], num));
+        offset[s] += num;
+        if (offset[s] == feats[s].NumRows()) {
+          pool.InputFinished(s);
+          num_done++;
+          tot_t += feats[s].NumRows();
+        }
+        num_live++;
+      }
+      if (num_live == 0) break;
+
+      detections.clear();
+      pool.Compute(&detections);
+      num_batches++;
+      for (int i = 0; i < detections.size(); i++) {
+        const KeywordDetection &d = detections[i];
+        ko.Stream() << utt[d.stream] << " " << d.keyword << " " << d.frame
+                    << " " << d.confidence << "\n";
+      }
+      num_detections += detections.size();
+    }
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Done " << num_done << " files, " << tot_t << " frames in "
+              << num_batches << " batches, " << num_detections
+              << " detections, fps " << tot_t / elapsed;
+
+#if HAVE_CUDA==1
+    if (kaldi::g_kaldi_verbose_level >= 1) {
+      CuDevice::Instantiate().PrintProfile();
+    }
+#endif
+
+    if (num_done == 0) return -1;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -123,14 +123,11 @@ int main(int argc, char *argv[]) {
       confidence.Resize(nnet_out.NumRows());
       id_vector.resize(nnet_out.NumRows());
 
-      float keyword_confidence = 0.0;
-      int keyword_id = 0;
       keyword_spotter.Reset();
-      for (int i = 0; i < nnet_out_host.NumRows(); i++) {
-        keyword_spotter.Spot(nnet_out_host.Row(i).Data(), nnet_out_host.NumCols(), 
-                             &keyword_confidence, &keyword_id);
-        confidence(i) = keyword_confidence;
-        id_vector[i] = keyword_id;
+      if (nnet_out_host.NumRows() > 0) {
+        keyword_spotter.SpotFrames(nnet_out_host.Data(), nnet_out_host.NumRows(),
+                                   nnet_out_host.NumCols(), nnet_out_host.Stride(),
+                                   confidence.Data(), id_vector.data());
       }
 
       // write,
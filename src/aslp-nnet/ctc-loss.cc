@@ -20,6 +20,7 @@
 #include "aslp-nnet/ctc-loss.h"
 #include "aslp-cudamatrix/cu-math.h"
 #include "aslp-cudamatrix/ctc-utils.h"
+#include "aslp-cudamatrix/ctc-cpu.h"
 #include "util/edit-distance.h"
 
 #include <sstream>
@@ -123,7 +124,6 @@ void Ctc::EvalParallel(const std::vector<std::string> &utt,
     int32 num_frames = net_out.NumRows();
     KALDI_ASSERT(num_frames % num_sequence == 0);  // after padding, number of frames is a multiple of number of sequences
 
-    int32 num_frames_per_sequence = num_frames / num_sequence;
     int32 num_classes = net_out.NumCols();
     int32 max_label_len = 0;
     for (int32 s = 0; s < num_sequence; s++) {
@@ -157,25 +157,42 @@ void Ctc::EvalParallel(const std::vector<std::string> &utt,
     beta_.Resize(num_frames, exp_len_labels);
     alpha_.Set(NumericLimits<BaseFloat>::log_zero_);
     beta_.Set(NumericLimits<BaseFloat>::log_zero_);
-    for (int t = 0; t < num_frames_per_sequence; t++) {
-        alpha_.ComputeCtcAlphaMSeq(log_nnet_out, t, label_expand_, frame_num_utt);
-    }
-    for (int t = (num_frames_per_sequence - 1); t >= 0; t--) {
-        beta_.ComputeCtcBetaMSeq(log_nnet_out, t, label_expand_, frame_num_utt, label_lengths_utt);
-    }
     CuVector<BaseFloat> pzx(num_sequence, kSetZero);
-    for (int s = 0; s < num_sequence; s++) {
-        int label_len = 2* label[s].size() + 1;
-        int frame_num = frame_num_utt[s];
-        BaseFloat tmp1 = alpha_((frame_num-1)*num_sequence + s, label_len - 1);
-        BaseFloat tmp2 = alpha_((frame_num-1)*num_sequence + s, label_len-2);
-        //pzx(s) = tmp1 + log(1 + ExpA(tmp2 - tmp1));
-        pzx(s) = (float)LogAPlusB((double)tmp1, (double)tmp2);
-    }
-
-    // gradients from CTC
     ctc_err_.Resize(num_frames, num_classes, kSetZero);
-    ctc_err_.ComputeCtcErrorMSeq(alpha_, beta_, net_out, label_expand_, frame_num_utt, pzx);  // here should use the original ??
+#if HAVE_CUDA == 1
+    if (CuDevice::Instantiate().Enabled()) {
+        int32 num_frames_per_sequence = num_frames / num_sequence;
+        for (int t = 0; t < num_frames_per_sequence; t++) {
+            alpha_.ComputeCtcAlphaMSeq(log_nnet_out, t, label_expand_, frame_num_utt);
+        }
+        for (int t = (num_frames_per_sequence - 1); t >= 0; t--) {
+            beta_.ComputeCtcBetaMSeq(log_nnet_out, t, label_expand_, frame_num_utt, label_lengths_utt);
+        }
+        for (int s = 0; s < num_sequence; s++) {
+            int label_len = 2* label[s].size() + 1;
+            int frame_num = frame_num_utt[s];
+            BaseFloat tmp1 = alpha_((frame_num-1)*num_sequence + s, label_len - 1);
+            BaseFloat tmp2 = alpha_((frame_num-1)*num_sequence + s, label_len-2);
+            //pzx(s) = tmp1 + log(1 + ExpA(tmp2 - tmp1));
+            pzx(s) = (float)LogAPlusB((double)tmp1, (double)tmp2);
+        }
+
+        // gradients from CTC
+        ctc_err_.ComputeCtcErrorMSeq(alpha_, beta_, net_out, label_expand_, frame_num_utt, pzx);  // here should use the original ??
+    } else
+#endif
+    {
+        // the sequences are independent, so they are shared among threads
+        // instead of going frame by frame over all of them
+        Vector<BaseFloat> pzx_cpu(num_sequence);
+        CpuSequenceTask task(frame_num_utt, label_lengths_utt, log_nnet_out.Mat(),
+                             net_out.Mat(), this, &pzx_cpu);
+        {
+            // 0 runs in this thread
+            MultiThreader<CpuSequenceTask> m(num_threads_ > 1 ? num_threads_ : 0, task);
+        }
+        pzx.CopyFromVec(pzx_cpu);
+    }
 
     // back-propagate the errors through the softmax layer
     ctc_err_.MulElements(net_out);
@@ -226,6 +243,44 @@ void Ctc::EvalParallel(const std::vector<std::string> &utt,
 
 }
 
+void Ctc::CpuSequenceTask::operator() () {
+    int32 num_sequence = frame_num_utt_.size();
+    int32 num_classes = prob_.NumCols();
+    int32 exp_len_labels = ctc_->alpha_.NumCols();
+    MatrixBase<BaseFloat> &alpha = ctc_->alpha_.Mat();
+    MatrixBase<BaseFloat> &beta = ctc_->beta_.Mat();
+    MatrixBase<BaseFloat> &ctc_err = ctc_->ctc_err_.Mat();
+    for (int32 s = thread_id_; s < num_sequence; s += num_threads_) {
+        const int32 *labels = &(ctc_->label_expand_[s * exp_len_labels]);
+        int32 label_len = label_lengths_utt_[s];
+        int32 frame_num = frame_num_utt_[s];
+        // rows of the sequence are interleaved with the other sequences
+        for (int32 t = 0; t < frame_num; t++) {
+            int32 row = t * num_sequence + s;
+            CtcAlphaRow(log_prob_.RowData(row),
+                        t > 0 ? alpha.RowData(row - num_sequence) : NULL,
+                        labels, label_len, alpha.RowData(row));
+        }
+        for (int32 t = frame_num - 1; t >= 0; t--) {
+            int32 row = t * num_sequence + s;
+            CtcBetaRow(log_prob_.RowData(row),
+                       t < frame_num - 1 ? beta.RowData(row + num_sequence) : NULL,
+                       labels, label_len, beta.RowData(row));
+        }
+        int32 last_row = (frame_num - 1) * num_sequence + s;
+        BaseFloat tmp1 = alpha(last_row, label_len - 1);
+        BaseFloat tmp2 = label_len > 1 ? alpha(last_row, label_len - 2) :
+                                         NumericLimits<BaseFloat>::log_zero_;
+        (*pzx_)(s) = (float)LogAPlusB((double)tmp1, (double)tmp2);
+        for (int32 t = 0; t < frame_num; t++) {
+            int32 row = t * num_sequence + s;
+            CtcErrorRow(alpha.RowData(row), beta.RowData(row), prob_.RowData(row),
+                        labels, label_len, num_classes, (*pzx_)(s),
+                        ctc_err.RowData(row));
+        }
+    }
+}
+
 void Ctc::StatAndAverageLossCheck(const std::vector<std::string> &utt, 
                                   const std::vector<int32> &frame_num_utt, 
                                   const Vector<BaseFloat> &pzx_host,
@@ -25,6 +25,7 @@
 #include "aslp-cudamatrix/cu-matrix.h"
 #include "aslp-cudamatrix/cu-vector.h"
 #include "aslp-cudamatrix/cu-array.h"
+#include "thread/kaldi-thread.h"
 
 namespace kaldi {
 namespace aslp_nnet {
@@ -40,7 +41,7 @@ public:
     Ctc() : frames_(0), sequences_num_(0), ref_num_(0), error_num_(0), 
     frames_progress_(0), ref_num_progress_(0), error_num_progress_(0),
     sequences_progress_(0), obj_progress_(0.0), report_step_(100),
-    obj_(0),
+    obj_(0), num_threads_(1),
     loss_sum_(0), loss_square_sum_(0),
     loss_sum_bak_(0), loss_square_sum_bak_(0), 
     normal_num_(0), stat_period_(100) { }
@@ -71,6 +72,13 @@ public:
     /// Set the step of reporting
     void SetReportStep(int32 report_step) { report_step_ = report_step;  }
 
+    /// Set the number of threads of EvalParallel without GPU, the sequences
+    /// are shared among the threads
+    void SetNumThreads(int32 num_threads) { 
+        KALDI_ASSERT(num_threads > 0);
+        num_threads_ = num_threads;
+    }
+
     /// Generate string with report
     std::string Report();
 
@@ -92,6 +100,27 @@ public:
                                  const Vector<BaseFloat> &pzx_host,
                                  CuMatrix<BaseFloat> *diff);
 private:
+    /// alpha_, beta_, ctc_err_ and pzx of EvalParallel on CPU, each thread
+    /// does the whole sequences of its share
+    class CpuSequenceTask : public MultiThreadable {
+    public:
+        CpuSequenceTask(const std::vector<int32> &frame_num_utt,
+                        const std::vector<int32> &label_lengths_utt,
+                        const MatrixBase<BaseFloat> &log_prob,
+                        const MatrixBase<BaseFloat> &prob,
+                        Ctc *ctc, VectorBase<BaseFloat> *pzx):
+            frame_num_utt_(frame_num_utt), label_lengths_utt_(label_lengths_utt),
+            log_prob_(log_prob), prob_(prob), ctc_(ctc), pzx_(pzx) {}
+        void operator() ();
+    private:
+        const std::vector<int32> &frame_num_utt_;
+        const std::vector<int32> &label_lengths_utt_;
+        const MatrixBase<BaseFloat> &log_prob_;
+        const MatrixBase<BaseFloat> &prob_;
+        Ctc *ctc_;
+        VectorBase<BaseFloat> *pzx_;
+    };
+
     int32 frames_;                    // total frame number
     int32 sequences_num_; 
     int32 ref_num_;                   // total number of tokens in label sequences
@@ -107,6 +136,7 @@ private:
     int32 report_step_;                // report obj and accuracy every so many sequences/utterances
 
     double obj_;
+    int32 num_threads_;                // threads of EvalParallel on CPU
 
     std::vector<int32> label_expand_;  // expanded version of the label sequence
     // For statistic grad
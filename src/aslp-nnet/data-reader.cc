@@ -13,9 +13,29 @@ FrameDataReader::FrameDataReader(
                     const std::vector<std::string> &feature_rspecifiers,
                     const std::vector<std::string> &targets_rspecifiers,
                     const NnetDataRandomizerOptions &rand_opts): 
-        num_input_(feature_rspecifiers.size()), 
-        num_output_(targets_rspecifiers.size()),
-        rand_opts_(rand_opts), read_done_(false) {
+        rand_opts_(rand_opts), free_caches_(rand_opts.prefetch_caches) {
+    Init(feature_rspecifiers, targets_rspecifiers);
+}
+
+FrameDataReader::FrameDataReader(const std::string &feature_rspecifier, 
+                                 const std::string &targets_rspecifier,
+                                 const NnetDataRandomizerOptions &rand_opts): 
+        rand_opts_(rand_opts), free_caches_(rand_opts.prefetch_caches) {
+    std::vector<std::string> feature_rspecifiers;
+    feature_rspecifiers.push_back(feature_rspecifier);
+    std::vector<std::string> targets_rspecifiers;
+    targets_rspecifiers.push_back(targets_rspecifier);
+    Init(feature_rspecifiers, targets_rspecifiers);
+}
+
+void FrameDataReader::Init(const std::vector<std::string> &feature_rspecifiers,
+                           const std::vector<std::string> &targets_rspecifiers) {
+    num_input_ = feature_rspecifiers.size();
+    num_output_ = targets_rspecifiers.size();
+    read_done_ = false;
+    num_leftover_ = 0;
+    prefetch_thread_ = NULL;
+    prefetch_stop_ = false;
     feature_readers_.resize(num_input_);
     feature_randomizers_.resize(num_input_);
     for (int i = 0; i < num_input_; i++) {
@@ -29,19 +49,25 @@ FrameDataReader::FrameDataReader(
         targets_randomizers_[i] = new PosteriorRandomizer(rand_opts_);
     }
     randomizer_mask_.Init(rand_opts_);
-}
-
-FrameDataReader::FrameDataReader(const std::string &feature_rspecifier, 
-                                 const std::string &targets_rspecifier,
-                                 const NnetDataRandomizerOptions &rand_opts): rand_opts_(rand_opts) {
-    std::vector<std::string> feature_rspecifiers;
-    feature_rspecifiers.push_back(feature_rspecifier);
-    std::vector<std::string> targets_rspecifiers;
-    targets_rspecifiers.push_back(targets_rspecifier);
-    new (this) FrameDataReader(feature_rspecifiers, targets_rspecifiers, rand_opts);
+    KALDI_ASSERT(rand_opts_.prefetch_caches >= 0);
+    if (rand_opts_.prefetch_caches > 0) {
+        prefetch_thread_ = new MultiThreader<PrefetchTask>(1, PrefetchTask(this));
+    }
 }
 
 FrameDataReader::~FrameDataReader() {
+    if (prefetch_thread_ != NULL) {
+        // Wake up the thread if it waits for a free cache, it stops after
+        // the cache it's reading
+        prefetch_mutex_.Lock();
+        prefetch_stop_ = true;
+        prefetch_mutex_.Unlock();
+        free_caches_.Signal();
+        delete prefetch_thread_; // join
+        for (size_t i = 0; i < prefetch_queue_.size(); i++) {
+            delete prefetch_queue_[i];
+        }
+    }
     for (int i = 0; i < feature_readers_.size(); i++) {
         delete feature_readers_[i];
     }
@@ -61,16 +87,44 @@ bool FrameDataReader::Done() {
     return (read_done_ && feature_randomizers_[0]->Done());
 }
 
-void FrameDataReader::FillRandomizer() {
+void FrameDataReader::PrefetchTask::operator() () {
+    FrameDataReader *r = reader_;
+    while (true) {
+        r->free_caches_.Wait();
+        r->prefetch_mutex_.Lock();
+        bool stop = r->prefetch_stop_;
+        r->prefetch_mutex_.Unlock();
+        if (stop) break;
+        DataCache *cache = new DataCache;
+        try {
+            r->ReadCache(cache);
+        } catch (const std::exception &e) {
+            // Logged by KALDI_ERR already, the training thread fails when it
+            // gets here
+            cache->failed = true;
+            cache->read_done = true;
+        }
+        r->prefetch_mutex_.Lock();
+        r->prefetch_queue_.push_back(cache);
+        r->prefetch_mutex_.Unlock();
+        r->ready_caches_.Signal();
+        if (cache->read_done) break;
+    }
+}
+
+void FrameDataReader::ReadCache(DataCache *cache) {
     KALDI_ASSERT(feature_readers_.size() > 0);
     KALDI_ASSERT(targets_readers_.size() > 0);
-    //for (; !feature_readers_[0].Done(); feature_readers_[0].Next()) {
+    cache->feats.resize(num_input_);
+    cache->targets.resize(num_output_);
+    // Same as the randomizer being full, with the leftover at the front
+    int32 num_frames = num_leftover_;
     while (true) {
-        if (feature_randomizers_[0]->IsFull()) break;
+        if (num_frames > rand_opts_.randomizer_size) break;
         if (feature_readers_[0]->Done()) {
             for (int i = 1; i < feature_readers_.size(); i++)
                 KALDI_ASSERT(feature_readers_[i]->Done());
-            read_done_ = true;
+            cache->read_done = true;
             break;
         }
         std::string utt = feature_readers_[0]->Key();
@@ -90,30 +144,69 @@ void FrameDataReader::FillRandomizer() {
                 all_have_target = false;
             }
         }
-        // Add to randomizer, check dim
+        // Add to cache, check dim
         if (all_have_target) {
             int num_frame = 0;
             for (int i = 0; i < feature_readers_.size(); i++) {
-                Matrix<BaseFloat> mat = feature_readers_[i]->Value();
+                const Matrix<BaseFloat> &mat = feature_readers_[i]->Value();
                 if (0 == i) num_frame = mat.NumRows();
                 else if (mat.NumRows() != num_frame) {
                     KALDI_ERR << "all feature dim not equal";
                 }
-                feature_randomizers_[i]->AddData(CuMatrix<BaseFloat>(mat));
+                cache->feats[i].push_back(mat);
             }
             for (int i = 0; i < targets_readers_.size(); i++) {
-                Posterior targets = targets_readers_[i]->Value(utt);
+                const Posterior &targets = targets_readers_[i]->Value(utt);
                 if (targets.size() != num_frame) {
                     KALDI_ERR << "feature and target dim must match";
                 }
-                targets_randomizers_[i]->AddData(targets);
+                cache->targets[i].push_back(targets);
             }
+            num_frames += num_frame;
         }
         // Add Iter
         for (int i = 0; i < feature_readers_.size(); i++) {
             feature_readers_[i]->Next();
         }
     }
+    // What's left after the last full minibatch of this fill
+    num_leftover_ = num_frames % rand_opts_.minibatch_size;
+}
+
+void FrameDataReader::FillRandomizer() {
+    DataCache local_cache, *cache = &local_cache;
+    if (prefetch_thread_ != NULL) {
+        ready_caches_.Wait();
+        prefetch_mutex_.Lock();
+        cache = prefetch_queue_.front();
+        prefetch_queue_.pop_front();
+        prefetch_mutex_.Unlock();
+        free_caches_.Signal();
+        if (cache->failed) {
+            delete cache;
+            KALDI_ERR << "Prefetching data failed, see the error above";
+        }
+    } else {
+        ReadCache(cache);
+    }
+    read_done_ = cache->read_done;
+    bool empty = cache->feats[0].empty();
+    for (int i = 0; i < num_input_; i++) {
+        std::deque<Matrix<BaseFloat> > &feats = cache->feats[i];
+        for (size_t j = 0; j < feats.size(); j++) {
+            feature_randomizers_[i]->AddData(CuMatrix<BaseFloat>(feats[j]));
+        }
+    }
+    for (int i = 0; i < num_output_; i++) {
+        std::deque<Posterior> &targets = cache->targets[i];
+        for (size_t j = 0; j < targets.size(); j++) {
+            targets_randomizers_[i]->AddData(targets[j]);
+        }
+    }
+    if (cache != &local_cache) delete cache;
+    // Nothing new at the end of the tables, the leftover is not enough for
+    // a minibatch anyway
+    if (empty) return;
     // Randomize
     const std::vector<int32>& mask = randomizer_mask_.Generate(feature_randomizers_[0]->NumFrames());
     for (int i = 0; i < feature_randomizers_.size(); i++) {
@@ -7,6 +7,8 @@
 #ifndef ASLP_NNET_DATA_READER_H_
 #define ASLP_NNET_DATA_READER_H_
 
+#include <deque>
+
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "base/kaldi-math.h"
@@ -14,6 +16,9 @@
 #include "aslp-cudamatrix/cu-vector.h"
 #include "hmm/posterior.h"
 #include "itf/options-itf.h"
+#include "thread/kaldi-thread.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-semaphore.h"
 
 #include "aslp-nnet/nnet-trnopts.h"
 #include "aslp-nnet/nnet-randomizer.h"
@@ -35,7 +40,29 @@ public:
                   std::vector<const Posterior *> *output); 
     bool Done();
 private:
+    // Utterances read from the tables for one fill of the randomizers,
+    // kept on host so that they can be read by the prefetch thread
+    struct DataCache {
+        std::vector<std::deque<Matrix<BaseFloat> > > feats; // [input][utt]
+        std::vector<std::deque<Posterior> > targets; // [output][utt]
+        bool read_done; // the tables are read through in this cache
+        bool failed; // the prefetch thread failed in reading it
+        DataCache(): read_done(false), failed(false) {}
+    };
+    // Reads the next cache in the background, at most
+    // rand_opts_.prefetch_caches of them wait in the queue
+    class PrefetchTask : public MultiThreadable {
+    public:
+        PrefetchTask(FrameDataReader *reader): reader_(reader) {}
+        void operator() ();
+    private:
+        FrameDataReader *reader_;
+    };
+
+    void Init(const std::vector<std::string> &feature_rspecifiers,
+              const std::vector<std::string> &targets_rspecifiers);
     void FillRandomizer(); 
+    void ReadCache(DataCache *cache);
     std::vector<SequentialBaseFloatMatrixReader *> feature_readers_;
     std::vector<RandomAccessPosteriorReader *> targets_readers_;
     RandomizerMask randomizer_mask_;
@@ -44,6 +71,16 @@ private:
     int num_input_, num_output_;
     const NnetDataRandomizerOptions &rand_opts_;
     bool read_done_;
+    // Frames the randomizers still hold when the next cache is added, the
+    // reading of a cache stops at the same utterance whether it's prefetched
+    // or not
+    int32 num_leftover_;
+    // Prefetching, the readers are only used by the thread once it's started
+    MultiThreader<PrefetchTask> *prefetch_thread_;
+    std::deque<DataCache *> prefetch_queue_;
+    Mutex prefetch_mutex_;
+    Semaphore free_caches_, ready_caches_;
+    bool prefetch_stop_;
 };
 
 struct SequenceDataReaderOptions {
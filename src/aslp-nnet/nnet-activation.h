@@ -248,6 +248,12 @@ class Dropout : public Component {
     out->Scale(1.0/dropout_retention_);
   }
 
+  void FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+                           ComponentState *state) const {
+    // decoding, same as the forward pass with dropout retention 1.0
+    out->CopyFromMat(in);
+  }
+
   void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
                         const CuMatrixBase<BaseFloat> &out_diff, CuMatrixBase<BaseFloat> *in_diff) {
     in_diff->CopyFromMat(out_diff);
@@ -174,6 +174,34 @@ public:
         }
     }
 
+    void FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in,
+                             CuMatrixBase<BaseFloat> *out,
+                             ComponentState *state) const {
+        // Same as FeedforwardFnc, the local stats are kept in local vectors
+        const CuVectorBase<BaseFloat> *mean = &mean_vec_, *inv_std = &var_vec_;
+        CuVector<BaseFloat> local_mean, local_inv_std;
+        if (num_acc_frames_ <= 0) {
+            int32 batch_size = in.NumRows();
+            local_mean.Resize(output_dim_);
+            local_mean.AddRowSumMat(1.0 / (batch_size), in, 0.0);
+            out->CopyFromMat(in);
+            out->AddVecToRows(-1.0, local_mean, 1.0);
+            out->MulElements(*out);
+            local_inv_std.Resize(output_dim_);
+            local_inv_std.AddRowSumMat(1.0 / (batch_size), *out, 0.0);
+            local_inv_std.Add(var_floor_);
+            local_inv_std.ApplyPow(0.5);
+            local_inv_std.InvertElements();
+            mean = &local_mean;
+            inv_std = &local_inv_std;
+        }
+        out->CopyFromMat(in);
+        out->AddVecToRows(-1.0, *mean, 1.0);
+        out->MulColsVec(*inv_std);
+        out->MulColsVec(scale_);
+        out->AddVecToRows(1.0, shift_, 1.0);
+    }
+
     void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
         if (!acc_cleaned_) {
             acc_cleaned_ = true;
@@ -54,6 +54,14 @@ namespace aslp_nnet {
 // "A Context-Sensitive-Chunk BPTT Approach to Training Deep LSTM/BLSTM Recurrent Neural Networks for Offline Handwriting Recognition"
 //
 
+// Streaming state, the forward direction state of one stream and its input
+// frames not output yet
+class BLstmLCStreamState : public StreamsState {
+ public:
+  explicit BLstmLCStreamState(int32 state_dim): StreamsState(state_dim) { }
+  CuMatrix<BaseFloat> frames;
+};
+
 class BLstmProjectedStreamsLC : public UpdatableComponent {
  public:
   BLstmProjectedStreamsLC(int32 input_dim, int32 output_dim) :
@@ -62,6 +70,7 @@ class BLstmProjectedStreamsLC : public UpdatableComponent {
     nrecur_(static_cast<int32>(output_dim/2)),
     nstream_(0),
     chunk_size_(0), 
+    right_context_(0),
     clip_gradient_(0.0)
     //, dropout_rate_(0.0)
   { }
@@ -489,9 +498,11 @@ class BLstmProjectedStreamsLC : public UpdatableComponent {
       }
     }   
   }
-  // set chunk size used for latency controlled BLstm training
-  void SetChunkSize( const int32 &chunk_size) {
+  // set chunk size used for latency controlled BLstm training, and the
+  // number of right context frames after every chunk when streaming
+  void SetChunkSize( const int32 &chunk_size, int32 right_context = 0) {
     chunk_size_ = chunk_size;
+    right_context_ = right_context;
   }    
   
   // For compatible with whole sentence train(like ctc train or lstm who sentence train
@@ -501,7 +512,6 @@ class BLstmProjectedStreamsLC : public UpdatableComponent {
   }
 
   void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
-    int DEBUG = 0;
     static bool do_stream_reset = false;
     if (nstream_ == 0) {
       do_stream_reset = true;
@@ -512,40 +522,125 @@ class BLstmProjectedStreamsLC : public UpdatableComponent {
     if (do_stream_reset) f_prev_nnet_state_.SetZero();
     KALDI_ASSERT(nstream_ > 0);
 
-    KALDI_ASSERT(in.NumRows() % nstream_ == 0);
-    int32 T = in.NumRows() / nstream_;
-    int32 S = nstream_;
+    PropagateStreams(in, out, nstream_, &f_prev_nnet_state_, &f_propagate_buf_, &b_propagate_buf_);
+  }
+
+  ComponentState* NewState() const {
+    return new StreamsState(7*ncell_ + 1*nrecur_);
+  }
+
+  void FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+                           ComponentState *state) const {
+    StreamsState *s = dynamic_cast<StreamsState*>(state);
+    KALDI_ASSERT(s != NULL);
+    PropagateStreams(in, out, s->NumStreams(), &s->prev_nnet_state,
+                     &s->propagate_buf, &s->b_propagate_buf);
+  }
+
+  // the last frame of a chunk waits for the right context frames
+  void GetContext(int32 *left_context, int32 *right_context) const {
+    *left_context = 0;
+    *right_context = std::max(chunk_size_ - 1, 0) + right_context_;
+  }
+
+  ComponentState* InitStreamState() const {
+    if (chunk_size_ <= 0) {
+      KALDI_ERR << "Chunk size must be set for the streaming forward of "
+                << "latency controlled BLSTM";
+    }
+    BLstmLCStreamState *state = new BLstmLCStreamState(7*ncell_ + 1*nrecur_);
+    state->ResetLstmStreams(std::vector<int32>(1, 1));
+    return state;
+  }
+
+  // Forward every chunk of chunk_size_ frames as soon as its right_context_
+  // frames are there (the chunk at the stream end without them), the same
+  // as the chunk by chunk forward of aslp-nnet-forward-blstm-lc
+  void FeedforwardChunkFnc(const CuMatrixBase<BaseFloat> &in, bool last,
+                           CuMatrix<BaseFloat> *out, ComponentState *state) const {
+    BLstmLCStreamState *s = dynamic_cast<BLstmLCStreamState*>(state);
+    KALDI_ASSERT(s != NULL);
+    if (in.NumRows() > 0) {
+      int32 num_kept = s->frames.NumRows();
+      CuMatrix<BaseFloat> frames(num_kept + in.NumRows(), input_dim_, kUndefined);
+      if (num_kept > 0) frames.RowRange(0, num_kept).CopyFromMat(s->frames);
+      frames.RowRange(num_kept, in.NumRows()).CopyFromMat(in);
+      s->frames.Swap(&frames);
+    }
+    int32 num_frames = s->frames.NumRows(),
+          window = chunk_size_ + right_context_,
+          num_out = 0;
+    if (last) {
+      num_out = num_frames;
+    } else if (num_frames >= window) {
+      num_out = ((num_frames - window) / chunk_size_ + 1) * chunk_size_;
+    }
+    if (num_out == 0) {
+      out->Resize(0, 0);
+    } else {
+      out->Resize(num_out, output_dim_, kUndefined);
+      CuMatrix<BaseFloat> chunk_out;
+      for (int32 t = 0; t < num_out; t += chunk_size_) {
+        int32 len = std::min(window, num_frames - t),
+              out_len = std::min(chunk_size_, num_out - t);
+        chunk_out.Resize(len, output_dim_, kUndefined);
+        PropagateStreams(s->frames.RowRange(t, len), &chunk_out, 1,
+                         &s->prev_nnet_state, &s->propagate_buf,
+                         &s->b_propagate_buf);
+        out->RowRange(t, out_len).CopyFromMat(chunk_out.RowRange(0, out_len));
+      }
+    }
+    if (last || num_out == num_frames) {
+      s->frames.Resize(0, 0);
+    } else if (num_out > 0) {
+      CuMatrix<BaseFloat> kept(s->frames.RowRange(num_out, num_frames - num_out));
+      s->frames.Swap(&kept);
+    }
+    if (last) s->ResetLstmStreams(std::vector<int32>(1, 1));
+  }
+
+  // Forward nstream streams of chunks, the forward direction starting from
+  // *f_prev_nnet_state which then holds the state at the chunk end,
+  // the weights are not touched
+  void PropagateStreams(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+                        int32 nstream, CuMatrix<BaseFloat> *f_prev_nnet_state,
+                        CuMatrix<BaseFloat> *f_propagate_buf,
+                        CuMatrix<BaseFloat> *b_propagate_buf) const {
+    int DEBUG = 0;
+    KALDI_ASSERT(in.NumRows() % nstream == 0);
+    int32 T = in.NumRows() / nstream;
+    int32 S = nstream;
 
     // 0:forward pass history, [1, T]:current sequence, T+1:dummy
     // forward direction
-    f_propagate_buf_.Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
-    f_propagate_buf_.RowRange(0*S, S).CopyFromMat(f_prev_nnet_state_);
+    f_propagate_buf->Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
+    f_propagate_buf->RowRange(0*S, S).CopyFromMat(*f_prev_nnet_state);
     // backward direction
-    b_propagate_buf_.Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
+    b_propagate_buf->Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
 
     // disassembling forward-pass forward-propagation buffer into different neurons,
-    CuSubMatrix<BaseFloat> F_YG(f_propagate_buf_.ColRange(0*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YI(f_propagate_buf_.ColRange(1*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YF(f_propagate_buf_.ColRange(2*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YO(f_propagate_buf_.ColRange(3*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YC(f_propagate_buf_.ColRange(4*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YH(f_propagate_buf_.ColRange(5*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YM(f_propagate_buf_.ColRange(6*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YR(f_propagate_buf_.ColRange(7*ncell_, nrecur_));
+    CuSubMatrix<BaseFloat> F_YG(f_propagate_buf->ColRange(0*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YI(f_propagate_buf->ColRange(1*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YF(f_propagate_buf->ColRange(2*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YO(f_propagate_buf->ColRange(3*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YC(f_propagate_buf->ColRange(4*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YH(f_propagate_buf->ColRange(5*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YM(f_propagate_buf->ColRange(6*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YR(f_propagate_buf->ColRange(7*ncell_, nrecur_));
 
-    CuSubMatrix<BaseFloat> F_YGIFO(f_propagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> F_YGIFO(f_propagate_buf->ColRange(0, 4*ncell_));
 
     // disassembling backward-pass forward-propagation buffer into different neurons,
-    CuSubMatrix<BaseFloat> B_YG(b_propagate_buf_.ColRange(0*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YI(b_propagate_buf_.ColRange(1*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YF(b_propagate_buf_.ColRange(2*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YO(b_propagate_buf_.ColRange(3*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YC(b_propagate_buf_.ColRange(4*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YH(b_propagate_buf_.ColRange(5*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YM(b_propagate_buf_.ColRange(6*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YR(b_propagate_buf_.ColRange(7*ncell_, nrecur_));
+    CuSubMatrix<BaseFloat> B_YG(b_propagate_buf->ColRange(0*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YI(b_propagate_buf->ColRange(1*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YF(b_propagate_buf->ColRange(2*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YO(b_propagate_buf->ColRange(3*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YC(b_propagate_buf->ColRange(4*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YH(b_propagate_buf->ColRange(5*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YM(b_propagate_buf->ColRange(6*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YR(b_propagate_buf->ColRange(7*ncell_, nrecur_));
 
-    CuSubMatrix<BaseFloat> B_YGIFO(b_propagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> B_YGIFO(b_propagate_buf->ColRange(0, 4*ncell_));
 
     // forward direction
     // x -> g, i, f, o, not recurrent, do it all in once
@@ -556,7 +651,7 @@ class BLstmProjectedStreamsLC : public UpdatableComponent {
 
     for (int t = 1; t <= T; t++) {
       // multistream buffers for current time-step
-      CuSubMatrix<BaseFloat> y_all(f_propagate_buf_.RowRange(t*S, S));
+      CuSubMatrix<BaseFloat> y_all(f_propagate_buf->RowRange(t*S, S));
       CuSubMatrix<BaseFloat> y_g(F_YG.RowRange(t*S, S));
       CuSubMatrix<BaseFloat> y_i(F_YI.RowRange(t*S, S));
       CuSubMatrix<BaseFloat> y_f(F_YF.RowRange(t*S, S));
@@ -571,39 +666,10 @@ class BLstmProjectedStreamsLC : public UpdatableComponent {
       // r(t-1) -> g, i, f, o
       y_gifo.AddMatMat(1.0, F_YR.RowRange((t-1)*S, S), kNoTrans, f_w_gifo_r_, kTrans, 1.0);
 
-      // c(t-1) -> i(t) via peephole
-      y_i.AddMatDiagVec(1.0, F_YC.RowRange((t-1)*S, S), kNoTrans, f_peephole_i_c_, 1.0);
-
-      // c(t-1) -> f(t) via peephole
-      y_f.AddMatDiagVec(1.0, F_YC.RowRange((t-1)*S, S), kNoTrans, f_peephole_f_c_, 1.0);
-
-      // i, f sigmoid squashing
-      y_i.Sigmoid(y_i);
-      y_f.Sigmoid(y_f);
-
-      // g tanh squashing
-      y_g.Tanh(y_g);
-
-      // g -> c
-      y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-      // c(t-1) -> c(t) via forget-gate
-      y_c.AddMatMatElements(1.0, F_YC.RowRange((t-1)*S, S), y_f, 1.0);
-
-      y_c.ApplyFloor(-50);   // optional clipping of cell activation
-      y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-      // h tanh squashing
-      y_h.Tanh(y_c);
-
-      // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, f_peephole_o_c_, 1.0);
-
-      // o sigmoid squashing
-      y_o.Sigmoid(y_o);
-
-      // h -> m via output gate
-      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+      // c(t-1) -> i, f, o via peepholes, squashing, clipped c, h and m,
+      // fused in one pass over the streams
+      cu::LstmCellForward(F_YC.RowRange((t-1)*S, S), f_peephole_i_c_, f_peephole_f_c_,
+                          f_peephole_o_c_, BaseFloat(50), &y_all);
 
       // m -> r
       y_r.AddMatMat(1.0, y_m, kNoTrans, f_w_r_m_, kTrans, 0.0);
@@ -626,7 +692,8 @@ class BLstmProjectedStreamsLC : public UpdatableComponent {
         std::cerr << "activation of r: " << y_r;
       }
     }
-    f_prev_nnet_state_.CopyFromMat(f_propagate_buf_.RowRange(chunk_size_*S, S));
+    // (the last chunk of a stream may be shorter)
+    f_prev_nnet_state->CopyFromMat(f_propagate_buf->RowRange(std::min(chunk_size_, T)*S, S));
 
     // backward direction
     B_YGIFO.RowRange(1*S, T*S).AddMatMat(1.0, in, kNoTrans, b_w_gifo_x_, kTrans, 0.0);
@@ -647,7 +714,7 @@ class BLstmProjectedStreamsLC : public UpdatableComponent {
     // backward direction, from T to 1, t--
     for (int t = T; t >= 1; t--) {
       // multistream buffers for current time-step
-      CuSubMatrix<BaseFloat> y_all(b_propagate_buf_.RowRange(t*S, S));
+      CuSubMatrix<BaseFloat> y_all(b_propagate_buf->RowRange(t*S, S));
       CuSubMatrix<BaseFloat> y_g(B_YG.RowRange(t*S, S));
       CuSubMatrix<BaseFloat> y_i(B_YI.RowRange(t*S, S));
       CuSubMatrix<BaseFloat> y_f(B_YF.RowRange(t*S, S));
@@ -661,39 +728,10 @@ class BLstmProjectedStreamsLC : public UpdatableComponent {
       // r(t+1) -> g, i, f, o
       y_gifo.AddMatMat(1.0, B_YR.RowRange((t+1)*S, S), kNoTrans, b_w_gifo_r_, kTrans, 1.0);
 
-      // c(t+1) -> i(t) via peephole
-      y_i.AddMatDiagVec(1.0, B_YC.RowRange((t+1)*S, S), kNoTrans, b_peephole_i_c_, 1.0);
-
-      // c(t+1) -> f(t) via peephole
-      y_f.AddMatDiagVec(1.0, B_YC.RowRange((t+1)*S, S), kNoTrans, b_peephole_f_c_, 1.0);
-
-      // i, f sigmoid squashing
-      y_i.Sigmoid(y_i);
-      y_f.Sigmoid(y_f);
-
-      // g tanh squashing
-      y_g.Tanh(y_g);
-
-      // g -> c
-      y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-      // c(t+1) -> c(t) via forget-gate
-      y_c.AddMatMatElements(1.0, B_YC.RowRange((t+1)*S, S), y_f, 1.0);
-
-      y_c.ApplyFloor(-50);   // optional clipping of cell activation
-      y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-      // h tanh squashing
-      y_h.Tanh(y_c);
-
-      // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, b_peephole_o_c_, 1.0);
-
-      // o sigmoid squashing
-      y_o.Sigmoid(y_o);
-
-      // h -> m via output gate
-      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+      // c(t+1) -> i, f, o via peepholes, squashing, clipped c, h and m,
+      // fused in one pass over the streams
+      cu::LstmCellForward(B_YC.RowRange((t+1)*S, S), b_peephole_i_c_, b_peephole_f_c_,
+                          b_peephole_o_c_, BaseFloat(50), &y_all);
 
       // m -> r
       y_r.AddMatMat(1.0, y_m, kNoTrans, b_w_r_m_, kTrans, 0.0);
@@ -719,9 +757,9 @@ class BLstmProjectedStreamsLC : public UpdatableComponent {
     CuMatrix<BaseFloat> YR_FB;
     YR_FB.Resize((T+2)*S, 2 * nrecur_, kSetZero);
     // forward part
-    YR_FB.ColRange(0, nrecur_).CopyFromMat(f_propagate_buf_.ColRange(7*ncell_, nrecur_));
+    YR_FB.ColRange(0, nrecur_).CopyFromMat(f_propagate_buf->ColRange(7*ncell_, nrecur_));
     // backward part
-    YR_FB.ColRange(nrecur_, nrecur_).CopyFromMat(b_propagate_buf_.ColRange(7*ncell_, nrecur_));
+    YR_FB.ColRange(nrecur_, nrecur_).CopyFromMat(b_propagate_buf->ColRange(7*ncell_, nrecur_));
     // recurrent projection layer is also feed-forward as BLSTM output
     out->CopyFromMat(YR_FB.RowRange(1*S, T*S));
   }
@@ -1115,6 +1153,7 @@ class BLstmProjectedStreamsLC : public UpdatableComponent {
   int32 nrecur_;  ///< recurrent projection layer dim
   int32 nstream_;
   int32 chunk_size_; 
+  int32 right_context_; ///< right context frames of a chunk when streaming
   // std::vector<int32> sequence_lengths_;
   CuMatrix<BaseFloat> f_prev_nnet_state_;
   // gradient-clipping value,
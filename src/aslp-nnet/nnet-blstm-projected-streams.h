@@ -465,41 +465,61 @@ class BLstmProjectedStreams : public UpdatableComponent {
   }
 
   void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
+    PropagateStreams(in, out, sequence_lengths_, &f_propagate_buf_, &b_propagate_buf_);
+  }
+
+  ComponentState* NewState() const {
+    return new StreamsState(7*ncell_ + 1*nrecur_);
+  }
+
+  void FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+                           ComponentState *state) const {
+    StreamsState *s = dynamic_cast<StreamsState*>(state);
+    KALDI_ASSERT(s != NULL);
+    PropagateStreams(in, out, s->SeqLengths(in.NumRows()),
+                     &s->propagate_buf, &s->b_propagate_buf);
+  }
+
+  // Forward the sequences of the given lengths, the weights are not touched
+  void PropagateStreams(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+                        const std::vector<int32> &sequence_lengths,
+                        CuMatrix<BaseFloat> *f_propagate_buf,
+                        CuMatrix<BaseFloat> *b_propagate_buf) const {
     int DEBUG = 0;
-    int32 nstream_ = sequence_lengths_.size();
-    KALDI_ASSERT(in.NumRows() % nstream_ == 0);
-    int32 T = in.NumRows() / nstream_;
-    int32 S = nstream_;
+    int32 nstream = sequence_lengths.size();
+    KALDI_ASSERT(in.NumRows() % nstream == 0);
+    int32 T = in.NumRows() / nstream;
+    int32 S = nstream;
 
     // 0:forward pass history, [1, T]:current sequence, T+1:dummy
     // forward direction
-    f_propagate_buf_.Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
+    f_propagate_buf->Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
     // backward direction
-    b_propagate_buf_.Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
+    b_propagate_buf->Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
 
     // disassembling forward-pass forward-propagation buffer into different neurons,
-    CuSubMatrix<BaseFloat> F_YG(f_propagate_buf_.ColRange(0*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YI(f_propagate_buf_.ColRange(1*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YF(f_propagate_buf_.ColRange(2*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YO(f_propagate_buf_.ColRange(3*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YC(f_propagate_buf_.ColRange(4*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YH(f_propagate_buf_.ColRange(5*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YM(f_propagate_buf_.ColRange(6*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YR(f_propagate_buf_.ColRange(7*ncell_, nrecur_));
+    CuSubMatrix<BaseFloat> F_YG(f_propagate_buf->ColRange(0*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YI(f_propagate_buf->ColRange(1*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YF(f_propagate_buf->ColRange(2*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YO(f_propagate_buf->ColRange(3*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YC(f_propagate_buf->ColRange(4*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YH(f_propagate_buf->ColRange(5*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YM(f_propagate_buf->ColRange(6*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YR(f_propagate_buf->ColRange(7*ncell_, nrecur_));
 
-    CuSubMatrix<BaseFloat> F_YGIFO(f_propagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> F_YGIFO(f_propagate_buf->ColRange(0, 4*ncell_));
 
     // disassembling backward-pass forward-propagation buffer into different neurons,
-    CuSubMatrix<BaseFloat> B_YG(b_propagate_buf_.ColRange(0*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YI(b_propagate_buf_.ColRange(1*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YF(b_propagate_buf_.ColRange(2*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YO(b_propagate_buf_.ColRange(3*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YC(b_propagate_buf_.ColRange(4*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YH(b_propagate_buf_.ColRange(5*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YM(b_propagate_buf_.ColRange(6*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YR(b_propagate_buf_.ColRange(7*ncell_, nrecur_));
+    CuSubMatrix<BaseFloat> B_YG(b_propagate_buf->ColRange(0*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YI(b_propagate_buf->ColRange(1*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YF(b_propagate_buf->ColRange(2*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YO(b_propagate_buf->ColRange(3*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YC(b_propagate_buf->ColRange(4*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YH(b_propagate_buf->ColRange(5*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YM(b_propagate_buf->ColRange(6*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YR(b_propagate_buf->ColRange(7*ncell_, nrecur_));
 
-    CuSubMatrix<BaseFloat> B_YGIFO(b_propagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> B_YGIFO(b_propagate_buf->ColRange(0, 4*ncell_));
 
     // forward direction
     // x -> g, i, f, o, not recurrent, do it all in once
@@ -510,7 +530,7 @@ class BLstmProjectedStreams : public UpdatableComponent {
 
     for (int t = 1; t <= T; t++) {
       // multistream buffers for current time-step
-      CuSubMatrix<BaseFloat> y_all(f_propagate_buf_.RowRange(t*S, S));
+      CuSubMatrix<BaseFloat> y_all(f_propagate_buf->RowRange(t*S, S));
       CuSubMatrix<BaseFloat> y_g(F_YG.RowRange(t*S, S));
       CuSubMatrix<BaseFloat> y_i(F_YI.RowRange(t*S, S));
       CuSubMatrix<BaseFloat> y_f(F_YF.RowRange(t*S, S));
@@ -525,46 +545,17 @@ class BLstmProjectedStreams : public UpdatableComponent {
       // r(t-1) -> g, i, f, o
       y_gifo.AddMatMat(1.0, F_YR.RowRange((t-1)*S, S), kNoTrans, f_w_gifo_r_, kTrans, 1.0);
 
-      // c(t-1) -> i(t) via peephole
-      y_i.AddMatDiagVec(1.0, F_YC.RowRange((t-1)*S, S), kNoTrans, f_peephole_i_c_, 1.0);
-
-      // c(t-1) -> f(t) via peephole
-      y_f.AddMatDiagVec(1.0, F_YC.RowRange((t-1)*S, S), kNoTrans, f_peephole_f_c_, 1.0);
-
-      // i, f sigmoid squashing
-      y_i.Sigmoid(y_i);
-      y_f.Sigmoid(y_f);
-
-      // g tanh squashing
-      y_g.Tanh(y_g);
-
-      // g -> c
-      y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-      // c(t-1) -> c(t) via forget-gate
-      y_c.AddMatMatElements(1.0, F_YC.RowRange((t-1)*S, S), y_f, 1.0);
-
-      y_c.ApplyFloor(-50);   // optional clipping of cell activation
-      y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-      // h tanh squashing
-      y_h.Tanh(y_c);
-
-      // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, f_peephole_o_c_, 1.0);
-
-      // o sigmoid squashing
-      y_o.Sigmoid(y_o);
-
-      // h -> m via output gate
-      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+      // c(t-1) -> i, f, o via peepholes, squashing, clipped c, h and m,
+      // fused in one pass over the streams
+      cu::LstmCellForward(F_YC.RowRange((t-1)*S, S), f_peephole_i_c_, f_peephole_f_c_,
+                          f_peephole_o_c_, BaseFloat(50), &y_all);
 
       // m -> r
       y_r.AddMatMat(1.0, y_m, kNoTrans, f_w_r_m_, kTrans, 0.0);
 
       // set zeros
       // for (int s = 0; s < S; s++) {
-      //   if (t > sequence_lengths_[s])
+      //   if (t > sequence_lengths[s])
       //     y_all.Row(s).SetZero();
       // }
 
@@ -600,7 +591,7 @@ class BLstmProjectedStreams : public UpdatableComponent {
     // backward direction, from T to 1, t--
     for (int t = T; t >= 1; t--) {
       // multistream buffers for current time-step
-      CuSubMatrix<BaseFloat> y_all(b_propagate_buf_.RowRange(t*S, S));
+      CuSubMatrix<BaseFloat> y_all(b_propagate_buf->RowRange(t*S, S));
       CuSubMatrix<BaseFloat> y_g(B_YG.RowRange(t*S, S));
       CuSubMatrix<BaseFloat> y_i(B_YI.RowRange(t*S, S));
       CuSubMatrix<BaseFloat> y_f(B_YF.RowRange(t*S, S));
@@ -614,45 +605,16 @@ class BLstmProjectedStreams : public UpdatableComponent {
       // r(t+1) -> g, i, f, o
       y_gifo.AddMatMat(1.0, B_YR.RowRange((t+1)*S, S), kNoTrans, b_w_gifo_r_, kTrans, 1.0);
 
-      // c(t+1) -> i(t) via peephole
-      y_i.AddMatDiagVec(1.0, B_YC.RowRange((t+1)*S, S), kNoTrans, b_peephole_i_c_, 1.0);
-
-      // c(t+1) -> f(t) via peephole
-      y_f.AddMatDiagVec(1.0, B_YC.RowRange((t+1)*S, S), kNoTrans, b_peephole_f_c_, 1.0);
-
-      // i, f sigmoid squashing
-      y_i.Sigmoid(y_i);
-      y_f.Sigmoid(y_f);
-
-      // g tanh squashing
-      y_g.Tanh(y_g);
-
-      // g -> c
-      y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-      // c(t+1) -> c(t) via forget-gate
-      y_c.AddMatMatElements(1.0, B_YC.RowRange((t+1)*S, S), y_f, 1.0);
-
-      y_c.ApplyFloor(-50);   // optional clipping of cell activation
-      y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-      // h tanh squashing
-      y_h.Tanh(y_c);
-
-      // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, b_peephole_o_c_, 1.0);
-
-      // o sigmoid squashing
-      y_o.Sigmoid(y_o);
-
-      // h -> m via output gate
-      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+      // c(t+1) -> i, f, o via peepholes, squashing, clipped c, h and m,
+      // fused in one pass over the streams
+      cu::LstmCellForward(B_YC.RowRange((t+1)*S, S), b_peephole_i_c_, b_peephole_f_c_,
+                          b_peephole_o_c_, BaseFloat(50), &y_all);
 
       // m -> r
       y_r.AddMatMat(1.0, y_m, kNoTrans, b_w_r_m_, kTrans, 0.0);
 
       for (int s = 0; s < S; s++) {
-         if (t > sequence_lengths_[s])
+         if (t > sequence_lengths[s])
             y_all.Row(s).SetZero();
       }
 
@@ -672,9 +634,9 @@ class BLstmProjectedStreams : public UpdatableComponent {
     CuMatrix<BaseFloat> YR_FB;
     YR_FB.Resize((T+2)*S, 2 * nrecur_, kSetZero);
     // forward part
-    YR_FB.ColRange(0, nrecur_).CopyFromMat(f_propagate_buf_.ColRange(7*ncell_, nrecur_));
+    YR_FB.ColRange(0, nrecur_).CopyFromMat(f_propagate_buf->ColRange(7*ncell_, nrecur_));
     // backward part
-    YR_FB.ColRange(nrecur_, nrecur_).CopyFromMat(b_propagate_buf_.ColRange(7*ncell_, nrecur_));
+    YR_FB.ColRange(nrecur_, nrecur_).CopyFromMat(b_propagate_buf->ColRange(7*ncell_, nrecur_));
     // recurrent projection layer is also feed-forward as BLSTM output
     out->CopyFromMat(YR_FB.RowRange(1*S, T*S));
   }
@@ -30,6 +30,13 @@
 namespace kaldi {
 namespace aslp_nnet {
 
+// Forward buffers of CompactFsmn
+// Forward buffers, and the context frames when streaming
+class CompactFsmnState : public ContextState {
+ public:
+  CuMatrix<BaseFloat> aux_pad_mat;
+};
+
 class CompactFsmn : public UpdatableComponent {
   
   public:
@@ -167,34 +174,72 @@ class CompactFsmn : public UpdatableComponent {
 	}
 
 	void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
+		PropagateBuffers(in, out, &aux_pad_mat_);
+	}
+
+	ComponentState* NewState() const {
+		return new CompactFsmnState();
+	}
+
+	void FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+	                         ComponentState *state) const {
+		CompactFsmnState *s = dynamic_cast<CompactFsmnState*>(state);
+		KALDI_ASSERT(s != NULL);
+		PropagateBuffers(in, out, &s->aux_pad_mat);
+	}
+
+	void GetContext(int32 *left_context, int32 *right_context) const {
+		*left_context = past_context_;
+		*right_context = future_context_;
+	}
+
+	ComponentState* InitStreamState() const {
+		return new CompactFsmnState();
+	}
+
+	void FeedforwardChunkFnc(const CuMatrixBase<BaseFloat> &in, bool last,
+	                         CuMatrix<BaseFloat> *out, ComponentState *state) const {
+		CompactFsmnState *s = dynamic_cast<CompactFsmnState*>(state);
+		KALDI_ASSERT(s != NULL);
+		KALDI_ASSERT(vec_coef_.NumRows() == past_context_ + future_context_ + 1);
+		// zero padded, same as PropagateBuffers
+		CuMatrix<BaseFloat> window;
+		int32 T = s->NextWindow(in, last, past_context_, future_context_, false, &window);
+		if (T == 0) {
+			out->Resize(0, 0);
+			return;
+		}
+		out->Resize(T, output_dim_, kUndefined);
+		PropagatePadded(window, window.RowRange(past_context_, T), out);
+	}
+
+	void PropagateBuffers(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+	                      CuMatrix<BaseFloat> *aux_pad_mat) const {
 		int32 T = in.NumRows();
 		int32 D = in.NumCols();
 		int32 C = vec_coef_.NumRows();
-		if (max_frames_ * C > aux_mat_.NumRows() || in.NumCols() != aux_mat_.NumCols()) {
-		    KALDI_ASSERT(T <= max_frames_);
-			aux_mat_.Resize(max_frames_ * C, D, kSetZero);
-	    }
-		if (max_frames_ + C - 1 > aux_pad_mat_.NumRows() || in.NumCols() != aux_pad_mat_.NumCols()) {
+		if (max_frames_ + C - 1 > aux_pad_mat->NumRows() || in.NumCols() != aux_pad_mat->NumCols()) {
 			KALDI_ASSERT(T <= max_frames_);
-			aux_pad_mat_.Resize(max_frames_ + C - 1, D, kSetZero);
+			aux_pad_mat->Resize(max_frames_ + C - 1, D, kSetZero);
 		}
 		KALDI_ASSERT(in.NumCols() == vec_coef_.NumCols());
 
-		CuSubMatrix<BaseFloat> padded_mat(aux_pad_mat_.RowRange(0, T + C - 1));
+		CuSubMatrix<BaseFloat> padded_mat(aux_pad_mat->RowRange(0, T + C - 1));
 		padded_mat.SetZero();
 		padded_mat.RowRange(past_context_, in.NumRows()).CopyFromMat(in);
 
-		// out
-		CuSubMatrix<BaseFloat> tmp_mat(aux_mat_.RowRange(0, T * C));
-		tmp_mat.AddConvMatMatElements(1.0, padded_mat, vec_coef_, 0.0);	
-		//for (int i = 0; i < T; i++) {
-		//	const CuSubMatrix<BaseFloat> padded_mat_chunk(padded_mat.RowRange(i, C));
-		//	CuSubMatrix<BaseFloat> tmp_mat_chunk(tmp_mat.RowRange(i * C, C));
-		//	tmp_mat_chunk.AddMatMatElements(1.0, padded_mat_chunk, vec_coef_, 0.0);
-		//}
+		PropagatePadded(padded_mat, in, out);
+	}
 
+	// out = in + memory of in, padded_mat is in with the past/future context
+	void PropagatePadded(const CuMatrixBase<BaseFloat> &padded_mat, const CuMatrixBase<BaseFloat> &in,
+	                     CuMatrixBase<BaseFloat> *out) const {
+		int32 T = in.NumRows();
+		int32 C = vec_coef_.NumRows();
+		KALDI_ASSERT(padded_mat.NumRows() == T + C - 1);
+		// out, the memory is convolved directly, without the (T * C) x D products
 		out->CopyFromMat(in);
-		out->AddRowSumMat(1.0, tmp_mat, 1.0);
+		out->AddDepthwiseConv(1.0, padded_mat, vec_coef_, 1.0);
 	}
 
 	void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
@@ -212,16 +257,7 @@ class CompactFsmn : public UpdatableComponent {
 		padded_mat.RowRange(past_context_, in.NumRows()).CopyFromMat(in);
 	
 		// vec_coef_corr_
-		CuSubMatrix<BaseFloat> tmp_mat(aux_mat_.RowRange(0, T * C));
-		//tmp_mat.Resize(C * T, D, kSetZero);
-	
-		for (int i = 0; i < C; i++) {
-			const CuSubMatrix<BaseFloat> padded_mat_chunk(padded_mat.RowRange(i, T));
-			CuSubMatrix<BaseFloat> tmp_mat_chunk(tmp_mat.RowRange(i * T, T));
-			tmp_mat_chunk.AddMatMatElements(1.0, padded_mat_chunk, out_diff, 0.0);
-		}
-		
-		vec_coef_corr_.AddRowSumMat(1.0, tmp_mat, 0.0);
+		vec_coef_corr_.AddDepthwiseConvGrad(1.0, padded_mat, out_diff, 0.0);
 		//KALDI_LOG << "vec_coef_corr: " << vec_coef_corr_;
 		CuSubMatrix<BaseFloat> padded_diff_mat(aux_pad_mat_.RowRange(0, T + C - 1));
 		padded_diff_mat.SetZero();
@@ -236,20 +272,8 @@ class CompactFsmn : public UpdatableComponent {
 		}
 	
 		// in_diff
-		CuSubMatrix<BaseFloat> in_diff_tmp_mat(aux_mat_.RowRange(0, T * C));
-		//CuMatrix<BaseFloat> in_tmp_mat;
-		//in_tmp_mat.Resize(T * C, D, kSetZero);
-		
-		in_diff_tmp_mat.AddConvMatMatElements(1.0, padded_diff_mat, reversed_vec_coef_, 0.0);
-		//for (int i = 0; i < T; i++) {
-		//	const CuSubMatrix<BaseFloat> padded_diff_mat_chunk(padded_diff_mat.RowRange(i, C));
-		//	CuSubMatrix<BaseFloat> in_diff_tmp_mat_chunk(in_diff_tmp_mat.RowRange(i * C, C));
-		//	in_diff_tmp_mat_chunk.AddMatMatElements(1.0, padded_diff_mat_chunk,
-		//									   reversed_vec_coef_, 0.0);
-		//}
-		
 		in_diff->CopyFromMat(out_diff);
-		in_diff->AddRowSumMat(1.0, in_diff_tmp_mat, 1.0);
+		in_diff->AddDepthwiseConv(1.0, padded_diff_mat, reversed_vec_coef_, 1.0);
 
 		if (clip_gradient_ > 0.0) {
 			vec_coef_corr_.ApplyFloor(-clip_gradient_);
@@ -268,7 +292,6 @@ class CompactFsmn : public UpdatableComponent {
 	CuMatrix<BaseFloat> vec_coef_corr_;
 	CuMatrix<BaseFloat> reversed_vec_coef_;
 
-	CuMatrix<BaseFloat> aux_mat_;	
 	CuMatrix<BaseFloat> aux_pad_mat_;
 	int32 max_frames_;
 	//CuMatrix<BaseFloat> aux_in_mat_;
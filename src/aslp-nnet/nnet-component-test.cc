@@ -21,6 +21,7 @@
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <unistd.h>
 
 #include "util/common-utils.h"
 
@@ -28,6 +29,8 @@
 #include "aslp-nnet/nnet-nnet.h"
 #include "aslp-nnet/nnet-convolutional-component.h"
 #include "aslp-nnet/nnet-max-pooling-component.h"
+#include "aslp-nnet/nnet-quantized-affine-transform.h"
+#include "aslp-nnet/nnet-lstm-projected-streams.h"
 
 namespace kaldi {
 namespace aslp_nnet {
@@ -46,13 +49,39 @@ namespace aslp_nnet {
     return Component::Read(is, false); // false for ascii
   }
 
+  // Nnet::Init reads the proto from a file,
+  Nnet* InitNnetFromString(const std::string& proto) {
+    std::string filename = "tmp.nnet.proto";
+    {
+      std::ofstream os(filename.c_str());
+      os << proto;
+    }
+    Nnet* nnet = new Nnet;
+    nnet->Init(filename);
+    unlink(filename.c_str());
+    return nnet;
+  }
+
+  // Random input for every input layer of the nnet,
+  void RandInput(const Nnet& nnet, int32 num_frames,
+                 std::vector<CuMatrix<BaseFloat> >* in) {
+    in->clear();
+    for (int32 c = 0; c < nnet.NumComponents(); c++) {
+      const Component& comp = nnet.GetComponent(c);
+      if (comp.GetType() != Component::kInputLayer) continue;
+      in->push_back(CuMatrix<BaseFloat>(num_frames, comp.InputDim()));
+      in->back().SetRandn();
+    }
+    KALDI_ASSERT(in->size() == nnet.NumInput());
+  }
+
 
   /*
    * Unit tests,
    */
   void UnitTestLengthNorm() {
     // make L2-lenght normalization component,
-    Component* c = ReadComponentFromString("<LengthNormComponent> 5 5");
+    Component* c = ReadComponentFromString("<LengthNormComponent> 5 5 0 [ ] [ ]");
     // prepare input,
     CuMatrix<BaseFloat> mat_in;
     ReadCuMatrixFromString("[ 1 2 3 4 5 \n 2 3 5 6 8 ] ", &mat_in);
@@ -70,7 +99,7 @@ namespace aslp_nnet {
 
   void UnitTestConvolutionalComponentUnity() {
     // make 'identity' convolutional component,
-    Component* c = ReadComponentFromString("<ConvolutionalComponent> 5 5 \
+    Component* c = ReadComponentFromString("<ConvolutionalComponent> 5 5 0 [ ] [ ] \
       <PatchDim> 1 <PatchStep> 1 <PatchStride> 5 \
       <LearnRateCoef> 1.0 <BiasLearnRateCoef> 1.0 \
       <MaxNorm> 0 \
@@ -100,7 +129,7 @@ namespace aslp_nnet {
 
   void UnitTestConvolutionalComponent3x3() {
     // make 3x3 convolutional component, design such weights and input so output is zero,
-    Component* c = ReadComponentFromString("<ConvolutionalComponent> 9 15 \
+    Component* c = ReadComponentFromString("<ConvolutionalComponent> 9 15 0 [ ] [ ] \
       <PatchDim> 3 <PatchStep> 1 <PatchStride> 5 \
       <LearnRateCoef> 1.0 <BiasLearnRateCoef> 1.0 \
       <MaxNorm> 0 \
@@ -205,6 +234,272 @@ namespace aslp_nnet {
     delete c;
   }
 
+  void UnitTestQuantizedAffineTransform() {
+    // make the float affine transform and its int8 version,
+    Component* c = Component::Init("<AffineTransform> <InputDim> 100 <OutputDim> 50 <ParamStddev> 0.1");
+    Component* q = new QuantizedAffineTransform(*dynamic_cast<AffineTransform*>(c));
+    // write and read back,
+    std::ostringstream os;
+    q->Write(os, true);
+    delete q;
+    std::istringstream is(os.str());
+    q = Component::Read(is, true);
+    // prepare input,
+    CuMatrix<BaseFloat> mat_in(20, 100);
+    mat_in.SetRandn();
+    // propagate,
+    CuMatrix<BaseFloat> mat_out, mat_out_q;
+    c->Propagate(mat_in, &mat_out);
+    q->Propagate(mat_in, &mat_out_q);
+    // the error is bounded by the int8 steps of the weights and the input,
+    mat_out_q.AddMat(-1.0, mat_out);
+    BaseFloat max_err = std::max(mat_out_q.Max(), -mat_out_q.Min());
+    KALDI_LOG << "Max int8 error " << max_err << ", output range " << mat_out.Max();
+    KALDI_ASSERT(max_err < 0.1);
+
+    delete c;
+    delete q;
+  }
+
+  void UnitTestQuantizedNnet() {
+    // float net and its int8 version, the lstm quantized in place,
+    Nnet* nnet = InitNnetFromString(
+      "<AffineTransform> <InputDim> 20 <OutputDim> 32 <ParamStddev> 0.1\n"
+      "<Sigmoid> <InputDim> 32 <OutputDim> 32\n"
+      "<LstmProjectedStreams> <InputDim> 32 <OutputDim> 16 <CellDim> 24 <ParamScale> 0.5\n"
+      "<AffineTransform> <InputDim> 16 <OutputDim> 8 <ParamStddev> 0.1\n");
+    Nnet* nnet_q = new Nnet(*nnet);
+    nnet_q->Quantize();
+    // write with the <Quantized> lstm weights and read back,
+    for (int32 binary = 0; binary < 2; binary++) {
+      std::ostringstream os;
+      nnet_q->Write(os, binary == 1);
+      if (binary == 0) KALDI_ASSERT(os.str().find("<Quantized>") != std::string::npos);
+      delete nnet_q;
+      std::istringstream is(os.str());
+      nnet_q = new Nnet;
+      nnet_q->Read(is, binary == 1);
+    }
+    int32 num_affine = 0, num_lstm = 0;
+    for (int32 c = 0; c < nnet_q->NumComponents(); c++) {
+      const Component& comp = nnet_q->GetComponent(c);
+      KALDI_ASSERT(comp.GetType() != Component::kAffineTransform);
+      if (comp.GetType() == Component::kQuantizedAffineTransform) num_affine++;
+      if (comp.GetType() == Component::kLstmProjectedStreams) {
+        KALDI_ASSERT(dynamic_cast<const LstmProjectedStreams&>(comp).IsQuantized());
+        num_lstm++;
+      }
+    }
+    KALDI_ASSERT(num_affine == 2 && num_lstm == 1);
+    // the int8 error goes through the recurrence, frame after frame,
+    NnetState state(*nnet), state_q(*nnet_q);
+    state.ResetLstmStreams(std::vector<int32>(1, 1));
+    state_q.ResetLstmStreams(std::vector<int32>(1, 1));
+    CuMatrix<BaseFloat> mat_in(50, 20), mat_out, mat_out_q;
+    mat_in.SetRandn();
+    nnet->Feedforward(mat_in, &mat_out, &state);
+    nnet_q->Feedforward(mat_in, &mat_out_q, &state_q);
+    mat_out_q.AddMat(-1.0, mat_out);
+    BaseFloat max_err = std::max(mat_out_q.Max(), -mat_out_q.Min());
+    KALDI_LOG << "Max int8 nnet error " << max_err << ", output range "
+              << std::max(mat_out.Max(), -mat_out.Min());
+    KALDI_ASSERT(max_err < 0.02);
+    delete nnet;
+    delete nnet_q;
+  }
+
+  // Feedforward on the planned (shared) buffers must be the same as
+  // Propagate, which keeps the buffers of every component,
+  void CheckFeedforwardPlan(Nnet* nnet) {
+    std::vector<CuMatrix<BaseFloat> > in;
+    std::vector<const CuMatrixBase<BaseFloat>*> in_ptr;
+    std::vector<CuMatrix<BaseFloat> > out(nnet->NumOutput()),
+                                      out_ref(nnet->NumOutput());
+    std::vector<CuMatrix<BaseFloat>*> out_ptr, out_ref_ptr;
+    for (int32 i = 0; i < nnet->NumOutput(); i++) {
+      out_ptr.push_back(&out[i]);
+      out_ref_ptr.push_back(&out_ref[i]);
+    }
+    NnetState state(*nnet);
+    // the buffers grow and are reused, so the longer input comes second,
+    int32 num_frames[] = { 7, 20, 3 };
+    for (int32 n = 0; n < 3; n++) {
+      RandInput(*nnet, num_frames[n], &in);
+      in_ptr.clear();
+      for (int32 i = 0; i < in.size(); i++) in_ptr.push_back(&in[i]);
+      nnet->Propagate(in_ptr, &out_ref_ptr);
+      nnet->Feedforward(in_ptr, &out_ptr);
+      for (int32 i = 0; i < out.size(); i++) {
+        KALDI_ASSERT(out[i].NumRows() == num_frames[n]);
+        AssertEqual(out[i], out_ref[i], 1.0e-05);
+      }
+      nnet->Feedforward(in_ptr, &out_ptr, &state);
+      for (int32 i = 0; i < out.size(); i++) {
+        AssertEqual(out[i], out_ref[i], 1.0e-05);
+      }
+    }
+  }
+
+  void UnitTestFeedforwardPlan() {
+    // linear net, the input/output layers are added,
+    Nnet* nnet = InitNnetFromString(
+      "<AffineTransform> <InputDim> 10 <OutputDim> 32 <ParamStddev> 0.1\n"
+      "<Sigmoid> <InputDim> 32 <OutputDim> 32\n"
+      "<AffineTransform> <InputDim> 32 <OutputDim> 32 <ParamStddev> 0.1\n"
+      "<Tanh> <InputDim> 32 <OutputDim> 32\n"
+      "<AffineTransform> <InputDim> 32 <OutputDim> 5 <ParamStddev> 0.1\n"
+      "<Softmax> <InputDim> 5 <OutputDim> 5\n");
+    CheckFeedforwardPlan(nnet);
+    delete nnet;
+
+    // two inputs spliced directly into one buffer, two outputs,
+    nnet = InitNnetFromString(
+      "<StructureType> graph\n"
+      "<InputLayer> <InputDim> 6 <OutputDim> 6 <Name> in1 <Input> -1\n"
+      "<InputLayer> <InputDim> 4 <OutputDim> 4 <Name> in2 <Input> -1\n"
+      "<AffineTransform> <InputDim> 6 <OutputDim> 8 <Name> a1 <Input> in1 <ParamStddev> 0.1\n"
+      "<AffineTransform> <InputDim> 4 <OutputDim> 5 <Name> a2 <Input> in2 <ParamStddev> 0.1\n"
+      "<Sigmoid> <InputDim> 8 <OutputDim> 8 <Name> s1 <Input> a1\n"
+      "<Sigmoid> <InputDim> 5 <OutputDim> 5 <Name> s2 <Input> a2\n"
+      "<AffineTransform> <InputDim> 13 <OutputDim> 7 <Name> a3 <Input> s1:0,s2:8 <ParamStddev> 0.1\n"
+      "<Softmax> <InputDim> 7 <OutputDim> 7 <Name> sm1 <Input> a3\n"
+      "<AffineTransform> <InputDim> 5 <OutputDim> 3 <Name> a4 <Input> s2 <ParamStddev> 0.1\n"
+      "<OutputLayer> <InputDim> 7 <OutputDim> 7 <Name> out1 <Input> sm1\n"
+      "<OutputLayer> <InputDim> 3 <OutputDim> 3 <Name> out2 <Input> a4\n");
+    KALDI_ASSERT(nnet->NumInput() == 2 && nnet->NumOutput() == 2);
+    CheckFeedforwardPlan(nnet);
+    delete nnet;
+
+    // an output read by the later components, an input read twice, inputs
+    // with a gap and overlapped inputs (summed), which are not direct,
+    nnet = InitNnetFromString(
+      "<StructureType> graph\n"
+      "<InputLayer> <InputDim> 6 <OutputDim> 6 <Name> in <Input> -1\n"
+      "<AffineTransform> <InputDim> 6 <OutputDim> 6 <Name> a1 <Input> in <ParamStddev> 0.1\n"
+      "<Sigmoid> <InputDim> 6 <OutputDim> 6 <Name> s1 <Input> a1\n"
+      "<AffineTransform> <InputDim> 6 <OutputDim> 6 <Name> a2 <Input> s1 <ParamStddev> 0.1\n"
+      "<Tanh> <InputDim> 6 <OutputDim> 6 <Name> t1 <Input> a2\n"
+      "<AffineTransform> <InputDim> 12 <OutputDim> 4 <Name> cat <Input> s1:0,t1:6 <ParamStddev> 0.1\n"
+      "<AffineTransform> <InputDim> 6 <OutputDim> 4 <Name> sum <Input> s1:0,t1:0 <ParamStddev> 0.1\n"
+      "<AffineTransform> <InputDim> 16 <OutputDim> 4 <Name> gap <Input> in:0,a1:10 <ParamStddev> 0.1\n"
+      "<OutputLayer> <InputDim> 6 <OutputDim> 6 <Name> out1 <Input> s1\n"
+      "<OutputLayer> <InputDim> 4 <OutputDim> 4 <Name> out2 <Input> cat\n"
+      "<OutputLayer> <InputDim> 4 <OutputDim> 4 <Name> out3 <Input> sum\n"
+      "<OutputLayer> <InputDim> 4 <OutputDim> 4 <Name> out4 <Input> gap\n");
+    KALDI_ASSERT(nnet->NumOutput() == 4);
+    CheckFeedforwardPlan(nnet);
+    delete nnet;
+  }
+
+  // Feed 'in' forward in chunks of the given sizes, the last one flushes
+  // the stream, and concatenate the output,
+  void FeedforwardInChunks(const Nnet& nnet, const CuMatrixBase<BaseFloat>& in,
+                           const std::vector<int32>& chunk_size,
+                           NnetStreamState* state, CuMatrix<BaseFloat>* out) {
+    std::vector<CuMatrix<BaseFloat> > pieces(chunk_size.size());
+    int32 t = 0, num_out = 0;
+    for (int32 i = 0; i < chunk_size.size(); i++) {
+      KALDI_ASSERT(t + chunk_size[i] <= in.NumRows());
+      bool last = (i + 1 == chunk_size.size());
+      if (last) KALDI_ASSERT(t + chunk_size[i] == in.NumRows());
+      if (chunk_size[i] > 0) {
+        nnet.FeedforwardChunk(in.RowRange(t, chunk_size[i]), last, &pieces[i],
+                              state);
+      } else {
+        // only flush the stream,
+        nnet.FeedforwardChunk(CuMatrix<BaseFloat>(), last, &pieces[i], state);
+      }
+      // the output lags the input, but never leads it,
+      num_out += pieces[i].NumRows();
+      t += chunk_size[i];
+      KALDI_ASSERT(num_out <= t);
+    }
+    KALDI_ASSERT(num_out == in.NumRows());
+    out->Resize(num_out, nnet.OutputDim());
+    t = 0;
+    for (int32 i = 0; i < pieces.size(); i++) {
+      if (pieces[i].NumRows() == 0) continue;
+      out->RowRange(t, pieces[i].NumRows()).CopyFromMat(pieces[i]);
+      t += pieces[i].NumRows();
+    }
+  }
+
+  void UnitTestFeedforwardChunk() {
+    // right context 2 + 3 + 2, left context 2 + 4 and the lstm state,
+    Nnet* nnet = InitNnetFromString(
+      "<Splice> <InputDim> 5 <OutputDim> 25 <BuildVector> -2:2 </BuildVector>\n"
+      "<AffineTransform> <InputDim> 25 <OutputDim> 16 <ParamStddev> 0.1\n"
+      "<RowConvolution> <InputDim> 16 <OutputDim> 16 <FutureContext> 3\n"
+      "<CompactFsmn> <InputDim> 16 <OutputDim> 16 <PastContext> 4 <FutureContext> 2\n"
+      "<LstmProjectedStreams> <InputDim> 16 <OutputDim> 8 <CellDim> 12 <ParamScale> 0.5\n"
+      "<AffineTransform> <InputDim> 8 <OutputDim> 4 <ParamStddev> 0.1\n");
+    int32 left_context, right_context;
+    nnet->GetContext(&left_context, &right_context);
+    KALDI_ASSERT(left_context == 6 && right_context == 7);
+    NnetState state(*nnet);
+    state.ResetLstmStreams(std::vector<int32>(1, 1));
+    // the same stream state is reused stream after stream,
+    NnetStreamState stream_state(*nnet);
+    // 1-frame chunks, a last chunk shorter than the right context, a
+    // last chunk bigger than the whole context and an empty last chunk,
+    int32 schedule[][8] = { { 1, 1, 1, 5, 1, 9, 3, 0 },
+                            { 2, 1, 17, 0, 0, 0, 0, 0 },
+                            { 1, 1, 1, 1, 0, 0, 0, 0 },
+                            { 4, 12, 0, 0, 0, 0, 0, 0 },
+                            { 3, 0, 0, 0, 0, 0, 0, 0 } };
+    int32 schedule_size[] = { 7, 4, 4, 2, 1 };
+    for (int32 n = 0; n < 5; n++) {
+      std::vector<int32> chunk_size(schedule[n], schedule[n] + schedule_size[n]);
+      int32 num_frames = 0;
+      for (int32 i = 0; i < chunk_size.size(); i++) num_frames += chunk_size[i];
+      CuMatrix<BaseFloat> in(num_frames, 5), out, out_ref;
+      in.SetRandn();
+      nnet->Feedforward(in, &out_ref, &state);
+      state.ResetLstmStreams(std::vector<int32>(1, 1));
+      FeedforwardInChunks(*nnet, in, chunk_size, &stream_state, &out);
+      AssertEqual(out, out_ref, 1.0e-05);
+    }
+    delete nnet;
+
+    // latency controlled blstm, the backward direction of every chunk
+    // sees the right context frames after it,
+    nnet = InitNnetFromString(
+      "<BLstmProjectedStreamsLC> <InputDim> 5 <OutputDim> 8 <CellDim> 6 <ParamScale> 0.5\n");
+    int32 chunk = 4, blstm_right_context = 2;
+    nnet->SetChunkSize(chunk, blstm_right_context);
+    int32 c = 0;
+    while (nnet->GetComponent(c).GetType() !=
+           Component::kBLstmProjectedStreamsLC) c++;
+    const Component& blstm = nnet->GetComponent(c);
+    NnetStreamState blstm_stream_state(*nnet);
+    int32 blstm_schedule[][6] = { { 1, 1, 1, 1, 1, 1 },
+                                  { 3, 7, 1, 2, 0, 0 },
+                                  { 9, 4, 1, 0, 0, 0 } };
+    int32 blstm_schedule_size[] = { 6, 4, 4 };
+    for (int32 n = 0; n < 3; n++) {
+      std::vector<int32> chunk_size(blstm_schedule[n],
+                                    blstm_schedule[n] + blstm_schedule_size[n]);
+      int32 num_frames = 0;
+      for (int32 i = 0; i < chunk_size.size(); i++) num_frames += chunk_size[i];
+      CuMatrix<BaseFloat> in(num_frames, 5), out, out_ref(num_frames, 8);
+      in.SetRandn();
+      // reference, window by window, the forward state carried over,
+      ComponentState* blstm_state = blstm.NewState();
+      blstm_state->ResetLstmStreams(std::vector<int32>(1, 1));
+      for (int32 t = 0; t < num_frames; t += chunk) {
+        int32 len = std::min(chunk + blstm_right_context, num_frames - t),
+              out_len = std::min(chunk, num_frames - t);
+        CuMatrix<BaseFloat> window_out(len, 8);
+        blstm.FeedforwardInto(in.RowRange(t, len), &window_out, blstm_state);
+        out_ref.RowRange(t, out_len).CopyFromMat(window_out.RowRange(0, out_len));
+      }
+      delete blstm_state;
+      FeedforwardInChunks(*nnet, in, chunk_size, &blstm_stream_state, &out);
+      AssertEqual(out, out_ref, 1.0e-05);
+    }
+    delete nnet;
+  }
+
 } // namespace aslp_nnet
 } // namespace kaldi
 
@@ -224,6 +519,10 @@ int main() {
     UnitTestConvolutionalComponentUnity();
     UnitTestConvolutionalComponent3x3();
     UnitTestMaxPoolingComponent();
+    UnitTestQuantizedAffineTransform();
+    UnitTestQuantizedNnet();
+    UnitTestFeedforwardPlan();
+    UnitTestFeedforwardChunk();
     // end of unit-tests,
     if (loop == 0)
         KALDI_LOG << "Tests without GPU use succeeded.";
@@ -37,6 +37,7 @@
 #include "aslp-nnet/nnet-gru-streams.h"
 #include "aslp-nnet/nnet-lstm-couple-if-projected-streams.h"
 #include "aslp-nnet/nnet-cfsmn-component.h"
+#include "aslp-nnet/nnet-quantized-affine-transform.h"
 
 #include <sstream>
 
@@ -78,6 +79,7 @@ const struct Component::key_value Component::kMarkerMap[] = {
   { Component::kCompactFsmn, "<CompactFsmn>"},
   { Component::kPnormComponent, "<Pnorm>"},
   { Component::kPnormComponent, "<Maxout>"},
+  { Component::kQuantizedAffineTransform, "<QuantizedAffineTransform>"},
 };
 
 
@@ -200,6 +202,9 @@ Component* Component::NewComponentOfType(ComponentType comp_type,
     case Component::kMaxoutComponent:
 	  ans = new MaxoutComponent(input_dim, output_dim);
       break;
+    case Component::kQuantizedAffineTransform:
+      ans = new QuantizedAffineTransform(input_dim, output_dim);
+      break;
     case Component::kUnknown :
     default :
       KALDI_ERR << "Missing type: " << TypeToMarker(comp_type);
@@ -349,5 +354,72 @@ void Component::WriteStandard(std::ostream &os, bool binary) const {
   this->WriteData(os, binary);
 }
 
+ComponentState* Component::InitStreamState() const {
+  // The components with a forward state have to implement the streaming
+  ComponentState *state = NewState();
+  if (state != NULL) {
+    delete state;
+    KALDI_ERR << TypeToMarker(GetType()) << " has no streaming forward";
+  }
+  return NULL;
+}
+
+int32 ContextState::NextWindow(const CuMatrixBase<BaseFloat> &in, bool last,
+                               int32 left_context, int32 right_context,
+                               bool replicate, CuMatrix<BaseFloat> *window) {
+  KALDI_ASSERT(left_context >= 0 && right_context >= 0);
+  int32 num_new = in.NumRows(),
+        num_kept = frames.NumRows(),
+        // padding before the first frame
+        num_left = (num_input == 0 && num_new > 0) ? left_context : 0,
+        num_avail = num_left + num_kept + num_new;
+  int32 num_ready = 0, num_right = 0;
+  if (num_input + num_new == 0) {
+    // nothing in the stream yet
+  } else if (last) {
+    num_right = right_context;
+    num_ready = num_avail - left_context;
+  } else {
+    num_ready = std::max(0, num_avail - left_context - right_context);
+  }
+  if (num_avail + num_right == 0) {
+    window->Resize(0, 0);
+    if (last) num_input = 0;
+    return 0;
+  }
+  int32 dim = num_new > 0 ? in.NumCols() : frames.NumCols();
+  window->Resize(num_avail + num_right, dim, kUndefined);
+  if (num_left > 0) {
+    CuSubMatrix<BaseFloat> pad(window->RowRange(0, num_left));
+    if (replicate) pad.CopyRowsFromVec(in.Row(0));
+    else pad.SetZero();
+  }
+  if (num_kept > 0) {
+    window->RowRange(num_left, num_kept).CopyFromMat(frames);
+  }
+  if (num_new > 0) {
+    window->RowRange(num_left + num_kept, num_new).CopyFromMat(in);
+  }
+  if (num_right > 0) {
+    CuSubMatrix<BaseFloat> pad(window->RowRange(num_avail, num_right));
+    if (replicate) pad.CopyRowsFromVec(window->Row(num_avail - 1));
+    else pad.SetZero();
+  }
+  if (last) {
+    frames.Resize(0, 0);
+    num_input = 0;
+  } else if (num_ready == num_avail) {
+    frames.Resize(0, 0);
+    num_input += num_new;
+  } else {
+    // The left context of the next output frame and the frames after it
+    CuMatrix<BaseFloat> kept(window->RowRange(num_ready, 
+                                              num_avail - num_ready));
+    frames.Swap(&kept);
+    num_input += num_new;
+  }
+  return num_ready;
+}
+
 } // namespace aslp_nnet
 } // namespace kaldi
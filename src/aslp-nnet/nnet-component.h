@@ -36,6 +36,112 @@
 namespace kaldi {
 namespace aslp_nnet {
 
+/**
+ * Everything a component modifies in the forward pass (activation buffers,
+ * recurrent state), kept out of the component so that one component can be
+ * shared read-only by several threads, each of them feeding forward with
+ * its own state. See Component::NewState() and NnetState.
+ */
+class ComponentState {
+ public:
+  virtual ~ComponentState() { }
+  /// Same as ResetLstmStreams/SetSeqLengths of the component, on this state
+  virtual void ResetLstmStreams(const std::vector<int32> &stream_reset_flag) { }
+  virtual void SetSeqLengths(const std::vector<int32> &sequence_lengths) { }
+};
+
+/**
+ * Forward state of the multi-stream recurrent components (the LSTM, GRU and
+ * BLSTM families, RowConvolution): number of streams, recurrent state of
+ * every stream and the forward-pass buffers.
+ */
+class StreamsState : public ComponentState {
+ public:
+  /// state_dim: dim of the recurrent state of one stream
+  explicit StreamsState(int32 state_dim): state_dim(state_dim), nstream(0) { }
+
+  void ResetLstmStreams(const std::vector<int32> &stream_reset_flag) {
+    if (nstream == 0) {
+      nstream = stream_reset_flag.size();
+      ResizeState(nstream);
+    }
+    if (state_dim == 0) return;
+    KALDI_ASSERT(prev_nnet_state.NumRows() == stream_reset_flag.size());
+    for (int s = 0; s < stream_reset_flag.size(); s++) {
+      if (stream_reset_flag[s] == 1) {
+        prev_nnet_state.Row(s).SetZero();
+      }
+    }
+  }
+
+  void SetSeqLengths(const std::vector<int32> &sequence_lengths) {
+    this->sequence_lengths = sequence_lengths;
+    nstream = sequence_lengths.size();
+    ResizeState(nstream);
+  }
+
+  /// Number of streams of the next forward pass. Streams never set up run
+  /// as one stream with the state reset on every call, like nnet-forward.
+  int32 NumStreams() {
+    if (nstream == 0) {
+      ResizeState(1);
+      return 1;
+    }
+    return nstream;
+  }
+
+  /// Sequence lengths of the next forward pass of num_rows frames,
+  /// all the rows are one sequence if they are never set up
+  const std::vector<int32> &SeqLengths(int32 num_rows) {
+    if (sequence_lengths.empty()) {
+      all_rows_length.assign(1, num_rows);
+      return all_rows_length;
+    }
+    return sequence_lengths;
+  }
+
+  int32 state_dim;
+  int32 nstream;
+  std::vector<int32> sequence_lengths;
+  CuMatrix<BaseFloat> prev_nnet_state;
+  /// forward-pass buffers, b_propagate_buf for the backward direction
+  CuMatrix<BaseFloat> propagate_buf, b_propagate_buf;
+
+ private:
+  void ResizeState(int32 num_streams) {
+    // state_dim is 0 for the components without recurrent state
+    if (state_dim > 0) prev_nnet_state.Resize(num_streams, state_dim, kSetZero);
+  }
+
+  std::vector<int32> all_rows_length;
+};
+
+/**
+ * Streaming state of the components looking at the neighbour frames
+ * (Splice, RowConvolution, CompactFsmn): the input frames kept as the left
+ * context of the next output frames, and the frames still waiting for their
+ * right context. See Component::FeedforwardChunk.
+ */
+class ContextState : public ComponentState {
+ public:
+  ContextState(): num_input(0) { }
+
+  /// Append the chunk 'in' and get the 'window' of the next frames to
+  /// output, with left_context frames before and right_context frames after
+  /// them. The frames before the stream begin and after its end ('last')
+  /// are copies of the first/last frame, or zeros if !replicate.
+  /// Returns the number of frames to output, the state is ready for a new
+  /// stream after the last chunk.
+  int32 NextWindow(const CuMatrixBase<BaseFloat> &in, bool last,
+                   int32 left_context, int32 right_context, bool replicate,
+                   CuMatrix<BaseFloat> *window);
+
+  /// Kept frames, starting with the left context of the next output frame
+  CuMatrix<BaseFloat> frames;
+  /// Number of frames of the stream so far
+  int32 num_input;
+};
+
 /**
  * Abstract class, building block of the network.
  * It is able to propagate (PropagateFnc: compute the output based on its input)
@@ -99,7 +205,8 @@ class Component {
     kLstmCifgProjectedStreams,
 	kCompactFsmn,
     kPnormComponent,
-    kMaxoutComponent
+    kMaxoutComponent,
+    kQuantizedAffineTransform
   } ComponentType;
   /// A pair of type and marker 
   struct key_value {
@@ -179,6 +286,38 @@ class Component {
   /// Perform feed forward pass
   virtual void Feedforward(const CuMatrixBase<BaseFloat> &in, 
                          CuMatrix<BaseFloat> *out); 
+  /// New forward state of the component, NULL if its feed forward pass
+  /// doesn't modify the component
+  virtual ComponentState* NewState() const { return NULL; }
+  /// Perform feed forward pass with the modified data kept in 'state' (from
+  /// NewState()), the component itself is untouched so it can be shared
+  void Feedforward(const CuMatrixBase<BaseFloat> &in,
+                   CuMatrix<BaseFloat> *out,
+                   ComponentState *state) const;
+  /// Perform feed forward pass into 'out' already of in.NumRows() x
+  /// OutputDim(), which may be a part of a bigger buffer (see
+  /// Nnet::PlanFeedforward)
+  void FeedforwardInto(const CuMatrixBase<BaseFloat> &in,
+                       CuMatrixBase<BaseFloat> *out);
+  /// Perform feed forward pass into 'out' with the data kept in 'state'
+  void FeedforwardInto(const CuMatrixBase<BaseFloat> &in,
+                       CuMatrixBase<BaseFloat> *out,
+                       ComponentState *state) const;
+  /// Number of frames before/after a frame its output depends on
+  virtual void GetContext(int32 *left_context, int32 *right_context) const {
+    *left_context = 0;
+    *right_context = 0;
+  }
+  /// New streaming state of one stream (see FeedforwardChunk), NULL if the
+  /// component works frame by frame
+  virtual ComponentState* InitStreamState() const;
+  /// Feed forward the next chunk 'in' of one stream, 'out' gets the output
+  /// frames which are complete (all their right context seen), so it lags
+  /// the input by the right context. After the 'last' chunk all the frames
+  /// are output, and the output of the whole stream is the same as the
+  /// Feedforward of the whole sequence.
+  void FeedforwardChunk(const CuMatrixBase<BaseFloat> &in, bool last,
+                        CuMatrix<BaseFloat> *out, ComponentState *state) const;
   /// Perform forward pass propagation Input->Output
   void Propagate(const CuMatrixBase<BaseFloat> &in, CuMatrix<BaseFloat> *out); 
   /// Perform backward pass propagation, out_diff -> in_diff
@@ -206,6 +345,17 @@ class Component {
  protected:
   virtual void FeedforwardFnc(const CuMatrixBase<BaseFloat> &in,
                             CuMatrixBase<BaseFloat> *out);
+  /// Feed forward transformation on a state, to be implemented by the
+  /// components modifying themselves in FeedforwardFnc
+  virtual void FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in,
+                                   CuMatrixBase<BaseFloat> *out,
+                                   ComponentState *state) const;
+  /// Streaming feed forward transformation, to be implemented by the
+  /// components with context or state (see FeedforwardChunk), the default
+  /// forwards the chunk frame by frame
+  virtual void FeedforwardChunkFnc(const CuMatrixBase<BaseFloat> &in, bool last,
+                                   CuMatrix<BaseFloat> *out,
+                                   ComponentState *state) const;
   /// Forward pass transformation (to be implemented by descending class...)
   virtual void PropagateFnc(const CuMatrixBase<BaseFloat> &in,
                             CuMatrixBase<BaseFloat> *out) = 0;
@@ -300,6 +450,71 @@ inline void Component::FeedforwardFnc(const CuMatrixBase<BaseFloat> &in,
   PropagateFnc(in, out);
 }
 
+inline void Component::Feedforward(const CuMatrixBase<BaseFloat> &in,
+                                   CuMatrix<BaseFloat> *out,
+                                   ComponentState *state) const {
+  // Check the dims
+  if (input_dim_ != in.NumCols()) {
+    KALDI_ERR << "Non-matching dims! " << TypeToMarker(GetType()) 
+              << " input-dim : " << input_dim_ << " data : " << in.NumCols();
+  }
+  // Allocate target buffer
+  out->Resize(in.NumRows(), output_dim_, kSetZero); // reset
+  FeedforwardStateFnc(in, out, state);
+}
+
+inline void Component::FeedforwardInto(const CuMatrixBase<BaseFloat> &in,
+                                       CuMatrixBase<BaseFloat> *out) {
+  KALDI_ASSERT(input_dim_ == in.NumCols());
+  KALDI_ASSERT(out->NumRows() == in.NumRows() && out->NumCols() == output_dim_);
+  out->SetZero();
+  FeedforwardFnc(in, out);
+}
+
+inline void Component::FeedforwardInto(const CuMatrixBase<BaseFloat> &in,
+                                       CuMatrixBase<BaseFloat> *out,
+                                       ComponentState *state) const {
+  KALDI_ASSERT(input_dim_ == in.NumCols());
+  KALDI_ASSERT(out->NumRows() == in.NumRows() && out->NumCols() == output_dim_);
+  out->SetZero();
+  FeedforwardStateFnc(in, out, state);
+}
+
+inline void Component::FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in,
+                                           CuMatrixBase<BaseFloat> *out,
+                                           ComponentState *state) const {
+  // Without state, the forward pass of the component is read-only
+  KALDI_ASSERT(state == NULL);
+  const_cast<Component*>(this)->FeedforwardFnc(in, out);
+}
+
+inline void Component::FeedforwardChunk(const CuMatrixBase<BaseFloat> &in,
+                                        bool last, CuMatrix<BaseFloat> *out,
+                                        ComponentState *state) const {
+  // An empty chunk may only flush the stream
+  if (in.NumRows() > 0 && input_dim_ != in.NumCols()) {
+    KALDI_ERR << "Non-matching dims! " << TypeToMarker(GetType()) 
+              << " input-dim : " << input_dim_ << " data : " << in.NumCols();
+  }
+  FeedforwardChunkFnc(in, last, out, state);
+  KALDI_ASSERT(out->NumRows() == 0 || out->NumCols() == output_dim_);
+}
+
+inline void Component::FeedforwardChunkFnc(const CuMatrixBase<BaseFloat> &in,
+                                           bool last, CuMatrix<BaseFloat> *out,
+                                           ComponentState *state) const {
+  if (in.NumRows() == 0) {
+    out->Resize(0, 0);
+  } else {
+    out->Resize(in.NumRows(), output_dim_, kSetZero);
+    FeedforwardStateFnc(in, out, state);
+  }
+  // the recurrent state is kept from chunk to chunk until the stream ends
+  if (last && state != NULL) {
+    state->ResetLstmStreams(std::vector<int32>(1, 1));
+  }
+}
+
 inline void Component::Propagate(const CuMatrixBase<BaseFloat> &in,
                                  CuMatrix<BaseFloat> *out) {
   // Check the dims
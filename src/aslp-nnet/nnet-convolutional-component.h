@@ -316,6 +316,38 @@ class ConvolutionalComponent : public UpdatableComponent {
     }
   }
 
+  void FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in,
+                           CuMatrixBase<BaseFloat> *out,
+                           ComponentState *state) const {
+    // same as PropagateFnc, the patches and the column map are local
+    int32 num_splice = input_dim_ / patch_stride_;
+    int32 num_patches = 1 + (patch_stride_ - patch_dim_) / patch_step_;
+    int32 num_filters = filters_.NumRows();
+    int32 filter_dim = filters_.NumCols();
+
+    std::vector<int32> column_map(filter_dim * num_patches);
+    for (int32 p=0, index=0; p<num_patches; p++) {
+      for (int32 s=0; s<num_splice; s++) {
+        for (int32 d=0; d<patch_dim_; d++, index++) {
+          column_map[index] = p * patch_step_ + s * patch_stride_ + d;
+        }
+      }
+    }
+    CuMatrix<BaseFloat> vectorized_feature_patches(in.NumRows(),
+                                                   filter_dim * num_patches,
+                                                   kUndefined);
+    vectorized_feature_patches.CopyCols(in, CuArray<int32>(column_map));
+
+    for (int32 p=0; p<num_patches; p++) {
+      CuSubMatrix<BaseFloat> tgt(out->ColRange(p * num_filters, num_filters));
+      CuSubMatrix<BaseFloat> patch(vectorized_feature_patches.ColRange(
+                                   p * filter_dim, filter_dim));
+      tgt.AddVecToRows(1.0, bias_, 0.0); // add bias
+      // apply all filters
+      tgt.AddMatMat(1.0, patch, kNoTrans, filters_, kTrans, 1.0);
+    }
+  }
+
   /*
    This function does an operation similar to reversing a map,
    except it handles maps that are not one-to-one by outputting
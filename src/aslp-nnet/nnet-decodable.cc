@@ -9,17 +9,21 @@ NnetDecodableBase::NnetDecodableBase(
         Nnet *nnet,
         const CuVector<BaseFloat> &log_priors,
         const TransitionModel &trans_model,
-        const NnetDecodableOptions &opts):
+        const NnetDecodableOptions &opts,
+        NnetForwardInterface *forward):
     nnet_(nnet),
+    forward_(forward),
     log_priors_(log_priors),
     trans_model_(trans_model),
     opts_(opts),
-    num_pdfs_(nnet_->OutputDim()),
+    num_pdfs_(forward != NULL ? forward->OutputDim() : nnet->OutputDim()),
     begin_frame_(-1) {
         KALDI_ASSERT(opts_.max_nnet_batch_size > 0);
         KALDI_ASSERT(log_priors_.Dim() == trans_model_.NumPdfs() &&
                 "Priors in neural network not set up (or mismatch "
                 "with transition model).");
+        // The stream state is kept by forward_ itself
+        if (forward_ != NULL) return;
         if (nnet_->NumOutput() != 1) {
             KALDI_ERR << "Num output must equal 1";
         }
@@ -27,6 +31,12 @@ NnetDecodableBase::NnetDecodableBase(
         nnet_->ResetLstmStreams(flags);
 }
 
+void NnetDecodableBase::Feedforward(const CuMatrixBase<BaseFloat> &in,
+                                    CuMatrix<BaseFloat> *out) {
+    if (forward_ != NULL) forward_->Feedforward(in, out);
+    else nnet_->Feedforward(in, out);
+}
+
 BaseFloat NnetDecodableBase::LogLikelihood(int32 frame, int32 index) {
     ComputeForFrame(frame);
     int32 pdf_id = trans_model_.TransitionIdToPdf(index);
@@ -35,6 +45,20 @@ BaseFloat NnetDecodableBase::LogLikelihood(int32 frame, int32 index) {
     return scaled_loglikes_(frame - begin_frame_, pdf_id);
 }
 
+void NnetDecodableBase::GetScaledLoglikes(Matrix<BaseFloat> *scaled_loglikes) {
+    int32 num_frames = NumFramesReady();
+    scaled_loglikes->Resize(num_frames, num_pdfs_, kUndefined);
+    for (int32 frame = 0; frame < num_frames; ) {
+        ComputeForFrame(frame);
+        // The cached batch may begin before frame
+        int32 offset = frame - begin_frame_,
+              num_rows = scaled_loglikes_.NumRows() - offset;
+        scaled_loglikes->RowRange(frame, num_rows).CopyFromMat(
+                scaled_loglikes_.RowRange(offset, num_rows));
+        frame += num_rows;
+    }
+}
+
 void NnetDecodableBase::ComputeForFrame(int32 frame) {
     int32 features_ready = NumFramesReady();
     //bool input_finished = features_->IsLastFrame(features_ready - 1);  
@@ -76,7 +100,7 @@ void NnetDecodableBase::ComputeForFrame(int32 frame) {
             for (int i = 0; i < skip_len; i++) {
                 skip_feat.Row(i).CopyFromVec(cu_features.Row(i * skip_width));
             }
-            nnet_->Feedforward(skip_feat, &skip_out);
+            Feedforward(skip_feat, &skip_out);
             for (int i = 0; i < skip_len; i++) {
                 for (int j = 0; j < skip_width; j++) {
                     int idx = i * skip_width + j;
@@ -95,7 +119,7 @@ void NnetDecodableBase::ComputeForFrame(int32 frame) {
                 for (int i = 0; i < skip_len; i++) {
                     skip_feat.Row(i).CopyFromVec(cu_features.Row(i * skip_width + skip_offset));
                 }
-                nnet_->Feedforward(skip_feat, &skip_out);
+                Feedforward(skip_feat, &skip_out);
                 for (int i = 0; i < skip_len; i++) {
                     cu_posteriors.Row(i * skip_width + skip_offset).CopyFromVec(skip_out.Row(i));
                 }
@@ -106,7 +130,7 @@ void NnetDecodableBase::ComputeForFrame(int32 frame) {
         }
     }
     else {
-        nnet_->Feedforward(cu_features, &cu_posteriors);
+        Feedforward(cu_features, &cu_posteriors);
     }
 
     cu_posteriors.ApplyFloor(1.0e-20); // Avoid log of zero which leads to NaN.
@@ -54,13 +54,44 @@ struct NnetDecodableOptions {
     }
 };
 
+// Computes the nnet output of one decoding stream in place of a direct
+// Nnet::Feedforward, eg. to score many online streams in one batch
+class NnetForwardInterface {
+public:
+    virtual void Feedforward(const CuMatrixBase<BaseFloat> &in,
+                             CuMatrix<BaseFloat> *out) = 0;
+    virtual int32 OutputDim() const = 0;
+    virtual ~NnetForwardInterface() {}
+};
+
+// Forward of one decoding stream on a Nnet shared read-only by all the
+// streams, only the buffers and the recurrent state belong to the stream
+class SharedNnetForward: public NnetForwardInterface {
+public:
+    explicit SharedNnetForward(const Nnet &nnet): nnet_(nnet), state_(nnet) {
+        // One stream, the recurrent state is kept between the calls
+        std::vector<int32> flags(1, 1);
+        state_.ResetLstmStreams(flags);
+    }
+    virtual void Feedforward(const CuMatrixBase<BaseFloat> &in,
+                             CuMatrix<BaseFloat> *out) {
+        nnet_.Feedforward(in, out, &state_);
+    }
+    virtual int32 OutputDim() const { return nnet_.OutputDim(); }
+private:
+    const Nnet &nnet_;
+    NnetState state_;
+};
 
 class NnetDecodableBase: public DecodableInterface {
 public:
+    /// If @forward is not NULL, it is used to compute the nnet output
+    /// instead of @nnet, and @nnet may be NULL
     NnetDecodableBase(Nnet *nnet,
                       const CuVector<BaseFloat> &log_priors,
                       const TransitionModel &trans_model,
-                      const NnetDecodableOptions &opts);
+                      const NnetDecodableOptions &opts,
+                      NnetForwardInterface *forward = NULL);
 
     /// Returns the scaled log likelihood
     virtual BaseFloat LogLikelihood(int32 frame, int32 index);
@@ -73,13 +104,22 @@ public:
     /// Indices are one-based!  This is for compatibility with OpenFst.
     virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
 
+    /// Computes the scaled log likelihoods of all the frames ready in
+    /// batches of max_nnet_batch_size, eg. to decode them later in another
+    /// thread with DecodableMatrixScaledMapped
+    void GetScaledLoglikes(Matrix<BaseFloat> *scaled_loglikes);
+
 protected:
 
     /// If the neural-network outputs for this frame are not cached, it computes
     /// them (and possibly for some succeeding frames)
     void ComputeForFrame(int32 frame);
 
+    void Feedforward(const CuMatrixBase<BaseFloat> &in, 
+                     CuMatrix<BaseFloat> *out);
+
     Nnet *nnet_;
+    NnetForwardInterface *forward_;
     const CuVector<BaseFloat> &log_priors_;  // log-priors taken from the model.
     const TransitionModel &trans_model_;
     NnetDecodableOptions opts_;
@@ -136,8 +176,9 @@ public:
                         const CuVector<BaseFloat> &log_priors,
                         const TransitionModel &trans_model,
                         const NnetDecodableOptions &opts,
-                        OnlineFeatureInterface *input_feats):
-        NnetDecodableBase(nnet, log_priors, trans_model, opts),
+                        OnlineFeatureInterface *input_feats,
+                        NnetForwardInterface *forward = NULL):
+        NnetDecodableBase(nnet, log_priors, trans_model, opts, forward),
         features_(input_feats) {}
 
     virtual bool IsLastFrame(int32 frame) const {
@@ -218,6 +218,17 @@ public:
 	    prev_nnet_state_.Resize(nstream_, 5 * output_dim_, kSetZero);
     }
 
+    // Recurrent state of all the streams, one row per stream, used to
+    // save and restore the state of a stream between batches
+    void GetStreamState(CuMatrix<BaseFloat> *state) const {
+        *state = prev_nnet_state_;
+    }
+    void SetStreamState(const CuMatrixBase<BaseFloat> &state) {
+        KALDI_ASSERT(state.NumCols() == 5 * output_dim_);
+        nstream_ = state.NumRows();
+        prev_nnet_state_ = state;
+    }
+
 	void ResetLstmStreams(const std::vector<int32> &stream_reset_flag) {
 		// allocate prev_nnet_state_ if not done yet,
 		if (nstream_ == 0) {
@@ -236,8 +247,6 @@ public:
 	}
 
 	void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
-		int DEBUG = 0;
-		
 		static bool do_stream_reset = false;
 		if (nstream_ == 0) {
 			do_stream_reset = true;
@@ -248,23 +257,51 @@ public:
 		if (do_stream_reset) prev_nnet_state_.SetZero();
 		KALDI_ASSERT(nstream_ > 0);
 
-		KALDI_ASSERT(in.NumRows() % nstream_ == 0);
-		int32 T = in.NumRows() / nstream_;
-		int32 S = nstream_;
+		PropagateStreams(in, out, nstream_, &prev_nnet_state_, &propagate_buf_);
+	}
+
+	ComponentState* NewState() const {
+		return new StreamsState(5 * output_dim_);
+	}
+
+	ComponentState* InitStreamState() const {
+		// one stream, its state is kept from chunk to chunk
+		ComponentState *state = NewState();
+		state->ResetLstmStreams(std::vector<int32>(1, 1));
+		return state;
+	}
+
+	void FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+	                         ComponentState *state) const {
+		StreamsState *s = dynamic_cast<StreamsState*>(state);
+		KALDI_ASSERT(s != NULL);
+		PropagateStreams(in, out, s->NumStreams(), &s->prev_nnet_state, &s->propagate_buf);
+	}
+
+	// Forward nstream streams starting from *prev_nnet_state, which then
+	// holds the state of the last frame, the weights are not touched
+	void PropagateStreams(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+	                      int32 nstream, CuMatrix<BaseFloat> *prev_nnet_state,
+	                      CuMatrix<BaseFloat> *propagate_buf) const {
+		int DEBUG = 0;
+
+		KALDI_ASSERT(in.NumRows() % nstream == 0);
+		int32 T = in.NumRows() / nstream;
+		int32 S = nstream;
 
 		// 0:forward pass history, [1, T]:current sequence, T+1:dummy
-		propagate_buf_.Resize((T+2)*S, 5 * output_dim_, kSetZero);
-		propagate_buf_.RowRange(0*S,S).CopyFromMat(prev_nnet_state_);
+		propagate_buf->Resize((T+2)*S, 5 * output_dim_, kSetZero);
+		propagate_buf->RowRange(0*S,S).CopyFromMat(*prev_nnet_state);
 
 		// disassemble entire neuron activation buffer in different neurons
-		CuSubMatrix<BaseFloat> YZ(propagate_buf_.ColRange(0*output_dim_, output_dim_));
-		CuSubMatrix<BaseFloat> YR(propagate_buf_.ColRange(1*output_dim_, output_dim_));
-		CuSubMatrix<BaseFloat> YM(propagate_buf_.ColRange(2*output_dim_, output_dim_));
-		CuSubMatrix<BaseFloat> YG(propagate_buf_.ColRange(3*output_dim_, output_dim_));
-		CuSubMatrix<BaseFloat> YH(propagate_buf_.ColRange(4*output_dim_, output_dim_));
+		CuSubMatrix<BaseFloat> YZ(propagate_buf->ColRange(0*output_dim_, output_dim_));
+		CuSubMatrix<BaseFloat> YR(propagate_buf->ColRange(1*output_dim_, output_dim_));
+		CuSubMatrix<BaseFloat> YM(propagate_buf->ColRange(2*output_dim_, output_dim_));
+		CuSubMatrix<BaseFloat> YG(propagate_buf->ColRange(3*output_dim_, output_dim_));
+		CuSubMatrix<BaseFloat> YH(propagate_buf->ColRange(4*output_dim_, output_dim_));
 
-		CuSubMatrix<BaseFloat> YZRM(propagate_buf_.ColRange(0, 3*output_dim_));
-		CuSubMatrix<BaseFloat> YZR(propagate_buf_.ColRange(0, 2*output_dim_));
+		CuSubMatrix<BaseFloat> YZRM(propagate_buf->ColRange(0, 3*output_dim_));
+		CuSubMatrix<BaseFloat> YZR(propagate_buf->ColRange(0, 2*output_dim_));
 
 		// x->z, r, m, not recurrent, do it all in once
 		YZRM.RowRange(1*S, T*S).AddMatMat(1.0, in, kNoTrans, w_zrm_x_, kTrans, 0.0);
@@ -274,6 +311,7 @@ public:
 
 		for (int t = 1; t <= T; t++) {
 			// multistream buffers for current time-step
+			CuSubMatrix<BaseFloat> y_all(propagate_buf->RowRange(t*S,S));
 			CuSubMatrix<BaseFloat> y_z(YZ.RowRange(t*S,S));
 			CuSubMatrix<BaseFloat> y_r(YR.RowRange(t*S,S));
 			CuSubMatrix<BaseFloat> y_m(YM.RowRange(t*S,S));
@@ -285,22 +323,14 @@ public:
 			// h(t-1) -> z, r
 			y_zr.AddMatMat(1.0, YH.RowRange((t-1)*S, S), kNoTrans, w_zr_h_, kTrans, 1.0);
 
-			// z, r sigmoid squashing
-			y_zr.Sigmoid(y_zr);
-
-			// r(t) * h(t-1) -> g(t)
-			y_g.AddMatMatElements(1.0, y_r, YH.RowRange((t-1)*S, S), 0.0);
+			// z, r sigmoid squashing, r(t) * h(t-1) -> g(t), in one pass
+			cu::GruGateForward(YH.RowRange((t-1)*S, S), &y_all);
 
 			// g(t) -> m(t)
 			y_m.AddMatMat(1.0, y_g, kNoTrans, w_m_g_, kTrans, 1.0);
 
-			// m tanh squashing
-			y_m.Tanh(y_m);
-
-			// h(t-1) z(t) m(t) -> h(t)
-			y_h.AddMat(1.0, YH.RowRange((t-1)*S, S));
-			y_h.AddMatMatElements(-1.0, YH.RowRange((t-1)*S, S), y_z, 1.0);
-			y_h.AddMatMatElements(1.0, y_z, y_m, 1.0);
+			// m tanh squashing, h(t-1) z(t) m(t) -> h(t), in one pass
+			cu::GruOutputForward(YH.RowRange((t-1)*S, S), &y_all);
 
 			if (DEBUG) {
 				std::cerr << "forward-pass frame " << t << "\n";
@@ -316,7 +346,7 @@ public:
 		out->CopyFromMat(YH.RowRange(1*S, T*S));
 
 		// now the last frame state becomes previous network state for next batch
-		prev_nnet_state_.CopyFromMat(propagate_buf_.RowRange(T*S, S));
+		prev_nnet_state->CopyFromMat(propagate_buf->RowRange(T*S, S));
 	}
 
 	void BackpropagateFnc( const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
@@ -25,6 +25,7 @@
 
 #include "aslp-nnet/nnet-component.h"
 #include "aslp-nnet/nnet-utils.h"
+#include "aslp-nnet/nnet-quantize.h"
 #include "aslp-cudamatrix/cu-math.h"
 
 /*************************************
@@ -50,8 +51,9 @@ class LstmProjectedStreams : public UpdatableComponent {
     ncell_(0),
     nrecur_(output_dim),
     nstream_(0),
-    clip_gradient_(0.0)
-    //, dropout_rate_(0.0)
+    clip_gradient_(0.0),
+    //dropout_rate_(0.0),
+    quantized_(false)
   { }
 
   ~LstmProjectedStreams()
@@ -135,15 +137,30 @@ class LstmProjectedStreams : public UpdatableComponent {
     ReadBasicType(is, binary, &clip_gradient_);
     //ExpectToken(is, binary, "<DropoutRate>");
     //ReadBasicType(is, binary, &dropout_rate_);
+    // optional int8 weights, see Quantize()
+    quantized_ = false;
+    if ('<' == Peek(is, binary)) {
+      ExpectToken(is, binary, "<Quantized>");
+      quantized_ = true;
+    }
 
-    w_gifo_x_.Read(is, binary);
-    w_gifo_r_.Read(is, binary);
+    if (quantized_) {
+      w_gifo_x_q_.Read(is, binary);
+      w_gifo_r_q_.Read(is, binary);
+    } else {
+      w_gifo_x_.Read(is, binary);
+      w_gifo_r_.Read(is, binary);
+    }
     bias_.Read(is, binary);
 
     peephole_i_c_.Read(is, binary);
     peephole_f_c_.Read(is, binary);
     peephole_o_c_.Read(is, binary);
 
+    if (quantized_) {
+      w_r_m_q_.Read(is, binary);
+      return; // no training buffers
+    }
     w_r_m_.Read(is, binary);
 
     // init delta buffers
@@ -166,18 +183,52 @@ class LstmProjectedStreams : public UpdatableComponent {
     //WriteToken(os, binary, "<DropoutRate>");
     //WriteBasicType(os, binary, dropout_rate_);
 
-    w_gifo_x_.Write(os, binary);
-    w_gifo_r_.Write(os, binary);
+    if (quantized_) {
+      WriteToken(os, binary, "<Quantized>");
+      w_gifo_x_q_.Write(os, binary);
+      w_gifo_r_q_.Write(os, binary);
+    } else {
+      w_gifo_x_.Write(os, binary);
+      w_gifo_r_.Write(os, binary);
+    }
     bias_.Write(os, binary);
 
     peephole_i_c_.Write(os, binary);
     peephole_f_c_.Write(os, binary);
     peephole_o_c_.Write(os, binary);
 
-    w_r_m_.Write(os, binary);
+    if (quantized_) w_r_m_q_.Write(os, binary);
+    else w_r_m_.Write(os, binary);
   }
 
+  /// Convert the weight matrices to int8 for the cpu inference, the float
+  /// weights are dropped, so the component can't be trained any more
+  void Quantize() {
+    if (quantized_) return;
+    w_gifo_x_q_.Quantize(w_gifo_x_);
+    w_gifo_r_q_.Quantize(w_gifo_r_);
+    w_r_m_q_.Quantize(w_r_m_);
+    quantized_ = true;
+    w_gifo_x_.Resize(0, 0);
+    w_gifo_r_.Resize(0, 0);
+    w_r_m_.Resize(0, 0);
+    w_gifo_x_corr_.Resize(0, 0);
+    w_gifo_r_corr_.Resize(0, 0);
+    w_r_m_corr_.Resize(0, 0);
+  }
+
+  bool IsQuantized() const { return quantized_; }
+
   int32 NumParams() const {
+    if (quantized_) {
+      return ( w_gifo_x_q_.NumRows() * w_gifo_x_q_.NumCols() +
+           w_gifo_r_q_.NumRows() * w_gifo_r_q_.NumCols() +
+           bias_.Dim() +
+           peephole_i_c_.Dim() +
+           peephole_f_c_.Dim() +
+           peephole_o_c_.Dim() +
+           w_r_m_q_.NumRows() * w_r_m_q_.NumCols() );
+    }
     return ( w_gifo_x_.NumRows() * w_gifo_x_.NumCols() +
          w_gifo_r_.NumRows() * w_gifo_r_.NumCols() +
          bias_.Dim() +
@@ -190,13 +241,28 @@ class LstmProjectedStreams : public UpdatableComponent {
   void GetParams(Vector<BaseFloat>* wei_copy) const {
     wei_copy->Resize(NumParams());
 
+    Matrix<BaseFloat> w_gifo_x, w_gifo_r, w_r_m;
+    if (quantized_) {
+      // dequantized weights
+      w_gifo_x_q_.GetMatrix(&w_gifo_x);
+      w_gifo_r_q_.GetMatrix(&w_gifo_r);
+      w_r_m_q_.GetMatrix(&w_r_m);
+    } else {
+      w_gifo_x.Resize(w_gifo_x_.NumRows(), w_gifo_x_.NumCols(), kUndefined);
+      w_gifo_x_.CopyToMat(&w_gifo_x);
+      w_gifo_r.Resize(w_gifo_r_.NumRows(), w_gifo_r_.NumCols(), kUndefined);
+      w_gifo_r_.CopyToMat(&w_gifo_r);
+      w_r_m.Resize(w_r_m_.NumRows(), w_r_m_.NumCols(), kUndefined);
+      w_r_m_.CopyToMat(&w_r_m);
+    }
+
     int32 offset, len;
 
-    offset = 0;  len = w_gifo_x_.NumRows() * w_gifo_x_.NumCols();
-    wei_copy->Range(offset, len).CopyRowsFromMat(w_gifo_x_);
+    offset = 0;  len = w_gifo_x.NumRows() * w_gifo_x.NumCols();
+    wei_copy->Range(offset, len).CopyRowsFromMat(w_gifo_x);
 
-    offset += len; len = w_gifo_r_.NumRows() * w_gifo_r_.NumCols();
-    wei_copy->Range(offset, len).CopyRowsFromMat(w_gifo_r_);
+    offset += len; len = w_gifo_r.NumRows() * w_gifo_r.NumCols();
+    wei_copy->Range(offset, len).CopyRowsFromMat(w_gifo_r);
 
     offset += len; len = bias_.Dim();
     wei_copy->Range(offset, len).CopyFromVec(bias_);
@@ -210,13 +276,14 @@ class LstmProjectedStreams : public UpdatableComponent {
     offset += len; len = peephole_o_c_.Dim();
     wei_copy->Range(offset, len).CopyFromVec(peephole_o_c_);
 
-    offset += len; len = w_r_m_.NumRows() * w_r_m_.NumCols();
-    wei_copy->Range(offset, len).CopyRowsFromMat(w_r_m_);
+    offset += len; len = w_r_m.NumRows() * w_r_m.NumCols();
+    wei_copy->Range(offset, len).CopyRowsFromMat(w_r_m);
 
     return;
   }
 
   void GetGpuParams(std::vector<std::pair<BaseFloat *, int> > *params) {
+    if (quantized_) KALDI_ERR << "Quantized LstmProjectedStreams is for inference only";
     params->clear();
     params->push_back(std::make_pair(w_gifo_x_.Data(), w_gifo_x_.NumRows() * w_gifo_x_.Stride()));
     params->push_back(std::make_pair(w_gifo_r_.Data(), w_gifo_r_.NumRows() * w_gifo_r_.Stride()));
@@ -228,6 +295,16 @@ class LstmProjectedStreams : public UpdatableComponent {
   }
 
   std::string Info() const {
+    if (quantized_) {
+      return std::string("  ") +
+        "\n  w_gifo_x_  "   + w_gifo_x_q_.Info() +
+        "\n  w_gifo_r_  "   + w_gifo_r_q_.Info() +
+        "\n  bias_  "     + MomentStatistics(bias_) +
+        "\n  peephole_i_c_  " + MomentStatistics(peephole_i_c_) +
+        "\n  peephole_f_c_  " + MomentStatistics(peephole_f_c_) +
+        "\n  peephole_o_c_  " + MomentStatistics(peephole_o_c_) +
+        "\n  w_r_m_  "    + w_r_m_q_.Info();
+    }
     return std::string("  ") +
       "\n  w_gifo_x_  "   + MomentStatistics(w_gifo_x_) +
       "\n  w_gifo_r_  "   + MomentStatistics(w_gifo_r_) +
@@ -310,9 +387,18 @@ class LstmProjectedStreams : public UpdatableComponent {
     prev_nnet_state_.Resize(nstream_, 7*ncell_ + 1*nrecur_, kSetZero);
   }
 
-  void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
-    int DEBUG = 0;
+  // Recurrent state of all the streams, one row per stream, used to
+  // save and restore the state of a stream between batches
+  void GetStreamState(CuMatrix<BaseFloat> *state) const {
+    *state = prev_nnet_state_;
+  }
+  void SetStreamState(const CuMatrixBase<BaseFloat> &state) {
+    KALDI_ASSERT(state.NumCols() == 7*ncell_ + 1*nrecur_);
+    nstream_ = state.NumRows();
+    prev_nnet_state_ = state;
+  }
 
+  void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
     static bool do_stream_reset = false;
     if (nstream_ == 0) {
       do_stream_reset = true;
@@ -323,28 +409,57 @@ class LstmProjectedStreams : public UpdatableComponent {
     if (do_stream_reset) prev_nnet_state_.SetZero();
     KALDI_ASSERT(nstream_ > 0);
 
-    KALDI_ASSERT(in.NumRows() % nstream_ == 0);
-    int32 T = in.NumRows() / nstream_;
-    int32 S = nstream_;
+    PropagateStreams(in, out, nstream_, &prev_nnet_state_, &propagate_buf_);
+  }
+
+  ComponentState* NewState() const {
+    return new StreamsState(7*ncell_ + 1*nrecur_);
+  }
+
+  ComponentState* InitStreamState() const {
+    // one stream, its state is kept from chunk to chunk
+    ComponentState *state = NewState();
+    state->ResetLstmStreams(std::vector<int32>(1, 1));
+    return state;
+  }
+
+  void FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+                           ComponentState *state) const {
+    StreamsState *s = dynamic_cast<StreamsState*>(state);
+    KALDI_ASSERT(s != NULL);
+    PropagateStreams(in, out, s->NumStreams(), &s->prev_nnet_state, &s->propagate_buf);
+  }
+
+  // Forward nstream streams starting from *prev_nnet_state, which then
+  // holds the state of the last frame, the weights are not touched
+  void PropagateStreams(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+                        int32 nstream, CuMatrix<BaseFloat> *prev_nnet_state,
+                        CuMatrix<BaseFloat> *propagate_buf) const {
+    int DEBUG = 0;
+
+    KALDI_ASSERT(in.NumRows() % nstream == 0);
+    int32 T = in.NumRows() / nstream;
+    int32 S = nstream;
 
     // 0:forward pass history, [1, T]:current sequence, T+1:dummy
-    propagate_buf_.Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
-    propagate_buf_.RowRange(0*S,S).CopyFromMat(prev_nnet_state_);
+    propagate_buf->Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
+    propagate_buf->RowRange(0*S,S).CopyFromMat(*prev_nnet_state);
 
     // disassemble entire neuron activation buffer into different neurons
-    CuSubMatrix<BaseFloat> YG(propagate_buf_.ColRange(0*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YI(propagate_buf_.ColRange(1*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YF(propagate_buf_.ColRange(2*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YO(propagate_buf_.ColRange(3*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YC(propagate_buf_.ColRange(4*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YH(propagate_buf_.ColRange(5*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YM(propagate_buf_.ColRange(6*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YR(propagate_buf_.ColRange(7*ncell_, nrecur_));
+    CuSubMatrix<BaseFloat> YG(propagate_buf->ColRange(0*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YI(propagate_buf->ColRange(1*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YF(propagate_buf->ColRange(2*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YO(propagate_buf->ColRange(3*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YC(propagate_buf->ColRange(4*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YH(propagate_buf->ColRange(5*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YM(propagate_buf->ColRange(6*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YR(propagate_buf->ColRange(7*ncell_, nrecur_));
 
-    CuSubMatrix<BaseFloat> YGIFO(propagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> YGIFO(propagate_buf->ColRange(0, 4*ncell_));
 
     // x -> g, i, f, o, not recurrent, do it all in once
-    YGIFO.RowRange(1*S,T*S).AddMatMat(1.0, in, kNoTrans, w_gifo_x_, kTrans, 0.0);
+    CuSubMatrix<BaseFloat> y_gifo_x(YGIFO.RowRange(1*S,T*S));
+    AddMatWeights(in, w_gifo_x_, w_gifo_x_q_, 0.0, &y_gifo_x);
     //// LSTM forward dropout
     //// Google paper 2014: Recurrent Neural Network Regularization
     //// by Wojciech Zaremba, Ilya Sutskever, Oriol Vinyals
@@ -361,6 +476,7 @@ class LstmProjectedStreams : public UpdatableComponent {
 
     for (int t = 1; t <= T; t++) {
       // multistream buffers for current time-step
+      CuSubMatrix<BaseFloat> y_all(propagate_buf->RowRange(t*S,S));
       CuSubMatrix<BaseFloat> y_g(YG.RowRange(t*S,S));
       CuSubMatrix<BaseFloat> y_i(YI.RowRange(t*S,S));
       CuSubMatrix<BaseFloat> y_f(YF.RowRange(t*S,S));
@@ -373,44 +489,15 @@ class LstmProjectedStreams : public UpdatableComponent {
       CuSubMatrix<BaseFloat> y_gifo(YGIFO.RowRange(t*S,S));
 
       // r(t-1) -> g, i, f, o
-      y_gifo.AddMatMat(1.0, YR.RowRange((t-1)*S,S), kNoTrans, w_gifo_r_, kTrans,  1.0);
-
-      // c(t-1) -> i(t) via peephole
-      y_i.AddMatDiagVec(1.0, YC.RowRange((t-1)*S,S), kNoTrans, peephole_i_c_, 1.0);
+      AddMatWeights(YR.RowRange((t-1)*S,S), w_gifo_r_, w_gifo_r_q_, 1.0, &y_gifo);
 
-      // c(t-1) -> f(t) via peephole
-      y_f.AddMatDiagVec(1.0, YC.RowRange((t-1)*S,S), kNoTrans, peephole_f_c_, 1.0);
-
-      // i, f sigmoid squashing
-      y_i.Sigmoid(y_i);
-      y_f.Sigmoid(y_f);
-
-      // g tanh squashing
-      y_g.Tanh(y_g);
-
-      // g -> c
-      y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-      // c(t-1) -> c(t) via forget-gate
-      y_c.AddMatMatElements(1.0, YC.RowRange((t-1)*S,S), y_f, 1.0);
-
-      y_c.ApplyFloor(-50);   // optional clipping of cell activation
-      y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-      // h tanh squashing
-      y_h.Tanh(y_c);
-
-      // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, peephole_o_c_, 1.0);
-
-      // o sigmoid squashing
-      y_o.Sigmoid(y_o);
-
-      // h -> m via output gate
-      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+      // c(t-1) -> i, f, o via peepholes, squashing, clipped c, h and m,
+      // fused in one pass over the streams
+      cu::LstmCellForward(YC.RowRange((t-1)*S,S), peephole_i_c_, peephole_f_c_,
+                          peephole_o_c_, BaseFloat(50), &y_all);
 
       // m -> r
-      y_r.AddMatMat(1.0, y_m, kNoTrans, w_r_m_, kTrans, 0.0);
+      AddMatWeights(y_m, w_r_m_, w_r_m_q_, 0.0, &y_r);
 
       if (DEBUG) {
         std::cerr << "forward-pass frame " << t << "\n";
@@ -429,11 +516,20 @@ class LstmProjectedStreams : public UpdatableComponent {
     out->CopyFromMat(YR.RowRange(1*S,T*S));
 
     // now the last frame state becomes previous network state for next batch
-    prev_nnet_state_.CopyFromMat(propagate_buf_.RowRange(T*S,S));
+    prev_nnet_state->CopyFromMat(propagate_buf->RowRange(T*S,S));
+  }
+
+  // out = in * w^T + beta * out, with the int8 weights w_q if quantized
+  void AddMatWeights(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &w,
+                     const QuantizedMatrix &w_q, BaseFloat beta,
+                     CuMatrixBase<BaseFloat> *out) const {
+    if (quantized_) w_q.AddMatMatTrans(1.0, in, beta, out);
+    else out->AddMatMat(1.0, in, kNoTrans, w, kTrans, beta);
   }
 
   void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
               const CuMatrixBase<BaseFloat> &out_diff, CuMatrixBase<BaseFloat> *in_diff) {
+    if (quantized_) KALDI_ERR << "Quantized LstmProjectedStreams is for inference only";
 
     int DEBUG = 0;
 
@@ -617,6 +713,7 @@ class LstmProjectedStreams : public UpdatableComponent {
   }
 
   void Update(const CuMatrixBase<BaseFloat> &input, const CuMatrixBase<BaseFloat> &diff) {
+    if (quantized_) KALDI_ERR << "Quantized LstmProjectedStreams is for inference only";
     const BaseFloat lr  = opts_.learn_rate;
 
     w_gifo_x_.AddMat(-lr, w_gifo_x_corr_);
@@ -733,6 +830,13 @@ class LstmProjectedStreams : public UpdatableComponent {
   CuMatrix<BaseFloat> w_r_m_;
   CuMatrix<BaseFloat> w_r_m_corr_;
 
+  // int8 copies of w_gifo_x_, w_gifo_r_ and w_r_m_ for the inference,
+  // the float ones are empty when quantized
+  bool quantized_;
+  QuantizedMatrix w_gifo_x_q_;
+  QuantizedMatrix w_gifo_r_q_;
+  QuantizedMatrix w_r_m_q_;
+
   // propagate buffer: output of [g, i, f, o, c, h, m, r]
   CuMatrix<BaseFloat> propagate_buf_;
 
@@ -18,6 +18,8 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+
 #include "aslp-nnet/nnet-nnet.h"
 #include "aslp-nnet/nnet-component.h"
 #include "aslp-nnet/nnet-io.h"
@@ -33,6 +35,7 @@
 #include "aslp-nnet/nnet-lstm-couple-if-projected-streams.h"
 #include "aslp-nnet/nnet-batch-normalization.h"
 #include "aslp-nnet/nnet-cfsmn-component.h"
+#include "aslp-nnet/nnet-quantized-affine-transform.h"
 
 namespace kaldi {
 namespace aslp_nnet {
@@ -156,36 +159,7 @@ void Nnet::Backpropagate(const std::vector<const CuMatrixBase<BaseFloat> *> &out
 void Nnet::Feedforward(const std::vector<const CuMatrixBase<BaseFloat> *> &in, 
         std::vector<CuMatrix<BaseFloat> *> *out) {
     KALDI_ASSERT(NULL != out);
-    
-    KALDI_ASSERT(in.size() == input_.size());
-    int num_frame = in[0]->NumRows();
-    // 1. Resize
-    for(int32 i=0; i<(int32)components_.size(); i++) {
-        input_buf_[i].Resize(num_frame, components_[i]->InputDim(), kSetZero);
-    }
-    // 2. Copy in to InputLayer
-    for (int i = 0; i < input_.size(); i++) {
-        int idx = input_[i];
-        input_buf_[idx].CopyFromMat(*(in[i]));
-    }
-    // 3. Do propagate
-    for(int32 i=0; i<(int32)components_.size(); i++) {
-        if (components_[i]->GetType() != Component::kInputLayer) {
-            const std::vector<int32> &input_idx = components_[i]->GetInput();
-            const std::vector<int32> &offset = components_[i]->GetOffset();
-            KALDI_ASSERT(input_idx.size() == offset.size());
-            for (int j = 0; j < input_idx.size(); j++) {
-                int out_len = components_[input_idx[j]]->OutputDim();
-                input_buf_[i].ColRange(offset[j], out_len).AddMat(1.0, 
-                    output_buf_[input_idx[j]]);
-            }
-        }
-        components_[i]->Feedforward(input_buf_[i], &output_buf_[i]);
-    }
-    // 4. Copy to Output
-    for (int i = 0; i < output_.size(); i++) {
-        *((*out)[i]) = output_buf_[output_[i]];
-    }
+    FeedforwardPlanned(in, out, &forward_buf_, NULL);
 }
 
 void Nnet::Propagate(const CuMatrixBase<BaseFloat> &in, CuMatrix<BaseFloat> *out) {
@@ -232,6 +206,205 @@ void Nnet::Feedforward(const CuMatrixBase<BaseFloat> &in, CuMatrix<BaseFloat> *o
     Feedforward(in_vec, &out_vec);
 }
 
+void Nnet::Feedforward(const std::vector<const CuMatrixBase<BaseFloat> *> &in, 
+        std::vector<CuMatrix<BaseFloat> *> *out, NnetState *state) const {
+    KALDI_ASSERT(NULL != out);
+    KALDI_ASSERT(NULL != state);
+    KALDI_ASSERT(state->component_state_.size() == components_.size());
+    FeedforwardPlanned(in, out, &state->forward_buf_, state);
+}
+
+CuSubMatrix<BaseFloat> Nnet::GetView(const ForwardView &view,
+        const std::vector<const CuMatrixBase<BaseFloat> *> &in,
+        std::vector<CuMatrix<BaseFloat> > *buf, int32 num_frame) {
+    if (view.buf < 0) {
+        return in[view.input]->ColRange(view.offset, view.cols);
+    }
+    return (*buf)[view.buf].Range(0, num_frame, view.offset, view.cols);
+}
+
+void Nnet::FeedforwardPlanned(const std::vector<const CuMatrixBase<BaseFloat> *> &in,
+        std::vector<CuMatrix<BaseFloat> *> *out,
+        std::vector<CuMatrix<BaseFloat> > *buf, NnetState *state) const {
+    KALDI_ASSERT(in.size() == input_.size());
+    KALDI_ASSERT(forward_plan_.size() == components_.size());
+    int num_frame = in[0]->NumRows();
+    for (int i = 0; i < in.size(); i++) {
+        KALDI_ASSERT(in[i]->NumRows() == num_frame);
+        KALDI_ASSERT(in[i]->NumCols() == components_[input_[i]]->InputDim());
+    }
+    // 1. Resize, the buffers only grow so they are allocated once
+    buf->resize(forward_buf_dim_.size());
+    for (int i = 0; i < buf->size(); i++) {
+        if ((*buf)[i].NumRows() < num_frame || 
+            (*buf)[i].NumCols() != forward_buf_dim_[i]) {
+            (*buf)[i].Resize(num_frame, forward_buf_dim_[i], kUndefined);
+        }
+    }
+    // 2. Do propagate
+    for (int32 i = 0; i < (int32)components_.size(); i++) {
+        const ForwardStep &step = forward_plan_[i];
+        CuSubMatrix<BaseFloat> step_in(GetView(step.in, in, buf, num_frame));
+        if (step.zero_in) step_in.SetZero();
+        for (int j = 0; j < step.copy.size(); j++) {
+            const ForwardView &from = step.copy[j].first;
+            CuSubMatrix<BaseFloat> from_mat(GetView(from, in, buf, num_frame));
+            if (step.zero_in) {
+                step_in.ColRange(step.copy[j].second, from.cols).AddMat(1.0, 
+                    from_mat);
+            } else {
+                step_in.ColRange(step.copy[j].second, from.cols).CopyFromMat(
+                    from_mat);
+            }
+        }
+        if (!step.compute) continue;
+        CuSubMatrix<BaseFloat> step_out(GetView(step.out, in, buf, num_frame));
+        if (state == NULL) {
+            components_[i]->FeedforwardInto(step_in, &step_out);
+        } else {
+            components_[i]->FeedforwardInto(step_in, &step_out,
+                                            state->component_state_[i]);
+        }
+    }
+    // 3. Copy to Output
+    for (int i = 0; i < output_.size(); i++) {
+        CuSubMatrix<BaseFloat> view(GetView(forward_plan_[output_[i]].out, 
+                                            in, buf, num_frame));
+        (*out)[i]->Resize(view.NumRows(), view.NumCols(), kUndefined);
+        (*out)[i]->CopyFromMat(view);
+    }
+}
+
+void Nnet::Feedforward(const CuMatrixBase<BaseFloat> &in, CuMatrix<BaseFloat> *out,
+        NnetState *state) const {
+    KALDI_ASSERT(NULL != out);
+
+    if (NumComponents() == 0) { 
+        out->Resize(in.NumRows(), in.NumCols());
+        out->CopyFromMat(in); 
+        return; 
+    }
+    KALDI_ASSERT(input_.size() == 1);
+    KALDI_ASSERT(output_.size() == 1);
+    std::vector<const CuMatrixBase<BaseFloat> *> in_vec;
+    in_vec.push_back(&in);
+    std::vector<CuMatrix<BaseFloat> *> out_vec;
+    out_vec.push_back(out);
+    Feedforward(in_vec, &out_vec, state);
+}
+
+// Append the rows of src to *dst
+static void AppendRows(const CuMatrixBase<BaseFloat> &src, 
+        CuMatrix<BaseFloat> *dst) {
+    if (src.NumRows() == 0) return;
+    CuMatrix<BaseFloat> tmp(dst->NumRows() + src.NumRows(), src.NumCols(), 
+                            kUndefined);
+    if (dst->NumRows() > 0) {
+        tmp.RowRange(0, dst->NumRows()).CopyFromMat(*dst);
+    }
+    tmp.RowRange(dst->NumRows(), src.NumRows()).CopyFromMat(src);
+    dst->Swap(&tmp);
+}
+
+void Nnet::FeedforwardChunk(const std::vector<const CuMatrixBase<BaseFloat> *> &in,
+        bool last, std::vector<CuMatrix<BaseFloat> *> *out,
+        NnetStreamState *state) const {
+    KALDI_ASSERT(NULL != out);
+    KALDI_ASSERT(NULL != state);
+    KALDI_ASSERT(state->component_state_.size() == components_.size());
+    KALDI_ASSERT(in.size() == input_.size());
+    std::vector<CuMatrix<BaseFloat> > &output = state->output_;
+    CuMatrix<BaseFloat> chunk;
+    for (int32 i = 0; i < (int32)components_.size(); i++) {
+        const Component &comp = *components_[i];
+        ComponentState *comp_state = state->component_state_[i];
+        if (comp.GetType() == Component::kInputLayer) {
+            int32 k = std::find(input_.begin(), input_.end(), i) - input_.begin();
+            comp.FeedforwardChunk(*in[k], last, &output[i], comp_state);
+            continue;
+        }
+        const std::vector<int32> &input_idx = comp.GetInput();
+        const std::vector<int32> &offset = comp.GetOffset();
+        if (input_idx.size() == 1 && offset[0] == 0 &&
+            components_[input_idx[0]]->OutputDim() == comp.InputDim()) {
+            comp.FeedforwardChunk(output[input_idx[0]], last, &output[i], 
+                                  comp_state);
+            continue;
+        }
+        // Several inputs, splice the frames which all of them have output
+        std::vector<CuMatrix<BaseFloat> > &pending = state->pending_[i];
+        pending.resize(input_idx.size());
+        int32 num_frames = 0;
+        for (int j = 0; j < input_idx.size(); j++) {
+            AppendRows(output[input_idx[j]], &pending[j]);
+            if (j == 0 || pending[j].NumRows() < num_frames) {
+                num_frames = pending[j].NumRows();
+            }
+        }
+        if (num_frames > 0) {
+            chunk.Resize(num_frames, comp.InputDim(), kSetZero);
+        } else {
+            chunk.Resize(0, 0);
+        }
+        for (int j = 0; j < input_idx.size() && num_frames > 0; j++) {
+            int32 num_left = pending[j].NumRows() - num_frames;
+            chunk.ColRange(offset[j], pending[j].NumCols()).AddMat(1.0, 
+                pending[j].RowRange(0, num_frames));
+            if (num_left > 0) {
+                CuMatrix<BaseFloat> tmp(pending[j].RowRange(num_frames, num_left));
+                pending[j].Swap(&tmp);
+            } else {
+                pending[j].Resize(0, 0);
+            }
+        }
+        if (last) {
+            for (int j = 0; j < pending.size(); j++) {
+                KALDI_ASSERT(pending[j].NumRows() == 0);
+            }
+        }
+        comp.FeedforwardChunk(chunk, last, &output[i], comp_state);
+    }
+    for (int i = 0; i < output_.size(); i++) {
+        *((*out)[i]) = output[output_[i]];
+    }
+}
+
+void Nnet::FeedforwardChunk(const CuMatrixBase<BaseFloat> &in, bool last,
+        CuMatrix<BaseFloat> *out, NnetStreamState *state) const {
+    KALDI_ASSERT(NULL != out);
+    KALDI_ASSERT(input_.size() == 1);
+    KALDI_ASSERT(output_.size() == 1);
+    std::vector<const CuMatrixBase<BaseFloat> *> in_vec;
+    in_vec.push_back(&in);
+    std::vector<CuMatrix<BaseFloat> *> out_vec;
+    out_vec.push_back(out);
+    FeedforwardChunk(in_vec, last, &out_vec, state);
+}
+
+void Nnet::GetContext(int32 *left_context, int32 *right_context) const {
+    // The longest context through the graph
+    int32 n = NumComponents();
+    std::vector<int32> left(n, 0), right(n, 0);
+    *left_context = 0;
+    *right_context = 0;
+    for (int32 i = 0; i < n; i++) {
+        components_[i]->GetContext(&left[i], &right[i]);
+        if (components_[i]->GetType() == Component::kInputLayer) continue;
+        const std::vector<int32> &input_idx = components_[i]->GetInput();
+        int32 in_left = 0, in_right = 0;
+        for (int j = 0; j < input_idx.size(); j++) {
+            in_left = std::max(in_left, left[input_idx[j]]);
+            in_right = std::max(in_right, right[input_idx[j]]);
+        }
+        left[i] += in_left;
+        right[i] += in_right;
+    }
+    for (int i = 0; i < output_.size(); i++) {
+        *left_context = std::max(*left_context, left[output_[i]]);
+        *right_context = std::max(*right_context, right[output_[i]]);
+    }
+}
+
 int32 Nnet::OutputDim() const {
   KALDI_ASSERT(!components_.empty());
   return components_.back()->OutputDim();
@@ -522,15 +695,87 @@ void Nnet::SetSeqLengths(const std::vector<int32> &sequence_lengths) {
   }
 }
 
-void Nnet::SetChunkSize(int chunk_size) {
+void Nnet::GetLstmStreamState(std::vector<CuMatrix<BaseFloat> > *state) const {
+  state->clear();
+  for (int32 c=0; c < NumComponents(); c++) {
+    const Component &comp = GetComponent(c);
+    if (comp.GetType() == Component::kLstmProjectedStreams) {
+      state->resize(state->size() + 1);
+      dynamic_cast<const LstmProjectedStreams&>(comp).GetStreamState(&state->back());
+    }
+    else if (comp.GetType() == Component::kLstm) {
+      state->resize(state->size() + 1);
+      dynamic_cast<const Lstm&>(comp).GetStreamState(&state->back());
+    }
+    else if (comp.GetType() == Component::kGruStreams) {
+      state->resize(state->size() + 1);
+      dynamic_cast<const GruStreams&>(comp).GetStreamState(&state->back());
+    }
+    else if (comp.GetType() == Component::kLstmCifgProjectedStreams) {
+      state->resize(state->size() + 1);
+      dynamic_cast<const LstmCifgProjectedStreams&>(comp).GetStreamState(&state->back());
+    }
+  }
+}
+
+void Nnet::SetLstmStreamState(const std::vector<CuMatrix<BaseFloat> > &state) {
+  int32 n = 0;
+  for (int32 c=0; c < NumComponents(); c++) {
+    Component &comp = GetComponent(c);
+    if (comp.GetType() == Component::kLstmProjectedStreams) {
+      KALDI_ASSERT(n < state.size());
+      dynamic_cast<LstmProjectedStreams&>(comp).SetStreamState(state[n++]);
+    }
+    else if (comp.GetType() == Component::kLstm) {
+      KALDI_ASSERT(n < state.size());
+      dynamic_cast<Lstm&>(comp).SetStreamState(state[n++]);
+    }
+    else if (comp.GetType() == Component::kGruStreams) {
+      KALDI_ASSERT(n < state.size());
+      dynamic_cast<GruStreams&>(comp).SetStreamState(state[n++]);
+    }
+    else if (comp.GetType() == Component::kLstmCifgProjectedStreams) {
+      KALDI_ASSERT(n < state.size());
+      dynamic_cast<LstmCifgProjectedStreams&>(comp).SetStreamState(state[n++]);
+    }
+  }
+  KALDI_ASSERT(n == state.size());
+}
+
+void Nnet::SetChunkSize(int chunk_size, int right_context) {
   for (int32 c=0; c < NumComponents(); c++) {
     if (GetComponent(c).GetType() == Component::kBLstmProjectedStreamsLC) {
       BLstmProjectedStreamsLC& comp = dynamic_cast<BLstmProjectedStreamsLC&>(GetComponent(c));
-      comp.SetChunkSize(chunk_size);
+      comp.SetChunkSize(chunk_size, right_context);
     }
   }
 }
 
+void Nnet::Quantize() {
+  int32 num_quantized = 0;
+  for (int32 c = 0; c < NumComponents(); c++) {
+    Component *comp = components_[c];
+    if (comp->GetType() == Component::kAffineTransform) {
+      Component *quantized = 
+          new QuantizedAffineTransform(dynamic_cast<AffineTransform&>(*comp));
+      // keep the place in the graph
+      quantized->SetId(comp->GetId());
+      quantized->SetName(comp->GetName());
+      quantized->SetInput(comp->GetInput());
+      quantized->SetInputName(comp->GetInputName());
+      quantized->SetOffset(comp->GetOffset());
+      delete comp;
+      components_[c] = quantized;
+      num_quantized++;
+    } else if (comp->GetType() == Component::kLstmProjectedStreams) {
+      dynamic_cast<LstmProjectedStreams*>(comp)->Quantize();
+      num_quantized++;
+    }
+  }
+  InitInputOutput();
+  KALDI_LOG << "Quantized " << num_quantized << " components to int8";
+}
+
 void Nnet::AutoComplete() {
     // Optional add InputLayer
     int input_dim = components_[0]->InputDim();
@@ -829,6 +1074,9 @@ void Nnet::Destroy() {
   input_diff_buf_.resize(0);
   output_buf_.resize(0);
   output_diff_buf_.resize(0);
+  forward_plan_.resize(0);
+  forward_buf_dim_.resize(0);
+  forward_buf_.resize(0);
 }
 
 
@@ -867,6 +1115,169 @@ void Nnet::InitInputOutput() {
 		propagate_time_[i].second = 0.0;
 		back_propagate_time_[i].second = 0.0;
 	}
+    PlanFeedforward();
+}
+
+void Nnet::PlanFeedforward() {
+    int32 n = NumComponents();
+    forward_plan_.clear();
+    forward_buf_dim_.clear();
+    forward_buf_.clear();
+    for (int i = 0; i < n; i++) {
+        // Not all the components are read yet
+        if (components_[i] == NULL) return;
+    }
+    // 1. Readers of every output
+    std::vector<int32> num_reader(n, 0);
+    std::vector<bool> is_output(n, false), is_copy(n, false);
+    for (int i = 0; i < n; i++) {
+        Component::ComponentType type = components_[i]->GetType();
+        is_copy[i] = (type == Component::kInputLayer || 
+                      type == Component::kOutputLayer);
+        if (type == Component::kInputLayer) continue;
+        const std::vector<int32> &input_idx = components_[i]->GetInput();
+        KALDI_ASSERT(input_idx.size() == components_[i]->GetOffset().size());
+        for (int j = 0; j < input_idx.size(); j++) {
+            if (input_idx[j] < 0 || input_idx[j] >= i) {
+                KALDI_ERR << "Component " << i << " takes the input of "
+                          << "component " << input_idx[j] 
+                          << ", the components must be in topological order";
+            }
+            num_reader[input_idx[j]]++;
+        }
+    }
+    for (int i = 0; i < output_.size(); i++) is_output[output_[i]] = true;
+
+    // 2. Splice the inputs of a component into its own input buffer unless
+    // it has only one input of the same dim, the inputs exactly covering
+    // the buffer are written directly into it if nobody else reads them
+    std::vector<bool> splice(n, false), zero_in(n, false), direct(n, false);
+    for (int i = 0; i < n; i++) {
+        if (components_[i]->GetType() == Component::kInputLayer) continue;
+        const std::vector<int32> &input_idx = components_[i]->GetInput();
+        const std::vector<int32> &offset = components_[i]->GetOffset();
+        int32 in_dim = components_[i]->InputDim();
+        if (input_idx.size() == 1 && offset[0] == 0 &&
+            components_[input_idx[0]]->OutputDim() == in_dim) continue;
+        splice[i] = true;
+        std::vector<std::pair<int32, int32> > range;
+        for (int j = 0; j < input_idx.size(); j++) {
+            range.push_back(std::make_pair(offset[j], 
+                components_[input_idx[j]]->OutputDim()));
+        }
+        std::sort(range.begin(), range.end());
+        int32 end = 0, j = 0;
+        for (; j < range.size() && range[j].first == end; j++) {
+            end += range[j].second;
+        }
+        // Gaps or overlaps (the overlapped inputs are summed)
+        zero_in[i] = (j != range.size() || end != in_dim || range.empty());
+        for (j = 0; j < input_idx.size() && !zero_in[i]; j++) {
+            int32 c = input_idx[j];
+            if (num_reader[c] == 1 && !is_output[c] && !is_copy[c]) {
+                direct[c] = true;
+            }
+        }
+    }
+
+    // 3. Views on the logical buffers, each of them has its dim, the step it
+    // is first written (def) and the step it is last read (last)
+    std::vector<int32> dim, def, last;
+    std::vector<ForwardStep> plan(n);
+    for (int i = 0; i < n; i++) {
+        ForwardStep &step = plan[i];
+        step.compute = !is_copy[i];
+        step.zero_in = zero_in[i];
+        const std::vector<int32> &input_idx = components_[i]->GetInput();
+        const std::vector<int32> &offset = components_[i]->GetOffset();
+        int32 in_dim = components_[i]->InputDim();
+        if (components_[i]->GetType() == Component::kInputLayer) {
+            step.in.input = std::find(input_.begin(), input_.end(), i) - 
+                            input_.begin();
+            step.in.cols = in_dim;
+        } else if (!splice[i]) {
+            step.in = plan[input_idx[0]].out;
+        } else {
+            step.in.buf = dim.size();
+            step.in.cols = in_dim;
+            dim.push_back(in_dim);
+            def.push_back(i);
+            last.push_back(i);
+            for (int j = 0; j < input_idx.size(); j++) {
+                int32 c = input_idx[j];
+                if (direct[c]) {
+                    // Step c writes here, it has no other reader
+                    plan[c].out = step.in;
+                    plan[c].out.offset = offset[j];
+                    plan[c].out.cols = components_[c]->OutputDim();
+                    def[step.in.buf] = std::min(def[step.in.buf], c);
+                } else {
+                    step.copy.push_back(std::make_pair(plan[c].out, offset[j]));
+                    int32 b = plan[c].out.buf;
+                    if (b >= 0) last[b] = std::max(last[b], i);
+                }
+            }
+        }
+        if (step.in.buf >= 0) last[step.in.buf] = std::max(last[step.in.buf], i);
+        if (is_copy[i]) {
+            step.out = step.in;
+        } else if (!direct[i]) {
+            step.out.buf = dim.size();
+            step.out.cols = components_[i]->OutputDim();
+            dim.push_back(step.out.cols);
+            def.push_back(i);
+            last.push_back(i);
+        }
+    }
+    for (int i = 0; i < output_.size(); i++) {
+        int32 b = plan[output_[i]].out.buf;
+        if (b >= 0) last[b] = n;
+    }
+
+    // 4. Map the logical buffers to the real ones, a real buffer is free
+    // again after the last step reading it
+    std::vector<int32> slot(dim.size(), -1);
+    std::vector<bool> free_slot;
+    for (int s = 0; s <= n; s++) {
+        for (int b = 0; b < dim.size(); b++) {
+            if (def[b] != s) continue;
+            // The smallest free one big enough, or else the biggest one
+            int32 best = -1;
+            for (int k = 0; k < free_slot.size(); k++) {
+                if (!free_slot[k]) continue;
+                if (best < 0) { best = k; continue; }
+                bool fit = forward_buf_dim_[k] >= dim[b],
+                     best_fit = forward_buf_dim_[best] >= dim[b];
+                if ((fit && (!best_fit || forward_buf_dim_[k] < forward_buf_dim_[best])) ||
+                    (!fit && !best_fit && forward_buf_dim_[k] > forward_buf_dim_[best])) {
+                    best = k;
+                }
+            }
+            if (best < 0) {
+                best = forward_buf_dim_.size();
+                forward_buf_dim_.push_back(0);
+                free_slot.push_back(true);
+            }
+            forward_buf_dim_[best] = std::max(forward_buf_dim_[best], dim[b]);
+            free_slot[best] = false;
+            slot[b] = best;
+        }
+        for (int b = 0; b < dim.size(); b++) {
+            if (last[b] == s) free_slot[slot[b]] = true;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        ForwardStep &step = plan[i];
+        if (step.in.buf >= 0) step.in.buf = slot[step.in.buf];
+        if (step.out.buf >= 0) step.out.buf = slot[step.out.buf];
+        for (int j = 0; j < step.copy.size(); j++) {
+            int32 &b = step.copy[j].first.buf;
+            if (b >= 0) b = slot[b];
+        }
+    }
+    forward_plan_.swap(plan);
+    KALDI_VLOG(1) << "Feedforward plan of " << n << " components uses " 
+                  << forward_buf_dim_.size() << " buffers";
 }
 
 void Nnet::GetComponentTime() {
@@ -957,5 +1368,48 @@ void Nnet::SortComponent(std::vector<Component*> &comp) {
 	comp.swap(tmp_comp);
 }
 
+NnetState::NnetState(const Nnet &nnet):
+    component_state_(nnet.NumComponents(), NULL) {
+  for (int32 c = 0; c < nnet.NumComponents(); c++) {
+    component_state_[c] = nnet.GetComponent(c).NewState();
+  }
+}
+
+NnetState::~NnetState() {
+  for (int32 c = 0; c < component_state_.size(); c++) {
+    delete component_state_[c];
+  }
+}
+
+void NnetState::ResetLstmStreams(const std::vector<int32> &stream_reset_flag) {
+  for (int32 c = 0; c < component_state_.size(); c++) {
+    if (component_state_[c] != NULL) {
+      component_state_[c]->ResetLstmStreams(stream_reset_flag);
+    }
+  }
+}
+
+void NnetState::SetSeqLengths(const std::vector<int32> &sequence_lengths) {
+  for (int32 c = 0; c < component_state_.size(); c++) {
+    if (component_state_[c] != NULL) {
+      component_state_[c]->SetSeqLengths(sequence_lengths);
+    }
+  }
+}
+
+NnetStreamState::NnetStreamState(const Nnet &nnet):
+    component_state_(nnet.NumComponents(), NULL),
+    output_(nnet.NumComponents()), pending_(nnet.NumComponents()) {
+  for (int32 c = 0; c < nnet.NumComponents(); c++) {
+    component_state_[c] = nnet.GetComponent(c).InitStreamState();
+  }
+}
+
+NnetStreamState::~NnetStreamState() {
+  for (int32 c = 0; c < component_state_.size(); c++) {
+    delete component_state_[c];
+  }
+}
+
 } // namespace aslp_nnet
 } // namespace kaldi
@@ -35,6 +35,9 @@
 namespace kaldi {
 namespace aslp_nnet {
 
+class NnetState;
+class NnetStreamState;
+
 class Nnet {
  public:
   Nnet() {}
@@ -59,6 +62,26 @@ class Nnet {
   /// Perform forward pass through the network, don't keep buffers (use it when not training)
   void Feedforward(const std::vector<const CuMatrixBase<BaseFloat> *> &in, 
         std::vector<CuMatrix<BaseFloat> *> *out); 
+  /// Perform forward pass with the buffers and the recurrent state kept in
+  /// 'state', the network itself is read-only here, so several threads can
+  /// share one Nnet, each of them with its own NnetState
+  void Feedforward(const CuMatrixBase<BaseFloat> &in, CuMatrix<BaseFloat> *out,
+        NnetState *state) const;
+  /// Perform forward pass with multi-input and multi-output on 'state'
+  void Feedforward(const std::vector<const CuMatrixBase<BaseFloat> *> &in, 
+        std::vector<CuMatrix<BaseFloat> *> *out, NnetState *state) const; 
+  /// Streaming forward of the next chunk of one stream with its 'state',
+  /// 'out' gets the output frames which are complete so far, it lags 'in'
+  /// by the right context. After the 'last' chunk (may be empty) all the
+  /// output frames are out, the same as the Feedforward of the whole stream
+  void FeedforwardChunk(const CuMatrixBase<BaseFloat> &in, bool last,
+        CuMatrix<BaseFloat> *out, NnetStreamState *state) const;
+  /// Streaming forward with multi-input and multi-output
+  void FeedforwardChunk(const std::vector<const CuMatrixBase<BaseFloat> *> &in,
+        bool last, std::vector<CuMatrix<BaseFloat> *> *out,
+        NnetStreamState *state) const;
+  /// Number of frames before/after a frame its output depends on
+  void GetContext(int32 *left_context, int32 *right_context) const;
   /// Print component's propagate time and backpropagate time
   void GetComponentTime();
   /// Dimensionality on network input (input feature dim.)
@@ -129,8 +152,20 @@ class Nnet {
   /// set sequence length in LSTM multi-stream training
   void SetSeqLengths(const std::vector<int32> &sequence_lengths);
 
-  /// Set chunk size for latency control BLSTM training
-  void SetChunkSize(int chunk_size);
+  /// Get the multi-stream recurrent state, one matrix (one row per stream)
+  /// per recurrent component in component order, empty for feedforward nets
+  void GetLstmStreamState(std::vector<CuMatrix<BaseFloat> > *state) const;
+  /// Set the multi-stream recurrent state got by GetLstmStreamState,
+  /// the number of rows is the number of streams of the next Feedforward
+  void SetLstmStreamState(const std::vector<CuMatrix<BaseFloat> > &state);
+
+  /// Set chunk size for latency control BLSTM training, and the right
+  /// context frames of every chunk for its streaming forward
+  void SetChunkSize(int chunk_size, int right_context = 0);
+  /// Convert the weights to int8 for the cpu inference: AffineTransform to
+  /// QuantizedAffineTransform, LstmProjectedStreams quantized in place.
+  /// The network is for inference only after it
+  void Quantize();
   /// Initialize MLP from config
   //
   void Init(const std::string &config_file);
@@ -174,6 +209,37 @@ class Nnet {
   void SortComponent(std::vector<Component*> &components);
  private:
    void InitInputOutput();
+  /// Plan the buffers of the Feedforward pass once for the topology: the
+  /// input of a component with a single input is the output of that input,
+  /// the Input/OutputLayer are skipped, the inputs of a component with
+  /// several inputs are written directly into its input buffer when possible,
+  /// and a buffer is reused as soon as nobody reads it any more
+  void PlanFeedforward();
+  /// Run the planned Feedforward on the buffers 'buf', with the components
+  /// modified in place when 'state' is NULL (non-const Feedforward only)
+  void FeedforwardPlanned(const std::vector<const CuMatrixBase<BaseFloat> *> &in,
+        std::vector<CuMatrix<BaseFloat> *> *out,
+        std::vector<CuMatrix<BaseFloat> > *buf, NnetState *state) const;
+
+  /// Columns [offset, offset + cols) of the planned buffer 'buf',
+  /// or of the network input 'input' if buf < 0
+  struct ForwardView {
+    int32 buf, input, offset, cols;
+    ForwardView(): buf(-1), input(0), offset(0), cols(0) {}
+  };
+  /// One step of the Feedforward plan per component
+  struct ForwardStep {
+    bool compute; ///< false for Input/OutputLayer, 'out' is 'in'
+    ForwardView in, out;
+    bool zero_in; ///< zero 'in' and add the copies to it
+    /// Inputs not written directly into 'in', (source, column offset)
+    std::vector<std::pair<ForwardView, int32> > copy;
+    ForwardStep(): compute(true), zero_in(false) {}
+  };
+  /// The first num_frame rows of 'view'
+  static CuSubMatrix<BaseFloat> GetView(const ForwardView &view,
+        const std::vector<const CuMatrixBase<BaseFloat> *> &in,
+        std::vector<CuMatrix<BaseFloat> > *buf, int32 num_frame);
   /// Vector which contains all the components composing the neural network,
   /// the components are for example: AffineTransform, Sigmoid, Softmax
   std::vector<Component*> components_;
@@ -187,11 +253,65 @@ class Nnet {
   std::vector<CuMatrix<BaseFloat> > backpropagate_buf_;  ///< buffers for backward pass
   std::vector<CuMatrix<BaseFloat> > input_buf_, output_buf_,
                                     input_diff_buf_, output_diff_buf_;
+  /// Feedforward plan and the dim of its buffers (see PlanFeedforward)
+  std::vector<ForwardStep> forward_plan_;
+  std::vector<int32> forward_buf_dim_;
+  std::vector<CuMatrix<BaseFloat> > forward_buf_;
 
   /// Option class with hyper-parameters passed to UpdatableComponent(s)
   NnetTrainOptions opts_;
 };
 
+/**
+ * Forward state of one user (thread, decoding stream) of a Nnet shared
+ * read-only: the forward buffers and the state of the components changing
+ * in the forward pass (see Component::NewState), so the weights are kept
+ * only once in memory. The state is bound to the topology of the Nnet
+ * it is created from, which must not be changed after.
+ */
+class NnetState {
+ public:
+  explicit NnetState(const Nnet &nnet);
+  ~NnetState();
+
+  /// Same as Nnet::ResetLstmStreams, on this state
+  void ResetLstmStreams(const std::vector<int32> &stream_reset_flag);
+  /// Same as Nnet::SetSeqLengths, on this state
+  void SetSeqLengths(const std::vector<int32> &sequence_lengths);
+
+ private:
+  friend class Nnet;
+  /// One per component, NULL for the read-only components
+  std::vector<ComponentState*> component_state_;
+  /// Buffers of the planned Feedforward
+  std::vector<CuMatrix<BaseFloat> > forward_buf_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetState);
+};
+
+/**
+ * Streaming forward state of one stream on a Nnet shared read-only, see
+ * Nnet::FeedforwardChunk. It's ready for a new stream after the last chunk.
+ */
+class NnetStreamState {
+ public:
+  explicit NnetStreamState(const Nnet &nnet);
+  ~NnetStreamState();
+
+ private:
+  friend class Nnet;
+  /// One per component (Component::InitStreamState), NULL for the frame by
+  /// frame components
+  std::vector<ComponentState*> component_state_;
+  /// Output frames of every component in the current chunk
+  std::vector<CuMatrix<BaseFloat> > output_;
+  /// Input frames not consumed yet of the components with several inputs,
+  /// when the inputs lag differently
+  std::vector<std::vector<CuMatrix<BaseFloat> > > pending_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetStreamState);
+};
+
 }  // namespace aslp_nnet
 }  // namespace kaldi
 
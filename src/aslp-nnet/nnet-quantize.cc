@@ -0,0 +1,234 @@
+// aslp-nnet/nnet-quantize.cc
+
+// Copyright 2016  ASLP (Author: zhangbinbin liwenpeng duwei)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "aslp-nnet/nnet-quantize.h"
+#include "aslp-nnet/nnet-utils.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+// The rows are padded to a multiple of it, so the kernels have no tail
+static const int32 kQuantizeAlign = 32;
+
+static inline int32 QuantizeStride(int32 num_cols) {
+  return (num_cols + kQuantizeAlign - 1) / kQuantizeAlign * kQuantizeAlign;
+}
+
+// Number of input rows multiplied with one weight row at a time, so the
+// weights are read from memory once every kRowBlock input rows
+static const int32 kRowBlock = 4;
+
+// Quantize x[0, n) to q[0, n) with the scale max|x|/127 and zero the
+// padding q[n, stride), returns the scale
+template<typename IntType>
+static BaseFloat QuantizeRow(const BaseFloat *x, int32 n, int32 stride,
+                             IntType *q) {
+  BaseFloat max_abs = 0.0;
+  for (int32 i = 0; i < n; i++) {
+    max_abs = std::max(max_abs, std::abs(x[i]));
+  }
+  if (max_abs == 0.0) {
+    memset(q, 0, stride * sizeof(IntType));
+    return 0.0;
+  }
+  BaseFloat inv_scale = 127.0 / max_abs;
+  for (int32 i = 0; i < n; i++) {
+    BaseFloat v = x[i] * inv_scale;
+    q[i] = static_cast<IntType>(v >= 0 ? v + 0.5 : v - 0.5);
+  }
+  memset(q + n, 0, (stride - n) * sizeof(IntType));
+  return max_abs / 127.0;
+}
+
+// Dot products of the kRows input rows a (int16 in [-127, 127], row
+// stride n) with the int8 weight row b, n is a multiple of kQuantizeAlign
+template<int32 kRows>
+static inline void DotRows(const int16_t *a, const int8_t *b, int32 n,
+                           int32 *out) {
+#if defined(__AVX2__)
+  __m256i sum[kRows];
+  for (int32 k = 0; k < kRows; k++) sum[k] = _mm256_setzero_si256();
+  for (int32 i = 0; i < n; i += 32) {
+    // sign extend the weights to int16 once for all the input rows
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    __m256i b_lo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(vb)),
+            b_hi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(vb, 1));
+    for (int32 k = 0; k < kRows; k++) {
+      const int16_t *a_k = a + k * n + i;
+      // multiply and add the pairs to int32
+      sum[k] = _mm256_add_epi32(sum[k], _mm256_madd_epi16(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_k)), b_lo));
+      sum[k] = _mm256_add_epi32(sum[k], _mm256_madd_epi16(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_k + 16)), b_hi));
+    }
+  }
+  for (int32 k = 0; k < kRows; k++) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum[k]),
+                              _mm256_extracti128_si256(sum[k], 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    out[k] = _mm_cvtsi128_si32(s);
+  }
+#elif defined(__SSE2__)
+  __m128i sum[kRows], zero = _mm_setzero_si128();
+  for (int32 k = 0; k < kRows; k++) sum[k] = _mm_setzero_si128();
+  for (int32 i = 0; i < n; i += 16) {
+    // sign extend the weights to int16 by interleaving with the sign bytes
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    __m128i sb = _mm_cmpgt_epi8(zero, vb);
+    __m128i b_lo = _mm_unpacklo_epi8(vb, sb), b_hi = _mm_unpackhi_epi8(vb, sb);
+    for (int32 k = 0; k < kRows; k++) {
+      const int16_t *a_k = a + k * n + i;
+      sum[k] = _mm_add_epi32(sum[k], _mm_madd_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(a_k)), b_lo));
+      sum[k] = _mm_add_epi32(sum[k], _mm_madd_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(a_k + 8)), b_hi));
+    }
+  }
+  for (int32 k = 0; k < kRows; k++) {
+    __m128i s = sum[k];
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    out[k] = _mm_cvtsi128_si32(s);
+  }
+#else
+  for (int32 k = 0; k < kRows; k++) {
+    const int16_t *a_k = a + k * n;
+    int32 sum = 0;
+    for (int32 i = 0; i < n; i++) {
+      sum += static_cast<int32>(a_k[i]) * static_cast<int32>(b[i]);
+    }
+    out[k] = sum;
+  }
+#endif
+}
+
+void QuantizedMatrix::Quantize(const CuMatrixBase<BaseFloat> &mat) {
+  Matrix<BaseFloat> host(mat);
+  num_rows_ = host.NumRows();
+  num_cols_ = host.NumCols();
+  stride_ = QuantizeStride(num_cols_);
+  scale_.Resize(num_rows_);
+  data_.resize(num_rows_ * stride_);
+  for (int32 r = 0; r < num_rows_; r++) {
+    scale_(r) = QuantizeRow(host.RowData(r), num_cols_, stride_,
+                            &data_[r * stride_]);
+  }
+}
+
+void QuantizedMatrix::GetMatrix(Matrix<BaseFloat> *mat) const {
+  mat->Resize(num_rows_, num_cols_, kUndefined);
+  for (int32 r = 0; r < num_rows_; r++) {
+    for (int32 c = 0; c < num_cols_; c++) {
+      (*mat)(r, c) = scale_(r) * data_[r * stride_ + c];
+    }
+  }
+}
+
+void QuantizedMatrix::AddMatMatTrans(BaseFloat alpha,
+                                     const MatrixBase<BaseFloat> &in,
+                                     BaseFloat beta,
+                                     MatrixBase<BaseFloat> *out) const {
+  KALDI_ASSERT(in.NumCols() == num_cols_);
+  KALDI_ASSERT(out->NumRows() == in.NumRows());
+  KALDI_ASSERT(out->NumCols() == num_rows_);
+  int32 num_in = in.NumRows();
+  if (num_in == 0) return;
+  // the input quantized row by row, kept in int16 to skip the sign
+  // extension in the kernel. The buffer is local as the matrix may be
+  // shared by several threads
+  std::vector<int16_t> q_in(num_in * stride_);
+  std::vector<BaseFloat> in_scale(num_in);
+  for (int32 r = 0; r < num_in; r++) {
+    in_scale[r] = QuantizeRow(in.RowData(r), num_cols_, stride_,
+                              &q_in[r * stride_]);
+  }
+  int32 dot[kRowBlock];
+  for (int32 r0 = 0; r0 < num_in; ) {
+    // whole blocks, then the left rows one by one
+    int32 num_rows = (num_in - r0 >= kRowBlock ? kRowBlock : 1);
+    const int16_t *a = &q_in[r0 * stride_];
+    for (int32 i = 0; i < num_rows_; i++) {
+      if (num_rows == kRowBlock) {
+        DotRows<kRowBlock>(a, &data_[i * stride_], stride_, dot);
+      } else {
+        DotRows<1>(a, &data_[i * stride_], stride_, dot);
+      }
+      BaseFloat w_scale = alpha * scale_(i);
+      for (int32 k = 0; k < num_rows; k++) {
+        BaseFloat v = w_scale * in_scale[r0 + k] * dot[k];
+        BaseFloat *o = out->RowData(r0 + k) + i;
+        *o = (beta == 0.0 ? v : beta * (*o) + v);
+      }
+    }
+    r0 += num_rows;
+  }
+}
+
+void QuantizedMatrix::AddMatMatTrans(BaseFloat alpha,
+                                     const CuMatrixBase<BaseFloat> &in,
+                                     BaseFloat beta,
+                                     CuMatrixBase<BaseFloat> *out) const {
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    Matrix<BaseFloat> in_host(in), out_host(*out);
+    AddMatMatTrans(alpha, in_host, beta, &out_host);
+    out->CopyFromMat(out_host);
+    return;
+  }
+#endif
+  AddMatMatTrans(alpha, in.Mat(), beta, &(out->Mat()));
+}
+
+void QuantizedMatrix::Read(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<QuantizedMatrix>");
+  ReadBasicType(is, binary, &num_rows_);
+  ReadBasicType(is, binary, &num_cols_);
+  scale_.Read(is, binary);
+  ReadIntegerVector(is, binary, &data_);
+  stride_ = QuantizeStride(num_cols_);
+  if (scale_.Dim() != num_rows_ || data_.size() != num_rows_ * stride_) {
+    KALDI_ERR << "Corrupted quantized matrix " << num_rows_ << "x"
+              << num_cols_;
+  }
+}
+
+void QuantizedMatrix::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<QuantizedMatrix>");
+  WriteBasicType(os, binary, num_rows_);
+  WriteBasicType(os, binary, num_cols_);
+  scale_.Write(os, binary);
+  WriteIntegerVector(os, binary, data_);
+}
+
+std::string QuantizedMatrix::Info() const {
+  return std::string("int8 ") + ToString(num_rows_) + "x" +
+         ToString(num_cols_) + ", row scale" + MomentStatistics(scale_);
+}
+
+} // namespace aslp_nnet
+} // namespace kaldi
@@ -0,0 +1,78 @@
+// aslp-nnet/nnet-quantize.h
+
+// Copyright 2016  ASLP (Author: zhangbinbin liwenpeng duwei)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ASLP_NNET_NNET_QUANTIZE_H_
+#define ASLP_NNET_NNET_QUANTIZE_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+#include "aslp-cudamatrix/cu-matrix.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+/**
+ * Int8 weight matrix for the cpu inference, every row is quantized with
+ * its own scale max|w|/127. The input of a product is quantized row by row
+ * on the fly the same way, so the product is an int8 dot product (SSE2 or
+ * AVX2 when compiled with -mavx2) scaled back to float.
+ */
+class QuantizedMatrix {
+ public:
+  QuantizedMatrix(): num_rows_(0), num_cols_(0), stride_(0) { }
+
+  /// Quantize the float matrix
+  void Quantize(const CuMatrixBase<BaseFloat> &mat);
+  /// Back to float, for checking
+  void GetMatrix(Matrix<BaseFloat> *mat) const;
+
+  int32 NumRows() const { return num_rows_; }
+  int32 NumCols() const { return num_cols_; }
+  bool IsEmpty() const { return num_rows_ == 0; }
+
+  /// out = alpha * in * this^T + beta * out, same as
+  /// out->AddMatMat(alpha, in, kNoTrans, mat, kTrans, beta) on the float
+  /// matrix, runs on cpu (the data is copied if a gpu is used)
+  void AddMatMatTrans(BaseFloat alpha, const CuMatrixBase<BaseFloat> &in,
+                      BaseFloat beta, CuMatrixBase<BaseFloat> *out) const;
+  void AddMatMatTrans(BaseFloat alpha, const MatrixBase<BaseFloat> &in,
+                      BaseFloat beta, MatrixBase<BaseFloat> *out) const;
+
+  void Read(std::istream &is, bool binary);
+  void Write(std::ostream &os, bool binary) const;
+
+  std::string Info() const;
+
+ private:
+  int32 num_rows_, num_cols_;
+  /// Row stride of data_, the rows are padded with zeros
+  int32 stride_;
+  /// Per row scale
+  Vector<BaseFloat> scale_;
+  std::vector<int8_t> data_;
+};
+
+} // namespace aslp_nnet
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,105 @@
+// aslp-nnet/nnet-quantized-affine-transform.h
+
+// Copyright 2016  ASLP (Author: zhangbinbin liwenpeng duwei)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ASLP_NNET_NNET_QUANTIZED_AFFINE_TRANSFORM_H_
+#define ASLP_NNET_NNET_QUANTIZED_AFFINE_TRANSFORM_H_
+
+#include "aslp-nnet/nnet-component.h"
+#include "aslp-nnet/nnet-affine-transform.h"
+#include "aslp-nnet/nnet-quantize.h"
+#include "aslp-nnet/nnet-utils.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+/**
+ * Inference only AffineTransform with int8 weights (see QuantizedMatrix),
+ * converted from a trained AffineTransform by Nnet::Quantize.
+ */
+class QuantizedAffineTransform : public Component {
+ public:
+  QuantizedAffineTransform(int32 dim_in, int32 dim_out)
+    : Component(dim_in, dim_out), bias_(dim_out)
+  { }
+  explicit QuantizedAffineTransform(const AffineTransform &affine)
+    : Component(affine.InputDim(), affine.OutputDim()),
+      bias_(affine.GetBias())
+  {
+    linearity_.Quantize(affine.GetLinearity());
+  }
+  ~QuantizedAffineTransform()
+  { }
+
+  Component* Copy() const { return new QuantizedAffineTransform(*this); }
+  ComponentType GetType() const { return kQuantizedAffineTransform; }
+
+  void InitData(std::istream &is) {
+    KALDI_ERR << "Can't initialize " << TypeToMarker(GetType())
+              << " from prototype, quantize a trained model instead";
+  }
+
+  void ReadData(std::istream &is, bool binary) {
+    linearity_.Read(is, binary);
+    bias_.Read(is, binary);
+
+    KALDI_ASSERT(linearity_.NumRows() == output_dim_);
+    KALDI_ASSERT(linearity_.NumCols() == input_dim_);
+    KALDI_ASSERT(bias_.Dim() == output_dim_);
+  }
+
+  void WriteData(std::ostream &os, bool binary) const {
+    linearity_.Write(os, binary);
+    bias_.Write(os, binary);
+  }
+
+  std::string Info() const {
+    return std::string("\n  linearity ") + linearity_.Info() +
+           "\n  bias" + MomentStatistics(bias_);
+  }
+
+  void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
+    // precopy bias
+    out->AddVecToRows(1.0, bias_, 0.0);
+    // multiply by weights^t
+    linearity_.AddMatMatTrans(1.0, in, 1.0, out);
+  }
+
+  void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
+                        const CuMatrixBase<BaseFloat> &out_diff, CuMatrixBase<BaseFloat> *in_diff) {
+    KALDI_ERR << TypeToMarker(GetType()) << " is for inference only";
+  }
+
+  const QuantizedMatrix& GetLinearity() const {
+    return linearity_;
+  }
+
+  const CuVectorBase<BaseFloat>& GetBias() const {
+    return bias_;
+  }
+
+ private:
+  QuantizedMatrix linearity_;
+  CuVector<BaseFloat> bias_;
+};
+
+} // namespace aslp_nnet
+} // namespace kaldi
+
+#endif
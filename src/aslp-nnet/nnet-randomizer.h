@@ -35,15 +35,18 @@ struct NnetDataRandomizerOptions {
   int32 randomizer_size; // Maximum number of samples we want to have in memory at once.
   int32 randomizer_seed;
   int32 minibatch_size;  // Size of a single mini-batch.
+  int32 prefetch_caches; // Randomizer fills read ahead in background (FrameDataReader).
 
   NnetDataRandomizerOptions()
-   : randomizer_size(32768), randomizer_seed(777), minibatch_size(256) 
+   : randomizer_size(32768), randomizer_seed(777), minibatch_size(256),
+     prefetch_caches(1)
   { }
 
   void Register(OptionsItf *opts) {
     opts->Register("randomizer-size", &randomizer_size, "Capacity of randomizer, length of concatenated utterances which are used for frame-level shuffling (in frames, affects memory consumption, max 8000000).");
     opts->Register("randomizer-seed", &randomizer_seed, "Seed value for srand, sets fixed order of frame-level shuffling");
     opts->Register("minibatch-size", &minibatch_size, "Size of a minibatch.");
+    opts->Register("prefetch-caches", &prefetch_caches, "Number of randomizer fills read ahead by a background thread, each holds about --randomizer-size frames on host (0 = read on the training thread, only used by the FrameDataReader tools)");
   }
 };
 ///
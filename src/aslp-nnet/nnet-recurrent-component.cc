@@ -232,6 +232,16 @@ void Lstm::SetSeqLengths(const std::vector<int32> &sequence_lengths) {
     prev_nnet_state_.Resize(nstream_, 7*ncell_, kSetZero);
 }
 
+void Lstm::GetStreamState(CuMatrix<BaseFloat> *state) const {
+    *state = prev_nnet_state_;
+}
+
+void Lstm::SetStreamState(const CuMatrixBase<BaseFloat> &state) {
+    KALDI_ASSERT(state.NumCols() == 7*ncell_);
+    nstream_ = state.NumRows();
+    prev_nnet_state_ = state;
+}
+
 void Lstm::PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
     static bool do_stream_reset = false;
     if (nstream_ == 0) {
@@ -243,24 +253,44 @@ void Lstm::PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloa
     if (do_stream_reset) prev_nnet_state_.SetZero();
     KALDI_ASSERT(nstream_ > 0);
 
-    KALDI_ASSERT(in.NumRows() % nstream_ == 0);
-    int32 T = in.NumRows() / nstream_;
-    int32 S = nstream_;
+    PropagateStreams(in, out, nstream_, &prev_nnet_state_, &propagate_buf_);
+}
+
+ComponentState* Lstm::NewState() const {
+    return new StreamsState(7*ncell_);
+}
+
+void Lstm::FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in,
+                               CuMatrixBase<BaseFloat> *out,
+                               ComponentState *state) const {
+    StreamsState *s = dynamic_cast<StreamsState*>(state);
+    KALDI_ASSERT(s != NULL);
+    PropagateStreams(in, out, s->NumStreams(), &s->prev_nnet_state,
+                     &s->propagate_buf);
+}
+
+void Lstm::PropagateStreams(const CuMatrixBase<BaseFloat> &in,
+                            CuMatrixBase<BaseFloat> *out, int32 nstream,
+                            CuMatrix<BaseFloat> *prev_nnet_state,
+                            CuMatrix<BaseFloat> *propagate_buf) const {
+    KALDI_ASSERT(in.NumRows() % nstream == 0);
+    int32 T = in.NumRows() / nstream;
+    int32 S = nstream;
 
     // 0:forward pass history, [1, T]:current sequence, T+1:dummy
-    propagate_buf_.Resize((T+2)*S, 7 * ncell_, kSetZero);
-    propagate_buf_.RowRange(0*S,S).CopyFromMat(prev_nnet_state_);
+    propagate_buf->Resize((T+2)*S, 7 * ncell_, kSetZero);
+    propagate_buf->RowRange(0*S,S).CopyFromMat(*prev_nnet_state);
 
     // disassemble entire neuron activation buffer into different neurons
-    CuSubMatrix<BaseFloat> YG(propagate_buf_.ColRange(0*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YI(propagate_buf_.ColRange(1*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YF(propagate_buf_.ColRange(2*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YO(propagate_buf_.ColRange(3*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YC(propagate_buf_.ColRange(4*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YH(propagate_buf_.ColRange(5*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YM(propagate_buf_.ColRange(6*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YG(propagate_buf->ColRange(0*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YI(propagate_buf->ColRange(1*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YF(propagate_buf->ColRange(2*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YO(propagate_buf->ColRange(3*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YC(propagate_buf->ColRange(4*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YH(propagate_buf->ColRange(5*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YM(propagate_buf->ColRange(6*ncell_, ncell_));
 
-    CuSubMatrix<BaseFloat> YGIFO(propagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> YGIFO(propagate_buf->ColRange(0, 4*ncell_));
 
     // x -> g, i, f, o, not recurrent, do it all in once
     YGIFO.RowRange(1*S,T*S).AddMatMat(1.0, in, kNoTrans, w_gifo_x_, kTrans, 0.0);
@@ -280,58 +310,23 @@ void Lstm::PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloa
 
     for (int t = 1; t <= T; t++) {
         // multistream buffers for current time-step
-        CuSubMatrix<BaseFloat> y_g(YG.RowRange(t*S,S));
-        CuSubMatrix<BaseFloat> y_i(YI.RowRange(t*S,S));
-        CuSubMatrix<BaseFloat> y_f(YF.RowRange(t*S,S));
-        CuSubMatrix<BaseFloat> y_o(YO.RowRange(t*S,S));
-        CuSubMatrix<BaseFloat> y_c(YC.RowRange(t*S,S));
-        CuSubMatrix<BaseFloat> y_h(YH.RowRange(t*S,S));
-        CuSubMatrix<BaseFloat> y_m(YM.RowRange(t*S,S));
+        CuSubMatrix<BaseFloat> y_all(propagate_buf->RowRange(t*S,S));
 
         CuSubMatrix<BaseFloat> y_gifo(YGIFO.RowRange(t*S,S));
 
         // r(t-1) -> g, i, f, o
         y_gifo.AddMatMat(1.0, YM.RowRange((t-1)*S,S), kNoTrans, w_gifo_r_, kTrans,  1.0);
 
-        // c(t-1) -> i(t) via peephole
-        y_i.AddMatDiagVec(1.0, YC.RowRange((t-1)*S,S), kNoTrans, peephole_i_c_, 1.0);
-
-        // c(t-1) -> f(t) via peephole
-        y_f.AddMatDiagVec(1.0, YC.RowRange((t-1)*S,S), kNoTrans, peephole_f_c_, 1.0);
-
-        // i, f sigmoid squashing
-        y_i.Sigmoid(y_i);
-        y_f.Sigmoid(y_f);
-
-        // g tanh squashing
-        y_g.Tanh(y_g);
-
-        // g -> c
-        y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-        // c(t-1) -> c(t) via forget-gate
-        y_c.AddMatMatElements(1.0, YC.RowRange((t-1)*S,S), y_f, 1.0);
-
-        y_c.ApplyFloor(-50);   // optional clipping of cell activation
-        y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-        // h tanh squashing
-        y_h.Tanh(y_c);
-
-        // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-        y_o.AddMatDiagVec(1.0, y_c, kNoTrans, peephole_o_c_, 1.0);
-
-        // o sigmoid squashing
-        y_o.Sigmoid(y_o);
-
-        // h -> m via output gate
-        y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+        // c(t-1) -> i, f, o via peepholes, squashing, clipped c, h and m,
+        // fused in one pass over the streams
+        cu::LstmCellForward(YC.RowRange((t-1)*S,S), peephole_i_c_, peephole_f_c_,
+                            peephole_o_c_, BaseFloat(50), &y_all);
     }
 
     out->CopyFromMat(YM.RowRange(1*S,T*S));
 
     // now the last frame state becomes previous network state for next batch
-    prev_nnet_state_.CopyFromMat(propagate_buf_.RowRange(T*S,S));
+    prev_nnet_state->CopyFromMat(propagate_buf->RowRange(T*S,S));
 }
 
 void Lstm::BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
@@ -911,38 +906,59 @@ std::string BLstm::InfoGradient() const {
 
 void BLstm::PropagateFnc(const CuMatrixBase<BaseFloat> &in, 
                   CuMatrixBase<BaseFloat> *out) {
-    int32 nstream_ = sequence_lengths_.size();
-    KALDI_ASSERT(in.NumRows() % nstream_ == 0);
-    int32 T = in.NumRows() / nstream_;
-    int32 S = nstream_;
+    PropagateStreams(in, out, sequence_lengths_, &f_propagate_buf_, &b_propagate_buf_);
+}
+
+ComponentState* BLstm::NewState() const {
+    return new StreamsState(7*ncell_);
+}
+
+void BLstm::FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in,
+                                CuMatrixBase<BaseFloat> *out,
+                                ComponentState *state) const {
+    StreamsState *s = dynamic_cast<StreamsState*>(state);
+    KALDI_ASSERT(s != NULL);
+    PropagateStreams(in, out, s->SeqLengths(in.NumRows()),
+                     &s->propagate_buf, &s->b_propagate_buf);
+}
+
+void BLstm::PropagateStreams(const CuMatrixBase<BaseFloat> &in,
+                             CuMatrixBase<BaseFloat> *out,
+                             const std::vector<int32> &sequence_lengths,
+                             CuMatrix<BaseFloat> *f_propagate_buf,
+                             CuMatrix<BaseFloat> *b_propagate_buf) const {
+    int32 nstream = sequence_lengths.size();
+    KALDI_ASSERT(in.NumRows() % nstream == 0);
+    int32 T = in.NumRows() / nstream;
+    int32 S = nstream;
 
     // 0:forward pass history, [1, T]:current sequence, T+1:dummy
     // forward direction
-    f_propagate_buf_.Resize((T+2)*S, 7 * ncell_, kSetZero);
+    f_propagate_buf->Resize((T+2)*S, 7 * ncell_, kSetZero);
     // backward direction
-    b_propagate_buf_.Resize((T+2)*S, 7 * ncell_, kSetZero);
+    b_propagate_buf->Resize((T+2)*S, 7 * ncell_, kSetZero);
 
     // disassembling forward-pass forward-propagation buffer into different neurons,
-    CuSubMatrix<BaseFloat> F_YG(f_propagate_buf_.ColRange(0*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YI(f_propagate_buf_.ColRange(1*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YF(f_propagate_buf_.ColRange(2*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YO(f_propagate_buf_.ColRange(3*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YC(f_propagate_buf_.ColRange(4*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YH(f_propagate_buf_.ColRange(5*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> F_YM(f_propagate_buf_.ColRange(6*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YG(f_propagate_buf->ColRange(0*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YI(f_propagate_buf->ColRange(1*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YF(f_propagate_buf->ColRange(2*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YO(f_propagate_buf->ColRange(3*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YC(f_propagate_buf->ColRange(4*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YH(f_propagate_buf->ColRange(5*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> F_YM(f_propagate_buf->ColRange(6*ncell_, ncell_));
 
-    CuSubMatrix<BaseFloat> F_YGIFO(f_propagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> F_YGIFO(f_propagate_buf->ColRange(0, 4*ncell_));
 
     // disassembling backward-pass forward-propagation buffer into different neurons,
-    CuSubMatrix<BaseFloat> B_YG(b_propagate_buf_.ColRange(0*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YI(b_propagate_buf_.ColRange(1*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YF(b_propagate_buf_.ColRange(2*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YO(b_propagate_buf_.ColRange(3*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YC(b_propagate_buf_.ColRange(4*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YH(b_propagate_buf_.ColRange(5*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> B_YM(b_propagate_buf_.ColRange(6*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YG(b_propagate_buf->ColRange(0*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YI(b_propagate_buf->ColRange(1*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YF(b_propagate_buf->ColRange(2*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YO(b_propagate_buf->ColRange(3*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YC(b_propagate_buf->ColRange(4*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YH(b_propagate_buf->ColRange(5*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> B_YM(b_propagate_buf->ColRange(6*ncell_, ncell_));
 
-    CuSubMatrix<BaseFloat> B_YGIFO(b_propagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> B_YGIFO(b_propagate_buf->ColRange(0, 4*ncell_));
 
     // forward direction
     // x -> g, i, f, o, not recurrent, do it all in once
@@ -953,57 +969,21 @@ void BLstm::PropagateFnc(const CuMatrixBase<BaseFloat> &in,
 
     for (int t = 1; t <= T; t++) {
         // multistream buffers for current time-step
-        CuSubMatrix<BaseFloat> y_all(f_propagate_buf_.RowRange(t*S, S));
-        CuSubMatrix<BaseFloat> y_g(F_YG.RowRange(t*S, S));
-        CuSubMatrix<BaseFloat> y_i(F_YI.RowRange(t*S, S));
-        CuSubMatrix<BaseFloat> y_f(F_YF.RowRange(t*S, S));
-        CuSubMatrix<BaseFloat> y_o(F_YO.RowRange(t*S, S));
-        CuSubMatrix<BaseFloat> y_c(F_YC.RowRange(t*S, S));
-        CuSubMatrix<BaseFloat> y_h(F_YH.RowRange(t*S, S));
-        CuSubMatrix<BaseFloat> y_m(F_YM.RowRange(t*S, S));
+        CuSubMatrix<BaseFloat> y_all(f_propagate_buf->RowRange(t*S, S));
 
         CuSubMatrix<BaseFloat> y_gifo(F_YGIFO.RowRange(t*S, S));
 
         // r(t-1) -> g, i, f, o
         y_gifo.AddMatMat(1.0, F_YM.RowRange((t-1)*S, S), kNoTrans, f_w_gifo_r_, kTrans, 1.0);
 
-        // c(t-1) -> i(t) via peephole
-        y_i.AddMatDiagVec(1.0, F_YC.RowRange((t-1)*S, S), kNoTrans, f_peephole_i_c_, 1.0);
-
-        // c(t-1) -> f(t) via peephole
-        y_f.AddMatDiagVec(1.0, F_YC.RowRange((t-1)*S, S), kNoTrans, f_peephole_f_c_, 1.0);
-
-        // i, f sigmoid squashing
-        y_i.Sigmoid(y_i);
-        y_f.Sigmoid(y_f);
-
-        // g tanh squashing
-        y_g.Tanh(y_g);
-
-        // g -> c
-        y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-        // c(t-1) -> c(t) via forget-gate
-        y_c.AddMatMatElements(1.0, F_YC.RowRange((t-1)*S, S), y_f, 1.0);
-
-        y_c.ApplyFloor(-50);   // optional clipping of cell activation
-        y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-        // h tanh squashing
-        y_h.Tanh(y_c);
-
-        // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-        y_o.AddMatDiagVec(1.0, y_c, kNoTrans, f_peephole_o_c_, 1.0);
-
-        // o sigmoid squashing
-        y_o.Sigmoid(y_o);
-
-        // h -> m via output gate
-        y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+        // c(t-1) -> i, f, o via peepholes, squashing, clipped c, h and m,
+        // fused in one pass over the streams
+        cu::LstmCellForward(F_YC.RowRange((t-1)*S, S), f_peephole_i_c_, f_peephole_f_c_,
+                            f_peephole_o_c_, BaseFloat(50), &y_all);
 
         // set zeros
         // for (int s = 0; s < S; s++) {
-        //   if (t > sequence_lengths_[s])
+        //   if (t > sequence_lengths[s])
         //     y_all.Row(s).SetZero();
         // }
     }
@@ -1027,55 +1007,19 @@ void BLstm::PropagateFnc(const CuMatrixBase<BaseFloat> &in,
     // backward direction, from T to 1, t--
     for (int t = T; t >= 1; t--) {
         // multistream buffers for current time-step
-        CuSubMatrix<BaseFloat> y_all(b_propagate_buf_.RowRange(t*S, S));
-        CuSubMatrix<BaseFloat> y_g(B_YG.RowRange(t*S, S));
-        CuSubMatrix<BaseFloat> y_i(B_YI.RowRange(t*S, S));
-        CuSubMatrix<BaseFloat> y_f(B_YF.RowRange(t*S, S));
-        CuSubMatrix<BaseFloat> y_o(B_YO.RowRange(t*S, S));
-        CuSubMatrix<BaseFloat> y_c(B_YC.RowRange(t*S, S));
-        CuSubMatrix<BaseFloat> y_h(B_YH.RowRange(t*S, S));
-        CuSubMatrix<BaseFloat> y_m(B_YM.RowRange(t*S, S));
+        CuSubMatrix<BaseFloat> y_all(b_propagate_buf->RowRange(t*S, S));
         CuSubMatrix<BaseFloat> y_gifo(B_YGIFO.RowRange(t*S, S));
 
         // r(t+1) -> g, i, f, o
         y_gifo.AddMatMat(1.0, B_YM.RowRange((t+1)*S, S), kNoTrans, b_w_gifo_r_, kTrans, 1.0);
 
-        // c(t+1) -> i(t) via peephole
-        y_i.AddMatDiagVec(1.0, B_YC.RowRange((t+1)*S, S), kNoTrans, b_peephole_i_c_, 1.0);
-
-        // c(t+1) -> f(t) via peephole
-        y_f.AddMatDiagVec(1.0, B_YC.RowRange((t+1)*S, S), kNoTrans, b_peephole_f_c_, 1.0);
-
-        // i, f sigmoid squashing
-        y_i.Sigmoid(y_i);
-        y_f.Sigmoid(y_f);
-
-        // g tanh squashing
-        y_g.Tanh(y_g);
-
-        // g -> c
-        y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-        // c(t+1) -> c(t) via forget-gate
-        y_c.AddMatMatElements(1.0, B_YC.RowRange((t+1)*S, S), y_f, 1.0);
-
-        y_c.ApplyFloor(-50);   // optional clipping of cell activation
-        y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-        // h tanh squashing
-        y_h.Tanh(y_c);
-
-        // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-        y_o.AddMatDiagVec(1.0, y_c, kNoTrans, b_peephole_o_c_, 1.0);
-
-        // o sigmoid squashing
-        y_o.Sigmoid(y_o);
-
-        // h -> m via output gate
-        y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+        // c(t+1) -> i, f, o via peepholes, squashing, clipped c, h and m,
+        // fused in one pass over the streams
+        cu::LstmCellForward(B_YC.RowRange((t+1)*S, S), b_peephole_i_c_, b_peephole_f_c_,
+                            b_peephole_o_c_, BaseFloat(50), &y_all);
 
         for (int s = 0; s < S; s++) {
-            if (t > sequence_lengths_[s])
+            if (t > sequence_lengths[s])
                 y_all.Row(s).SetZero();
         }
     }
@@ -1083,9 +1027,9 @@ void BLstm::PropagateFnc(const CuMatrixBase<BaseFloat> &in,
     CuMatrix<BaseFloat> YM_FB;
     YM_FB.Resize((T+2)*S, 2 * ncell_, kSetZero);
     // forward part
-    YM_FB.ColRange(0, ncell_).CopyFromMat(f_propagate_buf_.ColRange(6*ncell_, ncell_));
+    YM_FB.ColRange(0, ncell_).CopyFromMat(f_propagate_buf->ColRange(6*ncell_, ncell_));
     // backward part
-    YM_FB.ColRange(ncell_, ncell_).CopyFromMat(b_propagate_buf_.ColRange(6*ncell_, ncell_));
+    YM_FB.ColRange(ncell_, ncell_).CopyFromMat(b_propagate_buf->ColRange(6*ncell_, ncell_));
     // recurrent projection layer is also feed-forward as BLSTM output
     out->CopyFromMat(YM_FB.RowRange(1*S, T*S));
 }
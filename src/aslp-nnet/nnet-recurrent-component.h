@@ -51,8 +51,21 @@ public:
     void ResetLstmStreams(const std::vector<int32> &stream_reset_flag); 
     // For compatible with whole sentence train(like ctc train or lstm who sentence train
     void SetSeqLengths(const std::vector<int32> &sequence_lengths); 
+    // Recurrent state of all the streams, one row per stream
+    void GetStreamState(CuMatrix<BaseFloat> *state) const;
+    void SetStreamState(const CuMatrixBase<BaseFloat> &state);
     void PropagateFnc(const CuMatrixBase<BaseFloat> &in, 
                       CuMatrixBase<BaseFloat> *out); 
+    ComponentState* NewState() const;
+    void FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in,
+                             CuMatrixBase<BaseFloat> *out,
+                             ComponentState *state) const;
+    // Forward nstream streams starting from *prev_nnet_state, which then
+    // holds the state of the last frame, the weights are not touched
+    void PropagateStreams(const CuMatrixBase<BaseFloat> &in,
+                          CuMatrixBase<BaseFloat> *out, int32 nstream,
+                          CuMatrix<BaseFloat> *prev_nnet_state,
+                          CuMatrix<BaseFloat> *propagate_buf) const;
     void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, 
                           const CuMatrixBase<BaseFloat> &out,
                           const CuMatrixBase<BaseFloat> &out_diff, 
@@ -135,6 +148,16 @@ public:
     std::string InfoGradient() const; 
     void PropagateFnc(const CuMatrixBase<BaseFloat> &in, 
                       CuMatrixBase<BaseFloat> *out); 
+    ComponentState* NewState() const;
+    void FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in,
+                             CuMatrixBase<BaseFloat> *out,
+                             ComponentState *state) const;
+    // Forward the sequences of the given lengths, the weights are not touched
+    void PropagateStreams(const CuMatrixBase<BaseFloat> &in,
+                          CuMatrixBase<BaseFloat> *out,
+                          const std::vector<int32> &sequence_lengths,
+                          CuMatrix<BaseFloat> *f_propagate_buf,
+                          CuMatrix<BaseFloat> *b_propagate_buf) const;
     void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, 
                           const CuMatrixBase<BaseFloat> &out,
                           const CuMatrixBase<BaseFloat> &out_diff, 
@@ -89,30 +89,77 @@ std::string RowConvolution::InfoGradient() const {
 
 void RowConvolution::PropagateFnc(const CuMatrixBase<BaseFloat> &in, 
                                   CuMatrixBase<BaseFloat> *out) {
-    int32 nstream_ = sequence_lengths_.size();
-    KALDI_ASSERT(in.NumRows() % nstream_ == 0);
-    int32 T = in.NumRows() / nstream_;
-    int32 S = nstream_;    
+    PropagateStreams(in, out, sequence_lengths_, &in_buf_, &conv_buf_);
+}
+
+ComponentState* RowConvolution::NewState() const {
+    return new StreamsState(0);
+}
+
+void RowConvolution::FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in,
+                                         CuMatrixBase<BaseFloat> *out,
+                                         ComponentState *state) const {
+    StreamsState *s = dynamic_cast<StreamsState*>(state);
+    KALDI_ASSERT(s != NULL);
+    CuMatrix<BaseFloat> conv_buf(input_dim_, input_dim_);
+    PropagateStreams(in, out, s->SeqLengths(in.NumRows()),
+                     &s->propagate_buf, &conv_buf);
+}
+
+ComponentState* RowConvolution::InitStreamState() const {
+    return new ContextState();
+}
+
+void RowConvolution::FeedforwardChunkFnc(const CuMatrixBase<BaseFloat> &in,
+                                         bool last, CuMatrix<BaseFloat> *out,
+                                         ComponentState *state) const {
+    ContextState *s = dynamic_cast<ContextState*>(state);
+    KALDI_ASSERT(s != NULL);
+    // The future frames after the end are the last frame, as PropagateStreams
+    CuMatrix<BaseFloat> window;
+    int32 T = s->NextWindow(in, last, 0, future_ctx_, true, &window);
+    if (T == 0) {
+        out->Resize(0, 0);
+        return;
+    }
+    out->Resize(T, output_dim_, kUndefined);
+    CuMatrix<BaseFloat> conv_buf(input_dim_, input_dim_);
+    for (int t = 0; t < T; t++) {
+        CuSubMatrix<BaseFloat> yh(window.RowRange(t, future_ctx_ + 1));
+        conv_buf.AddMatMat(1.0, w_, kNoTrans, yh, kNoTrans, 0.0);
+        out->Row(t).CopyDiagFromMat(conv_buf);
+    }
+}
+
+void RowConvolution::PropagateStreams(const CuMatrixBase<BaseFloat> &in,
+                                      CuMatrixBase<BaseFloat> *out,
+                                      const std::vector<int32> &sequence_lengths,
+                                      CuMatrix<BaseFloat> *in_buf,
+                                      CuMatrix<BaseFloat> *conv_buf) const {
+    int32 nstream = sequence_lengths.size();
+    KALDI_ASSERT(in.NumRows() % nstream == 0);
+    int32 T = in.NumRows() / nstream;
+    int32 S = nstream;    
    
     int32 Ts = T + future_ctx_;
-    in_buf_.Resize(Ts * S, in.NumCols(), kSetZero);
+    in_buf->Resize(Ts * S, in.NumCols(), kSetZero);
 
     for (int s = 0; s < S; s++) {
         // Copy sequence s to sequence buffer
-        for (int t = 0; t < sequence_lengths_[s] + future_ctx_; t++) {
-            if (t < sequence_lengths_[s]) {
-                in_buf_.Row(s * Ts + t).CopyFromVec(in.Row(t * S + s));
+        for (int t = 0; t < sequence_lengths[s] + future_ctx_; t++) {
+            if (t < sequence_lengths[s]) {
+                in_buf->Row(s * Ts + t).CopyFromVec(in.Row(t * S + s));
             } else { // just copy the last frame
-                in_buf_.Row(s * Ts + t).CopyFromVec(
-                    in.Row((sequence_lengths_[s] - 1) * S + s));
+                in_buf->Row(s * Ts + t).CopyFromVec(
+                    in.Row((sequence_lengths[s] - 1) * S + s));
             }
         }
         // Do row convolution
-        for (int t = 0; t < sequence_lengths_[s]; t++) {
-            CuSubMatrix<BaseFloat> yh(in_buf_.RowRange(s * Ts + t, 
+        for (int t = 0; t < sequence_lengths[s]; t++) {
+            CuSubMatrix<BaseFloat> yh(in_buf->RowRange(s * Ts + t, 
                 future_ctx_ + 1));
-            conv_buf_.AddMatMat(1.0, w_, kNoTrans, yh, kNoTrans, 0.0);
-            out->Row(t * S + s).CopyDiagFromMat(conv_buf_);
+            conv_buf->AddMatMat(1.0, w_, kNoTrans, yh, kNoTrans, 0.0);
+            out->Row(t * S + s).CopyDiagFromMat(*conv_buf);
         }
     }
 }
@@ -52,6 +52,24 @@ public:
 
     void PropagateFnc(const CuMatrixBase<BaseFloat> &in, 
                       CuMatrixBase<BaseFloat> *out); 
+    ComponentState* NewState() const;
+    void FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in,
+                             CuMatrixBase<BaseFloat> *out,
+                             ComponentState *state) const;
+    void GetContext(int32 *left_context, int32 *right_context) const {
+        *left_context = 0;
+        *right_context = future_ctx_;
+    }
+    ComponentState* InitStreamState() const;
+    void FeedforwardChunkFnc(const CuMatrixBase<BaseFloat> &in, bool last,
+                             CuMatrix<BaseFloat> *out,
+                             ComponentState *state) const;
+    // Convolve the sequences of the given lengths, the weights are not touched
+    void PropagateStreams(const CuMatrixBase<BaseFloat> &in,
+                          CuMatrixBase<BaseFloat> *out,
+                          const std::vector<int32> &sequence_lengths,
+                          CuMatrix<BaseFloat> *in_buf,
+                          CuMatrix<BaseFloat> *conv_buf) const;
     void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, 
                           const CuMatrixBase<BaseFloat> &out,
                           const CuMatrixBase<BaseFloat> &out_diff, 
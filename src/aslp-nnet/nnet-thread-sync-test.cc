@@ -0,0 +1,72 @@
+// aslp-nnet/nnet-thread-sync-test.cc
+
+// Copyright 2016 ASLP (Author: zhangbinbin)
+
+// Created on 2016-08-25
+
+#include "base/kaldi-common.h"
+#include "thread/kaldi-thread.h"
+
+#include "aslp-nnet/nnet-thread-sync.h"
+
+using namespace kaldi;
+using namespace kaldi::aslp_nnet;
+
+// Thread t adds t + 1 to its model and trains t + 1 frames, except the last
+// thread which finished its data
+class SyncTask : public MultiThreadable {
+public:
+    SyncTask(ThreadSync *sync, std::vector<Vector<BaseFloat> > *models):
+        sync_(sync), models_(models) {}
+    void operator() () {
+        Vector<BaseFloat> &model = (*models_)[thread_id_];
+        std::vector<std::pair<BaseFloat *, int> > params;
+        // two params of one model
+        params.push_back(std::make_pair(model.Data(), 3));
+        params.push_back(std::make_pair(model.Data() + 3, model.Dim() - 3));
+        sync_->InitParam(thread_id_, params);
+        if (thread_id_ < num_threads_ - 1) {
+            model.Add(thread_id_ + 1);
+            KALDI_ASSERT(sync_->Synchronize(thread_id_, thread_id_ + 1));
+        }
+        sync_->Stop(thread_id_);
+    }
+private:
+    ThreadSync *sync_;
+    std::vector<Vector<BaseFloat> > *models_;
+};
+
+void UnitTestThreadSync(int num_threads, BaseFloat learn_rate,
+                        BaseFloat momentum) {
+    ThreadSyncOptions opts;
+    opts.num_threads = num_threads;
+    opts.bmuf_learn_rate = learn_rate;
+    opts.bmuf_momentum = momentum;
+    ThreadSync sync(opts);
+    std::vector<Vector<BaseFloat> > models(num_threads, Vector<BaseFloat>(11));
+    {
+        SyncTask task(&sync, &models);
+        MultiThreader<SyncTask> m(num_threads, task);
+    }
+    // The weighted average of the updates of the threads but the last one
+    double sum = 0.0, num = 0.0;
+    for (int t = 0; t < num_threads - 1; t++) {
+        sum += (t + 1) * (t + 1);
+        num += t + 1;
+    }
+    BaseFloat expect = num > 0 ? (1.0 - momentum) * learn_rate * sum / num : 0.0;
+    for (int t = 0; t < num_threads; t++) {
+        for (int i = 0; i < models[t].Dim(); i++) {
+            AssertEqual(models[t](i), expect);
+        }
+    }
+}
+
+int main() {
+    UnitTestThreadSync(1, 1.0, 0.0);
+    UnitTestThreadSync(2, 1.0, 0.0);
+    UnitTestThreadSync(4, 1.0, 0.0);
+    UnitTestThreadSync(13, 1.0, 0.0);
+    UnitTestThreadSync(4, 0.5, 0.9);
+    std::cout << "Tests succeeded.\n";
+}
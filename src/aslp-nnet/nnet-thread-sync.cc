@@ -0,0 +1,103 @@
+// aslp-nnet/nnet-thread-sync.cc
+
+// Copyright 2016 ASLP (Author: zhangbinbin)
+
+// Created on 2016-08-25
+
+#include "aslp-nnet/nnet-thread-sync.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+ThreadSync::ThreadSync(const ThreadSyncOptions &opts):
+        opts_(opts), params_(opts.num_threads),
+        num_samples_(opts.num_threads, 0), barrier_(opts.num_threads) {
+    KALDI_ASSERT(opts_.num_threads > 0);
+}
+
+ThreadSync::~ThreadSync() {
+    for (int t = 0; t < params_.size(); t++) {
+        for (int i = 0; i < params_[t].size(); i++) {
+            delete params_[t][i];
+        }
+    }
+    for (int i = 0; i < prev_params_.size(); i++) {
+        delete prev_params_[i];
+        delete prev_grads_[i];
+    }
+}
+
+void ThreadSync::InitParam(int thread,
+        const std::vector<std::pair<BaseFloat *, int> > &params) {
+    params_[thread].resize(params.size());
+    for (int i = 0; i < params.size(); i++) {
+        params_[thread][i] =
+            new SubVector<BaseFloat>(params[i].first, params[i].second);
+    }
+    // The last thread arrived allocates the global model, the model copies
+    // of all the threads are the same now
+    if (barrier_.Wait() == -1) {
+        prev_params_.resize(params.size());
+        prev_grads_.resize(params.size());
+        for (int i = 0; i < params.size(); i++) {
+            KALDI_ASSERT(params_[0][i]->Dim() == params[i].second);
+            prev_params_[i] = new Vector<BaseFloat>(*params_[0][i]);
+            prev_grads_[i] = new Vector<BaseFloat>(params[i].second);
+        }
+    }
+    barrier_.Wait();
+}
+
+bool ThreadSync::Synchronize(int thread, int num_thread_samples) {
+    num_samples_[thread] = num_thread_samples;
+    barrier_.Wait();
+    int num_all_samples = 0;
+    for (int t = 0; t < num_samples_.size(); t++) {
+        num_all_samples += num_samples_[t];
+    }
+    // All threads finished their data, return instantly
+    if (num_all_samples <= 0) {
+        barrier_.Wait();
+        return false;
+    }
+
+    int num_threads = opts_.num_threads;
+    float lr = (1.0 - opts_.bmuf_momentum) * opts_.bmuf_learn_rate;
+    Vector<BaseFloat> grad;
+    for (int i = 0; i < prev_params_.size(); i++) {
+        int dim = prev_params_[i]->Dim(),
+            begin = static_cast<int64>(dim) * thread / num_threads,
+            size = static_cast<int64>(dim) * (thread + 1) / num_threads - begin;
+        if (size == 0) continue;
+        SubVector<BaseFloat> prev(*prev_params_[i], begin, size),
+                             prev_grad(*prev_grads_[i], begin, size);
+        // 1. block grad g(t), the weighted average of the models - wg(t-1)
+        grad.Resize(size);
+        for (int t = 0; t < num_threads; t++) {
+            if (num_samples_[t] == 0) continue;
+            grad.AddVec(float(num_samples_[t]) / num_all_samples,
+                        params_[t][i]->Range(begin, size));
+        }
+        grad.AddVec(-1.0, prev);
+        // 2. d(t) = m * d(t-1) + (1 - m) * lr * g(t)
+        prev_grad.Scale(opts_.bmuf_momentum);
+        prev_grad.AddVec(lr, grad);
+        // 3. wg(t) = wg(t-1) + d(t), to all the threads
+        prev.AddVec(1.0, prev_grad);
+        for (int t = 0; t < num_threads; t++) {
+            params_[t][i]->Range(begin, size).CopyFromVec(prev);
+        }
+    }
+    // No one trains on a half updated model
+    barrier_.Wait();
+    return true;
+}
+
+void ThreadSync::Stop(int thread) {
+    // Wait other threads to finish their data, loop as BmufWorker::Stop
+    KALDI_VLOG(1) << "Thread " << thread << " finished, waitting for others";
+    while (Synchronize(thread, 0));
+}
+
+} // namespace aslp_nnet
+} // namespace kaldi
@@ -0,0 +1,78 @@
+// aslp-nnet/nnet-thread-sync.h
+
+// Copyright 2016 ASLP (Author: zhangbinbin)
+
+// Created on 2016-08-25
+
+#ifndef ASLP_NNET_NNET_THREAD_SYNC_H_
+#define ASLP_NNET_NNET_THREAD_SYNC_H_
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+#include "itf/options-itf.h"
+#include "thread/kaldi-barrier.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+struct ThreadSyncOptions {
+    int32 num_threads;
+    int32 sync_period;
+    BaseFloat bmuf_learn_rate;
+    BaseFloat bmuf_momentum;
+
+    ThreadSyncOptions(): num_threads(4), sync_period(25600),
+        bmuf_learn_rate(1.0), bmuf_momentum(0.0) {}
+
+    void Register(OptionsItf *opts) {
+        opts->Register("num-threads", &num_threads, "Number of training threads, "
+                       "every thread trains its own copy of the model");
+        opts->Register("sync-period", &sync_period, "Number of frames of one "
+                       "thread for every synchronization");
+        opts->Register("bmuf-learn-rate", &bmuf_learn_rate, "Block learn rate of "
+                       "the synchronization");
+        opts->Register("bmuf-momentum", &bmuf_momentum, "Block momentum of the "
+                       "synchronization, 0 for model average");
+    }
+};
+
+// ThreadSync: BMUF of the model copies of the training threads in one
+// process, the shared memory counterpart of BmufWorker in aslp-parallel,
+// with learn rate 1 and momentum 0 it is the model average of BspWorker.
+// The models are weighted by the frames trained since the last
+// synchronization. Every thread reduces a slice of every param, so there is
+// no master thread and no copy of the models.
+// The interface is the one of IWorker, with the thread id as the rank
+// (IWorker is a MpiNode, so it's not inherited here).
+// The params must be on host.
+class ThreadSync {
+public:
+    explicit ThreadSync(const ThreadSyncOptions &opts);
+    ~ThreadSync();
+    int NumThreads() const { return opts_.num_threads; }
+    // Called by every thread before the first Synchronize,
+    // @params type pair: first is to the data points of its model copy,
+    //                    second is the size of it
+    void InitParam(int thread,
+                   const std::vector<std::pair<BaseFloat *, int> > &params);
+    // Called by every thread the same times,
+    // @num_thread_samples: new sample frames since last synchronization
+    // return false if all the threads finished their data
+    bool Synchronize(int thread, int num_thread_samples);
+    // Called when the thread finished its data, wait the other threads
+    void Stop(int thread);
+private:
+    const ThreadSyncOptions &opts_;
+    // [thread][param]
+    std::vector<std::vector<SubVector<BaseFloat> *> > params_;
+    // The last global model and its update, the same for all the threads
+    std::vector<Vector<BaseFloat> *> prev_params_, prev_grads_;
+    std::vector<int> num_samples_; // of every thread
+    Barrier barrier_;
+    KALDI_DISALLOW_COPY_AND_ASSIGN(ThreadSync);
+};
+
+} // namespace aslp_nnet
+} // namespace kaldi
+
+#endif
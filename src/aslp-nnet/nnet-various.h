@@ -140,6 +140,48 @@ class Splice: public Component {
     cu::Splice(in, frame_offsets_, out); 
   }
 
+  void GetContext(int32 *left_context, int32 *right_context) const {
+    std::vector<int32> frame_offsets(frame_offsets_.Dim());
+    frame_offsets_.CopyToVec(&frame_offsets);
+    *left_context = 0;
+    *right_context = 0;
+    for (int32 c = 0; c < frame_offsets.size(); c++) {
+      *left_context = std::max(*left_context, -frame_offsets[c]);
+      *right_context = std::max(*right_context, frame_offsets[c]);
+    }
+  }
+
+  ComponentState* InitStreamState() const {
+    return new ContextState();
+  }
+
+  void FeedforwardChunkFnc(const CuMatrixBase<BaseFloat> &in, bool last,
+                           CuMatrix<BaseFloat> *out, ComponentState *state) const {
+    ContextState *s = dynamic_cast<ContextState*>(state);
+    KALDI_ASSERT(s != NULL);
+    int32 left_context, right_context;
+    GetContext(&left_context, &right_context);
+    // the edge frames are repeated, same as cu::Splice
+    CuMatrix<BaseFloat> window;
+    int32 num_frames = s->NextWindow(in, last, left_context, right_context,
+                                     true, &window);
+    if (num_frames == 0) {
+      out->Resize(0, 0);
+      return;
+    }
+    std::vector<int32> frame_offsets(frame_offsets_.Dim());
+    frame_offsets_.CopyToVec(&frame_offsets);
+    out->Resize(num_frames, output_dim_, kUndefined);
+    std::vector<int32> indexes(num_frames);
+    for (int32 c = 0; c < frame_offsets.size(); c++) {
+      for (int32 t = 0; t < num_frames; t++) {
+        indexes[t] = left_context + t + frame_offsets[c];
+      }
+      CuArray<int32> cu_indexes(indexes);
+      out->ColRange(c * input_dim_, input_dim_).CopyRows(window, cu_indexes);
+    }
+  }
+
   void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
                         const CuMatrixBase<BaseFloat> &out_diff, CuMatrixBase<BaseFloat> *in_diff) {
     // KALDI_ERR << __func__ << "Not implemented!";
@@ -351,6 +393,19 @@ class LengthNormComponent: public Component {
     out->MulRowsVec(row_scales_); // re-normalize,
   }
 
+  void FeedforwardStateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+                           ComponentState *state) const {
+    // same as PropagateFnc, with local buffers
+    CuMatrix<BaseFloat> l2_aux(in);
+    l2_aux.MulElements(l2_aux); // x^2,
+    CuVector<BaseFloat> row_scales(in.NumRows());
+    row_scales.AddColSumMat(1.0, l2_aux, 0.0); // sum_of_cols(x^2),
+    row_scales.ApplyPow(0.5); // L2norm = sqrt(sum_of_cols(x^2)),
+    row_scales.InvertElements(); // 1/L2norm,
+    out->CopyFromMat(in);
+    out->MulRowsVec(row_scales); // re-normalize,
+  }
+
   void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
                         const CuMatrixBase<BaseFloat> &out_diff, CuMatrixBase<BaseFloat> *in_diff) {
     in_diff->CopyFromMat(out_diff);
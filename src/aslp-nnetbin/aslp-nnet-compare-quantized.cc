@@ -0,0 +1,140 @@
+// aslp-nnetbin/aslp-nnet-compare-quantized.cc
+
+// Copyright 2016  ASLP (Author: zhangbinbin liwenpeng duwei)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "base/timer.h"
+
+#include "aslp-nnet/nnet-nnet.h"
+
+
+int main(int argc, char *argv[]) {
+  using namespace kaldi;
+  using namespace kaldi::aslp_nnet;
+  typedef kaldi::int32 int32;
+  try {
+    const char *usage =
+        "Compare the output and the speed of a quantized network (see\n"
+        "aslp-nnet-copy --quantize) with the float one on cpu.\n"
+        "\n"
+        "Usage:  aslp-nnet-compare-quantized [options] <float-model-in> <quantized-model-in> <feature-rspecifier>\n"
+        "e.g.: \n"
+        " aslp-nnet-compare-quantized final.nnet final.int8.nnet ark:features.ark\n";
+
+    ParseOptions po(usage);
+
+    std::string feature_transform;
+    po.Register("feature-transform", &feature_transform, "Feature transform in front of main network (in nnet format)");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string float_model_filename = po.GetArg(1),
+        quantized_model_filename = po.GetArg(2),
+        feature_rspecifier = po.GetArg(3);
+
+    Nnet nnet_transf;
+    if (feature_transform != "") {
+      nnet_transf.Read(feature_transform);
+    }
+
+    Nnet nnet_float, nnet_quantized;
+    nnet_float.Read(float_model_filename);
+    nnet_quantized.Read(quantized_model_filename);
+    if (nnet_float.InputDim() != nnet_quantized.InputDim() ||
+        nnet_float.OutputDim() != nnet_quantized.OutputDim()) {
+      KALDI_ERR << "The models have different dims";
+    }
+    nnet_float.SetDropoutRetention(1.0);
+    nnet_quantized.SetDropoutRetention(1.0);
+
+    SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+
+    CuMatrix<BaseFloat> feats, feats_transf, float_out, quantized_out;
+    Matrix<BaseFloat> float_host, quantized_host;
+
+    Timer timer;
+    double float_time = 0.0, quantized_time = 0.0;
+    double sum_abs_diff = 0.0, sum_sqr_diff = 0.0, sum_sqr_ref = 0.0;
+    BaseFloat max_abs_diff = 0.0;
+    int64 tot_t = 0, num_same_max = 0;
+    int32 num_done = 0;
+    for (; !feature_reader.Done(); feature_reader.Next()) {
+      std::string utt = feature_reader.Key();
+      feats = feature_reader.Value();
+      nnet_transf.Feedforward(feats, &feats_transf);
+
+      std::vector<int> frame_num_utt(1, feats_transf.NumRows());
+      nnet_float.SetSeqLengths(frame_num_utt);
+      nnet_quantized.SetSeqLengths(frame_num_utt);
+
+      timer.Reset();
+      nnet_float.Feedforward(feats_transf, &float_out);
+      float_time += timer.Elapsed();
+      timer.Reset();
+      nnet_quantized.Feedforward(feats_transf, &quantized_out);
+      quantized_time += timer.Elapsed();
+
+      float_host.Resize(float_out.NumRows(), float_out.NumCols(), kUndefined);
+      float_out.CopyToMat(&float_host);
+      quantized_host.Resize(quantized_out.NumRows(), quantized_out.NumCols(), kUndefined);
+      quantized_out.CopyToMat(&quantized_host);
+
+      // output difference and the agreement of the best class per frame
+      for (int32 r = 0; r < float_host.NumRows(); r++) {
+        SubVector<BaseFloat> ref(float_host, r), hyp(quantized_host, r);
+        for (int32 c = 0; c < ref.Dim(); c++) {
+          BaseFloat diff = hyp(c) - ref(c);
+          sum_abs_diff += std::abs(diff);
+          sum_sqr_diff += diff * diff;
+          sum_sqr_ref += ref(c) * ref(c);
+          max_abs_diff = std::max(max_abs_diff, std::abs(diff));
+        }
+        int32 ref_max, hyp_max;
+        ref.Max(&ref_max);
+        hyp.Max(&hyp_max);
+        if (ref_max == hyp_max) num_same_max++;
+      }
+      KALDI_VLOG(2) << "Processed utterance " << utt << ", "
+                    << float_host.NumRows() << "frm";
+      num_done++;
+      tot_t += float_host.NumRows();
+    }
+
+    if (num_done == 0) return -1;
+    KALDI_LOG << "Done " << num_done << " files, " << tot_t << " frames";
+    KALDI_LOG << "Float fps " << tot_t / float_time
+              << ", quantized fps " << tot_t / quantized_time
+              << ", speedup " << float_time / quantized_time;
+    KALDI_LOG << "Output mean abs diff "
+              << sum_abs_diff / (tot_t * nnet_float.OutputDim())
+              << ", max abs diff " << max_abs_diff
+              << ", relative error " << sqrt(sum_sqr_diff / sum_sqr_ref);
+    KALDI_LOG << "Frames with the same best class "
+              << 100.0 * num_same_max / tot_t << "%";
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
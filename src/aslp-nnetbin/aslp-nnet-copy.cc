@@ -16,7 +16,8 @@ int main(int argc, char *argv[]) {
         "Initialize Neural Network parameters according to a prototype (aslp_nnet).\n"
         "Usage:  aslp-nnet-copy [options] <nnet-in> <nnet-out>\n"
         "e.g.:\n"
-        " aslp-nnet-copy --binary=false nnet.in nnet.out\n";
+        " aslp-nnet-copy --binary=false nnet.in nnet.out\n"
+        " aslp-nnet-copy --quantize=true nnet.in nnet.int8\n";
 
     SetVerboseLevel(1); // be verbose by default
 
@@ -25,6 +26,9 @@ int main(int argc, char *argv[]) {
     po.Register("binary", &binary_write, "Write output in binary mode");
     int32 seed = 777;
     po.Register("seed", &seed, "Seed for random number generator");
+    bool quantize = false;
+    po.Register("quantize", &quantize, "Convert the AffineTransform and "
+                "LstmProjectedStreams weights to int8 for cpu inference");
 
     po.Read(argc, argv);
 
@@ -43,6 +47,10 @@ int main(int argc, char *argv[]) {
       Input ki(nnet_in_filename, &binary_read);
       nnet.Read(ki.Stream(), binary_read);
     }
+
+    if (quantize) {
+      nnet.Quantize();
+    }
     
     // store the network
     Output ko(nnet_out_filename, binary_write);
@@ -72,7 +72,9 @@ int main(int argc, char *argv[]) {
     
 
         std::string use_gpu="yes";
-        //po.Register("use-gpu", &use_gpu, "yes|no|optional, only has effect if compiled with CUDA"); 
+        po.Register("use-gpu", &use_gpu, "yes|no|optional, only has effect if compiled with CUDA"); 
+        int32 num_threads = 1;
+        po.Register("num-threads", &num_threads, "Number of threads for the CTC computation without GPU");
 
         po.Read(argc, argv);
 
@@ -110,6 +112,7 @@ int main(int argc, char *argv[]) {
         // Initialize CTC optimizer
         Ctc ctc;
         ctc.SetReportStep(report_step);
+        ctc.SetNumThreads(num_threads);
         CuMatrix<BaseFloat> net_out, obj_diff;
 
         Timer time;
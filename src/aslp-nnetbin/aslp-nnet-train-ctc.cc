@@ -59,7 +59,7 @@ int main(int argc, char *argv[]) {
                                            "then drop it, default(0, no drop)");
 
         std::string use_gpu="yes";
-        //    po.Register("use-gpu", &use_gpu, "yes|no|optional, only has effect if compiled with CUDA"); 
+        po.Register("use-gpu", &use_gpu, "yes|no|optional, only has effect if compiled with CUDA"); 
 
         po.Read(argc, argv);
 
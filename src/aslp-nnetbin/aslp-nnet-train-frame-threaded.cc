@@ -0,0 +1,231 @@
+// aslp-nnetbin/aslp-nnet-train-frame-threaded.cc
+
+// Copyright 2016  ASLP (Author: Zhang Binbin)
+
+// Created on 2016-08-25
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "base/timer.h"
+#include "thread/kaldi-thread.h"
+#include "thread/kaldi-mutex.h"
+
+#include "aslp-nnet/nnet-trnopts.h"
+#include "aslp-nnet/nnet-nnet.h"
+#include "aslp-nnet/nnet-loss.h"
+#include "aslp-nnet/data-reader.h"
+#include "aslp-nnet/nnet-thread-sync.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+// One training thread, it reads the minibatches from the shared reader and
+// trains its own copy of the model, which is synchronized by ThreadSync
+class TrainFrameTask : public MultiThreadable {
+public:
+    TrainFrameTask(FrameDataReader *reader, Mutex *reader_mutex,
+                   const std::vector<Nnet *> &nnets, ThreadSync *sync,
+                   const ThreadSyncOptions &sync_opts,
+                   const std::string &objective_function, int report_period,
+                   std::vector<int64> *num_frames):
+        reader_(reader), reader_mutex_(reader_mutex), nnets_(nnets),
+        sync_(sync), sync_opts_(sync_opts),
+        objective_function_(objective_function),
+        report_period_(report_period), num_frames_(num_frames) {}
+
+    void operator() () {
+        Nnet &nnet = *nnets_[thread_id_];
+        LossItf *loss = NULL;
+        if (objective_function_ == "xent") {
+            loss = new Xent;
+        } else {
+            loss = new Mse;
+        }
+        std::vector<std::pair<BaseFloat *, int> > params;
+        nnet.GetGpuParams(&params);
+        sync_->InitParam(thread_id_, params);
+
+        CuMatrix<BaseFloat> nnet_in, nnet_out, obj_diff;
+        Posterior nnet_tgt;
+        int64 total_frames = 0, report_frames = 0;
+        int num_frames_since_last_sync = 0;
+        for (;;) {
+            // The minibatch is copied, for the reader reuses its buffers
+            reader_mutex_->Lock();
+            if (reader_->Done()) {
+                reader_mutex_->Unlock();
+                break;
+            }
+            const CuMatrixBase<BaseFloat> *in;
+            const Posterior *tgt;
+            bool ok = reader_->ReadData(&in, &tgt);
+            if (ok) {
+                nnet_in = *in;
+                nnet_tgt = *tgt;
+            }
+            reader_mutex_->Unlock();
+            if (!ok) continue;
+
+            // Forward pass
+            nnet.Propagate(nnet_in, &nnet_out);
+            // Eval loss
+            loss->Eval(nnet_out, nnet_tgt, &obj_diff);
+            // Backward pass
+            nnet.Backpropagate(obj_diff, NULL);
+
+            total_frames += nnet_in.NumRows();
+            report_frames += nnet_in.NumRows();
+            num_frames_since_last_sync += nnet_in.NumRows();
+            // Do Synchronize
+            if (num_frames_since_last_sync > sync_opts_.sync_period) {
+                sync_->Synchronize(thread_id_, num_frames_since_last_sync);
+                num_frames_since_last_sync = 0;
+            }
+            // Report
+            if (report_period_ > 0 && report_frames >= report_period_) {
+                KALDI_LOG << "Thread " << thread_id_ << " " << loss->Report();
+                report_frames -= report_period_;
+            }
+        }
+        if (num_frames_since_last_sync > 0) {
+            sync_->Synchronize(thread_id_, num_frames_since_last_sync);
+        }
+        sync_->Stop(thread_id_);
+
+        KALDI_LOG << "Thread " << thread_id_ << " " << loss->Report();
+        (*num_frames_)[thread_id_] = total_frames;
+        delete loss;
+    }
+private:
+    FrameDataReader *reader_;
+    Mutex *reader_mutex_;
+    std::vector<Nnet *> nnets_; // of all threads
+    ThreadSync *sync_;
+    const ThreadSyncOptions &sync_opts_;
+    std::string objective_function_;
+    int report_period_;
+    std::vector<int64> *num_frames_; // of all threads
+};
+
+} // namespace aslp_nnet
+} // namespace kaldi
+
+int main(int argc, char *argv[]) {
+    using namespace kaldi;
+    using namespace kaldi::aslp_nnet;
+    typedef kaldi::int32 int32;
+    try {
+        const char *usage =
+            "Data parallel version of aslp-nnet-train-frame on cpu, in one process.\n"
+            "Every thread trains its own copy of the model on the minibatches of the\n"
+            "shared reader, the copies are synchronized by model average or BMUF\n"
+            "every --sync-period frames. Use a single threaded BLAS, eg.\n"
+            "OPENBLAS_NUM_THREADS=1, or the threads compete for the cores.\n"
+            "Usage:  aslp-nnet-train-frame-threaded [options] <feature-rspecifier> <targets-rspecifier> <model-in> <model-out>\n"
+            "e.g.: \n"
+            " aslp-nnet-train-frame-threaded --num-threads=16 scp:feature.scp ark:posterior.ark nnet.init nnet.iter1\n";
+
+        ParseOptions po(usage);
+
+        NnetTrainOptions trn_opts;
+        trn_opts.Register(&po);
+        NnetDataRandomizerOptions rnd_opts;
+        rnd_opts.Register(&po);
+        ThreadSyncOptions sync_opts;
+        sync_opts.Register(&po);
+
+        bool binary = true,
+             randomize = true;
+        po.Register("binary", &binary, "Write output in binary mode");
+        po.Register("randomize", &randomize, "Perform the frame-level shuffling within the Cache::");
+
+        std::string objective_function = "xent";
+        po.Register("objective-function", &objective_function, "Objective function : xent|mse");
+
+        double dropout_retention = 0.0;
+        po.Register("dropout-retention", &dropout_retention, "number between 0..1, saying how many neurons to preserve (0.0 will keep original value");
+        int report_period = -1; //
+        po.Register("report-period", &report_period, "Number of frames of one thread for one report log, default(-1, no report)");
+
+        po.Read(argc, argv);
+
+        if (po.NumArgs() != 4) {
+            po.PrintUsage();
+            exit(1);
+        }
+        std::string feature_rspecifier = po.GetArg(1),
+            targets_rspecifier = po.GetArg(2),
+            model_filename = po.GetArg(3),
+            target_model_filename = po.GetArg(4);
+
+        if (objective_function != "xent" && objective_function != "mse") {
+            KALDI_ERR << "Unsupported objective function: " << objective_function;
+        }
+
+        Nnet nnet;
+        nnet.Read(model_filename);
+        nnet.SetTrainOptions(trn_opts);
+
+        if (dropout_retention > 0.0) {
+            nnet.SetDropoutRetention(dropout_retention);
+        }
+
+        // Thread 0 trains nnet itself
+        int num_threads = sync_opts.num_threads;
+        std::vector<Nnet *> nnets(num_threads);
+        nnets[0] = &nnet;
+        for (int i = 1; i < num_threads; i++) {
+            nnets[i] = new Nnet(nnet);
+        }
+        ThreadSync sync(sync_opts);
+
+        Timer time;
+        KALDI_LOG << "TRAINING STARTED";
+
+        FrameDataReader reader(feature_rspecifier, targets_rspecifier, rnd_opts);
+        Mutex reader_mutex;
+        std::vector<int64> num_frames(num_threads, 0);
+        {
+            TrainFrameTask task(&reader, &reader_mutex, nnets, &sync, sync_opts,
+                                objective_function, report_period, &num_frames);
+            // Joins all the threads when it goes out of scope
+            MultiThreader<TrainFrameTask> m(num_threads, task);
+        }
+
+        // Acc stats of all the copies, see MpiNode::ReduceAccStat
+        std::vector<double *> acc_params;
+        std::vector<std::pair<double*, int> > data_params;
+        nnet.GetAccStats(&acc_params, &data_params);
+        for (int i = 1; i < num_threads; i++) {
+            std::vector<double *> thread_acc_params;
+            std::vector<std::pair<double*, int> > thread_data_params;
+            nnets[i]->GetAccStats(&thread_acc_params, &thread_data_params);
+            for (int j = 0; j < acc_params.size(); j++) {
+                *acc_params[j] += *thread_acc_params[j];
+            }
+            for (int j = 0; j < data_params.size(); j++) {
+                SubVector<double> data(data_params[j].first,
+                                       data_params[j].second);
+                data.AddVec(1.0, SubVector<double>(thread_data_params[j].first,
+                                                   thread_data_params[j].second));
+            }
+            delete nnets[i];
+        }
+
+        nnet.Write(target_model_filename, binary);
+
+        int64 total_frames = 0;
+        for (int i = 0; i < num_threads; i++) {
+            total_frames += num_frames[i];
+        }
+        KALDI_LOG << "[" << "TRAINING"
+            << ", " << (randomize?"RANDOMIZED":"NOT-RANDOMIZED")
+            << ", " << num_threads << " threads"
+            << ", " << time.Elapsed()/60 << " min, fps" << total_frames/time.Elapsed()
+            << "]";
+        return 0;
+    } catch(const std::exception &e) {
+        std::cerr << e.what();
+        return -1;
+    }
+}
@@ -46,6 +46,7 @@ static void GetDiagnosticsAndPrintOutput(const std::string &utt,
 void DecodeThread::operator() (void *resource) {
     try {
         aslp_nnet::Nnet *nnet = static_cast<aslp_nnet::Nnet *>(resource);
+        aslp_nnet::SharedNnetForward am_forward(*nnet);
         double tot_like = 0.0;
         int64 num_frames = 0;
         // This object receives raw wave data and sends the recognition results
@@ -59,7 +60,8 @@ void DecodeThread::operator() (void *resource) {
                 nnet,
                 log_prior_,
                 decode_fst_,
-                feature_pipeline);
+                feature_pipeline,
+                &am_forward);
 
         std::vector<std::pair<int32, BaseFloat> > delta_weights;
         std::vector<BaseFloat> data;
@@ -159,131 +161,188 @@ static void AddVadFeatureToFeaturePool(int num_frames,
     //KALDI_LOG << "Add " << num_voice_frames << " frames to the feature pool";
 }
 
-void NnetVadDecodeThread::operator() (void *resource) {
-    try {
-        NnetVadDecodeThreadResource *nnet_vad_resource = 
-            static_cast<NnetVadDecodeThreadResource *>(resource);
-        aslp_nnet::Nnet *am_nnet = nnet_vad_resource->am_nnet;
-        aslp_nnet::Nnet *vad_nnet = nnet_vad_resource->vad_nnet;
-        double tot_like = 0.0;
-        int64 num_frames = 0;
-
-        // This object receives raw wave data and sends the recognition results
-        // to the client. The client_socket is closed by this object.
-        WavProvider wav_provider(client_socket_);
-        OnlineVadFeaturePipeline *vad_pipeline = 
-            new OnlineVadFeaturePipeline(*vad_nnet, vad_config_, feature_info_);
-        OnlineFeaturePool *feature_pool = 
-            new OnlineFeaturePool(vad_pipeline->Dim());
-        MultiUtteranceNnetDecoder decoder(nnet_decoding_config_,
-                trans_model_,
-                am_nnet,
-                log_prior_,
-                decode_fst_,
-                feature_pool);
-
-        double get_partial_result_progress = 0.0;
-        std::vector<BaseFloat> data;
-        std::string all_result;
- 
-        // Vad on feats then decode speech frames
-        /* Here we assume that the feature for vad and the feature 
-           for decoder are the same, so the vad out feature is directly used
-           by the decoder
-           OnlineNnetVad has inner buffers that stores the none silence frames
-           when the buffer is full or endpoint detected, it is avaliable in 
-           the following code
-         */
-        while (!wav_provider.Done()) {
-            // Read until forward_batch speech frames or endpoint detected
-            while (!wav_provider.Done() && 
-                    vad_pipeline->NumSpeechFramesReady() < forward_batch_) {
-                // Read raw pcm audio
-                int num_read = wav_provider.ReadAudio(chunk_length_, &data);
-                if (num_read == 0) continue;
-                std::cerr << "WavProvider.ReadAudio() read " << num_read << std::endl;
-                // Feature extraction 
-                SubVector<BaseFloat> wave_part(data.data(), num_read);
-                vad_pipeline->AcceptWaveform(samp_freq_, wave_part);
-                if (vad_pipeline->EndpointDetected()) break;
-            }
+static aslp_nnet::NnetForwardInterface *NewAmForward(
+        NnetVadDecodeThreadResource *resource) {
+    if (resource->am_scorer != NULL) return resource->am_scorer->NewStream();
+    return new aslp_nnet::SharedNnetForward(*resource->am_nnet);
+}
 
-            // Get voiced frames to feature pool 
-            AddVadFeatureToFeaturePool(forward_batch_, vad_pipeline, feature_pool);
+static int AmLeftContext(const NnetVadDecodeThreadResource *resource) {
+    int32 left_context = 0, right_context = 0;
+    if (resource->am_nnet != NULL) {
+        resource->am_nnet->GetContext(&left_context, &right_context);
+    }
+    return left_context;
+}
 
-            // Advance decoding
-            decoder.AdvanceDecoding();
+NnetVadDecodeSession::NnetVadDecodeSession(int client_socket,
+        int forward_batch,
+        BaseFloat samp_freq,
+        const OnlineFeaturePipelineConfig &feature_info,
+        const OnlineNnetDecodingConfig &nnet_decoding_config,
+        const OnlineNnetVadOptions & vad_config,
+        const TransitionModel &trans_model,
+        const CuVector<BaseFloat> &log_prior,
+        const fst::Fst<fst::StdArc> &decode_fst,
+        const PunctuationProcessor &punctuation_processor,
+        const fst::SymbolTable *word_syms_table,
+        NnetVadDecodeThreadResource *resource):
+            forward_batch_(forward_batch),
+            samp_freq_(samp_freq),
+            feature_info_(feature_info),
+            vad_config_(vad_config),
+            punctuation_processor_(punctuation_processor),
+            punctuation_pool_(resource->punctuation_pool),
+            word_syms_table_(word_syms_table),
+            vad_nnet_(resource->vad_nnet),
+            am_left_context_(AmLeftContext(resource)),
+            wav_provider_(client_socket),
+            vad_pipeline_(new OnlineVadFeaturePipeline(*vad_nnet_, 
+                    vad_config_, feature_info_)),
+            feature_pool_(new OnlineFeaturePool(vad_pipeline_->Dim(),
+                    am_left_context_)),
+            am_forward_(NewAmForward(resource)),
+            decoder_(nnet_decoding_config,
+                     trans_model,
+                     resource->am_nnet,
+                     log_prior,
+                     decode_fst,
+                     feature_pool_,
+                     am_forward_),
+            get_partial_result_progress_(0.0),
+            tot_like_(0.0),
+            num_frames_(0) {
+}
 
-            int partial_progress = 
-                vad_pipeline->AudioReceived() - get_partial_result_progress;
-            // Print partial results
-            if (decoder.NumFramesDecoded() > 0 && 
-                    !vad_pipeline->EndpointDetected() && 
-                    partial_progress >= 0.7) {
-                get_partial_result_progress = vad_pipeline->AudioReceived();
-                std::string result;
-                decoder.GetPartialResult(word_syms_table_, &result);
-                if (result != "") {
-                    wav_provider.WritePartialReslut(result);
-                }
-                KALDI_VLOG(1) << "Partial: " << result;
-            } // if NumFramesDecoded > 0
+NnetVadDecodeSession::~NnetVadDecodeSession() {
+    delete am_forward_;
+    delete feature_pool_;
+    delete vad_pipeline_;
+}
 
-            if (vad_pipeline->EndpointDetected() && 
-                    decoder.NumFramesDecoded() > 0) {
-                vad_pipeline->InputFinished();
-                AddVadFeatureToFeaturePool(forward_batch_, vad_pipeline, feature_pool);
-                feature_pool->InputFinished();
-                decoder.AdvanceDecoding();
+// Vad on feats then decode speech frames
+/* Here we assume that the feature for vad and the feature 
+   for decoder are the same, so the vad out feature is directly used
+   by the decoder
+   OnlineNnetVad has inner buffers that stores the none silence frames
+   when the buffer is full or endpoint detected, it is avaliable in 
+   the following code
+ */
+void NnetVadDecodeSession::AcceptAudio(const VectorBase<BaseFloat> &wave_part) {
+    // Feature extraction 
+    vad_pipeline_->AcceptWaveform(samp_freq_, wave_part);
+    // Decode until forward_batch speech frames or endpoint detected
+    if (vad_pipeline_->NumSpeechFramesReady() >= forward_batch_ ||
+            vad_pipeline_->EndpointDetected()) {
+        do {
+            AdvanceDecoding();
+        } while (vad_pipeline_->NumSpeechFramesReady() >= forward_batch_);
+    }
+}
 
-                std::string result;
-                decoder.GetPartialResult(word_syms_table_, &result);
-                KALDI_VLOG(1) << "-Final: " << result;
-                if (result != "") {
-                    wav_provider.WriteFinalReslut(result);
-                    all_result += result;
-                }
-                delete vad_pipeline;
-                delete feature_pool;
-                vad_pipeline = new OnlineVadFeaturePipeline(*vad_nnet, 
-                        vad_config_, feature_info_);
-                feature_pool = new OnlineFeaturePool(vad_pipeline->Dim());
-                decoder.ResetDecoder(feature_pool);
-            }
+void NnetVadDecodeSession::AdvanceDecoding() {
+    // Get voiced frames to feature pool 
+    AddVadFeatureToFeaturePool(forward_batch_, vad_pipeline_, feature_pool_);
+
+    // Advance decoding
+    decoder_.AdvanceDecoding();
+
+    int partial_progress = 
+        vad_pipeline_->AudioReceived() - get_partial_result_progress_;
+    // Print partial results
+    if (decoder_.NumFramesDecoded() > 0 && 
+            !vad_pipeline_->EndpointDetected() && 
+            partial_progress >= 0.7) {
+        get_partial_result_progress_ = vad_pipeline_->AudioReceived();
+        std::string result;
+        decoder_.GetPartialResult(word_syms_table_, &result);
+        if (result != "") {
+            wav_provider_.WritePartialReslut(result);
+        }
+        KALDI_VLOG(1) << "Partial: " << result;
+    } // if NumFramesDecoded > 0
+
+    if (vad_pipeline_->EndpointDetected() && 
+            decoder_.NumFramesDecoded() > 0) {
+        vad_pipeline_->InputFinished();
+        AddVadFeatureToFeaturePool(forward_batch_, vad_pipeline_, feature_pool_);
+        feature_pool_->InputFinished();
+        decoder_.AdvanceDecoding();
+
+        std::string result;
+        decoder_.GetPartialResult(word_syms_table_, &result);
+        KALDI_VLOG(1) << "-Final: " << result;
+        if (result != "") {
+            wav_provider_.WriteFinalReslut(result);
+            all_result_ += result;
+        }
+        delete vad_pipeline_;
+        delete feature_pool_;
+        vad_pipeline_ = new OnlineVadFeaturePipeline(*vad_nnet_, 
+                vad_config_, feature_info_);
+        feature_pool_ = new OnlineFeaturePool(vad_pipeline_->Dim(),
+                am_left_context_);
+        decoder_.ResetDecoder(feature_pool_);
+    }
+}
 
-        } // end while
+void NnetVadDecodeSession::InputFinished() {
+    AdvanceDecoding();
 
-        vad_pipeline->InputFinished();
-        AddVadFeatureToFeaturePool(forward_batch_, vad_pipeline, feature_pool);
-        feature_pool->InputFinished();
+    vad_pipeline_->InputFinished();
+    AddVadFeatureToFeaturePool(forward_batch_, vad_pipeline_, feature_pool_);
+    feature_pool_->InputFinished();
 
-        decoder.FinalizeDecoding();
+    decoder_.FinalizeDecoding();
 
-        std::string recog_result;
-        CompactLattice clat;
-        if (decoder.NumFramesDecoded() > 0) {
-            bool end_of_utterance = true;
-            decoder.GetLattice(end_of_utterance, &clat);
-            GetDiagnosticsAndPrintOutput("+Final: ", word_syms_table_, clat,
-                    &num_frames, &tot_like, &recog_result);
-        } else {
-            KALDI_LOG << "no frames decoded";
-        }
-        if (recog_result != "") {
-            wav_provider.WriteFinalReslut(recog_result);
-            all_result += recog_result;
-        }
-        if (all_result.size() > 0) {
-            std::string punc_result;
-            punctuation_processor_.Process(all_result, &punc_result);
-            KALDI_LOG << "All Result: " << all_result;
-            KALDI_LOG << "Final Punctuation Result: " << punc_result;
-            wav_provider.WritePuncResult(punc_result);
+    std::string recog_result;
+    CompactLattice clat;
+    if (decoder_.NumFramesDecoded() > 0) {
+        bool end_of_utterance = true;
+        decoder_.GetLattice(end_of_utterance, &clat);
+        GetDiagnosticsAndPrintOutput("+Final: ", word_syms_table_, clat,
+                &num_frames_, &tot_like_, &recog_result);
+    } else {
+        KALDI_LOG << "no frames decoded";
+    }
+    if (recog_result != "") {
+        wav_provider_.WriteFinalReslut(recog_result);
+        all_result_ += recog_result;
+    }
+    if (all_result_.size() > 0) {
+        KALDI_LOG << "All Result: " << all_result_;
+        if (punctuation_pool_ != NULL) {
+            // The punctuation task sends the rest and closes the socket
+            punctuation_pool_->AddTask(wav_provider_.ReleaseSocket(),
+                                       all_result_);
+            return;
         }
-        wav_provider.WriteEOS();
+        std::string punc_result;
+        punctuation_processor_.Process(all_result_, &punc_result);
+        KALDI_LOG << "Final Punctuation Result: " << punc_result;
+        wav_provider_.WritePuncResult(punc_result);
+    }
+    wav_provider_.WriteEOS();
+}
 
-        delete feature_pool;
-        delete vad_pipeline;
+void NnetVadDecodeThread::operator() (void *resource) {
+    try {
+        NnetVadDecodeThreadResource *nnet_vad_resource = 
+            static_cast<NnetVadDecodeThreadResource *>(resource);
+        NnetVadDecodeSession session(client_socket_, forward_batch_,
+                samp_freq_, feature_info_, nnet_decoding_config_, vad_config_,
+                trans_model_, log_prior_, decode_fst_, punctuation_processor_,
+                word_syms_table_, nnet_vad_resource);
+        WavProvider &wav_provider = session.GetWavProvider();
+        Vector<BaseFloat> data;
+        while (!wav_provider.Done()) {
+            // Read raw pcm audio
+            int num_read = wav_provider.ReadAudio(chunk_length_, &data);
+            if (num_read == 0) continue;
+            std::cerr << "WavProvider.ReadAudio() read " << num_read << std::endl;
+            session.AcceptAudio(data);
+        }
+        session.InputFinished();
     } catch (const std::exception &e) {
         std::cerr << e.what();
     }
@@ -20,6 +20,8 @@
 #include "aslp-online/thread-pool.h"
 #include "aslp-online/online-feature-pool.h"
 #include "aslp-online/online-vad-feature-pipeline.h"
+#include "aslp-online/epoll-server.h"
+#include "aslp-online/nnet-batch-scorer.h"
 
 
 namespace kaldi {
@@ -29,7 +31,8 @@ namespace aslp_online {
 // thread, here we refactor it in thread pool for better abstraction,
 // better performance and more readable.
 // Here Nnet object is allocated as the resource object, namely allocated
-// enough at begin 
+// enough at begin. The Nnet is used read-only (every decoding keeps its own
+// forward state), so all the threads may share the same one.
 
 class DecodeThread : public Threadable {
 public:
@@ -80,10 +83,118 @@ private:
 
 struct NnetVadDecodeThreadResource {
     NnetVadDecodeThreadResource(aslp_nnet::Nnet *am_nnet,
-                                aslp_nnet::Nnet *vad_nnet):
-        am_nnet(am_nnet), vad_nnet(vad_nnet) {}
+                                aslp_nnet::Nnet *vad_nnet,
+                                NnetBatchScorer *am_scorer = NULL,
+                                PunctuationPool *punctuation_pool = NULL):
+        am_nnet(am_nnet), vad_nnet(vad_nnet), am_scorer(am_scorer),
+        punctuation_pool(punctuation_pool) {}
+    // The nnets are only read, every session has its own forward state
+    // (see aslp_nnet::NnetState), so they may be shared by all threads
     aslp_nnet::Nnet *am_nnet; // acoustic nnet model 
     aslp_nnet::Nnet *vad_nnet; // vad nnet model
+    // optional, shared by all threads, score the am instead of am_nnet
+    NnetBatchScorer *am_scorer;
+    // optional, shared by all threads, punctuate the sessions instead of
+    // the PunctuationProcessor, without blocking the decode thread
+    PunctuationPool *punctuation_pool;
+};
+
+// The decoding logic of NnetVadDecodeThread, but driven by the caller chunk
+// by chunk, so that it can be used both by the thread per connection server
+// (NnetVadDecodeThread) and by the multiplexed EpollServer.
+class NnetVadDecodeSession : public OnlineSession {
+public:
+    NnetVadDecodeSession(int client_socket,
+                         int forward_batch,
+                         BaseFloat samp_freq,
+                         const OnlineFeaturePipelineConfig &feature_info,
+                         const OnlineNnetDecodingConfig &nnet_decoding_config,
+                         const OnlineNnetVadOptions & vad_config,
+                         const TransitionModel &trans_model,
+                         const CuVector<BaseFloat> &log_prior,
+                         const fst::Fst<fst::StdArc> &decode_fst,
+                         const PunctuationProcessor &punctuation_processor,
+                         const fst::SymbolTable *word_syms_table,
+                         NnetVadDecodeThreadResource *resource);
+    ~NnetVadDecodeSession();
+
+    // Feature extraction and vad on the chunk, decode when forward_batch
+    // speech frames are ready or endpoint detected
+    virtual void AcceptAudio(const VectorBase<BaseFloat> &wave_part);
+    // Flush, send the final and punctuation results and EOS
+    virtual void InputFinished();
+
+    // Only the thread per connection server reads audio from it
+    WavProvider &GetWavProvider() { return wav_provider_; }
+private:
+    void AdvanceDecoding();
+
+    int forward_batch_;
+    BaseFloat samp_freq_;
+    const OnlineFeaturePipelineConfig &feature_info_;
+    const OnlineNnetVadOptions &vad_config_;
+    const PunctuationProcessor &punctuation_processor_;
+    PunctuationPool *punctuation_pool_;
+    const fst::SymbolTable *word_syms_table_;
+    aslp_nnet::Nnet *vad_nnet_;
+    // Frames the am looks back, kept by feature_pool_ after they are read
+    int am_left_context_;
+    // This object receives raw wave data and sends the recognition results
+    // to the client. The client_socket is closed by this object.
+    WavProvider wav_provider_;
+    OnlineVadFeaturePipeline *vad_pipeline_;
+    OnlineFeaturePool *feature_pool_;
+    // Am forward of this session, on the batch scorer or on am_nnet
+    aslp_nnet::NnetForwardInterface *am_forward_;
+    MultiUtteranceNnetDecoder decoder_;
+    double get_partial_result_progress_;
+    std::string all_result_;
+    double tot_like_;
+    int64 num_frames_;
+};
+
+class NnetVadDecodeSessionFactory : public OnlineSessionFactory {
+public:
+    NnetVadDecodeSessionFactory(int forward_batch,
+                        BaseFloat samp_freq,
+                        const OnlineFeaturePipelineConfig &feature_info,
+                        const OnlineNnetDecodingConfig &nnet_decoding_config,
+                        const OnlineNnetVadOptions & vad_config,
+                        const TransitionModel &trans_model,
+                        const CuVector<BaseFloat> &log_prior,
+                        const fst::Fst<fst::StdArc> &decode_fst,
+                        const PunctuationProcessor &punctuation_processor,
+                        const fst::SymbolTable *word_syms_table):
+            forward_batch_(forward_batch),
+            samp_freq_(samp_freq), 
+            feature_info_(feature_info),
+            nnet_decoding_config_(nnet_decoding_config), 
+            vad_config_(vad_config), 
+            trans_model_(trans_model), 
+            log_prior_(log_prior),
+            decode_fst_(decode_fst), 
+            punctuation_processor_(punctuation_processor),
+            word_syms_table_(word_syms_table) {
+    }
+    // Here resource is a pointer to a NnetVadDecodeThreadResource
+    virtual OnlineSession *NewSession(int client_socket, void *resource) {
+        return new NnetVadDecodeSession(client_socket, forward_batch_,
+                samp_freq_, feature_info_, nnet_decoding_config_, vad_config_,
+                trans_model_, log_prior_, decode_fst_, punctuation_processor_,
+                word_syms_table_,
+                static_cast<NnetVadDecodeThreadResource *>(resource));
+    }
+private:
+    int forward_batch_;
+    BaseFloat samp_freq_;
+    const OnlineFeaturePipelineConfig &feature_info_;
+    const OnlineNnetDecodingConfig &nnet_decoding_config_;
+    const OnlineNnetVadOptions &vad_config_;
+    const TransitionModel &trans_model_;
+    const CuVector<BaseFloat> &log_prior_;
+    const fst::Fst<fst::StdArc> &decode_fst_;
+    const PunctuationProcessor &punctuation_processor_;
+    const fst::SymbolTable *word_syms_table_;
 };
 
 class NnetVadDecodeThread : public Threadable {
@@ -0,0 +1,299 @@
+// aslp-online/epoll-server.cc
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "aslp-online/epoll-server.h"
+#include "aslp-online/wav-provider.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+static const int kMaxEvents = 256;
+static const int kReadBufferSize = 16384;
+
+static void SetNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        KALDI_ERR << "Set O_NONBLOCK failed on fd " << fd;
+    }
+}
+
+EpollServer::EpollServer(int chunk_length,
+                         int max_package_size,
+                         OnlineSessionFactory *factory,
+                         ThreadPool *workers):
+        chunk_length_(chunk_length),
+        max_package_size_(max_package_size),
+        factory_(factory),
+        workers_(workers),
+        next_conn_id_(0) {
+    KALDI_ASSERT(factory_ != NULL);
+    KALDI_ASSERT(workers_ != NULL);
+    KALDI_ASSERT(chunk_length_ > 0);
+    KALDI_ASSERT(max_package_size_ > 0);
+    epoll_fd_ = epoll_create(kMaxEvents);
+    if (epoll_fd_ == -1) {
+        KALDI_ERR << "epoll_create failed";
+    }
+    event_fd_ = eventfd(0, 0);
+    if (event_fd_ == -1) {
+        KALDI_ERR << "eventfd failed";
+    }
+    SetNonBlocking(event_fd_);
+    pthread_mutex_init(&mutex_, NULL);
+}
+
+EpollServer::~EpollServer() {
+    // Workers must be stopped before, no more ConnectionFinished here
+    std::map<int, Connection *>::iterator it = id_to_conn_.begin();
+    for (; it != id_to_conn_.end(); it++) {
+        if (it->second->session != NULL) delete it->second->session;
+        else close(it->second->fd);
+        for (int i = 0; i < it->second->queued.size(); i++) {
+            delete it->second->queued[i];
+        }
+        delete it->second;
+    }
+    close(epoll_fd_);
+    close(event_fd_);
+    pthread_mutex_destroy(&mutex_);
+}
+
+void EpollServer::AddToEpoll(int fd) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        KALDI_ERR << "epoll_ctl add failed on fd " << fd;
+    }
+}
+
+void EpollServer::Run(const TcpServer &tcp_server) {
+    int listen_fd = tcp_server.Descriptor();
+    KALDI_ASSERT(listen_fd >= 0);
+    SetNonBlocking(listen_fd);
+    AddToEpoll(listen_fd);
+    AddToEpoll(event_fd_);
+    KALDI_LOG << "Epoll server running with " << workers_->NumThreads()
+              << " decode workers";
+
+    struct epoll_event events[kMaxEvents];
+    while (true) {
+        int num = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+        if (num == -1) {
+            if (errno == EINTR) continue;
+            KALDI_ERR << "epoll_wait failed " << strerror(errno);
+        }
+        for (int i = 0; i < num; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd) {
+                AcceptAll(listen_fd);
+            } else if (fd == event_fd_) {
+                uint64_t count;
+                while (read(event_fd_, &count, sizeof(count)) > 0);
+                ReleaseFinished();
+            } else {
+                std::map<int, Connection *>::iterator it = fd_to_conn_.find(fd);
+                // Already finished in this round
+                if (it == fd_to_conn_.end()) continue;
+                ReadConnection(it->second);
+            }
+        }
+    }
+}
+
+void EpollServer::AcceptAll(int listen_fd) {
+    while (true) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd == -1) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                KALDI_WARN << "accept failed " << strerror(errno);
+            }
+            break;
+        }
+        // Note the client socket stays blocking, the event thread reads it
+        // with MSG_DONTWAIT while the worker writes results in blocking mode
+        int id = next_conn_id_++;
+        Connection *conn = new Connection(id, fd, id % workers_->NumThreads());
+        fd_to_conn_[fd] = conn;
+        id_to_conn_[id] = conn;
+        AddToEpoll(fd);
+        KALDI_VLOG(1) << "Accept connection " << id << " on worker "
+                      << conn->worker << ", " << fd_to_conn_.size()
+                      << " connections receiving, "
+                      << workers_->QueueDepth() << " chunks queued";
+    }
+}
+
+void EpollServer::ReadConnection(Connection *conn) {
+    char buf[kReadBufferSize];
+    while (!conn->finished) {
+        int ret = recv(conn->fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (ret > 0) {
+            ParsePackets(conn, buf, ret);
+        } else if (ret == -1 && errno == EINTR) {
+            continue;
+        } else if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            // 0 for the client closed the connection, else socket error
+            conn->finished = true;
+        }
+    }
+
+    if (conn->finished) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn->fd, NULL);
+        // fd will be closed by the worker and may be reused by the
+        // next accept, so forget it here
+        fd_to_conn_.erase(conn->fd);
+        Dispatch(conn, true);
+    } else if (conn->pending.size() >= chunk_length_) {
+        Dispatch(conn, false);
+    }
+}
+
+/* packet format, see WavProvider::ReadOnce
+ * len [4 bytes] + cmd [1 byte] + data[N byte]
+ * cmd: 0x00 audio data + short * N
+ *    : 0x01 finish signal
+ */
+void EpollServer::ParsePackets(Connection *conn, const char *buf, int len) {
+    while (len > 0 && !conn->finished) {
+        if (conn->header_read < 4) {
+            int n = std::min(4 - conn->header_read, len);
+            memcpy(conn->header + conn->header_read, buf, n);
+            conn->header_read += n;
+            buf += n;
+            len -= n;
+            if (conn->header_read == 4) {
+                int32 body_len;
+                memcpy(&body_len, conn->header, 4);
+                body_len = ntohl(body_len);
+                if (body_len <= 0 || body_len > max_package_size_) {
+                    KALDI_WARN << "Bad package size " << body_len
+                               << " from connection " << conn->id;
+                    conn->finished = true;
+                    break;
+                }
+                conn->body_len = body_len;
+                conn->body.resize(body_len);
+                conn->body_read = 0;
+            }
+            continue;
+        }
+        int n = std::min(conn->body_len - conn->body_read, len);
+        memcpy(&conn->body[conn->body_read], buf, n);
+        conn->body_read += n;
+        buf += n;
+        len -= n;
+        if (conn->body_read == conn->body_len) {
+            OnPacket(conn);
+            conn->header_read = 0;
+        }
+    }
+}
+
+void EpollServer::OnPacket(Connection *conn) {
+    int len = conn->body_len;
+    switch (conn->body[0]) {
+        case 0x00: {
+            if ((len - 1) % sizeof(short) != 0) {
+                KALDI_WARN << "Bad audio package size " << len
+                           << " from connection " << conn->id;
+                conn->finished = true;
+                break;
+            }
+            int num_samples = (len - 1) / sizeof(short);
+            int offset = conn->pending.size();
+            conn->pending.resize(offset + num_samples);
+            PcmToFloat(&conn->body[1], num_samples, &conn->pending[offset]);
+        }
+            break;
+        case 0x01:
+            conn->finished = true;
+            break;
+    }
+}
+
+void EpollServer::Dispatch(Connection *conn, bool last) {
+    ChunkTask *task = new ChunkTask(this, conn, last);
+    task->audio.swap(conn->pending);
+    pthread_mutex_lock(&mutex_);
+    bool run = !conn->running;
+    if (run) conn->running = true;
+    else conn->queued.push_back(task);
+    pthread_mutex_unlock(&mutex_);
+    if (run) workers_->AddTask(task, conn->worker);
+}
+
+void EpollServer::ChunkFinished(Connection *conn) {
+    ChunkTask *next = NULL;
+    pthread_mutex_lock(&mutex_);
+    if (!conn->queued.empty()) {
+        next = conn->queued.front();
+        conn->queued.pop_front();
+    } else {
+        conn->running = false;
+    }
+    pthread_mutex_unlock(&mutex_);
+    if (next != NULL) workers_->AddTask(next, conn->worker);
+}
+
+void EpollServer::ConnectionFinished(int conn_id) {
+    pthread_mutex_lock(&mutex_);
+    finished_conn_.push_back(conn_id);
+    pthread_mutex_unlock(&mutex_);
+    uint64_t one = 1;
+    if (write(event_fd_, &one, sizeof(one)) != sizeof(one)) {
+        KALDI_WARN << "Wakeup event thread failed";
+    }
+}
+
+void EpollServer::ReleaseFinished() {
+    std::vector<int> finished;
+    pthread_mutex_lock(&mutex_);
+    finished.swap(finished_conn_);
+    pthread_mutex_unlock(&mutex_);
+    for (int i = 0; i < finished.size(); i++) {
+        std::map<int, Connection *>::iterator it = id_to_conn_.find(finished[i]);
+        KALDI_ASSERT(it != id_to_conn_.end());
+        delete it->second;
+        id_to_conn_.erase(it);
+    }
+}
+
+void EpollServer::ChunkTask::operator() (void *resource) {
+    try {
+        if (conn_->session == NULL) {
+            conn_->session = server_->factory_->NewSession(conn_->fd, resource);
+        }
+        if (audio.size() > 0) {
+            SubVector<BaseFloat> wave_part(&audio[0], audio.size());
+            conn_->session->AcceptAudio(wave_part);
+        }
+        if (last_) {
+            conn_->session->InputFinished();
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what();
+    }
+    if (last_) {
+        // Session closes the client socket
+        if (conn_->session != NULL) delete conn_->session;
+        else close(conn_->fd);
+        conn_->session = NULL;
+        server_->ConnectionFinished(conn_->id);
+    } else {
+        server_->ChunkFinished(conn_);
+    }
+}
+
+} // namespace aslp_online
+} // namespace kaldi
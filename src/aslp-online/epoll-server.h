@@ -0,0 +1,142 @@
+// aslp-online/epoll-server.h
+
+/* Event driven multiplexed front end of the online decoder server.
+ *
+ * One thread waits on all client sockets with epoll and parses the packets
+ * (same format as WavProvider::ReadOnce) without blocking. Whenever a client
+ * has accumulated enough audio, the samples are handed over as a chunk task
+ * to a small pool of decode workers, so the number of concurrent sessions
+ * is bounded by cpu rather than by the number of threads. The chunks of one
+ * connection run one after another, but not always on the same worker: an
+ * idle worker steals the chunks queued to a busy one (see ThreadPool).
+ */
+
+#ifndef ASLP_ONLINE_EPOLL_SERVER_H_
+#define ASLP_ONLINE_EPOLL_SERVER_H_
+
+#include <pthread.h>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+
+#include "aslp-online/tcp-server.h"
+#include "aslp-online/thread-pool.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+// Per connection decoding state. All the calls for one connection are made
+// in order and never at the same time (maybe from different decode workers),
+// so the implementation needs no lock.
+class OnlineSession {
+public:
+    // Audio chunk received from the client
+    virtual void AcceptAudio(const VectorBase<BaseFloat> &wave_part) = 0;
+    // Client finished sending audio (or disconnected), flush the decoder
+    // and send the final results
+    virtual void InputFinished() = 0;
+    // The session owns the client socket and must close it on delete
+    virtual ~OnlineSession() {}
+};
+
+class OnlineSessionFactory {
+public:
+    // Called from the decode worker running the first chunk, @resource is
+    // the resource of that worker (see ThreadPool), the session keeps
+    // using it whichever worker runs the later chunks
+    virtual OnlineSession *NewSession(int client_socket, void *resource) = 0;
+    virtual ~OnlineSessionFactory() {}
+};
+
+class EpollServer {
+public:
+    // @chunk_length: min number of samples handed to a worker in one task
+    // @max_package_size: max bytes of a package body, a larger length
+    //                    closes the connection before anything is allocated
+    // @workers: decode workers, the chunks of a connection are queued to
+    //           the same worker for locality and may be stolen by the others
+    EpollServer(int chunk_length,
+                int max_package_size,
+                OnlineSessionFactory *factory,
+                ThreadPool *workers);
+    ~EpollServer();
+
+    // Serve the clients of the listening tcp_server, never return
+    void Run(const TcpServer &tcp_server);
+
+    // Called by the worker once the session of a connection is deleted
+    void ConnectionFinished(int conn_id);
+
+private:
+    class ChunkTask;
+
+    // Receive state of one client socket, only touched by the event thread
+    // until the last chunk is dispatched
+    struct Connection {
+        Connection(int id, int fd, int worker): id(id), fd(fd), worker(worker),
+            session(NULL), header_read(0), body_len(0), body_read(0),
+            finished(false), running(false) {}
+        int id;
+        int fd;
+        int worker; // the chunks are queued to this worker
+
+        OnlineSession *session; // only touched by the worker
+        char header[4];
+        int header_read;
+        std::vector<char> body;
+        int body_len, body_read;
+        std::vector<BaseFloat> pending; // samples not handed out yet
+        bool finished; // finish signal received or client disconnected
+        // guarded by mutex_, a chunk is in the thread pool, the next ones
+        // wait in queued so the session sees them in order
+        bool running;
+        std::deque<ChunkTask *> queued;
+    };
+
+    class ChunkTask : public Threadable {
+    public:
+        ChunkTask(EpollServer *server, Connection *conn, bool last):
+            server_(server), conn_(conn), last_(last) {}
+        virtual void operator() (void *resource);
+        std::vector<BaseFloat> audio;
+    private:
+        EpollServer *server_;
+        Connection *conn_;
+        bool last_;
+    };
+
+    void AddToEpoll(int fd);
+    void AcceptAll(int listen_fd);
+    // Read all available data of the connection without blocking
+    void ReadConnection(Connection *conn);
+    void ParsePackets(Connection *conn, const char *buf, int len);
+    void OnPacket(Connection *conn);
+    // Hand pending audio to the worker of the connection
+    void Dispatch(Connection *conn, bool last);
+    // Called by the worker once a chunk (not the last) is done, start the
+    // next queued chunk of the connection if any
+    void ChunkFinished(Connection *conn);
+    // Delete the connections whose session is finished
+    void ReleaseFinished();
+
+    int chunk_length_;
+    int max_package_size_;
+    OnlineSessionFactory *factory_;
+    ThreadPool *workers_;
+    int epoll_fd_;
+    int event_fd_; // wakeup the event thread when a connection is finished
+    int next_conn_id_;
+    std::map<int, Connection *> fd_to_conn_; // connections being received
+    std::map<int, Connection *> id_to_conn_; // all live connections
+    std::vector<int> finished_conn_;
+    pthread_mutex_t mutex_; // guard finished_conn_ and the connection queues
+};
+
+} // namespace aslp_online
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,294 @@
+// aslp-online/nnet-batch-scorer.cc
+
+#include <errno.h>
+#include <time.h>
+
+#include "aslp-online/nnet-batch-scorer.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+NnetBatchScorer::Stream::Stream(NnetBatchScorer *scorer):
+        scorer_(scorer), state_(scorer->zero_state_) {
+}
+
+NnetBatchScorer::Stream::~Stream() {
+    scorer_->RemoveStream();
+}
+
+void NnetBatchScorer::Stream::Feedforward(const CuMatrixBase<BaseFloat> &in,
+                                          CuMatrix<BaseFloat> *out) {
+    scorer_->Compute(this, in, out);
+}
+
+int32 NnetBatchScorer::Stream::OutputDim() const {
+    return scorer_->nnet_->OutputDim();
+}
+
+// Components looking at the neighbour rows, the rows of different streams
+// can not be put together for them
+static bool HasFrameContext(const aslp_nnet::Nnet &nnet) {
+    for (int32 c = 0; c < nnet.NumComponents(); c++) {
+        switch (nnet.GetComponent(c).GetType()) {
+            case aslp_nnet::Component::kSplice:
+            case aslp_nnet::Component::kRowConvolution:
+            case aslp_nnet::Component::kCompactFsmn:
+            case aslp_nnet::Component::kBLstmProjectedStreams:
+            case aslp_nnet::Component::kBLstm:
+            case aslp_nnet::Component::kBLstmProjectedStreamsLC:
+            case aslp_nnet::Component::kSentenceAveragingComponent:
+            case aslp_nnet::Component::kSimpleSentenceAveragingComponent:
+                return true;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+static void AddMilliSeconds(const struct timespec &t, int32 ms,
+                            struct timespec *out) {
+    out->tv_sec = t.tv_sec + ms / 1000;
+    out->tv_nsec = t.tv_nsec + (ms % 1000) * 1000000L;
+    if (out->tv_nsec >= 1000000000L) {
+        out->tv_sec++;
+        out->tv_nsec -= 1000000000L;
+    }
+}
+
+NnetBatchScorer::NnetBatchScorer(const NnetBatchScorerOptions &opts,
+                                 aslp_nnet::Nnet *nnet):
+        opts_(opts), nnet_(nnet), num_streams_(0), stop_(false),
+        num_batches_(0), num_requests_(0) {
+    KALDI_ASSERT(nnet_ != NULL);
+    KALDI_ASSERT(opts_.max_batch_streams > 0);
+    KALDI_ASSERT(opts_.max_wait_ms >= 0);
+    if (nnet_->NumOutput() != 1) {
+        KALDI_ERR << "Num output must equal 1";
+    }
+    if (HasFrameContext(*nnet_)) {
+        KALDI_ERR << "Batched scoring only supports frame by frame and "
+                  << "unidirectional multi-stream recurrent components";
+    }
+    // Allocate one stream state to know the state layout
+    std::vector<int32> flags(1, 1);
+    nnet_->ResetLstmStreams(flags);
+    nnet_->GetLstmStreamState(&zero_state_);
+    for (int i = 0; i < zero_state_.size(); i++) {
+        KALDI_ASSERT(zero_state_[i].NumRows() == 1);
+        zero_state_[i].SetZero();
+    }
+    recurrent_ = (zero_state_.size() > 0);
+
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&request_cond_, NULL);
+    pthread_cond_init(&done_cond_, NULL);
+    if (pthread_create(&thread_, NULL, NnetBatchScorer::ScoreThread,
+                       (void *)this) != 0) {
+        KALDI_ERR << "Create scoring thread failed";
+    }
+    KALDI_LOG << "Batch scorer started, recurrent " << recurrent_
+              << ", max batch streams " << opts_.max_batch_streams
+              << ", max wait " << opts_.max_wait_ms << "ms";
+}
+
+NnetBatchScorer::~NnetBatchScorer() {
+    pthread_mutex_lock(&mutex_);
+    stop_ = true;
+    pthread_mutex_unlock(&mutex_);
+    pthread_cond_broadcast(&request_cond_);
+    pthread_join(thread_, NULL);
+    KALDI_LOG << "Batch scorer scored " << num_requests_ << " requests in "
+              << num_batches_ << " batches";
+    pthread_mutex_destroy(&mutex_);
+    pthread_cond_destroy(&request_cond_);
+    pthread_cond_destroy(&done_cond_);
+    delete nnet_;
+}
+
+NnetBatchScorer::Stream *NnetBatchScorer::NewStream() {
+    pthread_mutex_lock(&mutex_);
+    num_streams_++;
+    pthread_mutex_unlock(&mutex_);
+    return new Stream(this);
+}
+
+void NnetBatchScorer::RemoveStream() {
+    pthread_mutex_lock(&mutex_);
+    num_streams_--;
+    pthread_mutex_unlock(&mutex_);
+    // The waiting requests may be all the live streams now
+    pthread_cond_signal(&request_cond_);
+}
+
+void NnetBatchScorer::Compute(Stream *stream,
+                              const CuMatrixBase<BaseFloat> &in,
+                              CuMatrix<BaseFloat> *out) {
+    KALDI_ASSERT(in.NumRows() > 0);
+    KALDI_ASSERT(in.NumCols() == nnet_->InputDim());
+    Request request(stream, &in, out);
+    clock_gettime(CLOCK_REALTIME, &request.arrive);
+    pthread_mutex_lock(&mutex_);
+    pending_.push_back(&request);
+    pthread_cond_signal(&request_cond_);
+    while (!request.done) {
+        pthread_cond_wait(&done_cond_, &mutex_);
+    }
+    pthread_mutex_unlock(&mutex_);
+    if (request.failed) {
+        KALDI_ERR << "Batched nnet forward failed";
+    }
+}
+
+void *NnetBatchScorer::ScoreThread(void *arg) {
+    NnetBatchScorer *scorer = static_cast<NnetBatchScorer *>(arg);
+    scorer->ScoreLoop();
+    return NULL;
+}
+
+bool NnetBatchScorer::WaitBatch() {
+    while (!stop_ && pending_.empty()) {
+        pthread_cond_wait(&request_cond_, &mutex_);
+    }
+    if (stop_) return false;
+    struct timespec deadline;
+    AddMilliSeconds(pending_[0]->arrive, opts_.max_wait_ms, &deadline);
+    // No more request can come if all the live streams are waiting
+    while (!stop_ &&
+           pending_.size() < std::min(num_streams_, opts_.max_batch_streams)) {
+        if (pthread_cond_timedwait(&request_cond_, &mutex_, &deadline)
+                == ETIMEDOUT) {
+            break;
+        }
+    }
+    return !stop_;
+}
+
+void NnetBatchScorer::ScoreLoop() {
+    pthread_mutex_lock(&mutex_);
+    while (WaitBatch()) {
+        int32 num = std::min<int32>(pending_.size(), opts_.max_batch_streams);
+        std::vector<Request *> batch(pending_.begin(), pending_.begin() + num);
+        pending_.erase(pending_.begin(), pending_.begin() + num);
+        pthread_mutex_unlock(&mutex_);
+
+        bool failed = false;
+        try {
+            if (recurrent_) ComputeStreamBatch(batch);
+            else ComputeBatch(batch);
+        } catch (const std::exception &e) {
+            KALDI_WARN << e.what();
+            failed = true;
+        }
+
+        pthread_mutex_lock(&mutex_);
+        for (int i = 0; i < batch.size(); i++) {
+            batch[i]->failed = failed;
+            batch[i]->done = true;
+        }
+        num_batches_++;
+        num_requests_ += batch.size();
+        pthread_cond_broadcast(&done_cond_);
+    }
+    // Stopped, nobody will score the left requests
+    for (int i = 0; i < pending_.size(); i++) {
+        pending_[i]->failed = true;
+        pending_[i]->done = true;
+    }
+    pending_.clear();
+    pthread_cond_broadcast(&done_cond_);
+    pthread_mutex_unlock(&mutex_);
+}
+
+// Frame by frame model, just stack the requests
+void NnetBatchScorer::ComputeBatch(const std::vector<Request *> &batch) {
+    int32 num_rows = 0;
+    for (int i = 0; i < batch.size(); i++) {
+        num_rows += batch[i]->in->NumRows();
+    }
+    CuMatrix<BaseFloat> feats(num_rows, nnet_->InputDim(), kUndefined), out;
+    int32 offset = 0;
+    for (int i = 0; i < batch.size(); i++) {
+        int32 rows = batch[i]->in->NumRows();
+        feats.RowRange(offset, rows).CopyFromMat(*batch[i]->in);
+        offset += rows;
+    }
+    nnet_->Feedforward(feats, &out);
+    offset = 0;
+    for (int i = 0; i < batch.size(); i++) {
+        int32 rows = batch[i]->in->NumRows();
+        batch[i]->out->Resize(rows, out.NumCols(), kUndefined);
+        batch[i]->out->CopyFromMat(out.RowRange(offset, rows));
+        offset += rows;
+    }
+}
+
+/* Recurrent model, the streams of one forward must have the same number of
+ * frames, so the requests are scored in rounds: every round forwards the
+ * first T left frames of the S requests still having frames, T being the
+ * least number of left frames among them.
+ */
+void NnetBatchScorer::ComputeStreamBatch(const std::vector<Request *> &batch) {
+    std::vector<int32> offset(batch.size(), 0);
+    for (int i = 0; i < batch.size(); i++) {
+        batch[i]->out->Resize(batch[i]->in->NumRows(), nnet_->OutputDim(),
+                              kUndefined);
+    }
+    std::vector<CuMatrix<BaseFloat> > state(zero_state_.size());
+    CuMatrix<BaseFloat> feats, out;
+    while (true) {
+        std::vector<Request *> active;
+        std::vector<int32> active_offset;
+        int32 T = 0;
+        for (int i = 0; i < batch.size(); i++) {
+            int32 left = batch[i]->in->NumRows() - offset[i];
+            if (left == 0) continue;
+            if (active.empty() || left < T) T = left;
+            active.push_back(batch[i]);
+            active_offset.push_back(offset[i]);
+        }
+        if (active.empty()) break;
+        int32 S = active.size();
+
+        // Gather input in multi-stream order and the stream states
+        std::vector<const BaseFloat *> in_rows(T * S);
+        std::vector<BaseFloat *> out_rows(T * S);
+        for (int32 t = 0; t < T; t++) {
+            for (int32 s = 0; s < S; s++) {
+                in_rows[t * S + s] = active[s]->in->RowData(active_offset[s] + t);
+                out_rows[t * S + s] = active[s]->out->RowData(active_offset[s] + t);
+            }
+        }
+        feats.Resize(T * S, nnet_->InputDim(), kUndefined);
+        feats.CopyRows(CuArray<const BaseFloat *>(in_rows));
+        for (int c = 0; c < state.size(); c++) {
+            std::vector<const BaseFloat *> state_rows(S);
+            for (int32 s = 0; s < S; s++) {
+                state_rows[s] = active[s]->stream->state_[c].RowData(0);
+            }
+            state[c].Resize(S, zero_state_[c].NumCols(), kUndefined);
+            state[c].CopyRows(CuArray<const BaseFloat *>(state_rows));
+        }
+        nnet_->SetLstmStreamState(state);
+
+        nnet_->Feedforward(feats, &out);
+
+        // Scatter output and the new stream states
+        out.CopyToRows(CuArray<BaseFloat *>(out_rows));
+        nnet_->GetLstmStreamState(&state);
+        for (int c = 0; c < state.size(); c++) {
+            std::vector<BaseFloat *> state_rows(S);
+            for (int32 s = 0; s < S; s++) {
+                state_rows[s] = active[s]->stream->state_[c].RowData(0);
+            }
+            state[c].CopyToRows(CuArray<BaseFloat *>(state_rows));
+        }
+
+        for (int i = 0; i < batch.size(); i++) {
+            if (offset[i] < batch[i]->in->NumRows()) offset[i] += T;
+        }
+    }
+}
+
+} // namespace aslp_online
+} // namespace kaldi
@@ -0,0 +1,120 @@
+// aslp-online/nnet-batch-scorer.h
+
+/* Cross session batched acoustic model scoring.
+ *
+ * Every online decoder calls Nnet::Feedforward on only a few frames, which
+ * makes many tiny GEMMs when there are lots of live streams. Here all the
+ * decodables share one NnetBatchScorer: their forward requests are queued,
+ * and a scoring thread runs one Feedforward over the frames of all the
+ * waiting streams and scatters the outputs back.
+ *
+ * For recurrent models (the components supported by Nnet::ResetLstmStreams)
+ * the requests are laid out as multi-stream input (row t * S + s is frame t
+ * of stream s) and the recurrent state of every stream is saved and
+ * restored around each batch, so the output of a stream is the same as if
+ * it was forwarded alone.
+ */
+
+#ifndef ASLP_ONLINE_NNET_BATCH_SCORER_H_
+#define ASLP_ONLINE_NNET_BATCH_SCORER_H_
+
+#include <pthread.h>
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+
+#include "aslp-nnet/nnet-nnet.h"
+#include "aslp-nnet/nnet-decodable.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+struct NnetBatchScorerOptions {
+    int32 max_batch_streams;
+    int32 max_wait_ms;
+
+    NnetBatchScorerOptions(): max_batch_streams(64), max_wait_ms(10) {}
+
+    void Register(OptionsItf *opts) {
+        opts->Register("batch-max-streams", &max_batch_streams,
+                "Max number of streams scored in one nnet forward");
+        opts->Register("batch-max-wait-ms", &max_wait_ms,
+                "Max time(ms) a forward request waits for other streams "
+                "before it is scored");
+    }
+};
+
+class NnetBatchScorer {
+public:
+    // One decoding stream, the forward interface of its decodable.
+    // Get it by NewStream() and delete it when the decoding is done.
+    class Stream : public aslp_nnet::NnetForwardInterface {
+    public:
+        ~Stream();
+        // Block until the batch including @in is scored
+        virtual void Feedforward(const CuMatrixBase<BaseFloat> &in,
+                                 CuMatrix<BaseFloat> *out);
+        virtual int32 OutputDim() const;
+    private:
+        friend class NnetBatchScorer;
+        explicit Stream(NnetBatchScorer *scorer);
+        NnetBatchScorer *scorer_;
+        // Recurrent state, one single row matrix per recurrent component
+        std::vector<CuMatrix<BaseFloat> > state_;
+    };
+
+    // The scorer takes the ownership of @nnet, which must be a model with
+    // only frame by frame or multi-stream recurrent components
+    NnetBatchScorer(const NnetBatchScorerOptions &opts, aslp_nnet::Nnet *nnet);
+    ~NnetBatchScorer();
+
+    // A new stream with zero recurrent state
+    Stream *NewStream();
+
+private:
+    struct Request {
+        Request(Stream *stream, const CuMatrixBase<BaseFloat> *in,
+                CuMatrix<BaseFloat> *out):
+            stream(stream), in(in), out(out), done(false), failed(false) {}
+        Stream *stream;
+        const CuMatrixBase<BaseFloat> *in;
+        CuMatrix<BaseFloat> *out;
+        struct timespec arrive;
+        bool done, failed;
+    };
+
+    void Compute(Stream *stream, const CuMatrixBase<BaseFloat> &in,
+                 CuMatrix<BaseFloat> *out);
+    void RemoveStream();
+    static void *ScoreThread(void *arg);
+    void ScoreLoop();
+    // Wait until all the live streams (or max_batch_streams) are queued or
+    // the oldest request has waited max_wait_ms, called with mutex_ held,
+    // false for stop
+    bool WaitBatch();
+    void ComputeBatch(const std::vector<Request *> &batch);
+    void ComputeStreamBatch(const std::vector<Request *> &batch);
+
+    NnetBatchScorerOptions opts_;
+    aslp_nnet::Nnet *nnet_;
+    bool recurrent_;
+    // Recurrent state of a new stream
+    std::vector<CuMatrix<BaseFloat> > zero_state_;
+    int32 num_streams_; // live streams
+    std::vector<Request *> pending_;
+    bool stop_;
+    pthread_t thread_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t request_cond_; // new request or stream removed
+    pthread_cond_t done_cond_; // batch finished
+    // Statistics
+    int64 num_batches_, num_requests_;
+    KALDI_DISALLOW_COPY_AND_ASSIGN(NnetBatchScorer);
+};
+
+} // namespace aslp_online
+} // namespace kaldi
+
+#endif
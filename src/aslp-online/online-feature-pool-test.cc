@@ -0,0 +1,62 @@
+// aslp-online/online-feature-pool-test.cc
+
+/* Created on 2018-05-06
+ * Author: Binbin Zhang
+ */
+
+#include "aslp-online/online-feature-pool.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+// Feed random chunks and read the frames in order as the decodable does,
+// the frames must be the fed ones and the ring must stay small
+void TestOnlineFeaturePool() {
+    int32 dim = 10 + Rand() % 20, left_context = Rand() % 5;
+    OnlineFeaturePool pool(dim, left_context);
+    Matrix<BaseFloat> feats(1000 + Rand() % 1000, dim);
+    feats.SetRandn();
+    Vector<BaseFloat> frame(dim);
+    int32 num_fed = 0, num_read = 0;
+    while (num_fed < feats.NumRows()) {
+        int32 num = std::min(1 + Rand() % 50, feats.NumRows() - num_fed);
+        pool.AcceptFeature(feats.RowRange(num_fed, num));
+        num_fed += num;
+        KALDI_ASSERT(pool.NumFramesReady() == num_fed);
+        // read all but a few frames
+        int32 end = num_fed - Rand() % 3;
+        for (; num_read < end; num_read++) {
+            // the left context is still there
+            int32 t = std::max(0, num_read - left_context);
+            SubVector<BaseFloat> fed(feats, t), fed_read(feats, num_read);
+            pool.GetFrame(t, &frame);
+            AssertEqual(frame, fed);
+            pool.GetFrame(num_read, &frame);
+            AssertEqual(frame, fed_read);
+        }
+        KALDI_ASSERT(pool.BeginFrame() >= num_read - 1 - left_context);
+    }
+    pool.InputFinished();
+    KALDI_ASSERT(pool.IsLastFrame(feats.NumRows() - 1));
+    // frames which are released can not be read
+    pool.DiscardFrames(feats.NumRows() - 1);
+    bool threw = false;
+    try {
+        pool.GetFrame(feats.NumRows() - 2, &frame);
+    } catch (const std::exception &e) {
+        threw = true;
+    }
+    KALDI_ASSERT(threw);
+}
+
+} // namespace aslp_online
+} // namespace kaldi
+
+int main() {
+    using namespace kaldi::aslp_online;
+    for (int i = 0; i < 10; i++) {
+        TestOnlineFeaturePool();
+    }
+    KALDI_LOG << "Test OK.";
+    return 0;
+}
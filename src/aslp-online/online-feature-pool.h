@@ -14,17 +14,33 @@
 namespace kaldi {
 namespace aslp_online {
 
+// Features fed by the caller (eg. the speech frames after vad), kept in a
+// ring buffer indexed by the absolute frame index. The decodable reads the
+// frames in order, so once frame t is read the frames before
+// t - left_context are released, and the memory is bounded by the frames
+// not consumed yet however long the session is.
 class OnlineFeaturePool : public OnlineFeatureInterface {
 public:
-    OnlineFeaturePool(int dim): dim_(dim), num_frames_(0),
-                                input_finished_(false) { }
+    // left_context is the number of frames kept before the last frame read,
+    // for consumers which look back (eg. Nnet::GetContext())
+    explicit OnlineFeaturePool(int dim, int left_context = 0):
+        dim_(dim), left_context_(left_context), begin_frame_(0),
+        num_frames_(0), input_finished_(false) {
+        KALDI_ASSERT(left_context >= 0);
+    }
 
     virtual int32 Dim() const { return dim_; }
 
     virtual int32 NumFramesReady() const { return num_frames_; }
 
     virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
-        feat->CopyFromVec(feature_pool_.Row(frame));
+        if (frame < begin_frame_ || frame >= num_frames_) {
+            KALDI_ERR << "Frame " << frame << " is not in the pool, which keeps"
+                      << " frames [" << begin_frame_ << ", " << num_frames_
+                      << ")";
+        }
+        feat->CopyFromVec(feature_pool_.Row(frame % feature_pool_.NumRows()));
+        DiscardFrames(frame - left_context_);
     }
 
     virtual bool IsLastFrame(int32 frame) const {
@@ -39,19 +55,44 @@ public:
         KALDI_ASSERT(feat.NumCols() == dim_);
         if (feat.NumRows() == 0) return;
         int new_num_frames = num_frames_ + feat.NumRows();
-        // If the feature pool is not big enough, expand it
-        if (new_num_frames > feature_pool_.NumRows()) {
-            int32 new_num_rows = std::max<int32>(new_num_frames,
-                                                 feature_pool_.NumRows() * 2);
-            feature_pool_.Resize(new_num_rows, Dim(), kCopyData);
+        // If the ring is not big enough for the kept frames, expand it
+        if (new_num_frames - begin_frame_ > feature_pool_.NumRows()) {
+            Expand(std::max<int32>(new_num_frames - begin_frame_,
+                                   feature_pool_.NumRows() * 2));
+        }
+        int32 capacity = feature_pool_.NumRows();
+        for (int32 i = 0; i < feat.NumRows(); i++) {
+            feature_pool_.Row((num_frames_ + i) % capacity).CopyFromVec(
+                    feat.Row(i));
         }
-        feature_pool_.Range(num_frames_, feat.NumRows(), 0, 
-                        Dim()).CopyFromMat(feat);
         num_frames_ = new_num_frames;
     }
 
+    // Release the frames before frame, they can not be read any more
+    void DiscardFrames(int32 frame) {
+        begin_frame_ = std::max(begin_frame_, std::min(frame, num_frames_));
+    }
+
+    // The first frame still kept
+    int32 BeginFrame() const { return begin_frame_; }
+
 private:
+    // Move the kept frames to a ring of num_rows
+    void Expand(int32 num_rows) {
+        Matrix<BaseFloat> new_pool(num_rows, dim_, kUndefined);
+        int32 capacity = feature_pool_.NumRows();
+        for (int32 t = begin_frame_; t < num_frames_; t++) {
+            new_pool.Row(t % num_rows).CopyFromVec(
+                    feature_pool_.Row(t % capacity));
+        }
+        feature_pool_.Swap(&new_pool);
+    }
+
     int dim_;
+    int left_context_;
+    // The pool keeps the frames [begin_frame_, num_frames_), frame t is in
+    // row t % feature_pool_.NumRows()
+    int begin_frame_;
     int num_frames_;
     bool input_finished_;
     Matrix<BaseFloat> feature_pool_;
@@ -33,12 +33,15 @@ MultiUtteranceNnetDecoder::MultiUtteranceNnetDecoder(
         aslp_nnet::Nnet *model,
         const CuVector<BaseFloat> &log_prior,
         const fst::Fst<fst::StdArc> &fst,
-        OnlineFeatureInterface *feature_interface):
+        OnlineFeatureInterface *feature_interface,
+        aslp_nnet::NnetForwardInterface *forward):
     config_(config),
     feature_interface_(feature_interface),
     tmodel_(tmodel),
-    decodable_(model, log_prior, tmodel, config.decodable_opts, feature_interface_),
-    decoder_(fst, config.decoder_opts) {
+    decodable_(model, log_prior, tmodel, config.decodable_opts, 
+               feature_interface_, forward),
+    decoder_(fst, config.decoder_opts),
+    traceback_(tmodel) {
         decoder_.InitDecoding();
 }
 
@@ -75,12 +78,16 @@ void MultiUtteranceNnetDecoder::GetBestPath(bool end_of_utterance,
 }
 
 bool MultiUtteranceNnetDecoder::EndpointDetected(
-        const OnlineEndpointConfig &config) {
-    KALDI_ERR << "Not implemented";
-    //return aslp_online::EndpointDetected(config, tmodel_,
-    //        feature_interface_->FrameShiftInSeconds(),
-    //        decoder_);  
-    return false;
+        const OnlineEndpointConfig &config,
+        BaseFloat frame_shift_in_seconds) {
+    if (decoder_.NumFramesDecoded() == 0) return false;
+    if (traceback_.SilencePhones() != config.silence_phones) {
+        traceback_.SetSilencePhones(config.silence_phones);
+    }
+    traceback_.Update(decoder_);
+    return aslp_online::EndpointDetected(config, decoder_.NumFramesDecoded(),
+            traceback_.TrailingSilenceLength(), frame_shift_in_seconds,
+            decoder_.FinalRelativeCost());
 }
 
 //void MultiUtteranceNnetDecoder::GetPartialResult(const fst::SymbolTable *word_syms, 
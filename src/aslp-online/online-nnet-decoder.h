@@ -37,6 +37,7 @@
 #include "aslp-online/online-endpoint.h"
 #include "aslp-online/online-helper.h"
 #include "aslp-online/online-feature-pipeline.h"
+#include "aslp-online/online-traceback.h"
 
 namespace kaldi {
 namespace aslp_online {
@@ -66,13 +67,15 @@ struct OnlineNnetDecodingConfig {
 class MultiUtteranceNnetDecoder {
 public:
     // Constructor.  The feature_pipeline_ pointer is not owned in this
-    // class, it's owned externally.
+    // class, it's owned externally. If forward is not NULL, the acoustic
+    // scores are computed by it instead of model (see NnetBatchScorer).
     MultiUtteranceNnetDecoder(const OnlineNnetDecodingConfig &config,
             const TransitionModel &tmodel,
             aslp_nnet::Nnet *model,
             const CuVector<BaseFloat> &log_prior,
             const fst::Fst<fst::StdArc> &fst,
-            OnlineFeatureInterface *feat_interface);
+            OnlineFeatureInterface *feat_interface,
+            aslp_nnet::NnetForwardInterface *forward = NULL);
 
     ~MultiUtteranceNnetDecoder() { }
     /// advance the decoding as far as we can.
@@ -102,8 +105,10 @@ public:
 
 
     /// This function calls EndpointDetected from online-endpoint.h,
-    /// with the required arguments.
-    bool EndpointDetected(const OnlineEndpointConfig &config);
+    /// with the required arguments, the trailing silence is from the
+    /// incremental traceback.
+    bool EndpointDetected(const OnlineEndpointConfig &config,
+                          BaseFloat frame_shift_in_seconds);
 
     /// This function resets the data member feature_interface_ and calls
     /// decoder_.InitDecoding().
@@ -113,16 +118,16 @@ public:
         feature_interface_ = new_feat_interface;
         decodable_.ResetFeature(feature_interface_);
         decoder_.InitDecoding();
+        traceback_.Reset();
     }
 
-    /// This function get the partial result by calling the function GetBestPath.
+    /// This function gets the partial result from the best path, which is
+    /// traced back incrementally (see IncrementalTraceback), so it only
+    /// costs the frames decoded since the last call.
     inline void GetPartialResult(const fst::SymbolTable *word_syms,
             std::string *result) {
-        decoder_.GetBestPath(&lat_, false);
-        GetLinearSymbolSequence(lat_, static_cast<std::vector<int32> *>(0), 
-                &words_,
-                static_cast<LatticeWeight *>(0));
-        aslp_online::WordsToString(words_, word_syms, "", result);
+        traceback_.Update(decoder_);
+        aslp_online::WordsToString(traceback_.Words(), word_syms, "", result);
     }
 
 private:
@@ -137,9 +142,8 @@ private:
 
     LatticeFasterOnlineDecoder decoder_;
 
-    // only used by GetPartialResult()
-    Lattice lat_;
-    std::vector<int32> words_;
+    // best path kept between the GetPartialResult() calls
+    IncrementalTraceback traceback_;
 
 };
 
@@ -0,0 +1,131 @@
+// aslp-online/online-traceback-test.cc
+
+#include <algorithm>
+
+#include "aslp-online/online-traceback.h"
+#include "aslp-online/online-endpoint.h"
+#include "decoder/decodable-matrix.h"
+#include "fstext/fstext-utils.h"
+#include "tree/context-dep.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+// Small graph on all the transition ids, every state goes to every state
+// with random weights and some words, plus epsilon arcs with words, so the
+// tokens of different states have different histories and the best path
+// changes its past from time to time
+fst::StdVectorFst *GenRandGraph(const TransitionModel &tmodel,
+                                int32 num_states) {
+    fst::StdVectorFst *graph = new fst::StdVectorFst;
+    for (int32 s = 0; s < num_states; s++) {
+        graph->AddState();
+        graph->SetFinal(s, fst::TropicalWeight::One());
+    }
+    graph->SetStart(0);
+    for (int32 s = 0; s < num_states; s++) {
+        for (int32 tid = 1; tid <= tmodel.NumTransitionIds(); tid++) {
+            int32 word = (rand() % 4 == 0) ? 1 + rand() % 10 : 0;
+            graph->AddArc(s, fst::StdArc(tid, word, 2.0 * RandUniform(),
+                                         rand() % num_states));
+        }
+        // forward only, no epsilon cycle
+        if (s + 1 < num_states) {
+            graph->AddArc(s, fst::StdArc(0, 11 + s, 1.0 + RandUniform(),
+                                         s + 1));
+        }
+    }
+    return graph;
+}
+
+// The full traceback, words of GetBestPath() and TrailingSilenceLength()
+void FullTraceback(const TransitionModel &tmodel,
+                   const std::string &silence_phones,
+                   const LatticeFasterOnlineDecoder &decoder,
+                   std::vector<int32> *alignment,
+                   std::vector<int32> *words,
+                   int32 *num_silence_frames) {
+    Lattice best_path;
+    decoder.GetBestPath(&best_path, false);
+    LatticeWeight weight;
+    KALDI_ASSERT(fst::GetLinearSymbolSequence(best_path, alignment, words,
+                                              &weight));
+    *num_silence_frames = TrailingSilenceLength(tmodel, silence_phones,
+                                                decoder);
+}
+
+void UnitTestIncrementalTraceback() {
+    std::vector<int32> phones;
+    for (int32 p = 1; p <= 4; p++) phones.push_back(p);
+    HmmTopology topo = GetDefaultTopology(phones);
+    std::vector<int32> phone2num_pdf_classes;
+    topo.GetPhoneToNumPdfClasses(&phone2num_pdf_classes);
+    ContextDependency *ctx_dep = MonophoneContextDependency(phones,
+        phone2num_pdf_classes);
+    TransitionModel tmodel(*ctx_dep, topo);
+    delete ctx_dep;
+
+    fst::StdVectorFst *graph = GenRandGraph(tmodel, 4);
+    LatticeFasterDecoderConfig config;
+    config.beam = 10.0;
+    LatticeFasterOnlineDecoder decoder(*graph, config);
+    IncrementalTraceback traceback(tmodel);
+    std::string silence_phones = "1";
+    traceback.SetSilencePhones(silence_phones);
+
+    int32 num_changes = 0, num_silence = 0;
+    for (int32 utt = 0; utt < 3; utt++) {
+        int32 num_frames = 50 + rand() % 100;
+        Matrix<BaseFloat> loglikes(num_frames, tmodel.NumPdfs());
+        loglikes.SetRandn();
+        loglikes.Scale(3.0);
+        DecodableMatrixScaledMapped decodable(tmodel, loglikes, 1.0);
+        decoder.InitDecoding();
+        traceback.Reset();
+        std::vector<int32> prev_alignment;
+        for (int32 t = 0; t < num_frames; t++) {
+            decoder.AdvanceDecoding(&decodable, 1);
+            KALDI_ASSERT(decoder.NumFramesDecoded() == t + 1);
+            // the silence phones may change in the middle of the utterance
+            if (utt == 1 && t == num_frames / 2) {
+                silence_phones = "1:2";
+                traceback.SetSilencePhones(silence_phones);
+            }
+            traceback.Update(decoder);
+            std::vector<int32> alignment, words;
+            int32 num_silence_frames;
+            FullTraceback(tmodel, silence_phones, decoder, &alignment, &words,
+                          &num_silence_frames);
+            KALDI_ASSERT(traceback.Words() == words);
+            KALDI_ASSERT(traceback.TrailingSilenceLength() ==
+                         num_silence_frames);
+            // the past of the best path changed, not only extended
+            if (!std::equal(prev_alignment.begin(), prev_alignment.end(),
+                            alignment.begin())) {
+                num_changes++;
+            }
+            if (num_silence_frames > 0) num_silence++;
+            prev_alignment.swap(alignment);
+        }
+        silence_phones = "1";
+        traceback.SetSilencePhones(silence_phones);
+    }
+    // or the kept path was never cut
+    KALDI_LOG << num_changes << " best path changes, " << num_silence
+              << " frames with trailing silence";
+    KALDI_ASSERT(num_changes > 0 && num_silence > 0);
+    delete graph;
+}
+
+} // namespace aslp_online
+} // namespace kaldi
+
+int main() {
+    using namespace kaldi;
+    using namespace kaldi::aslp_online;
+    for (int32 i = 0; i < 3; i++) {
+        UnitTestIncrementalTraceback();
+    }
+    KALDI_LOG << "Tests succeeded.";
+    return 0;
+}
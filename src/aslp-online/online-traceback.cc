@@ -0,0 +1,89 @@
+// aslp-online/online-traceback.cc
+
+#include <algorithm>
+
+#include "aslp-online/online-traceback.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+void IncrementalTraceback::Reset() {
+    path_.clear();
+    words_.clear();
+}
+
+void IncrementalTraceback::Update(const LatticeFasterOnlineDecoder &decoder) {
+    if (decoder.NumFramesDecoded() == 0) {
+        Reset();
+        return;
+    }
+    LatticeFasterOnlineDecoder::BestPathIterator iter =
+        decoder.BestPathEnd(false, NULL);
+    // Trace back until the token is on the kept path, the frames only go
+    // back, so does the position k on the kept path
+    int32 k = static_cast<int32>(path_.size()) - 1, meet = -1;
+    suffix_.clear();
+    while (!iter.Done()) {
+        while (k >= 0 && path_[k].frame > iter.frame) k--;
+        for (int32 m = k; m >= 0 && path_[m].frame == iter.frame; m--) {
+            if (path_[m].tok == iter.tok) {
+                meet = m;
+                break;
+            }
+        }
+        if (meet >= 0) break;
+        Link link;
+        link.tok = iter.tok;
+        link.frame = iter.frame;
+        LatticeArc arc;
+        iter = decoder.TraceBackBestPath(iter, &arc);
+        link.ilabel = arc.ilabel;
+        link.olabel = arc.olabel;
+        suffix_.push_back(link);
+    }
+    // meet is -1 if the whole path is traced back
+    path_.resize(meet + 1);
+    words_.resize(meet >= 0 ? path_[meet].num_words : 0);
+    for (int32 i = static_cast<int32>(suffix_.size()) - 1; i >= 0; i--) {
+        path_.push_back(suffix_[i]);
+        CountLink(path_.size() - 1);
+        if (path_.back().olabel != 0) words_.push_back(path_.back().olabel);
+    }
+}
+
+void IncrementalTraceback::CountLink(int32 i) {
+    Link &link = path_[i];
+    int32 prev_words = 0, prev_silence = 0;
+    if (i > 0) {
+        prev_words = path_[i - 1].num_words;
+        prev_silence = path_[i - 1].num_silence_frames;
+    }
+    link.num_words = prev_words + (link.olabel != 0 ? 1 : 0);
+    if (link.ilabel == 0) {
+        link.num_silence_frames = prev_silence;
+    } else if (silence_phones_.empty()) {
+        link.num_silence_frames = 0;
+    } else {
+        int32 phone = tmodel_.TransitionIdToPhone(link.ilabel);
+        bool silence = std::binary_search(silence_phones_.begin(),
+                                          silence_phones_.end(), phone);
+        link.num_silence_frames = silence ? prev_silence + 1 : 0;
+    }
+}
+
+void IncrementalTraceback::SetSilencePhones(const std::string &silence_phones) {
+    std::vector<int32> phones;
+    if (!SplitStringToIntegers(silence_phones, ":", false, &phones))
+        KALDI_ERR << "Bad --silence-phones option in endpointing config: "
+                  << silence_phones;
+    std::sort(phones.begin(), phones.end());
+    KALDI_ASSERT(IsSortedAndUniq(phones) &&
+                 "Duplicates in --silence-phones option in endpointing config");
+    silence_phones_str_ = silence_phones;
+    silence_phones_.swap(phones);
+    // count the kept path again with the new phones
+    for (int32 i = 0; i < path_.size(); i++) CountLink(i);
+}
+
+} // namespace aslp_online
+} // namespace kaldi
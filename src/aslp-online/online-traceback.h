@@ -0,0 +1,89 @@
+// aslp-online/online-traceback.h
+
+/* Incremental best path traceback of LatticeFasterOnlineDecoder.
+ *
+ * LatticeFasterOnlineDecoder::GetBestPath() traces the best token back to
+ * the start of the utterance, so getting the partial result every few
+ * hundred milliseconds costs more and more as the utterance goes on. Here
+ * the traceback is kept between the calls, the backpointer of a token never
+ * changes once its frame is decoded, so Update() only traces back from the
+ * current best token until it meets a token of the kept path, then the kept
+ * path before it is reused. This costs the frames decoded since the last
+ * call (plus the frames where the best path changed), the trailing silence
+ * for endpointing is kept incrementally too.
+ *
+ * A token of the kept path may be pruned by the decoder, the kept path only
+ * compares its address (together with the frame, a token is only created
+ * while its frame is decoded so the address can not be reused by another
+ * token of the same frame), it is never dereferenced.
+ */
+
+#ifndef ASLP_ONLINE_ONLINE_TRACEBACK_H_
+#define ASLP_ONLINE_ONLINE_TRACEBACK_H_
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "decoder/lattice-faster-online-decoder.h"
+#include "hmm/transition-model.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+class IncrementalTraceback {
+public:
+    explicit IncrementalTraceback(const TransitionModel &tmodel):
+        tmodel_(tmodel) {}
+
+    // Forget the path, must be called when the decoder is initialized
+    // again (InitDecoding()), its tokens are all gone
+    void Reset();
+
+    // Trace the best token of decoder (not using final-probs) back to the
+    // kept path
+    void Update(const LatticeFasterOnlineDecoder &decoder);
+
+    // Output labels (words) of the best path
+    const std::vector<int32> &Words() const { return words_; }
+
+    // Colon-separated list of the silence phones, for
+    // TrailingSilenceLength(), the same as OnlineEndpointConfig
+    void SetSilencePhones(const std::string &silence_phones);
+    const std::string &SilencePhones() const { return silence_phones_str_; }
+
+    // Number of frames of trailing silence of the best path, same as
+    // aslp_online::TrailingSilenceLength() but O(1)
+    int32 TrailingSilenceLength() const {
+        return path_.empty() ? 0 : path_.back().num_silence_frames;
+    }
+
+private:
+    // One link of the path, the link into tok (the start token has a dummy
+    // link with zero labels)
+    struct Link {
+        void *tok;
+        int32 frame;  // frame of LatticeFasterOnlineDecoder::BestPathIterator
+        int32 ilabel;
+        int32 olabel;
+        int32 num_words;  // number of words up to and including this link
+        int32 num_silence_frames;  // trailing silence frames at this link
+    };
+
+    // Fill the counts of path_[i] from path_[i - 1]
+    void CountLink(int32 i);
+
+    const TransitionModel &tmodel_;
+    std::vector<Link> path_;
+    std::vector<int32> words_;
+    std::string silence_phones_str_;
+    std::vector<int32> silence_phones_;  // sorted
+    // Links traced back by Update(), in reverse order
+    std::vector<Link> suffix_;
+};
+
+} // namespace aslp_online
+} // namespace kaldi
+
+#endif
@@ -2,6 +2,7 @@
    Author: xukaituo zhangbinbin
 */
 #include "aslp-online/punctuation-processor.h"
+#include "aslp-online/wav-provider.h"
 
 namespace kaldi {
 namespace aslp_online {
@@ -59,6 +60,52 @@ void PunctuationProcessor::ConvertToOutput(const char *output, std::string *raw_
     }
 }
 
+class PunctuationTask : public Threadable {
+public:
+    PunctuationTask(int client_socket, const std::string &text):
+        client_socket_(client_socket), text_(text) {}
+    // Here resource is the PunctuationProcessor of the thread
+    virtual void operator() (void *resource) {
+        PunctuationProcessor *processor =
+            static_cast<PunctuationProcessor *>(resource);
+        // closes the client_socket on return
+        WavProvider writer(client_socket_);
+        try {
+            std::string punc_result;
+            processor->Process(text_, &punc_result);
+            KALDI_LOG << "Final Punctuation Result: " << punc_result;
+            writer.WritePuncResult(punc_result);
+        } catch (const std::exception &e) {
+            std::cerr << e.what();
+        }
+        writer.WriteEOS();
+    }
+private:
+    int client_socket_;
+    std::string text_;
+};
+
+PunctuationPool::PunctuationPool(const char *file_name, int num_thread) {
+    KALDI_ASSERT(num_thread > 0);
+    processors_.resize(num_thread);
+    for (int i = 0; i < num_thread; i++) {
+        processors_[i] = new PunctuationProcessor(file_name);
+    }
+    thread_pool_ = new ThreadPool(num_thread, &processors_);
+}
+
+PunctuationPool::~PunctuationPool() {
+    // the threads finish the queued tasks before exit
+    delete thread_pool_;
+    for (int i = 0; i < processors_.size(); i++) {
+        delete static_cast<PunctuationProcessor *>(processors_[i]);
+    }
+}
+
+void PunctuationPool::AddTask(int client_socket, const std::string &text) {
+    thread_pool_->AddTask(new PunctuationTask(client_socket, text));
+}
+
 } // namespace aslp_online
 } // namespace kaldi
 
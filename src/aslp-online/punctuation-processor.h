@@ -4,31 +4,71 @@
 #ifndef ASLP_PUNCTUATION_PROCESSOR_H_
 #define ASLP_PUNCTUATION_PROCESSOR_H_
 
+#include <pthread.h>
+
 #include <string>
+#include <vector>
 
 #include "crfpp.h"
 
+#include "base/kaldi-common.h"
+
+#include "aslp-online/thread-pool.h"
+
 namespace kaldi {
 namespace aslp_online {
 
+// The CRF++ tagger is not re-entrant, so Process() is serialized by a
+// mutex when the processor is shared by threads, see PunctuationPool for
+// one tagger per thread
 class PunctuationProcessor {
 public:
     PunctuationProcessor(const char *file_name) {
         char param[1024] = {'\0'};
         sprintf(param, "-m %s", file_name);
         tagger = CRFPP::createTagger(param);
+        pthread_mutex_init(&mutex_, NULL);
+    }
+
+    ~PunctuationProcessor() {
+        delete tagger;
+        pthread_mutex_destroy(&mutex_);
     }
 
     void Process(const std::string &raw_input, std::string *raw_output) const {
         std::string input;
         ConvertToInput(raw_input, &input);
+        pthread_mutex_lock(&mutex_);
         const char *output = tagger->parse(input.c_str());
         ConvertToOutput(output, raw_output);
+        pthread_mutex_unlock(&mutex_);
     }
 private:
     void ConvertToInput(const std::string &raw_input, std::string *input) const; 
     void ConvertToOutput(const char *output, std::string *raw_output) const; 
     CRFPP::Tagger *tagger;
+    mutable pthread_mutex_t mutex_;
+    KALDI_DISALLOW_COPY_AND_ASSIGN(PunctuationProcessor);
+};
+
+// Punctuation as a stage of its own, so the decode threads send the final
+// result and go on with the next session. The punctuation tasks are queued
+// to a ThreadPool with one PunctuationProcessor (tagger) per thread, so the
+// taggers never race, and the sessions of all the decode threads are
+// punctuated by the same few threads.
+class PunctuationPool {
+public:
+    PunctuationPool(const char *file_name, int num_thread);
+    // Wait the queued tasks done
+    ~PunctuationPool();
+
+    // Punctuate text, then send the result and EOS (see WavProvider) to the
+    // client and close client_socket, whose ownership is taken
+    void AddTask(int client_socket, const std::string &text);
+private:
+    std::vector<void *> processors_;
+    ThreadPool *thread_pool_;
+    KALDI_DISALLOW_COPY_AND_ASSIGN(PunctuationPool);
 };
 
 } // namespace aslp_online
@@ -6,7 +6,7 @@ TcpServer::TcpServer() {
   server_desc_ = -1;
 }
 
-bool TcpServer::Listen(int32 port) {
+bool TcpServer::Listen(int32 port, int32 backlog) {
   h_addr_.sin_addr.s_addr = INADDR_ANY;
   h_addr_.sin_port = htons(port);
   h_addr_.sin_family = AF_INET;
@@ -30,7 +30,7 @@ bool TcpServer::Listen(int32 port) {
     return false;
   }
 
-  if (listen(server_desc_, 1) == -1) {
+  if (listen(server_desc_, backlog) == -1) {
     KALDI_ERR << "Cannot listen on port!";
     return false;
   }
@@ -23,8 +23,10 @@ class TcpServer {
   TcpServer();
   ~TcpServer();
   
-  bool Listen(int32 port);  //start listening on a given port
+  //start listening on a given port, backlog is the max pending connections
+  bool Listen(int32 port, int32 backlog = 1);
   int32 Accept();  //accept a client and return its descriptor
+  int32 Descriptor() const { return server_desc_; } //listening socket
 
  private:
   struct sockaddr_in h_addr_;
@@ -30,9 +30,52 @@ void TestThreadPool() {
     }
 }
 
+// Count the tasks run with every resource
+class CountTask : public Threadable {
+public:
+    virtual void operator() (void *resource) {
+        __sync_fetch_and_add(static_cast<int *>(resource), 1);
+        for (volatile int i = 0; i < 10000; i++);
+    }
+};
+
+void TestThreadPoolSteal() {
+    const int num_thread = 4, num_task = 1000;
+    std::vector<int> count(num_thread, 0);
+    std::vector<void *> resource(num_thread);
+    for (int i = 0; i < num_thread; i++) resource[i] = &count[i];
+    long num_done = 0, num_steals = 0;
+    {
+        ThreadPool thread_pool(num_thread, &resource);
+        // All to worker 0, the others have to steal
+        for (int i = 0; i < num_task; i++) {
+            thread_pool.AddTask(new CountTask(), 0);
+        }
+        while (thread_pool.QueueDepth() > 0);
+        for (int i = 0; i < num_thread; i++) {
+            assert(thread_pool.QueueDepth(i) == 0);
+        }
+        // Wait the running ones
+        while (num_done < num_task) {
+            num_done = 0, num_steals = 0;
+            for (int i = 0; i < num_thread; i++) {
+                num_done += thread_pool.NumTasksDone(i);
+                num_steals += thread_pool.NumSteals(i);
+            }
+        }
+        assert(thread_pool.NumSteals(0) == 0);
+        for (int i = 0; i < num_thread; i++) {
+            assert(thread_pool.NumTasksDone(i) == count[i]);
+        }
+    }
+    printf("%ld tasks done, %ld stolen\n", num_done, num_steals);
+    assert(num_done == num_task);
+    assert(num_steals == num_task - count[0]);
+}
 
 int main() {
     TestThreadPool();
+    TestThreadPoolSteal();
     return 0;
 }
 
@@ -16,8 +16,7 @@
 #include <pthread.h>
 
 #include <vector>
-#include <queue>
-#include <map>
+#include <deque>
 
 static void ErrorExit(const char *msg) {
     perror(msg);
@@ -32,109 +31,195 @@ public:
     virtual ~Threadable() {}
 };
 
-// ThreadPool
+// ThreadPool with work stealing
+// Every worker thread has its own task deque and lock. A task is queued to
+// one worker (round robin, or the given one eg. for cache affinity), the
+// worker runs its tasks from the front, and an idle worker steals from the
+// back of the others. So there is no single queue all the threads contend
+// on, and the short tasks (eg. one audio chunk) balance over the workers.
 class ThreadPool {
 public:
     //@param[in] resource_pool, optional resource pool for every thread
     //           here we just use the void * for polymorphism, for it is simple and stupid
     //           we can also use the template programming, like template <typename C> class ThreadPool
     //           but it is more complicated and requires specific init
-    ThreadPool(int num_thread = 5, std::vector<void *> *resource_pool = NULL): 
-            num_thread_(num_thread), 
+    //           worker i is bound to (*resource_pool)[i] before it starts
+    ThreadPool(int num_thread = 5, std::vector<void *> *resource_pool = NULL):
+            pending_(0),
+            num_sleeping_(0),
+            next_worker_(0),
             stop_(false) {
-        if (resource_pool != NULL && resource_pool->size() != num_thread_) {
+        if (resource_pool != NULL && resource_pool->size() != num_thread) {
             ErrorExit("resource and num thread must equal");
         }
-        if (pthread_mutex_init(&mutex_, NULL) != 0) {
+        if (pthread_mutex_init(&sleep_mutex_, NULL) != 0) {
             ErrorExit("mutex init error");
         }
-        if (pthread_cond_init(&cond_, NULL) != 0) {
+        if (pthread_cond_init(&sleep_cond_, NULL) != 0) {
             ErrorExit("cond init error");
         }
-        // Create num_thread thread at once
-        threads_.resize(num_thread_);
-        for (int i = 0; i < threads_.size(); i++) {
-            if (pthread_create(&threads_[i], NULL, 
-                               ThreadPool::WorkerThread, (void *)this) != 0) {
+        // All the workers exist before any thread starts to steal
+        workers_.resize(num_thread);
+        for (int i = 0; i < workers_.size(); i++) {
+            void *resource = resource_pool != NULL ? (*resource_pool)[i] : NULL;
+            workers_[i] = new Worker(this, i, resource);
+        }
+        for (int i = 0; i < workers_.size(); i++) {
+            if (pthread_create(&workers_[i]->thread, NULL,
+                               ThreadPool::WorkerThread, workers_[i]) != 0) {
                 ErrorExit("pthread create error");
             }
-            if (resource_pool != NULL) {
-                resource_table_[threads_[i]] = (*resource_pool)[i];
-            } else {
-                resource_table_[threads_[i]] = NULL;
-            }
         }
     }
 
+    // The queued tasks are all done before the threads exit
     ~ThreadPool() {
-        pthread_mutex_lock(&mutex_);
+        pthread_mutex_lock(&sleep_mutex_);
         stop_ = true;
-        pthread_mutex_unlock(&mutex_);
+        pthread_mutex_unlock(&sleep_mutex_);
         // notify all thread to stop
-        pthread_cond_broadcast(&cond_);
+        pthread_cond_broadcast(&sleep_cond_);
 
-        for (int i = 0; i < threads_.size(); i++) {
-            pthread_join(threads_[i], NULL);
+        for (int i = 0; i < workers_.size(); i++) {
+            pthread_join(workers_[i]->thread, NULL);
+            delete workers_[i];
         }
 
-        pthread_mutex_destroy(&mutex_);
-        pthread_cond_destroy(&cond_);
+        pthread_mutex_destroy(&sleep_mutex_);
+        pthread_cond_destroy(&sleep_cond_);
     }
 
-    void *GetResource(pthread_t tid) {
-        assert(resource_table_.find(tid) != resource_table_.end());
-        return resource_table_[tid];
-    }
+    int NumThreads() const { return workers_.size(); }
 
     void AddTask(Threadable *task) {
-        pthread_mutex_lock(&mutex_);
-        task_queue_.push(task);
-        pthread_mutex_unlock(&mutex_);
-        pthread_cond_signal(&cond_);
+        unsigned int next = __sync_fetch_and_add(&next_worker_, 1);
+        AddTask(task, next % workers_.size());
+    }
+
+    // Queue the task to worker, it may still be run by another worker if
+    // that one is idle
+    void AddTask(Threadable *task, int worker) {
+        assert(worker >= 0 && worker < workers_.size());
+        // counted before it can be taken, so pending_ never goes negative
+        __sync_fetch_and_add(&pending_, 1);
+        Worker *w = workers_[worker];
+        pthread_mutex_lock(&w->mutex);
+        w->tasks.push_back(task);
+        pthread_mutex_unlock(&w->mutex);
+        // A worker going to sleep counts itself before it checks pending_,
+        // so either it sees the task or we see it and wake it up
+        if (__sync_fetch_and_add(&num_sleeping_, 0) > 0) {
+            pthread_mutex_lock(&sleep_mutex_);
+            pthread_cond_signal(&sleep_cond_);
+            pthread_mutex_unlock(&sleep_mutex_);
+        }
+    }
+
+    // Number of tasks queued and not started yet
+    int QueueDepth() const {
+        return __sync_fetch_and_add(const_cast<int *>(&pending_), 0);
+    }
+
+    // Number of tasks queued to the worker and not started yet
+    int QueueDepth(int worker) const {
+        Worker *w = workers_[worker];
+        pthread_mutex_lock(&w->mutex);
+        int depth = w->tasks.size();
+        pthread_mutex_unlock(&w->mutex);
+        return depth;
+    }
+
+    // Number of tasks run by the worker, and of them stolen from others
+    long NumTasksDone(int worker) const {
+        return __sync_fetch_and_add(&workers_[worker]->num_done, 0);
+    }
+    long NumSteals(int worker) const {
+        return __sync_fetch_and_add(&workers_[worker]->num_steals, 0);
     }
 
-    // Wait a task to execute  
-    Threadable *WaitTask() {
+private:
+    struct Worker {
+        Worker(ThreadPool *pool, int id, void *resource):
+            pool(pool), id(id), resource(resource), num_done(0),
+            num_steals(0) {
+            if (pthread_mutex_init(&mutex, NULL) != 0) {
+                ErrorExit("mutex init error");
+            }
+        }
+        ~Worker() { pthread_mutex_destroy(&mutex); }
+        ThreadPool *pool;
+        int id;
+        void *resource;
+        pthread_t thread;
+        pthread_mutex_t mutex; // guard tasks
+        std::deque<Threadable *> tasks;
+        long num_done, num_steals;
+    };
+
+    // Own task from the front, else steal one from the back of the others
+    Threadable *PopTask(Worker *w) {
         Threadable *task = NULL;
-        pthread_mutex_lock(&mutex_);
-        while (!stop_ && task_queue_.empty()) {
-            pthread_cond_wait(&cond_, &mutex_);
+        pthread_mutex_lock(&w->mutex);
+        if (!w->tasks.empty()) {
+            task = w->tasks.front();
+            w->tasks.pop_front();
         }
-        if (task_queue_.size() > 0) {
-            task = task_queue_.front();
-            task_queue_.pop();
+        pthread_mutex_unlock(&w->mutex);
+        for (int i = 1; task == NULL && i < workers_.size(); i++) {
+            Worker *victim = workers_[(w->id + i) % workers_.size()];
+            pthread_mutex_lock(&victim->mutex);
+            if (!victim->tasks.empty()) {
+                task = victim->tasks.back();
+                victim->tasks.pop_back();
+                __sync_fetch_and_add(&w->num_steals, 1);
+            }
+            pthread_mutex_unlock(&victim->mutex);
         }
-        // else stop_ = true return NULL
-        pthread_mutex_unlock(&mutex_);
+        if (task != NULL) __sync_fetch_and_sub(&pending_, 1);
         return task;
     }
 
+    // Wait a task to execute, NULL when stopped and no more task
+    Threadable *WaitTask(Worker *w) {
+        for (;;) {
+            Threadable *task = PopTask(w);
+            if (task != NULL) return task;
+            pthread_mutex_lock(&sleep_mutex_);
+            __sync_fetch_and_add(&num_sleeping_, 1);
+            while (!stop_ && __sync_fetch_and_add(&pending_, 0) == 0) {
+                pthread_cond_wait(&sleep_cond_, &sleep_mutex_);
+            }
+            __sync_fetch_and_sub(&num_sleeping_, 1);
+            bool done = stop_ && __sync_fetch_and_add(&pending_, 0) == 0;
+            pthread_mutex_unlock(&sleep_mutex_);
+            if (done) return NULL;
+        }
+    }
+
     // PoolWorker thread
     static void *WorkerThread(void *arg) {
-        sleep(3); // wait main thread to construct the resource_table_
-        ThreadPool *pool = static_cast<ThreadPool *>(arg);
-        void *resource = pool->GetResource(pthread_self());
+        Worker *w = static_cast<Worker *>(arg);
+        ThreadPool *pool = w->pool;
         for(;;) {
-            Threadable *task = pool->WaitTask();
+            Threadable *task = pool->WaitTask(w);
             // Stop
             if (task == NULL) break;
             else {
-                (*task)(resource); // Run the task
+                (*task)(w->resource); // Run the task
                 delete task;
+                __sync_fetch_and_add(&w->num_done, 1);
             }
         }
         return NULL;
     }
 
-private:
-    int num_thread_;
+    std::vector<Worker *> workers_;
+    int pending_; // tasks queued in all the deques
+    int num_sleeping_; // workers waiting on sleep_cond_
+    unsigned int next_worker_;
     bool stop_;
-    std::vector<pthread_t> threads_;
-    std::vector<void *> *resource_pool_;
-    std::queue<Threadable *> task_queue_; //TaskQueue
-    std::map<pthread_t, void *> resource_table_;
-    pthread_cond_t cond_;
-    pthread_mutex_t mutex_;
+    pthread_cond_t sleep_cond_;
+    pthread_mutex_t sleep_mutex_;
 };
 
 #endif
@@ -3,12 +3,47 @@
  * Author: zhangbinbin 
  *         hechangqing
  */
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "aslp-online/wav-provider.h"
 
 namespace kaldi {
 namespace aslp_online {
 
-WavProvider::WavProvider(int client_sid): client_sid_(client_sid), done_(false), connect_(true) {
+template<typename Real>
+static void PcmToFloatTemplate(const char *pcm, int num, Real *out) {
+  for (int i = 0; i < num; i++) {
+    short value;
+    memcpy(&value, pcm + i * sizeof(short), sizeof(short));
+    out[i] = static_cast<Real>(value);
+  }
+}
+
+#if defined(__SSE2__)
+static void PcmToFloatTemplate(const char *pcm, int num, float *out) {
+  int i = 0;
+  for (; i + 8 <= num; i += 8) {
+    __m128i x = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(pcm + i * sizeof(short)));
+    // sign extend to int32 by shifting the int16 to the high half
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+    _mm_storeu_ps(out + i, _mm_cvtepi32_ps(lo));
+    _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(hi));
+  }
+  PcmToFloatTemplate<float>(pcm + i * sizeof(short), num - i, out + i);
+}
+#endif
+
+void PcmToFloat(const char *pcm, int num, BaseFloat *out) {
+  PcmToFloatTemplate(pcm, num, out);
+}
+
+WavProvider::WavProvider(int client_sid): client_sid_(client_sid), done_(false),
+                                          connect_(true), offset_(0) {
 
 }
 
@@ -48,14 +83,15 @@ bool WavProvider::WriteFull(const char *buf, int to_send) const{
 }
 
 bool WavProvider::Done() const {
-  return (done_ && data_queue_.empty()) || (!connect_ && data_queue_.empty());
+  return (done_ || !connect_) && NumSamplesBuffered() == 0;
 }
 
 void WavProvider::Reset() {
   client_sid_ = -1;
   done_ = false;
   connect_ = false;
-  while(!data_queue_.empty()) data_queue_.pop();
+  samples_.clear();
+  offset_ = 0;
 }
 
 /* packet format 
@@ -71,47 +107,91 @@ bool WavProvider::ReadOnce() {
   }
   len = ntohl(len); //convert netword to host
   KALDI_VLOG(2) << "new package arrived, package size: " << len;
-  char *data = new char[len];  
-  if (!ReadFull(data, len)) {
-    delete [] data;
+  // a bad package drops only this connection, not the server
+  if (len < 1) {
+    KALDI_WARN << "Bad package size " << len << ", close the connection";
+    connect_ = false;
+    return false;
+  }
+  char cmd;
+  if (!ReadFull(&cmd, 1)) {
     return false;
   }
-  int cur = 0;
-  switch (data[0]) {
-    case 0x00:{
-        cur += 1;
-        KALDI_ASSERT((len - 1) % sizeof(short) == 0); //2 byte
-        short value;
-        for (int i = 0; i < (len - 1) / sizeof(short) ; i++) {
-          //value = ntohs(*(short *)(data + cur));
-          value = (*(short *)(data + cur));
-          data_queue_.push(value);
-          cur += sizeof(short);
+  switch (cmd) {
+    case 0x00: {
+        if ((len - 1) % sizeof(short) != 0) { //2 byte
+          KALDI_WARN << "Bad audio package size " << len
+                     << ", close the connection";
+          connect_ = false;
+          return false;
+        }
+        // the samples are read in place, no copy
+        int num = (len - 1) / sizeof(short);
+        short *samples = AppendSamples(num);
+        if (!ReadFull(reinterpret_cast<char *>(samples), len - 1)) {
+          samples_.resize(samples_.size() - num);
+          return false;
         }
       }
       break;
     case 0x01:
-      KALDI_ASSERT(len == 1);
+      if (len != 1) {
+        KALDI_WARN << "Bad finish package size " << len
+                   << ", close the connection";
+        connect_ = false;
+        return false;
+      }
       done_ = true;
       break;
+    default:
+      packet_.resize(len);
+      if (len > 1 && !ReadFull(&packet_[0], len - 1)) {
+        return false;
+      }
+      break;
   }
-  delete [] data;
   return true;
 }
 
+short *WavProvider::AppendSamples(int num) {
+  // drop the samples already read when they are the most of the buffer,
+  // so the buffer does not grow
+  if (offset_ > 0 && offset_ >= NumSamplesBuffered()) {
+    samples_.erase(samples_.begin(), samples_.begin() + offset_);
+    offset_ = 0;
+  }
+  size_t end = samples_.size();
+  samples_.resize(end + num);
+  return &samples_[end];
+}
+
+int WavProvider::WaitSamples(int num) {
+  while (NumSamplesBuffered() < num && !done_ && connect_) {
+    if (!ReadOnce()) break;
+  }
+  return std::min(num, NumSamplesBuffered());
+}
+
+int WavProvider::ReadAudio(int num, Vector<BaseFloat> *data) {
+  int num_read = WaitSamples(num);
+  if (data->Dim() != num_read) data->Resize(num_read, kUndefined);
+  if (num_read > 0) {
+    PcmToFloat(reinterpret_cast<const char *>(&samples_[offset_]), num_read,
+               data->Data());
+    offset_ += num_read;
+  }
+  return num_read;
+}
+
 int WavProvider::ReadAudio(int num, std::vector<BaseFloat> *data) {
-  data->clear();
-  while (num > 0) {
-    if (Done()) break; // done and no more data Or connect break and no more data
-    if (!done_ && data_queue_.empty()) //no data in queue
-      ReadOnce(); 
-    if (!data_queue_.empty()) {
-      data->push_back(static_cast<BaseFloat>(data_queue_.front()));
-      data_queue_.pop();
-      num--;
-    }
+  int num_read = WaitSamples(num);
+  data->resize(num_read);
+  if (num_read > 0) {
+    PcmToFloat(reinterpret_cast<const char *>(&samples_[offset_]), num_read,
+               &(*data)[0]);
+    offset_ += num_read;
   }
-  return data->size();
+  return num_read;
 }
 
 void WavProvider::WriteDecoding() {
@@ -16,13 +16,18 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
-#include <queue>
+#include <vector>
 
 #include "util/common-utils.h"
+#include "matrix/kaldi-vector.h"
 
 namespace kaldi {
 namespace aslp_online {
 
+// Convert num int16 pcm samples (host byte order, may be unaligned) to float,
+// with SSE2 if possible
+void PcmToFloat(const char *pcm, int num, BaseFloat *out);
+
 class WavProvider {
  public:
   // This class is used by decoding server.
@@ -31,6 +36,17 @@ class WavProvider {
   ~WavProvider();
 
   bool IsConnected() const { return connect_; }
+  // Give up the client socket, which is not closed by this object any more,
+  // eg. to send the rest of the results from another thread
+  int ReleaseSocket() {
+    int sid = client_sid_;
+    client_sid_ = -1;
+    return sid;
+  }
+  // Read num samples (less only when the audio is done), returns the number
+  // read, data is only resized when the number changes, so the caller can
+  // keep it and take a SubVector of the samples
+  int ReadAudio(int num, Vector<BaseFloat> *data);
   int ReadAudio(int num, std::vector<BaseFloat> *data);
   void Reset();
   // This function returns true when there is no more data.
@@ -62,11 +78,24 @@ class WavProvider {
   bool ReadFull(char* buf, int32 len);
   bool WriteFull(const char *buf, int to_send) const; 
   bool ReadOnce();
+  // Block until num samples are buffered or no more audio, returns the
+  // number of buffered samples up to num
+  int WaitSamples(int num);
+  int NumSamplesBuffered() const { return samples_.size() - offset_; }
+  // Make room for num more samples at the end of samples_ and return it
+  short *AppendSamples(int num);
  private:
   int client_sid_; //client socket id
   bool done_; //if the remote audio done
   bool connect_; // whether the remote client is connected
-  std::queue<short> data_queue_;
+  // Contiguous sample buffer, packets are read into its end and the samples
+  // [offset_, samples_.size()) are not read by ReadAudio() yet. The read
+  // ones are dropped when they are the most of it, so it stays about the
+  // size of two reads.
+  std::vector<short> samples_;
+  int offset_;
+  // Body of the packets other than audio
+  std::vector<char> packet_;
 };
 
 } // namespace aslp_online
@@ -0,0 +1,224 @@
+// aslp-onlinebin/aslp-latgen-faster-parallel.cc
+
+/* Pipelined version of aslp-latgen-faster-rtf for bulk decoding
+ *
+ * The main thread reads the features and computes the nnet output of every
+ * utterance in batches, then the search and the lattice determinization of
+ * the utterance run in one of --num-threads decoding threads sharing the
+ * decode fst, while the main thread goes on with the next utterance. The
+ * outputs are written in the input order (see TaskSequencer).
+ */
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "tree/context-dep.h"
+#include "hmm/transition-model.h"
+#include "fstext/fstext-lib.h"
+#include "decoder/decoder-wrappers.h"
+#include "decoder/decodable-matrix.h"
+#include "thread/kaldi-task-sequence.h"
+#include "base/timer.h"
+
+#include "aslp-nnet/nnet-nnet.h"
+#include "aslp-nnet/nnet-pdf-prior.h"
+#include "aslp-nnet/nnet-decodable.h"
+
+namespace kaldi {
+
+// Times the decoding and the output of DecodeUtteranceLatticeFasterClass
+class TimedDecodeUtteranceTask {
+public:
+    // Takes ownership of task
+    TimedDecodeUtteranceTask(DecodeUtteranceLatticeFasterClass *task,
+                             double *decode_time_sum, double *write_time_sum):
+        task_(task), decode_time_(0.0), decode_time_sum_(decode_time_sum),
+        write_time_sum_(write_time_sum) {}
+    // Run in one of the decoding threads
+    void operator() () {
+        Timer timer;
+        (*task_)();
+        decode_time_ = timer.Elapsed();
+    }
+    // Run in order and one at a time, so the sums need no lock
+    ~TimedDecodeUtteranceTask() {
+        Timer timer;
+        delete task_; // Output happens here
+        *write_time_sum_ += timer.Elapsed();
+        *decode_time_sum_ += decode_time_;
+    }
+private:
+    DecodeUtteranceLatticeFasterClass *task_;
+    double decode_time_;
+    double *decode_time_sum_, *write_time_sum_;
+};
+
+} // namespace kaldi
+
+int main(int argc, char *argv[]) {
+    try {
+        using namespace kaldi;
+        using namespace aslp_nnet;
+        typedef kaldi::int32 int32;
+        using fst::SymbolTable;
+        using fst::VectorFst;
+        using fst::StdArc;
+
+        const char *usage =
+            "Decode with feature input and generate lattice in multiple threads,\n"
+            "the nnet forward of the next utterances runs while decoding\n"
+            "and the rtf of every stage is reported\n"
+            "Usage: aslp-latgen-faster-parallel [options] nnet_in trans-model-in fst-in feature-rspecifier"
+            " lattice-wspecifier [ words-wspecifier [alignments-wspecifier] ]\n";
+        ParseOptions po(usage);
+        bool allow_partial = false;
+        LatticeFasterDecoderConfig config;
+        TaskSequencerConfig sequencer_config; // has --num-threads option
+
+        std::string word_syms_filename;
+        config.Register(&po);
+        sequencer_config.Register(&po);
+
+        PdfPriorOptions prior_config;
+        prior_config.Register(&po);
+
+        NnetDecodableOptions nnet_decoding_config;
+        nnet_decoding_config.Register(&po);
+
+        po.Register("word-symbol-table", &word_syms_filename,
+                    "Symbol table for words [for debug output]");
+        po.Register("allow-partial", &allow_partial,
+                    "If true, produce output even if end state was not reached.");
+        double frames_per_second = 100;
+        po.Register("frames-per-second", &frames_per_second,
+                    "for calcuate RTF, one second wav for frames-per-second feat");
+
+        po.Read(argc, argv);
+
+        if (po.NumArgs() < 5 || po.NumArgs() > 7) {
+            po.PrintUsage();
+            exit(1);
+        }
+
+        std::string nnet_rxfilename = po.GetArg(1),
+            model_in_filename = po.GetArg(2),
+            fst_in_str = po.GetArg(3),
+            feature_rspecifier = po.GetArg(4),
+            lattice_wspecifier = po.GetArg(5),
+            words_wspecifier = po.GetOptArg(6),
+            alignment_wspecifier = po.GetOptArg(7);
+
+        // Read decode fst file, shared read-only by all the decoders
+        VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
+        // Prior file for pdf prior
+        KALDI_LOG << "Read prior file " << prior_config.class_frame_counts;
+        if (prior_config.class_frame_counts == "") {
+            KALDI_ERR << "class_frame_counts: prior file must be provided";
+        }
+        PdfPrior pdf_prior(prior_config);
+        const CuVector<BaseFloat> &log_prior = pdf_prior.LogPrior();
+        // Nnet model for acoustic model, only used by the main thread
+        Nnet nnet;
+        {
+            bool binary;
+            Input ki(nnet_rxfilename, &binary);
+            nnet.Read(ki.Stream(), binary);
+        }
+        // Read transition model
+        TransitionModel trans_model;
+        ReadKaldiObject(model_in_filename, &trans_model);
+
+        bool determinize = config.determinize_lattice;
+        CompactLatticeWriter compact_lattice_writer;
+        LatticeWriter lattice_writer;
+        if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+                    : lattice_writer.Open(lattice_wspecifier)))
+            KALDI_ERR << "Could not open table for writing lattices: "
+                << lattice_wspecifier;
+
+        Int32VectorWriter words_writer(words_wspecifier);
+
+        Int32VectorWriter alignment_writer(alignment_wspecifier);
+
+        fst::SymbolTable *word_syms = NULL;
+        if (word_syms_filename != "")
+            if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
+                KALDI_ERR << "Could not read symbol table from file "
+                    << word_syms_filename;
+
+        double tot_like = 0.0;
+        kaldi::int64 frame_count = 0;
+        int32 num_success = 0, num_fail = 0, num_partial = 0;
+        double total_wav_time = 0, read_time = 0, forward_time = 0,
+               decode_time = 0, write_time = 0;
+        Timer total_timer;
+
+        {
+            TaskSequencer<TimedDecodeUtteranceTask> sequencer(sequencer_config);
+            Timer read_timer;
+            SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+            for (; !feature_reader.Done(); feature_reader.Next()) {
+                std::string utt = feature_reader.Key();
+                const Matrix<BaseFloat> &feat = feature_reader.Value();
+                read_time += read_timer.Elapsed();
+                if (feat.NumRows() == 0) {
+                    KALDI_WARN << "Zero-length utterance: " << utt;
+                    num_fail++;
+                    read_timer.Reset();
+                    continue;
+                }
+                total_wav_time += feat.NumRows() / frames_per_second;
+
+                // The acoustic scale is applied here, so 1.0 for the decodable
+                Timer forward_timer;
+                Matrix<BaseFloat> *loglikes = new Matrix<BaseFloat>;
+                {
+                    NnetDecodable decodable(&nnet, log_prior, trans_model,
+                                            nnet_decoding_config, feat);
+                    decodable.GetScaledLoglikes(loglikes);
+                }
+                forward_time += forward_timer.Elapsed();
+
+                LatticeFasterDecoder *decoder =
+                    new LatticeFasterDecoder(*decode_fst, config);
+                DecodableInterface *decodable =
+                    new DecodableMatrixScaledMapped(trans_model, 1.0, loglikes);
+                DecodeUtteranceLatticeFasterClass *task =
+                    new DecodeUtteranceLatticeFasterClass(
+                            decoder, decodable, trans_model, word_syms, utt,
+                            nnet_decoding_config.acoustic_scale, determinize,
+                            allow_partial, &alignment_writer, &words_writer,
+                            &compact_lattice_writer, &lattice_writer,
+                            &tot_like, &frame_count, &num_success, &num_fail,
+                            &num_partial);
+                // Blocks when all the decoding threads are busy
+                sequencer.Run(new TimedDecodeUtteranceTask(task, &decode_time,
+                                                           &write_time));
+                read_timer.Reset();
+            }
+            sequencer.Wait();
+        }
+        double total_time = total_timer.Elapsed();
+
+        delete decode_fst; // delete this only after decoders go out of scope.
+
+        // decode rtf is the cpu time of all the decoding threads
+        KALDI_LOG << "RTF read " << read_time / total_wav_time
+                  << " forward " << forward_time / total_wav_time
+                  << " decode " << decode_time / total_wav_time
+                  << " write " << write_time / total_wav_time;
+        KALDI_LOG << "TOTAL RTF " << total_time / total_wav_time
+                  << " with " << sequencer_config.num_threads
+                  << " decoding threads";
+        KALDI_LOG << "Done " << num_success << " utterances, failed for "
+            << num_fail << ", partial for " << num_partial;
+        KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count) << " over "
+            << frame_count<<" frames.";
+
+        delete word_syms;
+        if (num_success != 0) return 0;
+        else return 1;
+    } catch (const std::exception &e) {
+        std::cerr << e.what();
+        return -1;
+    }
+}
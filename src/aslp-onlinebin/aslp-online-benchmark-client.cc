@@ -0,0 +1,378 @@
+// aslp-onlinebin/aslp-online-benchmark-client.cc
+
+/* Load generator of the online servers
+ *
+ * Replays a wav list over N concurrent connections, every connection sends
+ * its audio paced at --real-time-factor times real time, like
+ * aslp-audio-provider-client does for one stream, and records
+ *   packet latency: time to write one audio packet to the server
+ *   result latency: time from the first packet sent after the previous
+ *                   result to the next partial/final result
+ *   final latency:  time from the finish signal to the EOS of the session
+ * The p50/p95/p99 of them, the throughput and the rtf(stream time over
+ * audio time, the server rtf when --real-time-factor=0) are written as a
+ * json report.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "feat/wave-reader.h"
+#include "aslp-online/wav-provider.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+static double NowSeconds() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static bool SendFull(int socket_id, const char *data, int to_send) {
+    while (to_send > 0) {
+        int ret = send(socket_id, data, to_send, MSG_NOSIGNAL);
+        if (ret <= 0) return false;
+        to_send -= ret;
+        data += ret;
+    }
+    return true;
+}
+
+static bool ReadFull(int socket_id, char *buf, int len) {
+    while (len > 0) {
+        int ret = read(socket_id, buf, len);
+        if (ret <= 0) return false;
+        len -= ret;
+        buf += ret;
+    }
+    return true;
+}
+
+struct BenchmarkStats {
+    BenchmarkStats(): audio_time(0.0), stream_time(0.0), num_done(0),
+        num_failed(0) {}
+    void Add(const BenchmarkStats &other) {
+        packet_latency.insert(packet_latency.end(),
+            other.packet_latency.begin(), other.packet_latency.end());
+        result_latency.insert(result_latency.end(),
+            other.result_latency.begin(), other.result_latency.end());
+        final_latency.insert(final_latency.end(),
+            other.final_latency.begin(), other.final_latency.end());
+        audio_time += other.audio_time;
+        stream_time += other.stream_time;
+        num_done += other.num_done;
+        num_failed += other.num_failed;
+    }
+    // in seconds
+    std::vector<double> packet_latency, result_latency, final_latency;
+    double audio_time, stream_time;
+    int num_done, num_failed;
+};
+
+// Shared by all the streams
+struct BenchmarkConfig {
+    std::string server_ip;
+    int server_port;
+    BaseFloat real_time_factor;
+    int packet_size;
+    BaseFloat samp_freq;
+    const std::vector<Vector<BaseFloat> > *waves;
+    int num_utts;
+    int next_utt; // utterances taken by the streams
+};
+
+class BenchmarkStream {
+public:
+    BenchmarkStream(BenchmarkConfig *config): config_(config) {
+        pthread_mutex_init(&mutex_, NULL);
+    }
+    ~BenchmarkStream() { pthread_mutex_destroy(&mutex_); }
+
+    // Run utterances until all num_utts of config are taken
+    static void *Run(void *arg) {
+        BenchmarkStream *stream = static_cast<BenchmarkStream *>(arg);
+        BenchmarkConfig *config = stream->config_;
+        for (;;) {
+            int utt = __sync_fetch_and_add(&config->next_utt, 1);
+            if (utt >= config->num_utts) break;
+            const Vector<BaseFloat> &wave =
+                (*config->waves)[utt % config->waves->size()];
+            if (!stream->RunUtterance(wave)) stream->stats_.num_failed++;
+        }
+        return NULL;
+    }
+
+    const BenchmarkStats &Stats() const { return stats_; }
+
+private:
+    static void *ReceiveResults(void *arg) {
+        static_cast<BenchmarkStream *>(arg)->ReceiveResults();
+        return NULL;
+    }
+
+    // Record the result latencies until EOS
+    void ReceiveResults() {
+        std::vector<char> buf;
+        for (;;) {
+            int32 recv_len;
+            char cmd;
+            if (!ReadFull(socket_, (char *)&recv_len, 4)) return;
+            recv_len = ntohl(recv_len);
+            if (recv_len <= 0 || !ReadFull(socket_, &cmd, 1)) return;
+            buf.resize(recv_len);
+            if (recv_len > 1 && !ReadFull(socket_, &buf[0], recv_len - 1)) {
+                return;
+            }
+            double now = NowSeconds();
+            pthread_mutex_lock(&mutex_);
+            if (cmd == WavProvider::kPartialResult ||
+                cmd == WavProvider::kFinalResult) {
+                if (unanswered_time_ > 0) {
+                    stats_.result_latency.push_back(now - unanswered_time_);
+                    unanswered_time_ = -1.0;
+                }
+            }
+            if (cmd == WavProvider::kEOS) eos_time_ = now;
+            pthread_mutex_unlock(&mutex_);
+            if (cmd == WavProvider::kEOS) return;
+        }
+    }
+
+    bool RunUtterance(const VectorBase<BaseFloat> &wave) {
+        socket_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (socket_ == -1) {
+            KALDI_WARN << "create client socket failed";
+            return false;
+        }
+        struct sockaddr_in server_addr;
+        memset(&server_addr, 0, sizeof(server_addr));
+        server_addr.sin_addr.s_addr = inet_addr(config_->server_ip.c_str());
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(config_->server_port);
+        if (connect(socket_, (struct sockaddr *)&server_addr,
+                    sizeof(server_addr))) {
+            KALDI_WARN << "could not connect to " << config_->server_ip
+                       << ":" << config_->server_port;
+            close(socket_);
+            return false;
+        }
+        unanswered_time_ = -1.0;
+        eos_time_ = -1.0;
+        pthread_t receive_tid;
+        if (pthread_create(&receive_tid, NULL, ReceiveResults, this) != 0) {
+            KALDI_ERR << "could not create thread";
+        }
+
+        // cmd 0x00 for raw wave data, 0x01 for end of data
+        std::vector<char> packet(5 + config_->packet_size * sizeof(short));
+        double start_time = NowSeconds();
+        bool ok = true;
+        int sent = 0;
+        while (ok && sent < wave.Dim()) {
+            int to_send = std::min(config_->packet_size, wave.Dim() - sent);
+            // The packet is ready once its audio is recorded
+            if (config_->real_time_factor > 0) {
+                double due = start_time + (sent + to_send) /
+                    (config_->samp_freq * config_->real_time_factor);
+                double wait = due - NowSeconds();
+                if (wait > 0) usleep(static_cast<useconds_t>(wait * 1e6));
+            }
+            int32 data_len = htonl(1 + to_send * sizeof(short));
+            memcpy(&packet[0], &data_len, 4);
+            packet[4] = 0x00;
+            for (int i = 0; i < to_send; i++) {
+                short value = static_cast<short>(wave(sent + i));
+                memcpy(&packet[5 + i * sizeof(short)], &value, sizeof(short));
+            }
+            double send_time = NowSeconds();
+            pthread_mutex_lock(&mutex_);
+            if (unanswered_time_ < 0) unanswered_time_ = send_time;
+            pthread_mutex_unlock(&mutex_);
+            ok = SendFull(socket_, &packet[0], 5 + to_send * sizeof(short));
+            stats_.packet_latency.push_back(NowSeconds() - send_time);
+            sent += to_send;
+        }
+        // finish signal
+        int32 data_len = htonl(1);
+        memcpy(&packet[0], &data_len, 4);
+        packet[4] = 0x01;
+        double finish_time = NowSeconds();
+        ok = ok && SendFull(socket_, &packet[0], 5);
+        if (!ok) shutdown(socket_, SHUT_RDWR);
+
+        if (pthread_join(receive_tid, NULL) != 0) {
+            KALDI_ERR << "can not join with receive thread";
+        }
+        close(socket_);
+        if (!ok || eos_time_ < 0) {
+            KALDI_WARN << "Session failed after " << sent << " samples";
+            return false;
+        }
+        stats_.final_latency.push_back(eos_time_ - finish_time);
+        stats_.audio_time += wave.Dim() / config_->samp_freq;
+        stats_.stream_time += eos_time_ - start_time;
+        stats_.num_done++;
+        return true;
+    }
+
+    BenchmarkConfig *config_;
+    BenchmarkStats stats_;
+    int socket_;
+    pthread_mutex_t mutex_; // guard the times shared with the receive thread
+    // send time of the first packet not followed by a result, -1 for none
+    double unanswered_time_;
+    double eos_time_;
+};
+
+// Nearest rank percentile, @p in [0, 1]
+static double Percentile(const std::vector<double> &sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    int rank = static_cast<int>(ceil(p * sorted.size()));
+    return sorted[std::max(rank - 1, 0)];
+}
+
+static void WriteLatency(const std::string &name, std::vector<double> *latency,
+                         bool last, std::ostream &os) {
+    std::sort(latency->begin(), latency->end());
+    double sum = 0.0;
+    for (size_t i = 0; i < latency->size(); i++) sum += (*latency)[i];
+    double mean = latency->empty() ? 0.0 : sum / latency->size();
+    os << "  \"" << name << "\": {"
+       << "\"count\": " << latency->size()
+       << ", \"mean_ms\": " << 1000 * mean
+       << ", \"p50_ms\": " << 1000 * Percentile(*latency, 0.50)
+       << ", \"p95_ms\": " << 1000 * Percentile(*latency, 0.95)
+       << ", \"p99_ms\": " << 1000 * Percentile(*latency, 0.99)
+       << ", \"max_ms\": "
+       << 1000 * (latency->empty() ? 0.0 : latency->back())
+       << (last ? "}\n" : "},\n");
+    KALDI_LOG << name << " ms: p50 " << 1000 * Percentile(*latency, 0.50)
+              << " p95 " << 1000 * Percentile(*latency, 0.95)
+              << " p99 " << 1000 * Percentile(*latency, 0.99);
+}
+
+} // namespace aslp_online
+} // namespace kaldi
+
+int main(int argc, char *argv[]) {
+    try {
+        using namespace kaldi;
+        using namespace kaldi::aslp_online;
+
+        const char *usage =
+            "Replay the wavs over concurrent connections to the online server,\n"
+            "and report the latency percentiles, throughput and rtf in json\n"
+            "Usage: aslp-online-benchmark-client [options] server-ip port "
+            "wav-rspecifier [report-wxfilename]\n"
+            "e.g. : aslp-online-benchmark-client --num-streams=20 "
+            "127.0.0.1 10000 scp:wav.scp report.json\n";
+        ParseOptions po(usage);
+        int32 num_streams = 1, num_utts = 0, packet_size = 1600;
+        BaseFloat real_time_factor = 1.0;
+        po.Register("num-streams", &num_streams,
+                    "Number of concurrent connections");
+        po.Register("num-utts", &num_utts,
+                    "Total utterances to send, the wav list is replayed "
+                    "as needed, 0 for every wav once");
+        po.Register("real-time-factor", &real_time_factor,
+                    "Speed of sending the audio, 1.0 for real time, "
+                    "0 for as fast as possible");
+        po.Register("packet-size", &packet_size,
+                    "Number of samples in one audio packet");
+        po.Read(argc, argv);
+
+        if (po.NumArgs() < 3 || po.NumArgs() > 4) {
+            po.PrintUsage();
+            exit(1);
+        }
+        KALDI_ASSERT(num_streams > 0 && packet_size > 0);
+        KALDI_ASSERT(num_utts >= 0 && real_time_factor >= 0);
+
+        std::string wav_rspecifier = po.GetArg(3),
+            report_wxfilename = po.GetOptArg(4);
+
+        // Hold all the audio so reading wavs is not part of the benchmark
+        std::vector<Vector<BaseFloat> > waves;
+        SequentialTableReader<WaveHolder> reader(wav_rspecifier);
+        for (; !reader.Done(); reader.Next()) {
+            const WaveData &wav_data = reader.Value();
+            if (wav_data.SampFreq() != 16000)
+                KALDI_ERR << "Sampling rates other than 16kHz are not supported!";
+            KALDI_ASSERT(wav_data.Data().NumRows() == 1);
+            waves.push_back(Vector<BaseFloat>(wav_data.Data().Row(0)));
+        }
+        if (waves.empty()) KALDI_ERR << "No wav in " << wav_rspecifier;
+
+        BenchmarkConfig config;
+        config.server_ip = po.GetArg(1);
+        config.server_port = strtol(po.GetArg(2).c_str(), 0, 10);
+        config.real_time_factor = real_time_factor;
+        config.packet_size = packet_size;
+        config.samp_freq = 16000;
+        config.waves = &waves;
+        config.num_utts = num_utts > 0 ? num_utts : waves.size();
+        config.next_utt = 0;
+
+        KALDI_LOG << "Sending " << config.num_utts << " utterances over "
+                  << num_streams << " streams";
+        double start_time = NowSeconds();
+        std::vector<BenchmarkStream *> streams(num_streams);
+        std::vector<pthread_t> tids(num_streams);
+        for (int i = 0; i < num_streams; i++) {
+            streams[i] = new BenchmarkStream(&config);
+            if (pthread_create(&tids[i], NULL, BenchmarkStream::Run,
+                               streams[i]) != 0) {
+                KALDI_ERR << "could not create thread";
+            }
+        }
+        BenchmarkStats stats;
+        for (int i = 0; i < num_streams; i++) {
+            pthread_join(tids[i], NULL);
+            stats.Add(streams[i]->Stats());
+            delete streams[i];
+        }
+        double wall_time = NowSeconds() - start_time;
+
+        KALDI_LOG << "Done " << stats.num_done << " utterances, failed "
+                  << stats.num_failed << ", " << stats.audio_time
+                  << " seconds audio in " << wall_time << " seconds";
+        if (stats.audio_time > 0)
+            KALDI_LOG << "RTF " << stats.stream_time / stats.audio_time;
+
+        Output ko(report_wxfilename == "" ? "-" : report_wxfilename, false);
+        std::ostream &os = ko.Stream();
+        os << std::setprecision(6) << "{\n"
+           << "  \"num_streams\": " << num_streams << ",\n"
+           << "  \"real_time_factor\": " << real_time_factor << ",\n"
+           << "  \"num_done\": " << stats.num_done << ",\n"
+           << "  \"num_failed\": " << stats.num_failed << ",\n"
+           << "  \"audio_seconds\": " << stats.audio_time << ",\n"
+           << "  \"wall_seconds\": " << wall_time << ",\n"
+           // seconds of audio served per second
+           << "  \"throughput\": " << stats.audio_time / wall_time << ",\n"
+           << "  \"rtf\": " << (stats.audio_time > 0 ?
+                   stats.stream_time / stats.audio_time : 0.0) << ",\n";
+        WriteLatency("packet_latency", &stats.packet_latency, false, os);
+        WriteLatency("result_latency", &stats.result_latency, false, os);
+        WriteLatency("final_latency", &stats.final_latency, true, os);
+        os << "}\n";
+        return stats.num_failed == 0 ? 0 : 1;
+    } catch(const std::exception &e) {
+        std::cerr << e.what();
+        return -1;
+    }
+}
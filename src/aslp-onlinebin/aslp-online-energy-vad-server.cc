@@ -136,15 +136,10 @@ int main(int argc, char *argv[]) {
             chunk_length = std::numeric_limits<int32>::max();
         }
 
-        // Nnet pool for thread pool, allocated enough at begin,
-        // Avoid dynamic allocating in the running time
-        std::vector<void *> nnet_pool(num_thread, NULL);
-        for (int i = 0; i < num_thread; i++) {
-            Nnet *new_nnet = new Nnet(nnet);
-            nnet_pool[i] = static_cast<void *>(new_nnet);
-        }
+        // Nnet pool for thread pool, all the threads share the read-only
+        // nnet, every decoding has its own forward state
+        std::vector<void *> nnet_pool(num_thread, static_cast<void *>(&nnet));
 
-        // Wait ThreadPool destruct then delete nnet in nnet_pool
         {
             ThreadPool thread_pool(num_thread, &nnet_pool);
 
@@ -166,9 +161,6 @@ int main(int argc, char *argv[]) {
             }
         }
 
-        for (int i = 0; i < num_thread; i++) {
-            delete static_cast<Nnet *>(nnet_pool[i]); 
-        }
         delete decode_fst;
         delete word_syms; // will delete if non-NULL.
         return 0;
@@ -20,6 +20,8 @@
 #include "aslp-online/online-vad-feature-pipeline.h"
 #include "aslp-online/online-endpoint.h"
 #include "aslp-online/punctuation-processor.h"
+#include "aslp-online/epoll-server.h"
+#include "aslp-online/nnet-batch-scorer.h"
 
 int main(int argc, char *argv[]) {
     try {
@@ -47,6 +49,8 @@ int main(int argc, char *argv[]) {
         vad_config.Register(&po);
         PdfPriorOptions prior_config;
         prior_config.Register(&po);
+        NnetBatchScorerOptions batch_scorer_config;
+        batch_scorer_config.Register(&po);
 
         BaseFloat chunk_length_secs = 0.1;
         po.Register("chunk-length", &chunk_length_secs,
@@ -67,6 +71,25 @@ int main(int argc, char *argv[]) {
         int forward_batch = 12;
         po.Register("forward-batch", &forward_batch,
                 "forward batch size of the am nnet");
+        bool use_epoll = false;
+        po.Register("use-epoll", &use_epoll,
+                "If true, serve all the connections in one epoll event thread "
+                "and decode them on --num-thread workers, else one thread "
+                "per connection");
+        int max_package_size = 1 << 20;
+        po.Register("max-package-size", &max_package_size,
+                "Max bytes of a package from a client with --use-epoll, the "
+                "connection is closed on a larger one");
+        bool batch_am_scoring = false;
+        po.Register("batch-am-scoring", &batch_am_scoring,
+                "If true, score the am of all the connections in batch by "
+                "one shared scoring thread (see --batch-max-streams and "
+                "--batch-max-wait-ms)");
+        int num_punctuation_thread = 0;
+        po.Register("num-punctuation-thread", &num_punctuation_thread,
+                "If > 0, punctuate the sessions on this number of threads "
+                "(one crf tagger per thread) without blocking the decode "
+                "threads, else in the decode threads");
 
         po.Read(argc, argv);
         if (po.NumArgs() != 5) {
@@ -86,7 +109,7 @@ int main(int argc, char *argv[]) {
         // Start tcp server here, early stop if bind error ocurred
         // for reading fst graph and other input files are time-consuming
         TcpServer tcp_server;
-        tcp_server.Listen(port);
+        tcp_server.Listen(port, use_epoll ? SOMAXCONN : 1);
 
         // Prior file for pdf prior
         KALDI_LOG << "Read prior file " << prior_config.class_frame_counts;
@@ -121,6 +144,11 @@ int main(int argc, char *argv[]) {
         // Punctuation file for punctuation predict
         KALDI_LOG << "Reading crf punctuation file " << punc_model_rxfilename;
         PunctuationProcessor punctuation_processor(punc_model_rxfilename.c_str());
+        PunctuationPool *punctuation_pool = NULL;
+        if (num_punctuation_thread > 0) {
+            punctuation_pool = new PunctuationPool(
+                    punc_model_rxfilename.c_str(), num_punctuation_thread);
+        }
         // Fst for decode graph
         fst::SymbolTable *word_syms = NULL;
         if (word_syms_rxfilename != "") {
@@ -142,21 +170,42 @@ int main(int argc, char *argv[]) {
             chunk_length = std::numeric_limits<int32>::max();
         }
 
-        // Nnet pool for thread pool, allocated enough at begin,
-        // Avoid dynamic allocating in the running time
+        // Resource for thread pool, allocated enough at begin,
+        // Avoid dynamic allocating in the running time. All the threads
+        // share the read-only am and vad nnet, the forward buffers and the
+        // lstm state belong to the sessions
         KALDI_LOG << "Creating thread pool resource";
+        NnetBatchScorer *am_scorer = NULL;
+        if (batch_am_scoring) {
+            am_scorer = new NnetBatchScorer(batch_scorer_config, 
+                                            new Nnet(am_nnet));
+        }
         std::vector<void *> resource_pool(num_thread, NULL);
         for (int i = 0; i < num_thread; i++) {
-            Nnet *new_am_nnet = new Nnet(am_nnet);
-            Nnet *new_vad_nnet = new Nnet(vad_nnet);
             NnetVadDecodeThreadResource *resource = 
-                new NnetVadDecodeThreadResource(new_am_nnet, new_vad_nnet);
+                new NnetVadDecodeThreadResource(&am_nnet, &vad_nnet,
+                                                am_scorer, punctuation_pool);
             resource_pool[i] = static_cast<void *>(resource);
         }
         KALDI_LOG << "Creating thread pool resource Done!!!";
 
-        // Wait ThreadPool destruct then delete nnet in nnet_pool
-        {
+        // Wait ThreadPool destruct then delete the resources
+        if (use_epoll) {
+            // The chunks of a connection may be run by any worker, the
+            // session keeps the resource of the worker that created it
+            ThreadPool workers(num_thread, &resource_pool);
+            NnetVadDecodeSessionFactory session_factory(forward_batch,
+                                                        samp_freq,
+                                                        feature_config,
+                                                        nnet_decoding_config,
+                                                        vad_config, trans_model,
+                                                        log_prior, *decode_fst,
+                                                        punctuation_processor,
+                                                        word_syms);
+            EpollServer epoll_server(chunk_length, max_package_size,
+                                     &session_factory, &workers);
+            epoll_server.Run(tcp_server);
+        } else {
             ThreadPool thread_pool(num_thread, &resource_pool);
 
             while (true) {
@@ -180,10 +229,10 @@ int main(int argc, char *argv[]) {
         for (int i = 0; i < num_thread; i++) {
             NnetVadDecodeThreadResource *resource = 
                 static_cast<NnetVadDecodeThreadResource *>(resource_pool[i]); 
-            delete resource->am_nnet;
-            delete resource->vad_nnet;
             delete resource;
         }
+        if (am_scorer != NULL) delete am_scorer;
+        if (punctuation_pool != NULL) delete punctuation_pool;
         delete decode_fst;
         delete word_syms; // will delete if non-NULL.
         return 0;
@@ -0,0 +1,162 @@
+/* Created on 2016-08-10
+ * Author: Zhang Binbin
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "allreduce-engine.h"
+
+namespace kaldi {
+
+// Every node fills the buffers with rank + 1 + index, the sums are known
+void TestAllReduceEngine(const MpiNode &node, const std::string &algorithm,
+                         int bucket_size) {
+    AllReduceOptions opts;
+    opts.algorithm = algorithm;
+    opts.bucket_size = bucket_size;
+    AllReduceEngine engine(opts, node);
+    std::vector<int> sizes;
+    sizes.push_back(1);
+    sizes.push_back(node.NumNodes() - 1);
+    sizes.push_back(1000);
+    sizes.push_back(77);
+    engine.Init(sizes);
+    int n = node.NumNodes();
+    for (int iter = 0; iter < 3; iter++) {
+        Vector<BaseFloat> &buffer = engine.PackedBuffer();
+        for (int i = 0; i < buffer.Dim(); i++) {
+            buffer(i) = node.Rank() + 1 + i % 100 + iter;
+        }
+        engine.Start();
+        KALDI_ASSERT(engine.Pending());
+        engine.Wait();
+        KALDI_ASSERT(!engine.Pending());
+        for (int i = 0; i < buffer.Dim(); i++) {
+            BaseFloat expect = n * (n + 1) / 2 + n * (i % 100 + iter);
+            KALDI_ASSERT(buffer(i) == expect);
+        }
+    }
+    printf("rank %d %s bucket %d reduce %f s\n", node.Rank(), algorithm.c_str(),
+           bucket_size, engine.Timing().reduce);
+}
+
+// Small integers are exact in fp16, also the partial sums of the ring. With
+// error feedback, the sum of the compressed results tracks the sum of the
+// inputs, the difference is the sum of the residuals of the nodes, which
+// stays bounded. The second tensor is 100 times the first one, and shares
+// the bucket [600, 900) with it, the first one must not get its scale.
+void TestCompressedAllReduce(const MpiNode &node, const std::string &compress) {
+    AllReduceOptions opts;
+    opts.compress = compress;
+    opts.topk_ratio = 0.1;
+    opts.bucket_size = 300;
+    AllReduceEngine engine(opts, node);
+    std::vector<int> sizes;
+    sizes.push_back(700);
+    sizes.push_back(300);
+    engine.Init(sizes);
+    int n = node.NumNodes();
+    Vector<BaseFloat> &buffer = engine.PackedBuffer();
+    Vector<BaseFloat> input_sum(buffer.Dim()), output_sum(buffer.Dim());
+    for (int iter = 0; iter < 50; iter++) {
+        for (int i = 0; i < buffer.Dim(); i++) {
+            int scale = i < sizes[0] ? 1 : 100;
+            buffer(i) = scale * (node.Rank() + 1) * ((i + iter) % 7 - 3);
+            input_sum(i) += scale * n * (n + 1) / 2 * ((i + iter) % 7 - 3);
+        }
+        engine.Start();
+        engine.Wait();
+        if (compress == "fp16") {
+            for (int i = 0; i < buffer.Dim(); i++) {
+                int scale = i < sizes[0] ? 1 : 100;
+                KALDI_ASSERT(buffer(i) ==
+                             scale * n * (n + 1) / 2 * ((i + iter) % 7 - 3));
+            }
+            // half of the bytes of the float ring
+            KALDI_ASSERT(engine.Timing().bytes <=
+                         4 * (n - 1) * (buffer.Dim() / n + 4));
+        }
+        // no residual yet, a value of every node decodes to at most the
+        // largest value of its tensor
+        if (iter == 0) {
+            for (int i = 0; i < sizes[0]; i++) {
+                KALDI_ASSERT(fabs(buffer(i)) <= 3 * n * (n + 1) / 2);
+            }
+        }
+        output_sum.AddVec(1.0, buffer);
+    }
+    output_sum.AddVec(-1.0, input_sum);
+    for (int b = 0, offset = 0; b < sizes.size(); offset += sizes[b], b++) {
+        SubVector<BaseFloat> diff(output_sum, offset, sizes[b]);
+        BaseFloat max_diff = std::max(diff.Max(), -diff.Min());
+        // every residual is less than the largest input of its tensor
+        int scale = b == 0 ? 1 : 100;
+        KALDI_ASSERT(max_diff <= scale * 3 * n * n * (n + 1) / 2);
+        printf("rank %d compress %s tensor %d max diff of sum %f\n",
+               node.Rank(), compress.c_str(), b, max_diff);
+    }
+    printf("rank %d compress %s sent %ld bytes\n", node.Rank(),
+           compress.c_str(), static_cast<long>(engine.Timing().bytes));
+}
+
+// The records of the profiler sum up the timing of every reduce
+void TestSyncProfile(const MpiNode &node) {
+    AllReduceOptions opts;
+    AllReduceEngine engine(opts, node);
+    std::vector<int> sizes;
+    sizes.push_back(1000);
+    engine.Init(sizes);
+    SyncProfiler profiler;
+    int64 bytes = 0;
+    for (int iter = 0; iter < 3; iter++) {
+        profiler.Begin();
+        engine.PackedBuffer().Set(1.0);
+        engine.Start();
+        engine.Wait();
+        engine.Timing().AddTo(false, &profiler);
+        profiler.End();
+        bytes += engine.Timing().bytes;
+        KALDI_ASSERT(profiler.Records()[iter].time[kPhaseComm] ==
+                     engine.Timing().reduce);
+        KALDI_ASSERT(profiler.Records()[iter].time[kPhaseWait] == 0.0);
+    }
+    KALDI_ASSERT(profiler.NumRecords() == 3);
+    int64 sent = 0;
+    for (int i = 0; i < profiler.NumRecords(); i++) {
+        sent += profiler.Records()[i].bytes_sent;
+    }
+    KALDI_ASSERT(sent == bytes);
+    printf("rank %d sync profile %s\n", node.Rank(), profiler.Summary().c_str());
+}
+
+// As if the mpi library doesn't support MPI_THREAD_SERIALIZED
+class UnthreadedMpiNode : public MpiNode {
+public:
+    void SetThreadSerialized(bool thread_serialized) {
+        thread_serialized_ = thread_serialized;
+    }
+};
+
+} // namespace kaldi
+
+int main(int argc, char *argv[]) {
+    using namespace kaldi;
+    UnthreadedMpiNode mpi_node;
+    TestAllReduceEngine(mpi_node, "ring", 1 << 20);
+    TestAllReduceEngine(mpi_node, "ring", 100);
+    TestAllReduceEngine(mpi_node, "ring", 1);
+    TestAllReduceEngine(mpi_node, "mpi", 100);
+    TestCompressedAllReduce(mpi_node, "fp16");
+    TestCompressedAllReduce(mpi_node, "1bit");
+    TestCompressedAllReduce(mpi_node, "topk");
+    TestSyncProfile(mpi_node);
+    // the reduce on the calling thread
+    mpi_node.SetThreadSerialized(false);
+    TestAllReduceEngine(mpi_node, "ring", 100);
+    TestCompressedAllReduce(mpi_node, "fp16");
+    TestCompressedAllReduce(mpi_node, "1bit");
+    mpi_node.Barrier();
+    return 0;
+}
@@ -0,0 +1,316 @@
+/* Created on 2016-08-10
+ * Author: Zhang Binbin
+ */
+
+#include "base/timer.h"
+
+#include "aslp-parallel/allreduce-engine.h"
+#include "aslp-parallel/itf.h"
+
+namespace kaldi {
+
+AllReduceEngine::AllReduceEngine(const AllReduceOptions &opts,
+                                 const MpiNode &node):
+        opts_(opts), rank_(node.Rank()), num_nodes_(node.NumNodes()),
+        threaded_(node.ThreadSerialized()), start_(false), running_(false),
+        stop_(false), pending_(false) {
+    KALDI_ASSERT(opts_.bucket_size > 0);
+    if (opts_.algorithm != "ring" && opts_.algorithm != "mpi") {
+        KALDI_ERR << "Unsupported all-reduce algorithm " << opts_.algorithm;
+    }
+    compressor_ = Compressor::New(opts_.compress, opts_.topk_ratio);
+    offsets_.push_back(0);
+    // At most one chunk of a bucket is received at a time
+    recv_buffer_.Resize(opts_.bucket_size / num_nodes_ + 1, kUndefined);
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&cond_, NULL);
+    if (threaded_ &&
+        pthread_create(&thread_, NULL, AllReduceEngine::ThreadMain, this) != 0) {
+        KALDI_ERR << "Create all-reduce thread failed";
+    }
+}
+
+AllReduceEngine::~AllReduceEngine() {
+    pthread_mutex_lock(&mutex_);
+    stop_ = true;
+    pthread_cond_broadcast(&cond_);
+    pthread_mutex_unlock(&mutex_);
+    if (threaded_) pthread_join(thread_, NULL);
+    pthread_mutex_destroy(&mutex_);
+    pthread_cond_destroy(&cond_);
+    if (compressor_ != NULL) delete compressor_;
+}
+
+void AllReduceEngine::Init(const std::vector<int> &sizes) {
+    KALDI_ASSERT(!pending_);
+    offsets_.resize(sizes.size() + 1);
+    offsets_[0] = 0;
+    for (int i = 0; i < sizes.size(); i++) {
+        offsets_[i + 1] = offsets_[i] + sizes[i];
+    }
+    buffer_.Resize(offsets_.back());
+    if (compressor_ != NULL) residual_.Resize(offsets_.back());
+}
+
+void AllReduceEngine::Start() {
+    KALDI_ASSERT(!pending_);
+    pending_ = true;
+    if (!threaded_) {
+        Reduce();
+        return;
+    }
+    pthread_mutex_lock(&mutex_);
+    running_ = true;
+    start_ = true;
+    pthread_cond_broadcast(&cond_);
+    pthread_mutex_unlock(&mutex_);
+}
+
+void AllReduceEngine::Wait() {
+    Timer timer;
+    pthread_mutex_lock(&mutex_);
+    while (running_) {
+        pthread_cond_wait(&cond_, &mutex_);
+    }
+    pthread_mutex_unlock(&mutex_);
+    pending_ = false;
+    timing_.wait = timer.Elapsed();
+}
+
+void *AllReduceEngine::ThreadMain(void *arg) {
+    AllReduceEngine *engine = static_cast<AllReduceEngine *>(arg);
+    for (;;) {
+        pthread_mutex_lock(&engine->mutex_);
+        while (!engine->start_ && !engine->stop_) {
+            pthread_cond_wait(&engine->cond_, &engine->mutex_);
+        }
+        if (engine->stop_) {
+            pthread_mutex_unlock(&engine->mutex_);
+            break;
+        }
+        engine->start_ = false;
+        pthread_mutex_unlock(&engine->mutex_);
+
+        engine->Reduce();
+
+        pthread_mutex_lock(&engine->mutex_);
+        engine->running_ = false;
+        pthread_cond_broadcast(&engine->cond_);
+        pthread_mutex_unlock(&engine->mutex_);
+    }
+    return NULL;
+}
+
+void AllReduceEngine::Reduce() {
+    Timer timer;
+    timing_.bytes = 0;
+    for (int offset = 0; offset < buffer_.Dim(); offset += opts_.bucket_size) {
+        int size = std::min(opts_.bucket_size, buffer_.Dim() - offset);
+        BaseFloat *data = buffer_.Data() + offset;
+        if (compressor_ != NULL) {
+            CompressedAllReduce(offset, size);
+        } else if (opts_.algorithm == "ring") {
+            RingAllReduce(data, size);
+        } else if (num_nodes_ > 1) {
+            MPI_Allreduce(MPI_IN_PLACE, data, size, MpiNode::GetDataType(data),
+                          MPI_SUM, MPI_COMM_WORLD);
+            // as the ring, the least of an all-reduce
+            timing_.bytes += 2 * static_cast<int64>(size) * (num_nodes_ - 1) /
+                num_nodes_ * sizeof(BaseFloat);
+        }
+    }
+    timing_.reduce = timer.Elapsed();
+}
+
+// The bucket is split in num_nodes_ chunks. In step s of the reduce-scatter,
+// every node sends the partial sum of chunk (rank - s) to the right and adds
+// chunk (rank - s - 1) from the left, so in the end it has the sum of chunk
+// (rank + 1). Then the sums go around the ring the same way in the
+// all-gather.
+void AllReduceEngine::RingAllReduce(BaseFloat *data, int size) {
+    int n = num_nodes_;
+    if (n == 1) return;
+    int left = (rank_ - 1 + n) % n, right = (rank_ + 1) % n;
+    std::vector<int> begin(n + 1);
+    for (int i = 0; i <= n; i++) {
+        begin[i] = static_cast<int64>(size) * i / n;
+    }
+    MPI_Datatype type = MpiNode::GetDataType(data);
+    for (int s = 0; s < n - 1; s++) {
+        int send_chunk = (rank_ - s + n) % n,
+            recv_chunk = (rank_ - s - 1 + n) % n;
+        int send_size = begin[send_chunk + 1] - begin[send_chunk],
+            recv_size = begin[recv_chunk + 1] - begin[recv_chunk];
+        timing_.bytes += send_size * sizeof(BaseFloat);
+        MPI_Sendrecv(data + begin[send_chunk], send_size, type, right,
+                     kTagAllReduce, recv_buffer_.Data(), recv_size, type, left,
+                     kTagAllReduce, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        SubVector<BaseFloat> chunk(data + begin[recv_chunk], recv_size);
+        chunk.AddVec(1.0, recv_buffer_.Range(0, recv_size));
+    }
+    for (int s = 0; s < n - 1; s++) {
+        int send_chunk = (rank_ + 1 - s + n) % n,
+            recv_chunk = (rank_ - s + n) % n;
+        int send_size = begin[send_chunk + 1] - begin[send_chunk],
+            recv_size = begin[recv_chunk + 1] - begin[recv_chunk];
+        timing_.bytes += send_size * sizeof(BaseFloat);
+        MPI_Sendrecv(data + begin[send_chunk], send_size, type, right,
+                     kTagAllReduce, data + begin[recv_chunk], recv_size, type,
+                     left, kTagAllReduce, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+}
+
+// The pieces of the bucket [offset, offset + size), split at the buffers,
+// piece i is [begin[i], begin[i + 1]) of the bucket
+void AllReduceEngine::Pieces(int offset, int size,
+                             std::vector<int> *begin) const {
+    begin->clear();
+    begin->push_back(0);
+    for (int i = 1; i + 1 < offsets_.size(); i++) {
+        if (offsets_[i] > offset && offsets_[i] < offset + size) {
+            begin->push_back(offsets_[i] - offset);
+        }
+    }
+    begin->push_back(size);
+}
+
+// Every piece has its own code, so the 1bit means are of one parameter
+// tensor, and every tensor keeps its topk values
+int AllReduceEngine::EncodePieces(const std::vector<int> &begin,
+                                  const VectorBase<BaseFloat> &bucket,
+                                  char *code) const {
+    int code_size = 0;
+    for (int i = 0; i + 1 < begin.size(); i++) {
+        int dim = begin[i + 1] - begin[i];
+        if (code != NULL) {
+            compressor_->Encode(bucket.Range(begin[i], dim), code + code_size);
+        }
+        code_size += compressor_->CodeSize(dim);
+    }
+    return code_size;
+}
+
+void AllReduceEngine::DecodeAddPieces(const std::vector<int> &begin,
+                                      const char *code,
+                                      VectorBase<BaseFloat> *bucket) const {
+    for (int i = 0; i + 1 < begin.size(); i++) {
+        int dim = begin[i + 1] - begin[i];
+        SubVector<BaseFloat> piece(*bucket, begin[i], dim);
+        compressor_->DecodeAdd(code, &piece);
+        code += compressor_->CodeSize(dim);
+    }
+}
+
+void AllReduceEngine::CompressedAllReduce(int offset, int size) {
+    SubVector<BaseFloat> bucket(buffer_, offset, size),
+                         residual(residual_, offset, size);
+    // Error feedback, the error of the last time is sent this time
+    bucket.AddVec(1.0, residual);
+    if (opts_.compress == "fp16") {
+        Fp16RingAllReduce(&bucket, &residual);
+        return;
+    }
+    std::vector<int> begin;
+    Pieces(offset, size, &begin);
+    int code_size = EncodePieces(begin, bucket, NULL);
+    send_code_.resize(code_size);
+    recv_code_.resize(static_cast<size_t>(code_size) * num_nodes_);
+    EncodePieces(begin, bucket, &send_code_[0]);
+    residual.CopyFromVec(bucket);
+    bucket.SetZero();
+    DecodeAddPieces(begin, &send_code_[0], &bucket);
+    residual.AddVec(-1.0, bucket);
+    if (num_nodes_ == 1) return;
+
+    MPI_Allgather(&send_code_[0], code_size, MPI_CHAR, &recv_code_[0],
+                  code_size, MPI_CHAR, MPI_COMM_WORLD);
+    timing_.bytes += static_cast<int64>(code_size) * (num_nodes_ - 1);
+    bucket.SetZero();
+    for (int i = 0; i < num_nodes_; i++) {
+        DecodeAddPieces(begin, &recv_code_[static_cast<size_t>(code_size) * i],
+                        &bucket);
+    }
+}
+
+// The fp16 code of a value is 2 bytes, the code of the whole bucket is cut
+// in the chunks of RingAllReduce. The partial sums are sent in fp16 in the
+// reduce-scatter, and the final sums in the all-gather, where every node
+// forwards the code it received, so all the nodes decode the same sums.
+// The rounding error of every code a node makes (of its input, of the
+// partial sums it sends and of the sum of its chunk) goes to its residual,
+// so none of the error is lost.
+void AllReduceEngine::Fp16RingAllReduce(SubVector<BaseFloat> *bucket,
+                                        SubVector<BaseFloat> *residual) {
+    int n = num_nodes_, size = bucket->Dim();
+    int left = (rank_ - 1 + n) % n, right = (rank_ + 1) % n;
+    std::vector<int> begin(n + 1);
+    for (int i = 0; i <= n; i++) {
+        begin[i] = static_cast<int64>(size) * i / n;
+    }
+    send_code_.resize(compressor_->CodeSize(size));
+    // At most one chunk is received at a time in the reduce-scatter
+    recv_code_.resize(compressor_->CodeSize(opts_.bucket_size / n + 1));
+    char *code = &send_code_[0];
+    // The residual is in the bucket now, it gets the new errors
+    residual->SetZero();
+    EncodeChunk(0, size, bucket, residual, code);
+    if (n == 1) return;
+    for (int s = 0; s < n - 1; s++) {
+        int send_chunk = (rank_ - s + n) % n,
+            recv_chunk = (rank_ - s - 1 + n) % n;
+        int send_size = begin[send_chunk + 1] - begin[send_chunk],
+            recv_size = begin[recv_chunk + 1] - begin[recv_chunk];
+        // the input is already rounded, the partial sums are not
+        if (s > 0) {
+            EncodeChunk(begin[send_chunk], send_size, bucket, residual, code);
+        }
+        timing_.bytes += compressor_->CodeSize(send_size);
+        MPI_Sendrecv(code + compressor_->CodeSize(begin[send_chunk]),
+                     compressor_->CodeSize(send_size), MPI_CHAR, right,
+                     kTagAllReduce, &recv_code_[0],
+                     compressor_->CodeSize(recv_size), MPI_CHAR, left,
+                     kTagAllReduce, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        SubVector<BaseFloat> chunk(*bucket, begin[recv_chunk], recv_size);
+        compressor_->DecodeAdd(&recv_code_[0], &chunk);
+    }
+    // The sum of chunk rank + 1 is on this node
+    int own_chunk = (rank_ + 1) % n;
+    EncodeChunk(begin[own_chunk], begin[own_chunk + 1] - begin[own_chunk],
+                bucket, residual, code);
+    for (int s = 0; s < n - 1; s++) {
+        int send_chunk = (rank_ + 1 - s + n) % n,
+            recv_chunk = (rank_ - s + n) % n;
+        int send_size = begin[send_chunk + 1] - begin[send_chunk],
+            recv_size = begin[recv_chunk + 1] - begin[recv_chunk];
+        timing_.bytes += compressor_->CodeSize(send_size);
+        MPI_Sendrecv(code + compressor_->CodeSize(begin[send_chunk]),
+                     compressor_->CodeSize(send_size), MPI_CHAR, right,
+                     kTagAllReduce,
+                     code + compressor_->CodeSize(begin[recv_chunk]),
+                     compressor_->CodeSize(recv_size), MPI_CHAR, left,
+                     kTagAllReduce, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        SubVector<BaseFloat> chunk(*bucket, begin[recv_chunk], recv_size);
+        chunk.SetZero();
+        compressor_->DecodeAdd(code + compressor_->CodeSize(begin[recv_chunk]),
+                               &chunk);
+    }
+}
+
+// Encode [begin, begin + dim) of @bucket into its place in @code, the
+// bucket gets the decoded values and the rounding error is added to
+// @residual
+void AllReduceEngine::EncodeChunk(int begin, int dim,
+                                  SubVector<BaseFloat> *bucket,
+                                  SubVector<BaseFloat> *residual,
+                                  char *code) const {
+    SubVector<BaseFloat> chunk(*bucket, begin, dim),
+                         error(*residual, begin, dim);
+    char *chunk_code = code + compressor_->CodeSize(begin);
+    compressor_->Encode(chunk, chunk_code);
+    error.AddVec(1.0, chunk);
+    chunk.SetZero();
+    compressor_->DecodeAdd(chunk_code, &chunk);
+    error.AddVec(-1.0, chunk);
+}
+
+} // namespace kaldi
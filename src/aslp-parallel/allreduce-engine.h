@@ -0,0 +1,147 @@
+/* Created on 2016-08-10
+ * Author: Zhang Binbin
+ */
+
+#ifndef ASLP_PARALLEL_ALLREDUCE_ENGINE_H_
+#define ASLP_PARALLEL_ALLREDUCE_ENGINE_H_
+
+#include <pthread.h>
+
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "matrix/matrix-lib.h"
+
+#include "aslp-parallel/mpi-node.h"
+#include "aslp-parallel/compressor.h"
+#include "aslp-parallel/sync-profiler.h"
+
+namespace kaldi {
+
+struct AllReduceOptions {
+    int32 bucket_size;
+    std::string algorithm;
+    bool overlap;
+    std::string compress;
+    BaseFloat topk_ratio;
+
+    AllReduceOptions(): bucket_size(1 << 20), algorithm("ring"),
+        overlap(false), compress("none"), topk_ratio(0.01) {}
+
+    void Register(OptionsItf *opts) {
+        opts->Register("allreduce-bucket-size", &bucket_size,
+                "Number of parameters reduced in one bucket");
+        opts->Register("allreduce-algorithm", &algorithm,
+                "All-reduce of one bucket (ring | mpi), ring for the chunked "
+                "ring all-reduce, mpi for MPI_Allreduce");
+        opts->Register("overlap-sync", &overlap,
+                "If true, the all-reduce runs while training the next "
+                "minibatches, and the result is applied at the next "
+                "synchronization together with the local update since "
+                "(the synchronization is delayed by one period)");
+        opts->Register("compress", &compress,
+                "Compress the exchanged deltas (none | fp16 | 1bit | topk), "
+                "the compression error is added to the next synchronization");
+        opts->Register("compress-topk-ratio", &topk_ratio,
+                "Ratio of the values sent for --compress=topk");
+    }
+};
+
+// Time in seconds of the last synchronization
+struct AllReduceTiming {
+    AllReduceTiming(): pack(0.0), reduce(0.0), wait(0.0), unpack(0.0),
+        bytes(0) {}
+    double pack;   // copy to the buffer, by the caller
+    double reduce; // all-reduce of all the buckets, in background
+    double wait;   // the caller blocked for the reduce
+    double unpack; // copy back from the buffer, by the caller
+    int64 bytes; // sent by this node in the reduce
+
+    // Add to the current record of @profiler, the unpack is the model update.
+    // If the reduce is @overlapped with training, the time the caller blocked
+    // is idle, or else it is the reduce itself
+    void AddTo(bool overlapped, SyncProfiler *profiler) const {
+        profiler->Add(kPhaseCopy, pack);
+        profiler->Add(kPhaseComm, reduce);
+        if (overlapped) profiler->Add(kPhaseWait, wait);
+        profiler->Add(kPhaseUpdate, unpack);
+        // Every node receives as much as it sends in the reduce
+        profiler->AddBytes(bytes, bytes);
+    }
+};
+
+// AllReduceEngine: Sum a set of host buffers over all the mpi nodes on a
+// background thread. All the buffers are packed in one, which is reduced in
+// fixed size buckets, every bucket by a chunked ring all-reduce
+// (reduce-scatter then all-gather, every node sends 2 * (n-1) / n of the
+// bucket whatever the number of nodes n) or by MPI_Allreduce.
+// The caller must not make any mpi call between Start() and Wait()
+// (see MPI_THREAD_SERIALIZED in MpiNode). If the mpi library doesn't
+// support MPI_THREAD_SERIALIZED, there is no background thread, Start()
+// reduces on the calling thread and returns when it's done.
+// With opts.compress = fp16, the bucket goes through the same ring in half
+// precision. With 1bit or topk, every node encodes its bucket, a code per
+// buffer in it (see Compressor), the codes are gathered by MPI_Allgather,
+// and all the nodes decode and sum them in the same order, so they still
+// get the same sum. The buffers must hold deltas then, for the compression
+// error of a node is kept and added to its next buckets (error feedback).
+class AllReduceEngine {
+public:
+    AllReduceEngine(const AllReduceOptions &opts, const MpiNode &node);
+    ~AllReduceEngine();
+
+    // Allocate the packed buffer, @sizes is the size of every buffer
+    void Init(const std::vector<int> &sizes);
+    int NumBuffers() const { return offsets_.size() - 1; }
+    // The i-th buffer, in the packed one
+    SubVector<BaseFloat> Buffer(int i) {
+        return buffer_.Range(offsets_[i], offsets_[i + 1] - offsets_[i]);
+    }
+    // All the buffers
+    Vector<BaseFloat> &PackedBuffer() { return buffer_; }
+
+    // Begin the all-reduce of the buffers, and return at once (or when it's
+    // done without the background thread)
+    void Start();
+    // Block until the all-reduce is done, the buffers hold the sums then
+    void Wait();
+    // Start() called and Wait() not yet
+    bool Pending() const { return pending_; }
+
+    AllReduceTiming &Timing() { return timing_; }
+private:
+    static void *ThreadMain(void *arg);
+    void Reduce();
+    void RingAllReduce(BaseFloat *data, int size);
+    void CompressedAllReduce(int offset, int size);
+    void Fp16RingAllReduce(SubVector<BaseFloat> *bucket,
+                           SubVector<BaseFloat> *residual);
+    void EncodeChunk(int begin, int dim, SubVector<BaseFloat> *bucket,
+                     SubVector<BaseFloat> *residual, char *code) const;
+    void Pieces(int offset, int size, std::vector<int> *begin) const;
+    int EncodePieces(const std::vector<int> &begin,
+                     const VectorBase<BaseFloat> &bucket, char *code) const;
+    void DecodeAddPieces(const std::vector<int> &begin, const char *code,
+                         VectorBase<BaseFloat> *bucket) const;
+
+    AllReduceOptions opts_;
+    int rank_, num_nodes_;
+    Vector<BaseFloat> buffer_;
+    std::vector<int> offsets_; // of the buffers in buffer_
+    Vector<BaseFloat> recv_buffer_; // one chunk of the ring
+    Compressor *compressor_;
+    Vector<BaseFloat> residual_; // compression error of buffer_
+    std::vector<char> send_code_, recv_code_; // codes of a bucket
+    AllReduceTiming timing_;
+
+    bool threaded_; // reduce on thread_, or on the caller's thread
+    pthread_t thread_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t cond_;
+    bool start_, running_, stop_; // guarded by mutex_
+    bool pending_; // only used by the caller
+    KALDI_DISALLOW_COPY_AND_ASSIGN(AllReduceEngine);
+};
+
+} // namespace kaldi
+
+#endif
@@ -12,37 +12,29 @@
 
 #include "aslp-parallel/mpi-node.h"
 #include "aslp-parallel/itf.h"
+#include "aslp-parallel/sharded-server.h"
 
 namespace kaldi {
 
 // AsgdServer: Asynchronize SGD Server
-// Refer ASGD for details
+// Refer ASGD for details, the server is sharded, see ShardedServer
 
-class AsgdServer : public IServer {
+class AsgdServer : public ShardedServer {
 public:
-    AsgdServer(float alpha = 1.0, int sync_period = 1000): 
-				alpha_(alpha), sync_period_(sync_period) {}
-    ~AsgdServer();
-    // @params type pair: first is to the gpu data points, 
-    //                    second is the size of it
-    void InitParam(const std::vector<std::pair<BaseFloat *, int> > &params); 
+    AsgdServer(float alpha = 1.0, int sync_period = 1000, int num_servers = 1,
+               int num_threads = 1):
+        ShardedServer(sync_period, num_servers, num_threads), alpha_(alpha) {}
     void SetAlpha(float alpha) {
         KALDI_ASSERT(alpha >= 0.0);
         KALDI_ASSERT(alpha <= 1.0);
         alpha_ = alpha;
     }
-    // Start serve
-    void Run();
-    // Update server model with one worker
-    void Update(int worker_rank, int count);
+protected:
+    // Update server model with the grad of one worker
+    void UpdateParam(int worker_rank, int i, const VectorBase<BaseFloat> &grad,
+                     VectorBase<BaseFloat> *param);
 private:
     float alpha_;
-    int32 sync_period_;
-	// Here we use CuSubVector for that the memory is hold and managed by train model,
-    // CuSubVector only share and update this pointer, refer to CuSubVector for details
-    std::vector<CuSubVector<BaseFloat> *> server_gpu_params_;
-    std::vector<CuVector<BaseFloat> *> worker_gpu_params_;
-    std::vector<Vector<BaseFloat> *> cpu_params_;
 };
 
 
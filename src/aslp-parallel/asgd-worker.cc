@@ -2,6 +2,8 @@
  * Author: Zhang Binbin, Li Wenpeng, He Changqing
  */
 
+#include "base/timer.h"
+
 #include "aslp-parallel/asgd-worker.h"
 
 
@@ -12,14 +14,24 @@ void AsgdWorker::InitParam(
     prev_worker_gpu_params_.resize(params.size());
     worker_gpu_params_.resize(params.size());
     worker_cpu_params_.resize(params.size());
+    grad_cpu_params_.resize(params.size());
+    std::vector<int> sizes(params.size());
 
+    if (num_servers_ < 1 || num_servers_ > Rank()) {
+        KALDI_ERR << "Number of servers " << num_servers_ << " must be in [1, "
+                  << Rank() << "] for worker " << Rank();
+    }
     for (int i = 0; i < params.size(); i++) {
         worker_gpu_params_[i] = new 
             CuSubVector<BaseFloat>(params[i].first, params[i].second); 
         prev_worker_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
         prev_worker_gpu_params_[i]->CopyFromVec(*worker_gpu_params_[i]);
         worker_cpu_params_[i] = new Vector<BaseFloat>(params[i].second);
+        grad_cpu_params_[i] = new Vector<BaseFloat>(params[i].second);
+        sizes[i] = params[i].second;
     }
+    AssignShards(sizes, num_servers_, &shard_of_);
+    requests_.resize(2 * params.size());
 }
 
 AsgdWorker::~AsgdWorker() {
@@ -28,49 +40,73 @@ AsgdWorker::~AsgdWorker() {
         delete prev_worker_gpu_params_[i];
         delete worker_gpu_params_[i];
         delete worker_cpu_params_[i];
+        delete grad_cpu_params_[i];
     }
 }
 
 bool AsgdWorker::Synchronize(int num_worker_samples) {
     (void)num_worker_samples;
+    profiler_.Begin();
+    Timer timer;
     int msg_type = kMsgSynchronize;
-    // 1. send synchronize signal 
-    MPI_Send(&msg_type, 1, MPI_INT, MainNode(), kTagMsg, MPI_COMM_WORLD);
-    // 2.1 copy worker_gpu_params_ to worker_cpu_params_
+    // 1. send synchronize signal to all the shards
+    for (int s = 0; s < num_servers_; s++) {
+        MPI_Send(&msg_type, 1, MPI_INT, s, kTagMsg, MPI_COMM_WORLD);
+    }
+    profiler_.Add(kPhaseComm, timer.Elapsed());
+    timer.Reset();
+    // 2.1 copy worker_gpu_params_ to grad_cpu_params_
     for (int i = 0; i < worker_gpu_params_.size(); i++) {
         // get accumulated gradient
         worker_gpu_params_[i]->AddVec(-1.0, *prev_worker_gpu_params_[i], 1.0);
-        worker_cpu_params_[i]->CopyFromVec(*worker_gpu_params_[i]);
+        grad_cpu_params_[i]->CopyFromVec(*worker_gpu_params_[i]);
     }
+    profiler_.Add(kPhaseCopy, timer.Elapsed());
+    timer.Reset();
 
-    // 2.2 send accumulated gradient woker_cpu_params_
-    for (int i = 0; i < worker_cpu_params_.size(); i++) {
-        //KALDI_LOG << "send " << i << " size " << worker_cpu_params_[i]->Dim();
-        MPI_Send(worker_cpu_params_[i]->Data(), worker_cpu_params_[i]->Dim(), 
-                 MPI_FLOAT, MainNode(), i, MPI_COMM_WORLD);
+    // 2.2 send accumulated gradient grad_cpu_params_ and recive 
+    // server params to worker_cpu_params_, of every param from its shard
+    int n = worker_cpu_params_.size();
+    for (int i = 0; i < n; i++) {
+        MPI_Isend(grad_cpu_params_[i]->Data(), grad_cpu_params_[i]->Dim(), 
+                  MPI_FLOAT, shard_of_[i], kTagParam + i, MPI_COMM_WORLD,
+                  &requests_[i]);
+        MPI_Irecv(worker_cpu_params_[i]->Data(), worker_cpu_params_[i]->Dim(),
+                  MPI_FLOAT, shard_of_[i], kTagParam + i, MPI_COMM_WORLD,
+                  &requests_[n + i]);
+        int64 bytes = grad_cpu_params_[i]->Dim() * sizeof(BaseFloat);
+        profiler_.AddBytes(bytes, bytes);
     }
-    // 2.3 recive server_cpu_params_
-    MPI_Status status;
-    for (int i = 0; i < worker_cpu_params_.size(); i++) {
-        //KALDI_LOG << "recv " << i << " size " << worker_cpu_params_[i]->Dim();
-        MPI_Recv(worker_cpu_params_[i]->Data(), worker_cpu_params_[i]->Dim(),
-                 MPI_FLOAT, MainNode(), kTagModel, MPI_COMM_WORLD, &status);
+    if (n > 0) {
+        // The servers receive the grads at once, but the reply comes after
+        // the workers before and the update(or all the workers every
+        // sync_period), so it's counted as wait
+        MPI_Waitall(n, &requests_[0], MPI_STATUSES_IGNORE);
+        profiler_.Add(kPhaseComm, timer.Elapsed());
+        timer.Reset();
+        MPI_Waitall(n, &requests_[n], MPI_STATUSES_IGNORE);
+        profiler_.Add(kPhaseWait, timer.Elapsed());
     }
 
+    timer.Reset();
     // 2.3 copy worker_cpu_params_ to worker_gpu_params_ and prev_worker_gpu_params_ 
     for (int i = 0; i < worker_gpu_params_.size(); i++) {
         worker_gpu_params_[i]->CopyFromVec(*worker_cpu_params_[i]);
         prev_worker_gpu_params_[i]->CopyFromVec(*worker_cpu_params_[i]);
     }
+    profiler_.Add(kPhaseCopy, timer.Elapsed());
+    profiler_.End();
     
     // always return ture
     return true;
 }
 
 void AsgdWorker::Stop() {
-    // Send Stop signal
+    // Send Stop signal to all the shards
     int msg_type = kMsgFinished;
-    MPI_Send(&msg_type, 1, MPI_INT, MainNode(), kTagMsg, MPI_COMM_WORLD);
+    for (int s = 0; s < num_servers_; s++) {
+        MPI_Send(&msg_type, 1, MPI_INT, s, kTagMsg, MPI_COMM_WORLD);
+    }
     KALDI_LOG << "Worker " << Rank() << " finished";
 }
 
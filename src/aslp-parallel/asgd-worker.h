@@ -17,10 +17,13 @@ namespace kaldi {
 
 // AsgdWorker:  ASGD Worker
 // Refer "ASGD" for details
+// The server is sharded over ranks [0, num_servers), see ShardedServer, the
+// grads are sent to and the params received from all the shards at the same
+// time with non-blocking calls
 
 class AsgdWorker: public IWorker {
 public:
-    AsgdWorker() {};
+    AsgdWorker(int num_servers = 1): num_servers_(num_servers) {};
     ~AsgdWorker();
     // @params type pair: first is to the gpu data points, 
     //                    second is the size of it
@@ -31,11 +34,14 @@ public:
     
     void Stop();
 private:
+    int num_servers_;
+    std::vector<int> shard_of_; // shard of every param
     // Here we use CuSubVector for that the memory is hold and managed by train model,
     // CuSubVector only share and update this pointer, refer to CuSubVector for details
     std::vector<CuSubVector<BaseFloat> *> worker_gpu_params_;
     std::vector<CuVector<BaseFloat> *> prev_worker_gpu_params_;
-    std::vector<Vector<BaseFloat> *> worker_cpu_params_;
+    std::vector<Vector<BaseFloat> *> worker_cpu_params_, grad_cpu_params_;
+    std::vector<MPI_Request> requests_;
 };
 
 } // namespace kaldi
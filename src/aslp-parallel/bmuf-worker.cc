@@ -2,6 +2,8 @@
  * Author: Zhang Binbin
  */
 
+#include "base/timer.h"
+
 #include "aslp-parallel/bmuf-worker.h"
 
 namespace kaldi {
@@ -12,7 +14,7 @@ void BmufWorker::InitParam(
     prev_gpu_params_.resize(params.size());
     grad_gpu_params_.resize(params.size());
     prev_grad_gpu_params_.resize(params.size());
-    grad_cpu_params_.resize(params.size());
+    std::vector<int> sizes(params.size());
     for (int i = 0; i < params.size(); i++) {
         gpu_params_[i] = new 
             CuSubVector<BaseFloat>(params[i].first, params[i].second); 
@@ -20,8 +22,9 @@ void BmufWorker::InitParam(
         prev_gpu_params_[i]->CopyFromVec(*gpu_params_[i]);
         grad_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
         prev_grad_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
-        grad_cpu_params_[i] = new Vector<BaseFloat>(params[i].second);
+        sizes[i] = params[i].second;
     }
+    engine_.Init(sizes);
 }
 
 BmufWorker::~BmufWorker() {
@@ -30,41 +33,73 @@ BmufWorker::~BmufWorker() {
         delete prev_gpu_params_[i];
         delete grad_gpu_params_[i];
         delete prev_grad_gpu_params_[i];
-        delete grad_cpu_params_[i];
     }
 }
 
 bool BmufWorker::Synchronize(int num_worker_samples) {
+    profiler_.Begin();
+    // The reduce started last time, no mpi call in between
+    if (engine_.Pending()) {
+        engine_.Wait();
+        ApplyUpdate();
+    }
     int num_all_samples = num_worker_samples; 
+    // The slowest worker arrives last, the others are idle here
+    Timer wait_timer;
     AllReduce(&num_all_samples, 1);
+    profiler_.Add(kPhaseWait, wait_timer.Elapsed());
     // All workers finished it's data, return instantly
     if (num_all_samples <= 0) {
         KALDI_LOG << "All worker finished their data";
+        profiler_.End();
         return false;
     }
     
     // Do BMUF(Block Momentum Update Filtering)
+    Timer timer;
     for (int i = 0; i < gpu_params_.size(); i++) {
         // 1. calc grad w(t) - wg(t-1)
         grad_gpu_params_[i]->CopyFromVec(*gpu_params_[i]);
         grad_gpu_params_[i]->AddVec(-1.0, *prev_gpu_params_[i]);
-        grad_cpu_params_[i]->CopyFromVec(*grad_gpu_params_[i]);
-        // 2. reduce
-        AllReduce(grad_cpu_params_[i]->Data(), grad_cpu_params_[i]->Dim());
+        engine_.Buffer(i).CopyFromVec(*grad_gpu_params_[i]);
+    }
+    engine_.Timing().pack = timer.Elapsed();
+    // 2. reduce
+    engine_.Start();
+    if (!opts_.overlap) {
+        engine_.Wait();
+        ApplyUpdate();
+    }
+    profiler_.End();
+    return true;
+}
+
+// w(t) + local update since, which is 0 if !opts_.overlap
+void BmufWorker::ApplyUpdate() {
+    Timer timer;
+    float lr = (1.0 - momentum_) * learn_rate_;
+    for (int i = 0; i < gpu_params_.size(); i++) {
+        // local update since: w - (wg(t-1) + g(t))
+        gpu_params_[i]->AddVec(-1.0, *prev_gpu_params_[i]);
+        gpu_params_[i]->AddVec(-1.0, *grad_gpu_params_[i]);
         // 3. copy to gpu
-        grad_gpu_params_[i]->CopyFromVec(*grad_cpu_params_[i]);
+        grad_gpu_params_[i]->CopyFromVec(engine_.Buffer(i));
         // 4. calc mometum grad:  d(t) = m * g(t-1) + (1 - m) * lr * g(t)
-        float lr = (1.0 - momentum_) * learn_rate_;
         grad_gpu_params_[i]->AddVec(momentum_, *prev_grad_gpu_params_[i], lr);
         // 5. update model w(t) = w(t-1) + d(t)
-        gpu_params_[i]->CopyFromVec(*prev_gpu_params_[i]);
-        gpu_params_[i]->AddVec(1.0, *grad_gpu_params_[i]);
+        prev_gpu_params_[i]->AddVec(1.0, *grad_gpu_params_[i]);
+        gpu_params_[i]->AddVec(1.0, *prev_gpu_params_[i]);
 
         // 6. update prev
-        prev_gpu_params_[i]->CopyFromVec(*gpu_params_[i]);
         prev_grad_gpu_params_[i]->CopyFromVec(*grad_gpu_params_[i]);
     }
-    return true;
+    AllReduceTiming &timing = engine_.Timing();
+    timing.unpack = timer.Elapsed();
+    KALDI_VLOG(1) << "Worker " << Rank() << " synchronize time pack "
+                  << timing.pack << " reduce " << timing.reduce << " wait "
+                  << timing.wait << " unpack " << timing.unpack << " sent "
+                  << timing.bytes << " bytes";
+    timing.AddTo(opts_.overlap, &profiler_);
 }
 
 void BmufWorker::Stop() {
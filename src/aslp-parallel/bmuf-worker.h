@@ -12,6 +12,7 @@
 
 #include "aslp-parallel/mpi-node.h"
 #include "aslp-parallel/itf.h"
+#include "aslp-parallel/allreduce-engine.h"
 
 namespace kaldi {
 
@@ -26,10 +27,16 @@ namespace kaldi {
 // 1) All workers use the same global model after each synchronization, just like model averaging.
 // 2) BMUF use momentum.
 
+// The block grad is reduced by AllReduceEngine, if opts.overlap it runs while
+// training the next minibatches, then the local update since is added to the
+// new global model
+
 class BmufWorker : public IWorker {
 public:
-    BmufWorker(float learn_rate = 1.0, float momentum = 0.9): 
-        learn_rate_(learn_rate), momentum_(momentum) {}
+    BmufWorker(float learn_rate = 1.0, float momentum = 0.9,
+               const AllReduceOptions &opts = AllReduceOptions()): 
+        learn_rate_(learn_rate), momentum_(momentum), opts_(opts),
+        engine_(opts, *this) {}
     ~BmufWorker();
     // @params type pair: first is to the gpu data points, 
     //                    second is the size of it
@@ -41,16 +48,20 @@ public:
 
     void Stop();
 private:
+    // Block momentum update with the reduced grad
+    void ApplyUpdate();
+
     // Here we use CuSubVector for that the memory is hold and managed by train model,
     // CuSubVector only share and update this pointer, refer to CuSubVector for details
     std::vector<CuSubVector<BaseFloat> *> gpu_params_;
     std::vector<CuVector<BaseFloat > *> prev_gpu_params_;
     std::vector<CuVector<BaseFloat> *> grad_gpu_params_;
     std::vector<CuVector<BaseFloat> *> prev_grad_gpu_params_;
-    std::vector<Vector<BaseFloat> *> grad_cpu_params_;
 
     float learn_rate_;
     float momentum_; // 
+    AllReduceOptions opts_;
+    AllReduceEngine engine_;
 };
 
 //The block momentum and block learning rate are usually automatically set according to the number of workers used, i.e.,
@@ -2,6 +2,8 @@
  * Author: Zhang Binbin
  */
 
+#include "base/timer.h"
+
 #include "aslp-parallel/bsp-worker.h"
 
 namespace kaldi {
@@ -9,19 +11,31 @@ namespace kaldi {
 void BspWorker::InitParam(
         const std::vector<std::pair<BaseFloat *, int> > &params) {
     gpu_params_.resize(params.size());
-    cpu_params_.resize(params.size());
+    global_gpu_params_.resize(params.size());
+    snapshot_gpu_params_.resize(params.size());
+    std::vector<int> sizes(params.size());
     for (int i = 0; i < params.size(); i++) {
         gpu_params_[i] = new 
             CuSubVector<BaseFloat>(params[i].first, params[i].second); 
-        cpu_params_[i] = new Vector<BaseFloat>(params[i].second);
+        // The mean of the initial models, in case they are not the same
+        Vector<BaseFloat> cpu_param(params[i].second);
+        cpu_param.CopyFromVec(*gpu_params_[i]);
+        AllReduce(cpu_param.Data(), cpu_param.Dim());
+        cpu_param.Scale(1.0 / NumNodes());
+        global_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
+        global_gpu_params_[i]->CopyFromVec(cpu_param);
+        snapshot_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
+        sizes[i] = params[i].second;
     }
+    engine_.Init(sizes);
 }
 
 BspWorker::~BspWorker() {
-    KALDI_ASSERT(gpu_params_.size() == cpu_params_.size());
+    KALDI_ASSERT(gpu_params_.size() == snapshot_gpu_params_.size());
     for (int i = 0; i < gpu_params_.size(); i++) {
         delete gpu_params_[i];
-        delete cpu_params_[i];
+        delete global_gpu_params_[i];
+        delete snapshot_gpu_params_[i];
     }
 }
 
@@ -31,32 +45,66 @@ BspWorker::~BspWorker() {
 // which my be more efficient
 // This implemention is simple and stupid
 bool BspWorker::Synchronize(int num_worker_samples) {
+    profiler_.Begin();
+    // The average started last time, no mpi call in between
+    if (engine_.Pending()) {
+        engine_.Wait();
+        ApplyAverage();
+    }
     int num_all_samples = num_worker_samples; 
+    // The slowest worker arrives last, the others are idle here
+    Timer wait_timer;
     AllReduce(&num_all_samples, 1);
+    profiler_.Add(kPhaseWait, wait_timer.Elapsed());
     // All workers finished it's data, return instantly
     if (num_all_samples <= 0) {
         KALDI_LOG << "All worker finished their data";
+        profiler_.End();
         return false;
     }
     // 1. Calc scale
     float factor = float(num_worker_samples) / num_all_samples;
     KALDI_ASSERT(factor >= 0.0 && factor <= 1.0);
-    // 2. Do average
-    KALDI_ASSERT(gpu_params_.size() == cpu_params_.size());
+    // 2. Copy delta to host and start average
+    Timer timer;
     for (int i = 0; i < gpu_params_.size(); i++) {
-        // scale factor
-        gpu_params_[i]->Scale(factor);
-        // copy from gpu to host
-        cpu_params_[i]->CopyFromVec(*gpu_params_[i]);
-        // sum, average 
-        AllReduce(cpu_params_[i]->Data(), cpu_params_[i]->Dim());
-        // copy to gpu
-        gpu_params_[i]->CopyFromVec(*cpu_params_[i]);
+        snapshot_gpu_params_[i]->CopyFromVec(*gpu_params_[i]);
+        snapshot_gpu_params_[i]->AddVec(-1.0, *global_gpu_params_[i]);
+        engine_.Buffer(i).CopyFromVec(*snapshot_gpu_params_[i]);
     }
-
+    engine_.PackedBuffer().Scale(factor);
+    engine_.Timing().pack = timer.Elapsed();
+    engine_.Start();
+    if (!opts_.overlap) {
+        engine_.Wait();
+        ApplyAverage();
+    }
+    profiler_.End();
     return true;
 }
 
+void BspWorker::ApplyAverage() {
+    Timer timer;
+    for (int i = 0; i < gpu_params_.size(); i++) {
+        // -(w - snapshot), the local update since the average started
+        snapshot_gpu_params_[i]->AddVec(1.0, *global_gpu_params_[i]);
+        snapshot_gpu_params_[i]->AddVec(-1.0, *gpu_params_[i]);
+        // average = global + average delta
+        gpu_params_[i]->CopyFromVec(engine_.Buffer(i));
+        gpu_params_[i]->AddVec(1.0, *global_gpu_params_[i]);
+        global_gpu_params_[i]->CopyFromVec(*gpu_params_[i]);
+        // w = average + (w - snapshot)
+        gpu_params_[i]->AddVec(-1.0, *snapshot_gpu_params_[i]);
+    }
+    AllReduceTiming &timing = engine_.Timing();
+    timing.unpack = timer.Elapsed();
+    KALDI_VLOG(1) << "Worker " << Rank() << " synchronize time pack "
+                  << timing.pack << " reduce " << timing.reduce << " wait "
+                  << timing.wait << " unpack " << timing.unpack << " sent "
+                  << timing.bytes << " bytes";
+    timing.AddTo(opts_.overlap, &profiler_);
+}
+
 void BspWorker::Stop() {
     // Wait other worker to finish their data, it is called when worker finish 
     // it's own data, then loop to wait others 
@@ -12,13 +12,19 @@
 
 #include "aslp-parallel/mpi-node.h"
 #include "aslp-parallel/itf.h"
+#include "aslp-parallel/allreduce-engine.h"
 
 namespace kaldi {
 
 // BspWorker: Do modle Averge
+// The average is reduced by AllReduceEngine as the average of the deltas
+// from the last average (so they can be compressed), if opts.overlap it runs
+// while training the next minibatches, then the local update since is added
+// to it
 class BspWorker : public IWorker {
 public:
-    BspWorker() {}
+    BspWorker(const AllReduceOptions &opts = AllReduceOptions()):
+        opts_(opts), engine_(opts, *this) {}
     ~BspWorker();
     // @params type pair: first is to the gpu data points, 
     //                    second is the size of it
@@ -30,10 +36,18 @@ public:
 
     void Stop();
 private:
+    // Replace the params by the average, plus the update since it started
+    void ApplyAverage();
+
+    AllReduceOptions opts_;
+    AllReduceEngine engine_;
     // Here we use CuSubVector for that the memory is hold and managed by train model,
     // CuSubVector only share and update this pointer, refer to CuSubVector for details
     std::vector<CuSubVector<BaseFloat> *> gpu_params_;
-    std::vector<Vector<BaseFloat> *> cpu_params_;
+    // the last average, the same on all the workers
+    std::vector<CuVector<BaseFloat> *> global_gpu_params_;
+    // delta from global_gpu_params_ when the average started
+    std::vector<CuVector<BaseFloat> *> snapshot_gpu_params_;
 };
 
 
@@ -0,0 +1,154 @@
+/* Created on 2016-08-15
+ * Author: Zhang Binbin
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+
+#include "aslp-parallel/compressor.h"
+
+namespace kaldi {
+
+Compressor *Compressor::New(const std::string &type, BaseFloat topk_ratio) {
+    if (type == "none") return NULL;
+    else if (type == "fp16") return new Fp16Compressor();
+    else if (type == "1bit") return new OneBitCompressor();
+    else if (type == "topk") return new TopKCompressor(topk_ratio);
+    else KALDI_ERR << "Unsupported compress type " << type;
+    return NULL;
+}
+
+uint16 Fp16Compressor::FloatToHalf(float f) {
+    uint32 x;
+    memcpy(&x, &f, sizeof(x));
+    uint16 sign = (x >> 16) & 0x8000;
+    int32 float_exp = (x >> 23) & 0xff, exp = float_exp - 127 + 15;
+    uint32 mant = x & 0x7fffff;
+    // inf or nan
+    if (float_exp == 0xff) return sign | 0x7c00 | (mant != 0 ? 0x200 : 0);
+    // overflow to inf
+    if (exp >= 31) return sign | 0x7c00;
+    // subnormal or zero, round to nearest even
+    if (exp <= 0) {
+        if (exp < -10) return sign;
+        mant |= 0x800000;
+        int shift = 14 - exp;
+        uint32 half = mant >> shift, rem = mant & ((1u << shift) - 1),
+               mid = 1u << (shift - 1);
+        if (rem > mid || (rem == mid && (half & 1))) half++;
+        return sign | half;
+    }
+    // a carry of the rounding goes to the exponent, or to inf
+    uint32 half = sign | (exp << 10) | (mant >> 13), rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) half++;
+    return half;
+}
+
+float Fp16Compressor::HalfToFloat(uint16 h) {
+    uint32 sign = static_cast<uint32>(h & 0x8000) << 16,
+           exp = (h >> 10) & 0x1f, mant = h & 0x3ff;
+    if (exp == 0) {
+        float f = ldexpf(static_cast<float>(mant), -24);
+        return sign ? -f : f;
+    }
+    uint32 x;
+    if (exp == 31) x = sign | 0x7f800000 | (mant << 13);
+    else x = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+void Fp16Compressor::Encode(const VectorBase<BaseFloat> &in, char *code) const {
+    for (int i = 0; i < in.Dim(); i++) {
+        uint16 h = FloatToHalf(in(i));
+        memcpy(code + i * sizeof(uint16), &h, sizeof(uint16));
+    }
+}
+
+void Fp16Compressor::DecodeAdd(const char *code,
+                               VectorBase<BaseFloat> *out) const {
+    for (int i = 0; i < out->Dim(); i++) {
+        uint16 h;
+        memcpy(&h, code + i * sizeof(uint16), sizeof(uint16));
+        (*out)(i) += HalfToFloat(h);
+    }
+}
+
+void OneBitCompressor::Encode(const VectorBase<BaseFloat> &in,
+                              char *code) const {
+    double pos_sum = 0.0, neg_sum = 0.0;
+    int num_pos = 0;
+    for (int i = 0; i < in.Dim(); i++) {
+        if (in(i) >= 0) {
+            pos_sum += in(i);
+            num_pos++;
+        } else {
+            neg_sum += in(i);
+        }
+    }
+    float mean[2];
+    mean[0] = num_pos > 0 ? pos_sum / num_pos : 0.0;
+    mean[1] = num_pos < in.Dim() ? neg_sum / (in.Dim() - num_pos) : 0.0;
+    memcpy(code, mean, sizeof(mean));
+    unsigned char *bits = reinterpret_cast<unsigned char *>(code + sizeof(mean));
+    memset(bits, 0, (in.Dim() + 7) / 8);
+    for (int i = 0; i < in.Dim(); i++) {
+        if (in(i) < 0) bits[i / 8] |= 1 << (i % 8);
+    }
+}
+
+void OneBitCompressor::DecodeAdd(const char *code,
+                                 VectorBase<BaseFloat> *out) const {
+    float mean[2];
+    memcpy(mean, code, sizeof(mean));
+    const unsigned char *bits =
+        reinterpret_cast<const unsigned char *>(code + sizeof(mean));
+    for (int i = 0; i < out->Dim(); i++) {
+        (*out)(i) += mean[(bits[i / 8] >> (i % 8)) & 1];
+    }
+}
+
+// Order the indexes by the magnitude of the values
+class MagnitudeGreater {
+public:
+    explicit MagnitudeGreater(const VectorBase<BaseFloat> &vec): vec_(vec) {}
+    bool operator() (int32 a, int32 b) const {
+        return fabs(vec_(a)) > fabs(vec_(b));
+    }
+private:
+    const VectorBase<BaseFloat> &vec_;
+};
+
+void TopKCompressor::Encode(const VectorBase<BaseFloat> &in, char *code) const {
+    int k = NumKept(in.Dim());
+    std::vector<int32> index(in.Dim());
+    for (int i = 0; i < in.Dim(); i++) index[i] = i;
+    std::nth_element(index.begin(), index.begin() + k - 1, index.end(),
+                     MagnitudeGreater(in));
+    // In order for the memory access of decoding
+    std::sort(index.begin(), index.begin() + k);
+    for (int i = 0; i < k; i++) {
+        float value = in(index[i]);
+        memcpy(code, &index[i], sizeof(int32));
+        memcpy(code + sizeof(int32), &value, sizeof(float));
+        code += sizeof(int32) + sizeof(float);
+    }
+}
+
+void TopKCompressor::DecodeAdd(const char *code,
+                               VectorBase<BaseFloat> *out) const {
+    int k = NumKept(out->Dim());
+    for (int i = 0; i < k; i++) {
+        int32 index;
+        float value;
+        memcpy(&index, code, sizeof(int32));
+        memcpy(&value, code + sizeof(int32), sizeof(float));
+        (*out)(index) += value;
+        code += sizeof(int32) + sizeof(float);
+    }
+}
+
+} // namespace kaldi
@@ -0,0 +1,80 @@
+/* Created on 2016-08-15
+ * Author: Zhang Binbin
+ */
+
+#ifndef ASLP_PARALLEL_COMPRESSOR_H_
+#define ASLP_PARALLEL_COMPRESSOR_H_
+
+#include <string>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+
+namespace kaldi {
+
+// Compressor: Lossy fixed size code of a float vector, to exchange less data
+// between the nodes. The code size only depends on the dim, so the codes of
+// all the nodes can be gathered with MPI_Allgather. The code of fp16 is per
+// value, so a range of the code is the code of the range of the vector.
+// The error of 1bit and topk is large, the caller should add it to the next
+// vector it encodes(error feedback, see AllReduceEngine), it is done for the
+// deltas of model, but not for a model itself.
+class Compressor {
+public:
+    virtual ~Compressor() {}
+    // Bytes of the code of a vector of @dim
+    virtual int CodeSize(int dim) const = 0;
+    virtual void Encode(const VectorBase<BaseFloat> &in, char *code) const = 0;
+    // @out += the vector decoded from @code
+    virtual void DecodeAdd(const char *code, VectorBase<BaseFloat> *out) const = 0;
+    // @type: none | fp16 | 1bit | topk, return NULL for none
+    // @topk_ratio: ratio of the values kept by topk
+    static Compressor *New(const std::string &type, BaseFloat topk_ratio = 0.01);
+};
+
+// Half precision float, rounded to nearest
+class Fp16Compressor : public Compressor {
+public:
+    virtual int CodeSize(int dim) const { return dim * sizeof(uint16); }
+    virtual void Encode(const VectorBase<BaseFloat> &in, char *code) const;
+    virtual void DecodeAdd(const char *code, VectorBase<BaseFloat> *out) const;
+    static uint16 FloatToHalf(float f);
+    static float HalfToFloat(uint16 h);
+};
+
+// 1 bit for every value, which is decoded as the mean of the non negative
+// or of the negative values, refer "1-Bit Stochastic Gradient Descent and
+// its Application to Data-Parallel Distributed Training of Speech DNNs".
+// The means are of the whole vector, AllReduceEngine encodes every parameter
+// tensor apart, so a tensor doesn't get the scale of another one.
+class OneBitCompressor : public Compressor {
+public:
+    virtual int CodeSize(int dim) const {
+        return 2 * sizeof(float) + (dim + 7) / 8;
+    }
+    virtual void Encode(const VectorBase<BaseFloat> &in, char *code) const;
+    virtual void DecodeAdd(const char *code, VectorBase<BaseFloat> *out) const;
+};
+
+// Index and value of the k values of largest magnitude, 0 for the others
+class TopKCompressor : public Compressor {
+public:
+    explicit TopKCompressor(BaseFloat ratio): ratio_(ratio) {
+        KALDI_ASSERT(ratio_ > 0.0 && ratio_ <= 1.0);
+    }
+    virtual int CodeSize(int dim) const {
+        return NumKept(dim) * (sizeof(int32) + sizeof(float));
+    }
+    virtual void Encode(const VectorBase<BaseFloat> &in, char *code) const;
+    virtual void DecodeAdd(const char *code, VectorBase<BaseFloat> *out) const;
+private:
+    int NumKept(int dim) const {
+        int k = static_cast<int>(ratio_ * dim + 0.5);
+        return std::min(std::max(k, 1), dim);
+    }
+    BaseFloat ratio_;
+};
+
+} // namespace kaldi
+
+#endif
@@ -2,11 +2,21 @@
  * Author: Zhang Binbin
  */
 
+#include "base/timer.h"
+
 #include "aslp-parallel/easgd-server.h"
 
 
 namespace kaldi {
 
+EasgdServer::EasgdServer(float alpha, const std::string &compress):
+        alpha_(alpha), compressor_(NULL) {
+    if (compress == "fp16") compressor_ = new Fp16Compressor();
+    else if (compress != "none") 
+        KALDI_ERR << "Easgd only supports compress none or fp16, not " 
+                  << compress;
+}
+
 void EasgdServer::InitParam(
         const std::vector<std::pair<BaseFloat *, int> > &params) {
     server_gpu_params_.resize(params.size());
@@ -32,6 +42,7 @@ EasgdServer::~EasgdServer() {
         delete worker_gpu_params_[i];
         delete worker_cpu_params_[i];
     }
+    if (compressor_ != NULL) delete compressor_;
 }
 
 void EasgdServer::Run() {
@@ -39,9 +50,13 @@ void EasgdServer::Run() {
     MPI_Status status;
     int msg_type, worker_rank;
     while (num_running_workers > 0) {
+        // The idle time before a worker is served is in its record
+        if (!profiler_.IsOpen()) profiler_.Begin();
+        Timer timer;
         // tag 0, msg type 
         MPI_Recv(&msg_type, 1, MPI_INT, MPI_ANY_SOURCE, MPI_ANY_TAG, 
             MPI_COMM_WORLD, &status);
+        profiler_.Add(kPhaseWait, timer.Elapsed());
         worker_rank = status.MPI_SOURCE;
         KALDI_VLOG(2) << "Worker rank " << worker_rank << " Msg " << msg_type;
         switch (msg_type) {
@@ -50,40 +65,72 @@ void EasgdServer::Run() {
                 KALDI_LOG << "Worker " << worker_rank << " Finished ";
                 break;
             case kMsgSynchronize: 
+                profiler_.SetPeer(worker_rank);
                 Update(worker_rank); 
+                profiler_.End();
                 break;
             default:
                 KALDI_WARN << "Unknown mpi msg type " << msg_type;
         }
     }
+    if (profiler_.IsOpen()) profiler_.End();
 
     KALDI_LOG << "All worker finished";
 }
 
 void EasgdServer::Update(int worker_rank) {
+    Timer timer;
     // 1. copy server_gpu_params_ to server_cpu_params_ 
     for (int i = 0; i < server_cpu_params_.size(); i++) {
         server_cpu_params_[i]->CopyFromVec(*server_gpu_params_[i]);
     }
+    profiler_.Add(kPhaseCopy, timer.Elapsed());
     // 2. send server_cpu_params_ and recv worker_cpu_params_
     MPI_Status status;
     for (int i = 0; i < server_cpu_params_.size(); i++) {
-        MPI_Sendrecv(server_cpu_params_[i]->Data(), server_cpu_params_[i]->Dim(), 
-                     MPI_FLOAT, worker_rank, i,
-                     worker_cpu_params_[i]->Data(), worker_cpu_params_[i]->Dim(),
-                     MPI_FLOAT, worker_rank, i,
+        if (compressor_ == NULL) {
+            timer.Reset();
+            MPI_Sendrecv(server_cpu_params_[i]->Data(), server_cpu_params_[i]->Dim(), 
+                         MPI_FLOAT, worker_rank, i,
+                         worker_cpu_params_[i]->Data(), worker_cpu_params_[i]->Dim(),
+                         MPI_FLOAT, worker_rank, i,
+                         MPI_COMM_WORLD, &status);
+            profiler_.Add(kPhaseComm, timer.Elapsed());
+            int64 bytes = server_cpu_params_[i]->Dim() * sizeof(BaseFloat);
+            profiler_.AddBytes(bytes, bytes);
+            continue;
+        }
+        timer.Reset();
+        int code_size = compressor_->CodeSize(server_cpu_params_[i]->Dim());
+        send_code_.resize(code_size);
+        recv_code_.resize(code_size);
+        compressor_->Encode(*server_cpu_params_[i], &send_code_[0]);
+        profiler_.Add(kPhaseCopy, timer.Elapsed());
+        timer.Reset();
+        MPI_Sendrecv(&send_code_[0], code_size, MPI_CHAR, worker_rank, i,
+                     &recv_code_[0], code_size, MPI_CHAR, worker_rank, i,
                      MPI_COMM_WORLD, &status);
+        profiler_.Add(kPhaseComm, timer.Elapsed());
+        profiler_.AddBytes(code_size, code_size);
+        timer.Reset();
+        worker_cpu_params_[i]->SetZero();
+        compressor_->DecodeAdd(&recv_code_[0], worker_cpu_params_[i]);
+        profiler_.Add(kPhaseCopy, timer.Elapsed());
     }
+    timer.Reset();
     // 3. copy worker_cpu_params_ to worker_gpu_params_
     for (int i = 0; i < worker_gpu_params_.size(); i++) {
         worker_gpu_params_[i]->CopyFromVec(*worker_cpu_params_[i]);
     }   
+    profiler_.Add(kPhaseCopy, timer.Elapsed());
+    timer.Reset();
     // 4. update server gpu model
     for (int i = 0; i < server_gpu_params_.size(); i++) {
         //x_server = x_server + alpha(x_worker - x_server)
         //         = (1 - alpha) * x_server + alpha * x_worker
         server_gpu_params_[i]->AddVec(alpha_, *worker_gpu_params_[i], 1 - alpha_);
     }
+    profiler_.Add(kPhaseUpdate, timer.Elapsed());
 }
 
 
@@ -12,15 +12,18 @@
 
 #include "aslp-parallel/mpi-node.h"
 #include "aslp-parallel/itf.h"
+#include "aslp-parallel/compressor.h"
 
 namespace kaldi {
 
 // EasgdServer: Asynchronize Elastic Averaging SGD Server
 // Refer "Deep learning with Elastic Averaging SGD" for details
+// The models are exchanged, not the deltas, so only fp16 compress is
+// supported, which must be the same on the server and the workers
 
 class EasgdServer : public IServer {
 public:
-    EasgdServer(float alpha = 0.5): alpha_(alpha) {}
+    EasgdServer(float alpha = 0.5, const std::string &compress = "none");
     ~EasgdServer();
     // @params type pair: first is to the gpu data points, 
     //                    second is the size of it
@@ -36,6 +39,8 @@ public:
     void Update(int worker_rank);
 private:
     float alpha_;
+    Compressor *compressor_; // NULL for none
+    std::vector<char> send_code_, recv_code_;
     // Here we use CuSubVector for that the memory is hold and managed by train model,
     // CuSubVector only share and update this pointer, refer to CuSubVector for details
     std::vector<CuSubVector<BaseFloat> *> server_gpu_params_;
@@ -2,11 +2,21 @@
  * Author: Zhang Binbin
  */
 
+#include "base/timer.h"
+
 #include "aslp-parallel/easgd-worker.h"
 
 
 namespace kaldi {
 
+EasgdWorker::EasgdWorker(float alpha, const std::string &compress):
+        alpha_(alpha), compressor_(NULL) {
+    if (compress == "fp16") compressor_ = new Fp16Compressor();
+    else if (compress != "none") 
+        KALDI_ERR << "Easgd only supports compress none or fp16, not " 
+                  << compress;
+}
+
 void EasgdWorker::InitParam(
         const std::vector<std::pair<BaseFloat *, int> > &params) {
     server_gpu_params_.resize(params.size());
@@ -32,35 +42,72 @@ EasgdWorker::~EasgdWorker() {
         delete worker_gpu_params_[i];
         delete worker_cpu_params_[i];
     }
+    if (compressor_ != NULL) delete compressor_;
 }
 
 bool EasgdWorker::Synchronize(int num_worker_samples) {
     (void)num_worker_samples;
+    profiler_.Begin();
+    Timer timer;
     int msg_type = kMsgSynchronize;
     // 1. send synchronize signal 
     MPI_Send(&msg_type, 1, MPI_INT, MainNode(), kTagMsg, MPI_COMM_WORLD);
+    profiler_.Add(kPhaseComm, timer.Elapsed());
+    timer.Reset();
     // 2.1 copy worker_gpu_params_ to worker_cpu_params_
     for (int i = 0; i < worker_gpu_params_.size(); i++) {
         worker_cpu_params_[i]->CopyFromVec(*worker_gpu_params_[i]);
     }
+    profiler_.Add(kPhaseCopy, timer.Elapsed());
     // 2.2 send woker_cpu_params_ and recv server_cpu_params_
+    // The server serves one worker at a time, the first exchange includes
+    // the time waiting for it, so it's counted as wait
     MPI_Status status;
     for (int i = 0; i < server_cpu_params_.size(); i++) {
-        MPI_Sendrecv(worker_cpu_params_[i]->Data(), worker_cpu_params_[i]->Dim(), 
-                     MPI_FLOAT, MainNode(), i,
-                     server_cpu_params_[i]->Data(), server_cpu_params_[i]->Dim(),
-                     MPI_FLOAT, MainNode(), i,
+        SyncPhase phase = (i == 0 ? kPhaseWait : kPhaseComm);
+        if (compressor_ == NULL) {
+            timer.Reset();
+            MPI_Sendrecv(worker_cpu_params_[i]->Data(), worker_cpu_params_[i]->Dim(), 
+                         MPI_FLOAT, MainNode(), i,
+                         server_cpu_params_[i]->Data(), server_cpu_params_[i]->Dim(),
+                         MPI_FLOAT, MainNode(), i,
+                         MPI_COMM_WORLD, &status);
+            profiler_.Add(phase, timer.Elapsed());
+            int64 bytes = worker_cpu_params_[i]->Dim() * sizeof(BaseFloat);
+            profiler_.AddBytes(bytes, bytes);
+            continue;
+        }
+        timer.Reset();
+        int code_size = compressor_->CodeSize(worker_cpu_params_[i]->Dim());
+        send_code_.resize(code_size);
+        recv_code_.resize(code_size);
+        compressor_->Encode(*worker_cpu_params_[i], &send_code_[0]);
+        profiler_.Add(kPhaseCopy, timer.Elapsed());
+        timer.Reset();
+        MPI_Sendrecv(&send_code_[0], code_size, MPI_CHAR, MainNode(), i,
+                     &recv_code_[0], code_size, MPI_CHAR, MainNode(), i,
                      MPI_COMM_WORLD, &status);
+        profiler_.Add(phase, timer.Elapsed());
+        profiler_.AddBytes(code_size, code_size);
+        timer.Reset();
+        server_cpu_params_[i]->SetZero();
+        compressor_->DecodeAdd(&recv_code_[0], server_cpu_params_[i]);
+        profiler_.Add(kPhaseCopy, timer.Elapsed());
     }
 
+    timer.Reset();
     // 2.3 copy server_gpu_params_ to server_cpu_params_ 
     for (int i = 0; i < server_gpu_params_.size(); i++) {
         server_gpu_params_[i]->CopyFromVec(*server_cpu_params_[i]);
     }
+    profiler_.Add(kPhaseCopy, timer.Elapsed());
+    timer.Reset();
     // 2.4 update worker gpu model
     for (int i = 0; i < worker_gpu_params_.size(); i++) {
         worker_gpu_params_[i]->AddVec(alpha_, *server_gpu_params_[i], 1 - alpha_);
     }
+    profiler_.Add(kPhaseUpdate, timer.Elapsed());
+    profiler_.End();
     
     // always return ture
     return true;
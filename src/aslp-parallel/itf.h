@@ -5,14 +5,19 @@
 #ifndef ASLP_PARALLEL_ITF_H_
 #define ASLP_PARALLEL_ITF_H_
 
+#include <algorithm>
+
 #include "aslp-parallel/mpi-node.h"
+#include "aslp-parallel/sync-profiler.h"
 
 namespace kaldi {
 
 // Mpi tag type 
 typedef enum {
     kTagMsg = 0,
-    kTagModel = 1
+    kTagModel = 1,
+    kTagAllReduce = 2, // see AllReduceEngine
+    kTagParam = 3 // kTagParam + i for the i-th param, see ShardedServer
 } MpiTagType;
 
 // Mpi message types in kTagMsg for server and worker communication
@@ -22,6 +27,25 @@ typedef enum {
 } MpiMsgType;
 
 
+// Assign the params of @sizes to @num_shards parameter servers, the largest
+// first to the least loaded one, so it is the same on the servers and workers
+inline void AssignShards(const std::vector<int> &sizes, int num_shards,
+                         std::vector<int> *shard_of) {
+    KALDI_ASSERT(num_shards > 0);
+    std::vector<std::pair<int, int> > order(sizes.size());
+    for (int i = 0; i < sizes.size(); i++) {
+        order[i] = std::make_pair(-sizes[i], i);
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<int64> load(num_shards, 0);
+    shard_of->resize(sizes.size());
+    for (int i = 0; i < order.size(); i++) {
+        int shard = std::min_element(load.begin(), load.end()) - load.begin();
+        (*shard_of)[order[i].second] = shard;
+        load[shard] += sizes[order[i].second];
+    }
+}
+
 class IWorker : public MpiNode {
 public:
     virtual ~IWorker() {}
@@ -31,6 +55,10 @@ public:
     virtual bool Synchronize(int num_worker_samples) = 0;
     // Wait other workers
     virtual void Stop() = 0;
+    // A record every Synchronize, including the ones in Stop
+    SyncProfiler &Profiler() { return profiler_; }
+protected:
+    SyncProfiler profiler_;
 };
 
 class IServer : public MpiNode {
@@ -38,6 +66,10 @@ public:
     virtual ~IServer() {}
     virtual void InitParam(const std::vector<std::pair<BaseFloat *, int> > &params) = 0; 
     virtual void Run() = 0;
+    // A record every worker served in Run
+    SyncProfiler &Profiler() { return profiler_; }
+protected:
+    SyncProfiler profiler_;
 };
 
 } // namespace kaldi
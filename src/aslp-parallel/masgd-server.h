@@ -12,40 +12,38 @@
 
 #include "aslp-parallel/mpi-node.h"
 #include "aslp-parallel/itf.h"
+#include "aslp-parallel/sharded-server.h"
 
 namespace kaldi {
 
 // MasgdServer: Asynchronize SGD Server
-// Refer ASGD for details
+// Refer ASGD for details, the server is sharded, see ShardedServer
 
 #define GMASGD 0 // global
 #define LMASGD 1 // local
 #define MASGD_TYPE LMASGD
 
-class MasgdServer : public IServer {
+class MasgdServer : public ShardedServer {
 public:
-    MasgdServer(int sync_period = 1000, float momentum = 0.9): 
-				  sync_period_(sync_period), momentum_(momentum) {}
+    MasgdServer(int sync_period = 1000, float momentum = 0.9,
+                int num_servers = 1, int num_threads = 1):
+        ShardedServer(sync_period, num_servers, num_threads),
+        momentum_(momentum) {}
     ~MasgdServer();
     // @params type pair: first is to the gpu data points, 
     //                    second is the size of it
     void InitParam(const std::vector<std::pair<BaseFloat *, int> > &params); 
-    // Start serve
-    void Run();
-    // Update server model with one worker
-    void Update(int worker_rank, int count);
+protected:
+    // Update server model with the grad of one worker
+    void UpdateParam(int worker_rank, int i, const VectorBase<BaseFloat> &grad,
+                     VectorBase<BaseFloat> *param);
 private:
-    int32 sync_period_;
     float momentum_;
-	// Here we use CuSubVector for that the memory is hold and managed by train model,
-    // CuSubVector only share and update this pointer, refer to CuSubVector for details
-    std::vector<CuSubVector<BaseFloat> *> server_gpu_params_;
-    std::vector<CuVector<BaseFloat> *> worker_gpu_params_;
-    std::vector<Vector<BaseFloat> *> cpu_params_;
+    // Of all the params, NULL for the params not in the shard
 #if MASGD_TYPE == GMASGD
-    std::vector<CuVector<BaseFloat> * > diffs_;
+    std::vector<Vector<BaseFloat> * > diffs_;
 #elif MASGD_TYPE == LMASGD
-    std::vector<std::vector<CuVector<BaseFloat >* > > diffs_;
+    std::vector<std::vector<Vector<BaseFloat >* > > diffs_;
 #else 
     #error "Unknown masgd type"
 #endif
@@ -17,16 +17,32 @@ namespace kaldi {
 // mpi wrapper
 class MpiNode {
 public:
+    // If mpi is already initialized(e.g. by a test running several nodes
+    // one after another), it's used as it is, and not finalized here
     MpiNode() {
         int argc = 0;
         char **argv = NULL;
-        MPI_Init(&argc, &argv);
+        // The AllReduceEngine thread makes mpi calls, but never at the same
+        // time as the main thread
+        int initialized, provided;
+        MPI_Initialized(&initialized);
+        own_mpi_ = !initialized;
+        if (own_mpi_) {
+            MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
+        } else {
+            MPI_Query_thread(&provided);
+        }
+        thread_serialized_ = (provided >= MPI_THREAD_SERIALIZED);
+        if (!thread_serialized_) {
+            KALDI_WARN << "MPI_THREAD_SERIALIZED is not supported, "
+                       << "AllReduceEngine reduces on the calling thread";
+        }
         MPI_Comm_rank(MPI_COMM_WORLD, &rank_);
         MPI_Comm_size(MPI_COMM_WORLD, &num_nodes_);
     }
 
     virtual ~MpiNode() {
-        MPI_Finalize();
+        if (own_mpi_) MPI_Finalize();
     }
 
     int Rank() const {
@@ -45,6 +61,12 @@ public:
         return rank_ == 0;
     }
 
+    // Whether mpi calls may be made from another thread than the main one
+    // (one thread at a time)
+    bool ThreadSerialized() const {
+        return thread_serialized_;
+    }
+
     static MPI_Datatype GetDataType(char *) {   
         return MPI_CHAR;
     }   
@@ -94,6 +116,8 @@ public:
 
 protected:
     int rank_, num_nodes_;
+    bool thread_serialized_;
+    bool own_mpi_; // initialized mpi, so finalizes it
 };
 
 } // namespace kaldi
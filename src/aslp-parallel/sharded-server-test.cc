@@ -0,0 +1,148 @@
+/* Created on 2016-08-22
+ * Author: Zhang Binbin
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sharded-server.h"
+#include "asgd-worker.h"
+
+namespace kaldi {
+
+const int kNumServers = 2;
+
+// Adds the grads to the params, as AsgdServer with alpha 1, and counts the
+// updates
+class TestServer : public ShardedServer {
+public:
+    TestServer(int sync_period):
+            ShardedServer(sync_period, kNumServers, 2), num_updates_(0) {}
+    // The shard of the server is the one AssignShards gives the workers
+    void CheckShard(const std::vector<int> &sizes) const {
+        std::vector<int> shard_of, shard_params;
+        AssignShards(sizes, kNumServers, &shard_of);
+        for (int i = 0; i < sizes.size(); i++) {
+            if (shard_of[i] == Rank()) shard_params.push_back(i);
+        }
+        KALDI_ASSERT(ShardParams() == shard_params);
+    }
+    int NumUpdates() const { return num_updates_; }
+protected:
+    virtual void UpdateParam(int worker_rank, int i,
+                             const VectorBase<BaseFloat> &grad,
+                             VectorBase<BaseFloat> *param) {
+        (void)worker_rank;
+        (void)i;
+        param->AddVec(1.0, grad);
+        __sync_fetch_and_add(&num_updates_, 1);
+    }
+private:
+    int num_updates_;
+};
+
+// Worker w synchronizes Iters(w) times, every time it adds w + 1 to all
+// its params
+static int Iters(int w) { return 3 + 2 * w; }
+
+// The initial param i
+static BaseFloat InitValue(int i, int j) { return i + j % 3; }
+
+// The params of the workers summed up to @iters synchronizations each
+static BaseFloat SumOfGrads(int num_workers, int iters) {
+    BaseFloat sum = 0;
+    for (int w = 0; w < num_workers; w++) {
+        sum += (w + 1) * std::min(iters, Iters(w));
+    }
+    return sum;
+}
+
+// kNumServers shards and the other ranks as the workers, with sync_period 1
+// the main server holds every reply until all the running workers arrived,
+// so the workers go in lock step on its params, the other shard never holds.
+// In the end the params of all the shards are gathered on the main server.
+void TestShardedServer(const MpiNode &node, const std::vector<int> &sizes) {
+    std::vector<std::vector<BaseFloat> > store(sizes.size());
+    std::vector<std::pair<BaseFloat *, int> > params;
+    for (int i = 0; i < sizes.size(); i++) {
+        for (int j = 0; j < sizes[i]; j++) store[i].push_back(InitValue(i, j));
+        params.push_back(std::make_pair(&store[i][0], sizes[i]));
+    }
+    std::vector<int> shard_of;
+    AssignShards(sizes, kNumServers, &shard_of);
+    int num_workers = node.NumNodes() - kNumServers;
+    int total_iters = 0;
+    for (int w = 0; w < num_workers; w++) total_iters += Iters(w);
+
+    if (node.Rank() < kNumServers) {
+        TestServer server(1);
+        server.InitParam(params);
+        server.CheckShard(sizes);
+        server.Run();
+        int k = 0;
+        for (int i = 0; i < sizes.size(); i++) {
+            if (shard_of[i] == node.Rank()) k++;
+        }
+        KALDI_ASSERT(server.NumUpdates() == k * total_iters);
+        if (server.IsMainNode()) {
+            BaseFloat sum = SumOfGrads(num_workers, total_iters);
+            for (int i = 0; i < sizes.size(); i++) {
+                for (int j = 0; j < sizes[i]; j++) {
+                    KALDI_ASSERT(store[i][j] == InitValue(i, j) + sum);
+                }
+            }
+        }
+        printf("server %d %d params, %d updates\n", node.Rank(), k,
+               server.NumUpdates());
+    } else {
+        int w = node.Rank() - kNumServers;
+        AsgdWorker worker(kNumServers);
+        worker.InitParam(params);
+        for (int t = 1; t <= Iters(w); t++) {
+            for (int i = 0; i < sizes.size(); i++) {
+                for (int j = 0; j < sizes[i]; j++) store[i][j] += w + 1;
+            }
+            worker.Synchronize(1);
+            BaseFloat sum = SumOfGrads(num_workers, t);
+            for (int i = 0; i < sizes.size(); i++) {
+                if (shard_of[i] != 0) continue;
+                for (int j = 0; j < sizes[i]; j++) {
+                    KALDI_ASSERT(store[i][j] == InitValue(i, j) + sum);
+                }
+            }
+        }
+        worker.Stop();
+        printf("worker %d %d synchronizations\n", node.Rank(), Iters(w));
+    }
+    node.Barrier();
+}
+
+} // namespace kaldi
+
+int main(int argc, char *argv[]) {
+    using namespace kaldi;
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
+    {
+        MpiNode mpi_node;
+        // e.g. mpirun -np 4 sharded-server-test, for 2 shards and 2 workers
+        if (mpi_node.NumNodes() <= kNumServers) {
+            KALDI_WARN << "No worker on " << mpi_node.NumNodes()
+                       << " nodes, skip the test";
+        } else {
+            std::vector<int> sizes;
+            sizes.push_back(5);
+            sizes.push_back(1000);
+            sizes.push_back(37);
+            sizes.push_back(300);
+            sizes.push_back(1);
+            sizes.push_back(64);
+            TestShardedServer(mpi_node, sizes);
+            // one param, the second shard has none
+            sizes.assign(1, 64);
+            TestShardedServer(mpi_node, sizes);
+        }
+    }
+    MPI_Finalize();
+    return 0;
+}
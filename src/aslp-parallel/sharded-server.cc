@@ -0,0 +1,287 @@
+/* Created on 2016-08-20
+ * Author: Zhang Binbin
+ */
+
+#include "base/timer.h"
+
+#include "aslp-parallel/sharded-server.h"
+
+namespace kaldi {
+
+ShardedServer::ShardedServer(int sync_period, int num_servers, int num_threads):
+        sync_period_(sync_period), num_servers_(num_servers),
+        num_threads_(num_threads), update_time_(0.0), num_updates_(0),
+        job_id_(0), job_worker_(-1), num_busy_(0), stop_(false),
+        next_param_(0) {
+    KALDI_ASSERT(num_threads_ >= 1);
+    if (num_servers_ < 1 || num_servers_ >= NumNodes()) {
+        KALDI_ERR << "Number of servers " << num_servers_ << " must be in [1, "
+                  << NumNodes() - 1 << "]";
+    }
+    KALDI_ASSERT(Rank() < num_servers_);
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&cond_, NULL);
+    // The main thread is one of the update threads
+    threads_.resize(num_threads_ - 1);
+    for (int i = 0; i < threads_.size(); i++) {
+        if (pthread_create(&threads_[i], NULL, ShardedServer::ThreadMain,
+                           this) != 0) {
+            KALDI_ERR << "Create update thread failed";
+        }
+    }
+}
+
+ShardedServer::~ShardedServer() {
+    pthread_mutex_lock(&mutex_);
+    stop_ = true;
+    pthread_cond_broadcast(&cond_);
+    pthread_mutex_unlock(&mutex_);
+    for (int i = 0; i < threads_.size(); i++) {
+        pthread_join(threads_[i], NULL);
+    }
+    pthread_mutex_destroy(&mutex_);
+    pthread_cond_destroy(&cond_);
+    for (int i = 0; i < gpu_params_.size(); i++) {
+        delete gpu_params_[i];
+    }
+    for (int j = 0; j < params_.size(); j++) {
+        delete params_[j];
+        for (int w = 0; w < recv_params_.size(); w++) {
+            delete recv_params_[w][j];
+            delete send_params_[w][j];
+        }
+    }
+}
+
+void ShardedServer::InitParam(
+        const std::vector<std::pair<BaseFloat *, int> > &params) {
+    std::vector<int> sizes(params.size());
+    gpu_params_.resize(params.size());
+    for (int i = 0; i < params.size(); i++) {
+        gpu_params_[i] = new
+            CuSubVector<BaseFloat>(params[i].first, params[i].second);
+        sizes[i] = params[i].second;
+    }
+    AssignShards(sizes, num_servers_, &shard_of_);
+    for (int i = 0; i < params.size(); i++) {
+        if (shard_of_[i] == Rank()) shard_params_.push_back(i);
+    }
+
+    int num_workers = NumWorkers(), k = shard_params_.size();
+    params_.resize(k);
+    recv_params_.resize(num_workers);
+    send_params_.resize(num_workers);
+    for (int w = 0; w < num_workers; w++) {
+        recv_params_[w].resize(k);
+        send_params_[w].resize(k);
+    }
+    int64 shard_size = 0;
+    for (int j = 0; j < k; j++) {
+        int i = shard_params_[j];
+        params_[j] = new Vector<BaseFloat>(params[i].second);
+        params_[j]->CopyFromVec(*gpu_params_[i]);
+        for (int w = 0; w < num_workers; w++) {
+            recv_params_[w][j] = new Vector<BaseFloat>(params[i].second);
+            send_params_[w][j] = new Vector<BaseFloat>(params[i].second);
+        }
+        shard_size += params[i].second;
+    }
+    KALDI_LOG << "Server " << Rank() << " shard of " << k << " params, "
+              << shard_size << " values";
+}
+
+void *ShardedServer::ThreadMain(void *arg) {
+    ShardedServer *server = static_cast<ShardedServer *>(arg);
+    int last_job = 0;
+    for (;;) {
+        pthread_mutex_lock(&server->mutex_);
+        while (server->job_id_ == last_job && !server->stop_) {
+            pthread_cond_wait(&server->cond_, &server->mutex_);
+        }
+        if (server->stop_) {
+            pthread_mutex_unlock(&server->mutex_);
+            break;
+        }
+        last_job = server->job_id_;
+        int worker_rank = server->job_worker_;
+        pthread_mutex_unlock(&server->mutex_);
+
+        server->UpdateLoop(worker_rank);
+
+        pthread_mutex_lock(&server->mutex_);
+        if (--server->num_busy_ == 0) pthread_cond_broadcast(&server->cond_);
+        pthread_mutex_unlock(&server->mutex_);
+    }
+    return NULL;
+}
+
+void ShardedServer::UpdateLoop(int worker_rank) {
+    int w = WorkerIndex(worker_rank);
+    for (;;) {
+        int j = __sync_fetch_and_add(&next_param_, 1);
+        if (j >= shard_params_.size()) break;
+        UpdateParam(worker_rank, shard_params_[j], *recv_params_[w][j],
+                    params_[j]);
+    }
+}
+
+void ShardedServer::ParallelUpdate(int worker_rank) {
+    Timer timer;
+    pthread_mutex_lock(&mutex_);
+    next_param_ = 0;
+    job_worker_ = worker_rank;
+    num_busy_ = threads_.size();
+    job_id_++;
+    pthread_cond_broadcast(&cond_);
+    pthread_mutex_unlock(&mutex_);
+
+    UpdateLoop(worker_rank);
+
+    pthread_mutex_lock(&mutex_);
+    while (num_busy_ > 0) {
+        pthread_cond_wait(&cond_, &mutex_);
+    }
+    pthread_mutex_unlock(&mutex_);
+    double elapsed = timer.Elapsed();
+    update_time_ += elapsed;
+    num_updates_++;
+    profiler_.Add(kPhaseUpdate, elapsed);
+}
+
+void ShardedServer::Reply(int worker_rank) {
+    int w = WorkerIndex(worker_rank);
+    std::vector<MPI_Request> &requests = send_requests_[w];
+    Timer timer;
+    // The worker got the last reply, so they are done
+    if (!requests.empty()) {
+        MPI_Waitall(requests.size(), &requests[0], MPI_STATUSES_IGNORE);
+    }
+    double comm_time = timer.Elapsed(), copy_time = 0.0;
+    for (int j = 0; j < shard_params_.size(); j++) {
+        timer.Reset();
+        send_params_[w][j]->CopyFromVec(*params_[j]);
+        copy_time += timer.Elapsed();
+        timer.Reset();
+        MPI_Isend(send_params_[w][j]->Data(), send_params_[w][j]->Dim(),
+                  MPI_FLOAT, worker_rank, kTagParam + shard_params_[j],
+                  MPI_COMM_WORLD, &requests[j]);
+        comm_time += timer.Elapsed();
+        profiler_.AddBytes(send_params_[w][j]->Dim() * sizeof(BaseFloat), 0);
+    }
+    profiler_.Add(kPhaseCopy, copy_time);
+    profiler_.Add(kPhaseComm, comm_time);
+}
+
+void ShardedServer::Run() {
+    int num_workers = NumWorkers(), k = shard_params_.size();
+    // 1 msg and k grads for every worker
+    int stride = k + 1;
+    recv_requests_.assign(num_workers * stride, MPI_REQUEST_NULL);
+    msg_.resize(num_workers);
+    num_pending_grads_.assign(num_workers, 0);
+    send_requests_.assign(num_workers,
+                          std::vector<MPI_Request>(k, MPI_REQUEST_NULL));
+    for (int w = 0; w < num_workers; w++) {
+        MPI_Irecv(&msg_[w], 1, MPI_INT, w + num_servers_, kTagMsg,
+                  MPI_COMM_WORLD, &recv_requests_[w * stride]);
+    }
+
+    int num_running_workers = num_workers;
+    int synchronized_count = 0;
+    std::vector<int> waited_worker;
+    while (num_running_workers > 0) {
+        // The idle time before a worker is updated is in its record
+        if (!profiler_.IsOpen()) profiler_.Begin();
+        Timer timer;
+        int index;
+        MPI_Waitany(recv_requests_.size(), &recv_requests_[0], &index,
+                    MPI_STATUS_IGNORE);
+        profiler_.Add(kPhaseWait, timer.Elapsed());
+        KALDI_ASSERT(index != MPI_UNDEFINED);
+        int w = index / stride, worker_rank = w + num_servers_;
+        bool updated = false;
+        if (index % stride == 0) {
+            KALDI_VLOG(2) << "Worker rank " << worker_rank << " Msg " << msg_[w];
+            switch (msg_[w]) {
+                case kMsgFinished:
+                    num_running_workers--;
+                    KALDI_LOG << "Worker " << worker_rank << " Finished ";
+                    break;
+                case kMsgSynchronize:
+                    for (int j = 0; j < k; j++) {
+                        MPI_Irecv(recv_params_[w][j]->Data(),
+                                  recv_params_[w][j]->Dim(), MPI_FLOAT,
+                                  worker_rank, kTagParam + shard_params_[j],
+                                  MPI_COMM_WORLD, &recv_requests_[index + 1 + j]);
+                    }
+                    num_pending_grads_[w] = k;
+                    // The next msg comes after the reply
+                    MPI_Irecv(&msg_[w], 1, MPI_INT, worker_rank, kTagMsg,
+                              MPI_COMM_WORLD, &recv_requests_[index]);
+                    updated = (k == 0);
+                    break;
+                default:
+                    KALDI_WARN << "Unknown mpi msg type " << msg_[w];
+                    MPI_Irecv(&msg_[w], 1, MPI_INT, worker_rank, kTagMsg,
+                              MPI_COMM_WORLD, &recv_requests_[index]);
+            }
+        } else {
+            profiler_.AddBytes(0, recv_params_[w][index % stride - 1]->Dim() *
+                                  sizeof(BaseFloat));
+            updated = (--num_pending_grads_[w] == 0);
+        }
+
+        if (updated) {
+            ++synchronized_count;
+            profiler_.SetPeer(worker_rank);
+            ParallelUpdate(worker_rank);
+            if (IsMainNode() && sync_period_ > 0 &&
+                    synchronized_count >= sync_period_) {
+                waited_worker.push_back(worker_rank);
+            } else {
+                Reply(worker_rank);
+            }
+        }
+        if (sync_period_ > 0 &&
+                synchronized_count >= sync_period_ &&
+                waited_worker.size() == num_running_workers &&
+                num_running_workers != 0) {
+            for (int j = 0; j < waited_worker.size(); j++) {
+                KALDI_LOG << "Worker " << waited_worker[j] << " synchronized!";
+                Reply(waited_worker[j]);
+            }
+            synchronized_count = synchronized_count - sync_period_;
+            waited_worker.clear();
+        }
+        if (updated) profiler_.End();
+    }
+    if (profiler_.IsOpen()) profiler_.End();
+    for (int w = 0; w < num_workers && k > 0; w++) {
+        MPI_Waitall(k, &send_requests_[w][0], MPI_STATUSES_IGNORE);
+    }
+    KALDI_LOG << "All worker finished, server " << Rank() << " "
+              << num_updates_ << " updates in " << update_time_ << " s";
+    GatherParams();
+}
+
+void ShardedServer::GatherParams() {
+    if (!IsMainNode()) {
+        for (int j = 0; j < shard_params_.size(); j++) {
+            MPI_Send(params_[j]->Data(), params_[j]->Dim(), MPI_FLOAT,
+                     MainNode(), kTagParam + shard_params_[j], MPI_COMM_WORLD);
+        }
+        return;
+    }
+    for (int j = 0; j < shard_params_.size(); j++) {
+        gpu_params_[shard_params_[j]]->CopyFromVec(*params_[j]);
+    }
+    for (int i = 0; i < gpu_params_.size(); i++) {
+        if (shard_of_[i] == Rank()) continue;
+        Vector<BaseFloat> param(gpu_params_[i]->Dim());
+        MPI_Recv(param.Data(), param.Dim(), MPI_FLOAT, shard_of_[i],
+                 kTagParam + i, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        gpu_params_[i]->CopyFromVec(param);
+    }
+}
+
+} // namespace kaldi
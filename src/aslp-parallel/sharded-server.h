@@ -0,0 +1,94 @@
+/* Created on 2016-08-20
+ * Author: Zhang Binbin
+ */
+
+#ifndef ASLP_PARALLEL_SHARDED_SERVER_H_
+#define ASLP_PARALLEL_SHARDED_SERVER_H_
+
+#include <pthread.h>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+#include "cudamatrix/cu-matrix.h"
+#include "cudamatrix/cu-vector.h"
+
+#include "aslp-parallel/mpi-node.h"
+#include "aslp-parallel/itf.h"
+
+namespace kaldi {
+
+// ShardedServer: Parameter server of ASGD like workers(see AsgdWorker),
+// sharded by parameter block over the ranks [0, num_servers), the workers
+// are the other ranks.
+// Every shard keeps its params on host, receives the grads of all the
+// workers with non-blocking receives, and applies the grads of one worker
+// with num_threads threads, each updates a different param at a time.
+// The reply to a worker is a copy of the params, sent by a non-blocking
+// send, so the next worker is served at once.
+// Every sync_period synchronizations, the main server(rank 0) holds the
+// replies until all the running workers arrived, the other shards never
+// hold, or they may wait for each other.
+class ShardedServer : public IServer {
+public:
+    ShardedServer(int sync_period, int num_servers, int num_threads);
+    virtual ~ShardedServer();
+    // @params type pair: first is to the gpu data points,
+    //                    second is the size of it
+    void InitParam(const std::vector<std::pair<BaseFloat *, int> > &params);
+    // Start serve, when all workers finished, the params of all the shards
+    // are gathered to the gpu params of the main server
+    void Run();
+protected:
+    // Apply @grad of the worker to @param, the i-th param of the model, it is
+    // called by the update threads at the same time for different params,
+    // never for the same param
+    virtual void UpdateParam(int worker_rank, int i,
+                             const VectorBase<BaseFloat> &grad,
+                             VectorBase<BaseFloat> *param) = 0;
+    int NumServers() const { return num_servers_; }
+    int NumWorkers() const { return NumNodes() - num_servers_; }
+    // From 0 to NumWorkers() - 1
+    int WorkerIndex(int worker_rank) const { return worker_rank - num_servers_; }
+    // The params of the model in this shard
+    const std::vector<int> &ShardParams() const { return shard_params_; }
+private:
+    static void *ThreadMain(void *arg);
+    void UpdateLoop(int worker_rank);
+    // Update the shard params with the grads of the worker by all the threads
+    void ParallelUpdate(int worker_rank);
+    // Send the current params to the worker
+    void Reply(int worker_rank);
+    // Send the params to the main server, or receive the other shards there
+    void GatherParams();
+
+    int32 sync_period_;
+    int num_servers_, num_threads_;
+    // Here we use CuSubVector for that the memory is hold and managed by train model,
+    // CuSubVector only share and update this pointer, refer to CuSubVector for details
+    std::vector<CuSubVector<BaseFloat> *> gpu_params_;
+    std::vector<int> shard_of_; // shard of every param
+    std::vector<int> shard_params_;
+    std::vector<Vector<BaseFloat> *> params_; // of shard_params_
+    // for every worker, of shard_params_
+    std::vector<std::vector<Vector<BaseFloat> *> > recv_params_, send_params_;
+    // for every worker, the msg and then the grads of shard_params_
+    std::vector<MPI_Request> recv_requests_;
+    std::vector<int> msg_;
+    std::vector<int> num_pending_grads_;
+    std::vector<std::vector<MPI_Request> > send_requests_;
+    double update_time_;
+    int64 num_updates_;
+
+    std::vector<pthread_t> threads_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t cond_;
+    // guarded by mutex_
+    int job_id_, job_worker_, num_busy_;
+    bool stop_;
+    int next_param_; // atomic, of the current job
+};
+
+
+} // namespace kaldi
+
+#endif
@@ -2,6 +2,8 @@
  * Author: Zhang Binbin
  */
 
+#include "base/timer.h"
+
 #include "aslp-parallel/sod-worker.h"
 
 namespace kaldi {
@@ -11,17 +13,18 @@ void SodWorker::InitParam(
     gpu_params_.resize(params.size());
     prev_gpu_params_.resize(params.size());
     grad_gpu_params_.resize(params.size());
-    grad_cpu_params_.resize(params.size());
     optimizers_.resize(params.size());
+    std::vector<int> sizes(params.size());
     for (int i = 0; i < params.size(); i++) {
         gpu_params_[i] = new 
             CuSubVector<BaseFloat>(params[i].first, params[i].second); 
         prev_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
         prev_gpu_params_[i]->CopyFromVec(*gpu_params_[i]);
         grad_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
-        grad_cpu_params_[i] = new Vector<BaseFloat>(params[i].second);
         optimizers_[i] = config_.NewInstance(params[i].second);
+        sizes[i] = params[i].second;
     }
+    engine_.Init(sizes);
 }
 
 SodWorker::~SodWorker() {
@@ -29,34 +32,51 @@ SodWorker::~SodWorker() {
         delete gpu_params_[i];
         delete prev_gpu_params_[i];
         delete grad_gpu_params_[i];
-        delete grad_cpu_params_[i];
         delete optimizers_[i];
     }
 }
 
 bool SodWorker::Synchronize(int num_worker_samples) {
+    profiler_.Begin();
     int num_all_samples = num_worker_samples; 
+    // The slowest worker arrives last, the others are idle here
+    Timer timer;
     AllReduce(&num_all_samples, 1);
+    profiler_.Add(kPhaseWait, timer.Elapsed());
     /// All workers finished it's data, return instantly
     if (num_all_samples <= 0) {
         KALDI_LOG << "All worker finished their data";
+        profiler_.End();
         return false;
     }
    
+    timer.Reset();
     for (int i = 0; i < gpu_params_.size(); i++) {
         // 1. calc grad of wg(t), wg(t-1) - w(t) 
         grad_gpu_params_[i]->CopyFromVec(*prev_gpu_params_[i]);
         grad_gpu_params_[i]->AddVec(-1.0, *gpu_params_[i]);
-        grad_cpu_params_[i]->CopyFromVec(*grad_gpu_params_[i]);
-        // 2. reduce
-        AllReduce(grad_cpu_params_[i]->Data(), grad_cpu_params_[i]->Dim());
+        engine_.Buffer(i).CopyFromVec(*grad_gpu_params_[i]);
+    }
+    AllReduceTiming &timing = engine_.Timing();
+    timing.pack = timer.Elapsed();
+    // 2. reduce
+    engine_.Start();
+    engine_.Wait();
+    KALDI_VLOG(1) << "Sod reduce " << timing.reduce << " sent "
+                  << timing.bytes << " bytes";
+    timer.Reset();
+    for (int i = 0; i < gpu_params_.size(); i++) {
         // 3. copy to gpu
-        grad_gpu_params_[i]->CopyFromVec(*grad_cpu_params_[i]);
+        grad_gpu_params_[i]->CopyFromVec(engine_.Buffer(i));
         // 4. using solver to optimize grad_gpu_params_[i]
         optimizers_[i]->Optimize(*grad_gpu_params_[i], gpu_params_[i]);
         // 5. update prev
         prev_gpu_params_[i]->CopyFromVec(*gpu_params_[i]);
     }
+    timing.unpack = timer.Elapsed();
+    // The reduce is never overlapped here
+    timing.AddTo(false, &profiler_);
+    profiler_.End();
     return true;
 }
 
@@ -12,16 +12,21 @@
 
 #include "aslp-parallel/mpi-node.h"
 #include "aslp-parallel/itf.h"
+#include "aslp-parallel/allreduce-engine.h"
 
 #include "aslp-parallel/optimizer.h"
 
 namespace kaldi {
 
 // Synchronous Optimize the Difference between Global and local model
+// The differences are summed by AllReduceEngine, which may compress them, the
+// optimizer needs the sum at once, so the reduce is not overlapped
 
 class SodWorker : public IWorker {
 public:
-    SodWorker(const OptimizerOption &config): config_(config) {}
+    SodWorker(const OptimizerOption &config,
+              const AllReduceOptions &opts = AllReduceOptions()):
+        config_(config), engine_(opts, *this) {}
     ~SodWorker();
     // @params type pair: first is to the gpu data points, 
     //                    second is the size of it
@@ -38,9 +43,9 @@ private:
     std::vector<CuSubVector<BaseFloat> *> gpu_params_;
     std::vector<CuVector<BaseFloat > *> prev_gpu_params_;
     std::vector<CuVector<BaseFloat> *> grad_gpu_params_;
-    std::vector<Vector<BaseFloat> *> grad_cpu_params_;
     std::vector<Optimizer *> optimizers_;
     const OptimizerOption &config_; 
+    AllReduceEngine engine_;
 };
 
 } // namespace kaldi
@@ -0,0 +1,65 @@
+/* Created on 2016-08-28
+ * Author: Zhang Binbin
+ */
+
+#include <algorithm>
+#include <sstream>
+
+#include "util/kaldi-io.h"
+
+#include "aslp-parallel/sync-profiler.h"
+
+namespace kaldi {
+
+void SyncProfiler::End() {
+    KALDI_ASSERT(open_);
+    for (int p = 0; p < kNumPhases; p++) {
+        total_[p] += current_.time[p];
+    }
+    records_.push_back(current_);
+    open_ = false;
+}
+
+std::string SyncProfiler::Summary() {
+    const char *names[kNumPhases] = { "copy", "comm", "wait", "update" };
+    double elapsed = timer_.Elapsed(), max_wait = 0.0;
+    int64 bytes_sent = 0, bytes_recv = 0;
+    for (int i = 0; i < records_.size(); i++) {
+        bytes_sent += records_[i].bytes_sent;
+        bytes_recv += records_[i].bytes_recv;
+        max_wait = std::max(max_wait, records_[i].time[kPhaseWait]);
+    }
+    std::ostringstream os;
+    os << records_.size() << " synchronizations in " << elapsed << " s,";
+    for (int p = 0; p < kNumPhases; p++) {
+        os << (p == 0 ? " " : ", ") << names[p] << " " << total_[p] << " s("
+           << (elapsed > 0.0 ? 100.0 * total_[p] / elapsed : 0.0) << "%)";
+    }
+    os << ", max wait " << max_wait << " s, sent "
+       << bytes_sent / 1048576.0 << " MB, recv "
+       << bytes_recv / 1048576.0 << " MB";
+    if (total_[kPhaseComm] > 0.0) {
+        os << ", " << (bytes_sent + bytes_recv) / 1048576.0 / total_[kPhaseComm]
+           << " MB/s";
+    }
+    return os.str();
+}
+
+void SyncProfiler::WriteTimeline(const std::string &prefix, int rank) const {
+    std::ostringstream filename;
+    filename << prefix << "." << rank;
+    Output ko(filename.str(), false);
+    std::ostream &os = ko.Stream();
+    os << "# index start copy comm wait update sent recv peer\n";
+    for (int i = 0; i < records_.size(); i++) {
+        const SyncRecord &r = records_[i];
+        os << i << " " << r.start;
+        for (int p = 0; p < kNumPhases; p++) {
+            os << " " << r.time[p];
+        }
+        os << " " << r.bytes_sent << " " << r.bytes_recv << " " << r.peer
+           << "\n";
+    }
+}
+
+} // namespace kaldi
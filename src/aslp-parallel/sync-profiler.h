@@ -0,0 +1,84 @@
+/* Created on 2016-08-28
+ * Author: Zhang Binbin
+ */
+
+#ifndef ASLP_PARALLEL_SYNC_PROFILER_H_
+#define ASLP_PARALLEL_SYNC_PROFILER_H_
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+
+namespace kaldi {
+
+// Phases of a synchronization, in seconds
+typedef enum {
+    kPhaseCopy = 0,   // gpu <-> cpu copies, packing and compression
+    kPhaseComm = 1,   // mpi transfer, for the AllReduceEngine it's the reduce
+                      // on the background thread, overlapped with training
+                      // if --overlap-sync
+    kPhaseWait = 2,   // idle, waiting for the peers(the slowest worker, the
+                      // server, or the workers on the server)
+    kPhaseUpdate = 3, // model update on the synchronized params
+    kNumPhases = 4
+} SyncPhase;
+
+struct SyncRecord {
+    SyncRecord(): start(0.0), bytes_sent(0), bytes_recv(0), peer(-1) {
+        for (int p = 0; p < kNumPhases; p++) time[p] = 0.0;
+    }
+    double start; // seconds since the profiler is created
+    double time[kNumPhases];
+    int64 bytes_sent, bytes_recv;
+    int peer; // the worker rank served by a server, -1 for the workers
+};
+
+// SyncProfiler: The time by phase and the bytes of every synchronization
+// of a worker, or every update of a server, see IWorker and IServer.
+// The records are kept in memory, and written as a per-rank timeline
+// <prefix>.<rank> by WriteTimeline, one line a record:
+//   <index> <start> <copy> <comm> <wait> <update> <sent> <recv> <peer>
+// see aslp_scripts/mpi_sync_analyse.sh
+class SyncProfiler {
+public:
+    SyncProfiler(): open_(false) {
+        for (int p = 0; p < kNumPhases; p++) total_[p] = 0.0;
+    }
+    // Start a new record, the time before it is not recorded
+    void Begin(int peer = -1) {
+        current_ = SyncRecord();
+        current_.start = timer_.Elapsed();
+        current_.peer = peer;
+        open_ = true;
+    }
+    bool IsOpen() const { return open_; }
+    void SetPeer(int peer) { current_.peer = peer; }
+    void Add(SyncPhase phase, double seconds) {
+        KALDI_ASSERT(open_);
+        current_.time[phase] += seconds;
+    }
+    void AddBytes(int64 sent, int64 recv) {
+        KALDI_ASSERT(open_);
+        current_.bytes_sent += sent;
+        current_.bytes_recv += recv;
+    }
+    void End();
+    int32 NumRecords() const { return records_.size(); }
+    const std::vector<SyncRecord> &Records() const { return records_; }
+    // One line summary of all the records and the time since the profiler
+    // is created, eg. for KALDI_LOG
+    std::string Summary();
+    void WriteTimeline(const std::string &prefix, int rank) const;
+private:
+    Timer timer_;
+    bool open_;
+    SyncRecord current_;
+    std::vector<SyncRecord> records_;
+    double total_[kNumPhases];
+};
+
+} // namespace kaldi
+
+#endif
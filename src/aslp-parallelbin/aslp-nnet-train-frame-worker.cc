@@ -70,6 +70,12 @@ int main(int argc, char *argv[]) {
         po.Register("bmuf-learn-rate", &bmuf_learn_rate, "learn rate for bmuf worker");
         int sync_period = 25600;
         po.Register("sync-period", &sync_period, "number frames for every synchronization");
+        int num_servers = 1;
+        po.Register("num-servers", &num_servers, "Number of server ranks for asgd and masgd worker, the same as the server");
+        AllReduceOptions allreduce_opts; // for bsp, bmuf and sod worker, compress for easgd
+        allreduce_opts.Register(&po);
+        std::string sync_profile = "";
+        po.Register("sync-profile", &sync_profile, "If not empty, write the timeline of the synchronizations of every rank to <sync-profile>.<rank>, see aslp_scripts/mpi_sync_analyse.sh");
         int gpu_id = -1;
         po.Register("gpu-id", &gpu_id, "selected gpu id, if negative then select automaticly");
         
@@ -112,15 +118,15 @@ int main(int argc, char *argv[]) {
         // Init Worker
         IWorker *worker = NULL;
         if (worker_type == "bsp") {
-            worker = new BspWorker();
+            worker = new BspWorker(allreduce_opts);
         } else if (worker_type == "easgd") {
-            worker = new EasgdWorker(alpha);
+            worker = new EasgdWorker(alpha, allreduce_opts.compress);
         } else if (worker_type == "bmuf") {
-            worker = new BmufWorker(bmuf_learn_rate, bmuf_momentum);
+            worker = new BmufWorker(bmuf_learn_rate, bmuf_momentum, allreduce_opts);
         } else if (worker_type == "asgd" || worker_type == "masgd") {
-            worker = new AsgdWorker();
+            worker = new AsgdWorker(num_servers);
         } else if (worker_type == "sod") {
-            worker = new SodWorker(optimizer_opts);
+            worker = new SodWorker(optimizer_opts, allreduce_opts);
         } else {
             KALDI_ERR << "Unsupported worker type: " << worker_type;
         }
@@ -170,6 +176,11 @@ int main(int argc, char *argv[]) {
 
         // Stop worker
         worker->Stop();
+        KALDI_LOG << "Worker " << worker->Rank() << " sync profile, "
+                  << worker->Profiler().Summary();
+        if (sync_profile != "") {
+            worker->Profiler().WriteTimeline(sync_profile, worker->Rank());
+        }
 
         // Acc stats
         std::vector<double *> acc_params; 
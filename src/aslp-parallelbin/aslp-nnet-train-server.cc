@@ -17,6 +17,7 @@
 #include "aslp-parallel/itf.h"
 #include "aslp-parallel/easgd-server.h"
 #include "aslp-parallel/asgd-server.h"
+#include "aslp-parallel/masgd-server.h"
 
 
 int main(int argc, char *argv[]) {
@@ -48,6 +49,14 @@ int main(int argc, char *argv[]) {
         po.Register("gpu-id", &gpu_id, "selected gpu id, if negative then select automaticly");
         float masgd_momentum = 0.9;
         po.Register("masgd-momentum", &masgd_momentum, "momentum for masgd");
+        int num_servers = 1;
+        po.Register("num-servers", &num_servers, "Number of server ranks for asgd and masgd server, the model is sharded over them, the same for the workers");
+        int num_update_threads = 4;
+        po.Register("num-update-threads", &num_update_threads, "Number of threads to update the model shard for asgd and masgd server");
+        std::string compress = "none";
+        po.Register("compress", &compress, "Compress the exchanged models for easgd server(none | fp16), must be the same as the workers");
+        std::string sync_profile = "";
+        po.Register("sync-profile", &sync_profile, "If not empty, write the timeline of the served workers of every server rank to <sync-profile>.<rank>, see aslp_scripts/mpi_sync_analyse.sh");
         
         po.Read(argc, argv);
 
@@ -72,11 +81,11 @@ int main(int argc, char *argv[]) {
         // Init Server
         IServer *server = NULL;
         if (server_type == "easgd") {
-            server = new EasgdServer(alpha);
+            server = new EasgdServer(alpha, compress);
         } else if (server_type == "asgd") {
-            server = new AsgdServer(alpha, sync_period);
+            server = new AsgdServer(alpha, sync_period, num_servers, num_update_threads);
         } else if (server_type == "masgd") {
-            server = new MasgdServer(sync_period, masgd_momentum);
+            server = new MasgdServer(sync_period, masgd_momentum, num_servers, num_update_threads);
         }
         else {
             KALDI_ERR << "Unsupported server type: " << server_type;
@@ -89,6 +98,11 @@ int main(int argc, char *argv[]) {
         
         // Run loop until all worker finished
         server->Run();
+        KALDI_LOG << "Server " << server->Rank() << " sync profile, "
+                  << server->Profiler().Summary();
+        if (sync_profile != "") {
+            server->Profiler().WriteTimeline(sync_profile, server->Rank());
+        }
 
         // Acc stats
         std::vector<double *> acc_params; 
@@ -96,7 +110,10 @@ int main(int argc, char *argv[]) {
         nnet.GetAccStats(&acc_params, &data_params);
         server->ReduceAccStat(acc_params, data_params);
 
-        nnet.Write(target_model_filename, binary);
+        // The model is gathered to the main server
+        if (server->IsMainNode()) {
+            nnet.Write(target_model_filename, binary);
+        }
         if (server != NULL) delete server;
 
 #if HAVE_CUDA==1
@@ -19,12 +19,12 @@ void NnetVad::GetScore(const Matrix<BaseFloat> &feat) {
     // Set nnet stream for recurrent component
     std::vector<int> frame_num_utt;
     frame_num_utt.push_back(feat.NumRows());
-    const_cast<Nnet &>(nnet_).SetSeqLengths(frame_num_utt);
+    nnet_state_.SetSeqLengths(frame_num_utt);
 
     CuMatrix<BaseFloat> cu_nnet_out;
     Matrix<BaseFloat> nnet_out_host;
     // Get likelyhood
-    const_cast<Nnet &>(nnet_).Feedforward(CuMatrix<BaseFloat>(feat), &cu_nnet_out);
+    nnet_.Feedforward(CuMatrix<BaseFloat>(feat), &cu_nnet_out, &nnet_state_);
     cu_nnet_out.Swap(&nnet_out_host);
     for (int i = 0; i < nnet_out_host.NumRows(); i++) 
         sil_score_[i] = nnet_out_host(i, 0);
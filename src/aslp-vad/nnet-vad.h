@@ -29,10 +29,11 @@ public:
     NnetVad(const Nnet &nnet, const NnetVadOptions &nnet_vad_config): 
             Vad(nnet_vad_config),
             nnet_(nnet), 
+            nnet_state_(nnet),
             nnet_vad_config_(nnet_vad_config) {
         // Reset lstm state for lstm model
         std::vector<int> flags(1, 1);
-        const_cast<Nnet &>(nnet_).ResetLstmStreams(flags);
+        nnet_state_.ResetLstmStreams(flags);
     } 
 
     virtual bool IsSilence(int frame) const; 
@@ -56,6 +57,8 @@ public:
 protected:
     std::vector<float> sil_score_;
     const Nnet &nnet_;
+    // Forward state of this vad, nnet_ may be shared by many vads
+    aslp_nnet::NnetState nnet_state_;
     const NnetVadOptions &nnet_vad_config_;
 };
 